@@ -0,0 +1,586 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  cpubench.c - Mesura les instruccions per segon de la UCP amb un
+ *               bucle MIPS sintètic.
+ *
+ */
+/*
+ * NOTA: No cal cap BIOS ni disc. Es construeix en memòria una BIOS
+ * que copia un bucle a la RAM i salta a ell. El bucle mescla ALU,
+ * desplaçaments, accessos a memòria, un salt condicional i una
+ * subrutina, i no acaba mai. Cada iteració incrementa un comptador
+ * en un registre, de manera que les instruccions executades es poden
+ * calcular sense compilar la llibreria amb PSX_COUNTERS.
+ */
+
+
+#define _POSIX_C_SOURCE 199309L
+
+#ifdef PSX_MULTI_INSTANCE
+#include <pthread.h>
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define DEFAULT_CYCLES 300000000L
+#define CHUNK_CYCLES 100000
+#define MAX_THREADS 64
+
+// Registres.
+#define ZERO 0
+#define V0 2
+#define T0 8
+#define T1 9
+#define T2 10
+#define T3 11
+#define T4 12
+#define T5 13
+#define T6 14
+#define S0 16
+#define S1 17
+#define S2 18
+#define S3 19
+#define RA 31
+
+// Codificació.
+#define R_INST(RS,RT,RD,SA,FN)        					\
+  ((uint32_t) (((RS)<<21)|((RT)<<16)|((RD)<<11)|((SA)<<6)|(FN)))
+#define I_INST(OP,RS,RT,IMM)        					\
+  ((uint32_t) (((OP)<<26)|((RS)<<21)|((RT)<<16)|((IMM)&0xFFFF)))
+#define J_INST(OP,ADDR) ((uint32_t) (((OP)<<26)|(((ADDR)>>2)&0x3FFFFFF)))
+
+#define NOP 0x00000000
+#define SLL(RD,RT,SA) R_INST ( 0, RT, RD, SA, 0x00 )
+#define SRL(RD,RT,SA) R_INST ( 0, RT, RD, SA, 0x02 )
+#define JR(RS) R_INST ( RS, 0, 0, 0, 0x08 )
+#define ADDU(RD,RS,RT) R_INST ( RS, RT, RD, 0, 0x21 )
+#define SUBU(RD,RS,RT) R_INST ( RS, RT, RD, 0, 0x23 )
+#define OR(RD,RS,RT) R_INST ( RS, RT, RD, 0, 0x25 )
+#define XOR(RD,RS,RT) R_INST ( RS, RT, RD, 0, 0x26 )
+#define SLT(RD,RS,RT) R_INST ( RS, RT, RD, 0, 0x2A )
+#define J(ADDR) J_INST ( 0x02, ADDR )
+#define JAL(ADDR) J_INST ( 0x03, ADDR )
+#define BEQ(RS,RT,OFF) I_INST ( 0x04, RS, RT, OFF )
+#define BNE(RS,RT,OFF) I_INST ( 0x05, RS, RT, OFF )
+#define ADDIU(RT,RS,IMM) I_INST ( 0x09, RS, RT, IMM )
+#define ANDI(RT,RS,IMM) I_INST ( 0x0C, RS, RT, IMM )
+#define ORI(RT,RS,IMM) I_INST ( 0x0D, RS, RT, IMM )
+#define LUI(RT,IMM) I_INST ( 0x0F, 0, RT, IMM )
+#define LW(RT,OFF,RS) I_INST ( 0x23, RS, RT, OFF )
+#define LBU(RT,OFF,RS) I_INST ( 0x24, RS, RT, OFF )
+#define SW(RT,OFF,RS) I_INST ( 0x2B, RS, RT, OFF )
+
+// On es copia el bucle i on llig/escriu.
+#define CODE_ADDR 0x80010000
+#define DATA_ADDR 0x80020000
+#define CODE_BIOS_OFF 0x100
+
+// Posicions dins del bucle.
+#define LOOP_POS 4
+#define SUB_POS 22
+#define ADDR(POS) (CODE_ADDR + (POS)*4)
+
+// Instruccions que s'executen en cada iteració sense contar la que
+// sols s'executa quan no es pren el salt (la que incrementa S3).
+#define LOOP_INSTS 21
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+
+  long            ncycles;
+  PSX_CPUBackend  cpu;
+  int             nthreads; // 0 vol dir sense fils.
+
+} args_t;
+
+// Resultat d'una màquina.
+typedef struct
+{
+
+  const args_t   *args;
+  const uint8_t  *bios;
+  bool            ok;
+  double          t;
+  long            cc;
+  uint32_t        iters;
+  uint64_t        ninsts;
+  uint32_t        check;
+
+} result_t;
+
+
+
+
+/************/
+/* PROGRAMA */
+/************/
+
+// Copia els NWORDS de CODE_BIOS_OFF a CODE_ADDR i salta.
+static const uint32_t BOOT[]=
+  {
+    LUI ( T0, CODE_ADDR>>16 ),
+    LUI ( T1, 0xBFC0 ),
+    ORI ( T1, T1, CODE_BIOS_OFF ),
+    ORI ( T2, ZERO, 0 ), // NWORDS, es fixa en build_bios.
+    /* copy: */
+    LW ( T3, 0, T1 ),
+    ADDIU ( T1, T1, 4 ),
+    ADDIU ( T2, T2, -1 ),
+    SW ( T3, 0, T0 ),
+    BNE ( T2, ZERO, -5 ), // copy
+    ADDIU ( T0, T0, 4 ),
+    LUI ( T0, CODE_ADDR>>16 ),
+    JR ( T0 ),
+    NOP
+  };
+
+// S0 compta iteracions i S3 els salts no presos.
+static const uint32_t CODE[]=
+  {
+    LUI ( S1, DATA_ADDR>>16 ),
+    OR ( S0, ZERO, ZERO ),
+    OR ( S3, ZERO, ZERO ),
+    ORI ( S2, ZERO, 0x1234 ),
+    /* loop (LOOP_POS): */
+    LW ( T0, 0, S1 ),
+    ADDIU ( S0, S0, 1 ),
+    ADDU ( T1, T0, S2 ),
+    SLL ( T2, T1, 3 ),
+    XOR ( S2, T2, S0 ),
+    SRL ( T3, S2, 7 ),
+    ANDI ( T3, T3, 0x3FC ),
+    ADDU ( T4, S1, T3 ),
+    SW ( S2, 0, T4 ),
+    LBU ( T5, 1, T4 ),
+    JAL ( ADDR(SUB_POS) ),
+    NOP,
+    SLT ( T6, T5, S2 ),
+    BEQ ( T6, ZERO, 2 ),
+    ADDIU ( S2, S2, -3 ),
+    ADDIU ( S3, S3, 1 ),
+    J ( ADDR(LOOP_POS) ),
+    NOP,
+    /* sub (SUB_POS): */
+    SUBU ( V0, S2, S0 ),
+    OR ( V0, V0, T0 ),
+    JR ( RA ),
+    SW ( V0, 4, S1 )
+  };
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+usage (
+       const char *prog
+       )
+{
+
+  fprintf ( stderr,
+            "Ús: %s [opcions]\n"
+            "\n"
+            "Opcions:\n"
+            "  -n N     Cicles a executar (per defecte %ld)\n"
+            "  -c UCP   Implementació de la UCP: interp, cache o rec\n"
+#ifdef PSX_MULTI_INSTANCE
+            "  -j N     Executa N màquines, cadascuna en el seu context\n"
+            "           i el seu fil, i les compara amb una execució de\n"
+            "           referència (màxim %d)\n"
+#endif
+            , prog, DEFAULT_CYCLES
+#ifdef PSX_MULTI_INSTANCE
+            , MAX_THREADS
+#endif
+            );
+
+} // end usage
+
+
+static bool
+parse_args (
+            int      argc,
+            char    *argv[],
+            args_t  *args
+            )
+{
+
+  int i;
+  char *end;
+
+
+  memset ( args, 0, sizeof(*args) );
+  args->ncycles= DEFAULT_CYCLES;
+  args->cpu= PSX_CPU_INTERPRETER;
+  for ( i= 1; i < argc; ++i )
+    {
+      if ( !strcmp ( argv[i], "-n" ) && i+1 < argc )
+        {
+          args->ncycles= strtol ( argv[++i], &end, 10 );
+          if ( *end != '\0' || args->ncycles <= 0 ) return false;
+        }
+      else if ( !strcmp ( argv[i], "-c" ) && i+1 < argc )
+        {
+          ++i;
+          if ( !strcmp ( argv[i], "interp" ) )
+            args->cpu= PSX_CPU_INTERPRETER;
+          else if ( !strcmp ( argv[i], "cache" ) )
+            args->cpu= PSX_CPU_CACHED_INTERPRETER;
+          else if ( !strcmp ( argv[i], "rec" ) )
+            args->cpu= PSX_CPU_RECOMPILER;
+          else return false;
+        }
+#ifdef PSX_MULTI_INSTANCE
+      else if ( !strcmp ( argv[i], "-j" ) && i+1 < argc )
+        {
+          args->nthreads= (int) strtol ( argv[++i], &end, 10 );
+          if ( *end != '\0' || args->nthreads <= 0 ||
+               args->nthreads > MAX_THREADS )
+            return false;
+        }
+#endif
+      else return false;
+    }
+
+  return true;
+
+} // end parse_args
+
+
+static void
+put_words (
+           uint8_t         bios[PSX_BIOS_SIZE],
+           const int       off,
+           const uint32_t *words,
+           const int       nwords
+           )
+{
+
+  int i;
+  uint8_t *p;
+
+
+  for ( i= 0, p= &(bios[off]); i < nwords; ++i, p+= 4 )
+    {
+      p[0]= (uint8_t) words[i];
+      p[1]= (uint8_t) (words[i]>>8);
+      p[2]= (uint8_t) (words[i]>>16);
+      p[3]= (uint8_t) (words[i]>>24);
+    }
+
+} // end put_words
+
+
+static void
+build_bios (
+            uint8_t bios[PSX_BIOS_SIZE]
+            )
+{
+
+  uint32_t boot[sizeof(BOOT)/sizeof(BOOT[0])];
+  const int nwords= (int) (sizeof(CODE)/sizeof(CODE[0]));
+
+
+  memset ( bios, 0, PSX_BIOS_SIZE );
+  memcpy ( boot, BOOT, sizeof(boot) );
+  boot[3]= ORI ( T2, ZERO, nwords );
+  put_words ( bios, 0, boot, (int) (sizeof(boot)/sizeof(boot[0])) );
+  put_words ( bios, CODE_BIOS_OFF, CODE, nwords );
+
+} // end build_bios
+
+
+static double
+get_time (void)
+{
+
+  struct timespec t;
+
+
+  clock_gettime ( CLOCK_MONOTONIC, &t );
+
+  return t.tv_sec + t.tv_nsec*1e-9;
+
+} // end get_time
+
+
+
+
+/************/
+/* FRONTEND */
+/************/
+
+static void
+warning (
+         void       *udata,
+         const char *format,
+         ...
+         )
+{
+} // end warning
+
+
+static void
+play_sound (
+            const int16_t  samples[PSX_AUDIO_BUFFER_SIZE*2],
+            void          *udata
+            )
+{
+} // end play_sound
+
+
+static const PSX_ControllerState *
+get_ctrl_state (
+                const int  joy,
+                void      *udata
+                )
+{
+  return NULL;
+} // end get_ctrl_state
+
+
+
+
+/***********/
+/* MÀQUINA */
+/***********/
+
+// Inicialitza i executa una màquina en el context actiu.
+static void
+run_machine (
+             result_t *res
+             )
+{
+
+  PSX_Frontend frontend;
+  PSX_Options opts;
+  PSX_Renderer *renderer;
+  long cc;
+  double t0;
+  bool stop;
+
+
+  // Inicialitza. La BIOS és de només lectura i es comparteix.
+  res->ok= false;
+  memset ( &frontend, 0, sizeof(frontend) );
+  frontend.warning= warning;
+  frontend.play_sound= play_sound;
+  frontend.get_ctrl_state= get_ctrl_state;
+  memset ( &opts, 0, sizeof(opts) );
+  opts.cpu= res->args->cpu;
+  opts.no_idle_skip= true;
+  opts.shared_bios= true;
+  renderer= PSX_create_stats_renderer ();
+  if ( renderer == NULL ) return;
+  PSX_init ( res->bios, &frontend, NULL, renderer, &opts );
+
+  // Executa.
+  stop= false;
+  cc= 0;
+  t0= get_time ();
+  while ( cc < res->args->ncycles )
+    cc+= PSX_iter ( CHUNK_CYCLES, &stop );
+  res->t= get_time () - t0;
+
+  // Resultats. La iteració en curs no es conta.
+  res->cc= cc;
+  res->iters= PSX_cpu_regs.gpr[S0].v;
+  res->ninsts= (uint64_t) PSX_cpu_regs.gpr[S0].v*LOOP_INSTS +
+    PSX_cpu_regs.gpr[S3].v;
+  res->check= PSX_cpu_regs.gpr[S2].v;
+  PSX_renderer_free ( renderer );
+  res->ok= true;
+
+} // end run_machine
+
+
+#ifdef PSX_MULTI_INSTANCE
+// Executa una màquina en un context propi.
+static void *
+run_context (
+             void *data
+             )
+{
+
+  result_t *res;
+  PSX_Context *ctx;
+
+
+  res= (result_t *) data;
+  res->ok= false;
+  ctx= PSX_context_new ();
+  if ( ctx == NULL ) return NULL;
+  PSX_context_make_current ( ctx );
+  run_machine ( res );
+  PSX_context_free ( ctx );
+
+  return NULL;
+
+} // end run_context
+
+
+// Executa ARGS->nthreads màquines en paral·lel i comprova que totes
+// acaben igual que REF.
+static bool
+run_threads (
+             const args_t   *args,
+             const uint8_t  *bios,
+             const result_t *ref
+             )
+{
+
+  static result_t res[MAX_THREADS];
+  static pthread_t threads[MAX_THREADS];
+
+  int i,n;
+  uint64_t ninsts;
+  double t0,t;
+  bool ok;
+
+
+  t0= get_time ();
+  for ( n= 0; n < args->nthreads; ++n )
+    {
+      res[n].args= args;
+      res[n].bios= bios;
+      if ( pthread_create ( &threads[n], NULL, run_context, &res[n] ) != 0 )
+        {
+          fprintf ( stderr, "no s'ha pogut crear el fil %d\n", n );
+          break;
+        }
+    }
+  for ( i= 0; i < n; ++i )
+    pthread_join ( threads[i], NULL );
+  t= get_time () - t0;
+  if ( n != args->nthreads ) return false;
+
+  ok= true;
+  ninsts= 0;
+  for ( i= 0; i < n; ++i )
+    {
+      if ( !res[i].ok || res[i].cc != ref->cc ||
+           res[i].iters != ref->iters || res[i].check != ref->check )
+        {
+          fprintf ( stderr, "fil %d: resultat distint de la referència\n", i );
+          ok= false;
+        }
+      ninsts+= res[i].ninsts;
+    }
+  printf ( "fils:          %d\n", n );
+  printf ( "temps (fils):  %.3f s\n", t );
+  printf ( "MIPS (total):  %.2f\n", ninsts/t/1e6 );
+  printf ( "comparació:    %s\n", ok ? "OK" : "DISTINT" );
+
+  return ok;
+
+} // end run_threads
+#endif
+
+
+
+
+/********************/
+/* FUNCIÓ PRINCIPAL */
+/********************/
+
+int
+main (
+      int   argc,
+      char *argv[]
+      )
+{
+
+  static _Alignas(4) uint8_t bios[PSX_BIOS_SIZE];
+
+  args_t args;
+  result_t res;
+#ifdef PSX_MULTI_INSTANCE
+  PSX_Context *ctx;
+#endif
+
+
+  // Arguments.
+  if ( !parse_args ( argc, argv, &args ) )
+    {
+      usage ( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+  // Referència.
+  build_bios ( bios );
+  res.args= &args;
+  res.bios= bios;
+#ifdef PSX_MULTI_INSTANCE
+  ctx= PSX_context_new ();
+  if ( ctx == NULL )
+    {
+      fprintf ( stderr, "no s'ha pogut crear el context\n" );
+      return EXIT_FAILURE;
+    }
+  PSX_context_make_current ( ctx );
+#endif
+  run_machine ( &res );
+#ifdef PSX_MULTI_INSTANCE
+  PSX_context_free ( ctx );
+#endif
+  if ( !res.ok )
+    {
+      fprintf ( stderr, "no s'ha pogut crear el renderer\n" );
+      return EXIT_FAILURE;
+    }
+  printf ( "temps:         %.3f s\n", res.t );
+  printf ( "cicles:        %ld\n", res.cc );
+  printf ( "iteracions:    %u\n", res.iters );
+  printf ( "instruccions:  %llu\n", (unsigned long long) res.ninsts );
+  printf ( "MIPS:          %.2f\n", res.ninsts/res.t/1e6 );
+  printf ( "check:         %08X\n", res.check );
+
+#ifdef PSX_MULTI_INSTANCE
+  // Diverses màquines.
+  if ( args.nthreads > 0 && !run_threads ( &args, bios, &res ) )
+    return EXIT_FAILURE;
+#endif
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,553 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  psxbench.c - Executa el simulador sense so ni pantalla i mesura el
+ *               rendiment.
+ *
+ */
+/*
+ * NOTA: S'empra el renderer per defecte (es rasteritza igual que en
+ * un frontend real) però la pantalla no es mostra. Al final es mostra
+ * un hash de la RAM i la VRAM per a comprovar que un canvi de
+ * rendiment no ha canviat el resultat.
+ */
+
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define DEFAULT_FRAMES 600
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+
+  const char     *bios_fn;
+  const char     *cd_fn;    // Pot ser NULL.
+  long            nframes;
+  PSX_CPUBackend  cpu;
+  bool            stats;    // Empra el stats_renderer.
+  bool            threaded; // Dibuixa en un altre fil.
+  int             bands;    // Fils del band_renderer (0 no s'empra).
+  bool            fast_boot;
+  bool            bios_hle;
+  bool            no_idle_skip;
+  int             frameskip;
+
+} args_t;
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+static long _nwarnings;
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+usage (
+       const char *prog
+       )
+{
+
+  fprintf ( stderr,
+            "Ús: %s [opcions] BIOS [CDIMG]\n"
+            "\n"
+            "Opcions:\n"
+            "  -f N     Frames a executar (per defecte %d)\n"
+            "  -c UCP   Implementació de la UCP: interp, cache o rec\n"
+            "  -s       Empra el stats_renderer en compte del de defecte\n"
+            "  -T       Dibuixa en un fil a banda (threaded_renderer)\n"
+            "  -B N     Dibuixa amb N fils, un per banda (band_renderer)\n"
+            "  -b       Arrancada ràpida (bota la intro de la BIOS)\n"
+            "  -H       HLE de les funcions de la BIOS\n"
+            "  -I       Desactiva la detecció de bucles d'espera\n"
+            "  -F N     Frameskip: sols es mostra 1 de cada N+1 frames\n",
+            prog, DEFAULT_FRAMES );
+
+} // end usage
+
+
+static bool
+parse_args (
+            int      argc,
+            char    *argv[],
+            args_t  *args
+            )
+{
+
+  int i;
+  char *end;
+
+
+  memset ( args, 0, sizeof(*args) );
+  args->nframes= DEFAULT_FRAMES;
+  args->cpu= PSX_CPU_INTERPRETER;
+  for ( i= 1; i < argc && argv[i][0] == '-'; ++i )
+    {
+      if ( !strcmp ( argv[i], "-f" ) && i+1 < argc )
+        {
+          args->nframes= strtol ( argv[++i], &end, 10 );
+          if ( *end != '\0' || args->nframes <= 0 ) return false;
+        }
+      else if ( !strcmp ( argv[i], "-c" ) && i+1 < argc )
+        {
+          ++i;
+          if ( !strcmp ( argv[i], "interp" ) )
+            args->cpu= PSX_CPU_INTERPRETER;
+          else if ( !strcmp ( argv[i], "cache" ) )
+            args->cpu= PSX_CPU_CACHED_INTERPRETER;
+          else if ( !strcmp ( argv[i], "rec" ) )
+            args->cpu= PSX_CPU_RECOMPILER;
+          else return false;
+        }
+      else if ( !strcmp ( argv[i], "-F" ) && i+1 < argc )
+        {
+          args->frameskip= (int) strtol ( argv[++i], &end, 10 );
+          if ( *end != '\0' || args->frameskip < 0 ) return false;
+        }
+      else if ( !strcmp ( argv[i], "-B" ) && i+1 < argc )
+        {
+          args->bands= (int) strtol ( argv[++i], &end, 10 );
+          if ( *end != '\0' || args->bands <= 0 ) return false;
+        }
+      else if ( !strcmp ( argv[i], "-s" ) ) args->stats= true;
+      else if ( !strcmp ( argv[i], "-T" ) ) args->threaded= true;
+      else if ( !strcmp ( argv[i], "-b" ) ) args->fast_boot= true;
+      else if ( !strcmp ( argv[i], "-H" ) ) args->bios_hle= true;
+      else if ( !strcmp ( argv[i], "-I" ) ) args->no_idle_skip= true;
+      else return false;
+    }
+  if ( i == argc || argc-i > 2 ) return false;
+  args->bios_fn= argv[i];
+  args->cd_fn= i+1 < argc ? argv[i+1] : NULL;
+
+  return true;
+
+} // end parse_args
+
+
+static bool
+load_bios (
+           const char *fn,
+           uint8_t     bios[PSX_BIOS_SIZE]
+           )
+{
+
+  FILE *f;
+  size_t n;
+
+
+  f= fopen ( fn, "rb" );
+  if ( f == NULL )
+    {
+      fprintf ( stderr, "no s'ha pogut obrir '%s'\n", fn );
+      return false;
+    }
+  n= fread ( bios, 1, PSX_BIOS_SIZE, f );
+  if ( n != PSX_BIOS_SIZE || fgetc ( f ) != EOF )
+    {
+      fprintf ( stderr, "'%s' no és una BIOS de %d bytes\n",
+                fn, PSX_BIOS_SIZE );
+      fclose ( f );
+      return false;
+    }
+  fclose ( f );
+
+  return true;
+
+} // end load_bios
+
+
+static double
+get_time (void)
+{
+
+  struct timespec t;
+
+
+  clock_gettime ( CLOCK_MONOTONIC, &t );
+
+  return t.tv_sec + t.tv_nsec*1e-9;
+
+} // end get_time
+
+
+static uint64_t
+fnv (
+     uint64_t     h,
+     const void  *data,
+     const size_t nbytes
+     )
+{
+
+  const uint8_t *p;
+  size_t i;
+
+
+  p= (const uint8_t *) data;
+  for ( i= 0; i < nbytes; ++i )
+    h= (h^p[i])*FNV_PRIME;
+
+  return h;
+
+} // end fnv
+
+
+static uint64_t
+ram_hash (void)
+{
+
+  uint64_t h;
+  int i,page;
+
+
+  h= FNV_OFFSET;
+  for ( i= 0; i < PSX_MEM_CODE_RAM_PAGES; ++i )
+    h= fnv ( h,
+             PSX_mem_get_code_page ( (uint32_t) i*PSX_MEM_CODE_PAGE_SIZE,
+                                     &page ),
+             PSX_MEM_CODE_PAGE_SIZE );
+
+  return h;
+
+} // end ram_hash
+
+
+// Sols si la llibreria s'ha compilat amb PSX_PROFILE.
+static void
+print_profile (void)
+{
+
+  static const char *names[PSX_PROFILE_NUM]=
+    { "UCP", "GPU", "SPU", "MDEC", "DMA", "CD", "Altres" };
+
+  PSX_Profile prof;
+  uint64_t total;
+  int i;
+
+
+  if ( !PSX_get_profile ( &prof ) ) return;
+  total= 0;
+  for ( i= 0; i < PSX_PROFILE_NUM; ++i )
+    total+= prof.ns[i];
+  printf ( "perfil:\n" );
+  for ( i= 0; i < PSX_PROFILE_NUM; ++i )
+    printf ( "  %-8s %10.3f ms  %5.1f%%  %12llu crides\n",
+             names[i], prof.ns[i]/1e6,
+             total > 0 ? 100.0*prof.ns[i]/total : 0.0,
+             (unsigned long long) prof.calls[i] );
+
+} // end print_profile
+
+
+// Sols si la llibreria s'ha compilat amb PSX_COUNTERS.
+static void
+print_counters (void)
+{
+
+  static const char *regions[PSX_COUNTERS_NUM_REGIONS]=
+    { "RAM", "scratchpad", "BIOS", "E/S", "altres" };
+  static const char *prims[PSX_GP0_UNK]=
+    {
+      [PSX_GP0_POL3]= "pol3",
+      [PSX_GP0_POL4]= "pol4",
+      [PSX_GP0_LINE]= "segment",
+      [PSX_GP0_RECT]= "rectangle",
+      [PSX_GP0_FILL]= "emplena",
+      [PSX_GP0_COPY_VRAM2VRAM]= "vram2vram"
+    };
+  
+  PSX_Counters cnt;
+  uint64_t n;
+  int i;
+
+
+  if ( !PSX_get_counters ( &cnt ) ) return;
+  printf ( "comptadors:\n" );
+  printf ( "  instruccions  %llu\n", (unsigned long long) cnt.insts );
+  for ( i= 0; i < PSX_COUNTERS_NUM_REGIONS; ++i )
+    printf ( "  %-12s  %llu lectures, %llu escriptures\n",
+             regions[i], (unsigned long long) cnt.loads[i],
+             (unsigned long long) cnt.stores[i] );
+  n= 0;
+  for ( i= 0; i < 64; ++i )
+    n+= cnt.gte_cmds[i];
+  printf ( "  GTE           %llu\n", (unsigned long long) n );
+  for ( i= 0; i < PSX_GP0_UNK; ++i )
+    if ( prims[i] != NULL )
+      printf ( "  %-12s  %llu\n", prims[i],
+               (unsigned long long) cnt.gpu_prims[i] );
+  printf ( "  píxels        %llu\n", (unsigned long long) cnt.gpu_pixels );
+  for ( i= 0; i < 7; ++i )
+    printf ( "  DMA%d          %llu paraules\n", i,
+             (unsigned long long) cnt.dma_words[i] );
+  printf ( "  mostres SPU   %llu\n", (unsigned long long) cnt.spu_samples );
+  printf ( "  sectors CD    %llu\n", (unsigned long long) cnt.cd_sectors );
+  for ( i= 0; i < PSX_COUNTERS_NUM_INTS; ++i )
+    printf ( "  IRQ%-2d         %llu\n", i, (unsigned long long) cnt.ints[i] );
+
+} // end print_counters
+
+
+static uint64_t
+vram_hash (void)
+{
+  return fnv ( FNV_OFFSET, PSX_gpu_get_frame_buffer (), 1024*512*2 );
+} // end vram_hash
+
+
+
+
+/************/
+/* FRONTEND */
+/************/
+
+static void
+warning (
+         void       *udata,
+         const char *format,
+         ...
+         )
+{
+
+  va_list ap;
+
+
+  ++_nwarnings;
+  va_start ( ap, format );
+  fprintf ( stderr, "Avís: " );
+  vfprintf ( stderr, format, ap );
+  putc ( '\n', stderr );
+  va_end ( ap );
+
+} // end warning
+
+
+static void
+play_sound (
+            const int16_t  samples[PSX_AUDIO_BUFFER_SIZE*2],
+            void          *udata
+            )
+{
+} // end play_sound
+
+
+static const PSX_ControllerState *
+get_ctrl_state (
+                const int  joy,
+                void      *udata
+                )
+{
+
+  static const PSX_ControllerState idle= { 0 };
+
+
+  return joy == 0 ? &idle : NULL;
+
+} // end get_ctrl_state
+
+
+static void
+update_screen (
+               const uint32_t                 *fb,
+               const PSX_UpdateScreenGeometry *g,
+               void                           *udata
+               )
+{
+} // end update_screen
+
+
+
+
+/********************/
+/* FUNCIÓ PRINCIPAL */
+/********************/
+
+int
+main (
+      int   argc,
+      char *argv[]
+      )
+{
+
+  static uint8_t bios[PSX_BIOS_SIZE];
+
+  args_t args;
+  PSX_Frontend frontend;
+  PSX_Options opts;
+  PSX_Renderer *renderer,*inner;
+  CD_Disc *disc;
+  char *err;
+  long n,nupdated;
+  uint64_t cc;
+  double t0,t;
+  bool stop,updated;
+#ifdef PSX_MULTI_INSTANCE
+  PSX_Context *ctx;
+#endif
+
+
+  disc= NULL;
+  renderer= inner= NULL;
+#ifdef PSX_MULTI_INSTANCE
+  ctx= NULL;
+#endif
+
+  // Arguments.
+  if ( !parse_args ( argc, argv, &args ) )
+    {
+      usage ( argv[0] );
+      return EXIT_FAILURE;
+    }
+  if ( !load_bios ( args.bios_fn, bios ) ) goto error;
+#ifdef PSX_MULTI_INSTANCE
+  ctx= PSX_context_new ();
+  if ( ctx == NULL )
+    {
+      fprintf ( stderr, "no s'ha pogut crear el context\n" );
+      goto error;
+    }
+  PSX_context_make_current ( ctx );
+#endif
+  if ( args.cd_fn != NULL )
+    {
+      disc= CD_disc_new ( args.cd_fn, &err );
+      if ( disc == NULL )
+        {
+          fprintf ( stderr, "no s'ha pogut obrir '%s': %s\n",
+                    args.cd_fn, err );
+          free ( err );
+          goto error;
+        }
+    }
+
+  // Inicialitza.
+  memset ( &frontend, 0, sizeof(frontend) );
+  frontend.warning= warning;
+  frontend.play_sound= play_sound;
+  frontend.get_ctrl_state= get_ctrl_state;
+  memset ( &opts, 0, sizeof(opts) );
+  opts.cpu= args.cpu;
+  opts.no_idle_skip= args.no_idle_skip;
+  opts.bios_hle= args.bios_hle;
+  opts.fast_boot= args.fast_boot;
+  inner= args.stats ?
+    PSX_create_stats_renderer () :
+    PSX_create_default_renderer ( update_screen, NULL );
+  if ( inner == NULL )
+    {
+      fprintf ( stderr, "no s'ha pogut crear el renderer\n" );
+      goto error;
+    }
+  if ( args.threaded || args.bands > 0 )
+    {
+      renderer= args.bands > 0 ?
+        PSX_create_band_renderer ( inner, args.bands ) :
+        PSX_create_threaded_renderer ( inner );
+      if ( renderer == NULL )
+        {
+          fprintf ( stderr, "no s'ha pogut crear el fil del renderer\n" );
+          goto error;
+        }
+    }
+  else renderer= inner;
+  PSX_init ( bios, &frontend, NULL, renderer, &opts );
+  if ( disc != NULL ) PSX_set_disc ( disc );
+  PSX_gpu_set_frameskip ( args.frameskip );
+
+  // Executa.
+  stop= false;
+  cc= 0; nupdated= 0;
+  PSX_reset_profile ();
+  PSX_reset_counters ();
+  t0= get_time ();
+  for ( n= 0; n < args.nframes && !stop; ++n )
+    {
+      cc+= (uint64_t) PSX_run_frame ( &updated, &stop );
+      if ( updated ) ++nupdated;
+    }
+  t= get_time ()-t0;
+
+  // Resultats.
+  printf ( "frames:        %ld (%ld mostrats)\n", n, nupdated );
+  printf ( "cicles:        %llu\n", (unsigned long long) cc );
+  printf ( "temps:         %.3f s\n", t );
+  printf ( "MHz emulats:   %.2f\n", t > 0 ? cc/t/1e6 : 0.0 );
+  printf ( "FPS:           %.2f\n", t > 0 ? n/t : 0.0 );
+  printf ( "velocitat:     %.1f%%\n",
+           t > 0 ? 100.0*cc/((double) PSX_CYCLES_PER_SEC)/t : 0.0 );
+  printf ( "avisos:        %ld\n", _nwarnings );
+  printf ( "hash RAM:      %016llx\n", (unsigned long long) ram_hash () );
+  printf ( "hash VRAM:     %016llx\n", (unsigned long long) vram_hash () );
+  print_profile ();
+  print_counters ();
+
+  // Allibera.
+  if ( renderer != inner ) PSX_renderer_free ( renderer );
+  PSX_renderer_free ( inner );
+  if ( disc != NULL ) CD_disc_free ( disc );
+#ifdef PSX_MULTI_INSTANCE
+  PSX_context_free ( ctx );
+#endif
+
+  return EXIT_SUCCESS;
+
+ error:
+  if ( inner != NULL ) PSX_renderer_free ( inner );
+  if ( disc != NULL ) CD_disc_free ( disc );
+#ifdef PSX_MULTI_INSTANCE
+  PSX_context_free ( ctx );
+#endif
+  return EXIT_FAILURE;
+
+} // end main
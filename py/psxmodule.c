@@ -1733,39 +1733,28 @@ loop (void)
 {
 
   int cc;
-  gint64 t0,last;
+  gint64 t,target;
   bool stop;
 
-  /* Un valor un poc arreu. Si cada T és correspon amb un cicle de
-     rellotge que va a 33.87MHz approx, tenim que és
-     comprova cada 1/100 segons. */
-  static const int CCTOCHECK= 338700;
+  /* Si es va més d'aquest temps arrere (en microsegons) no s'intenta
+     recuperar. */
+  static const gint64 MAX_DELAY= 100000;
   
   
   stop= false;
-  cc= 0; last= 0;
+  target= g_get_monotonic_time ();
   for (;;)
     {
       
-      /* Temps i casos especials. */
-      if ( last == 0 ) { last= g_get_monotonic_time (); continue; }
-      t0= g_get_monotonic_time ();
-      if ( t0 <= last ) { last= t0; continue; }
+      /* Executa un frame. */
+      cc= PSX_run_frame ( NULL, &stop );
+      if ( stop ) return;
       
-      /* Executa. */
-      cc+= (int) ((PSX_CYCLES_PER_SEC/1000000.0)*(t0-last) + 0.5);
-      while ( cc > 0 )
-        {
-          cc-= PSX_iter ( CCTOCHECK, &stop );
-          if ( stop ) return;
-        }
-
-      /* Actualitza. */
-      last= t0;
-      
-      /* Quant més xicotet siga l'interval millor, però més
-         lent. Menys d'1ms va molt lent. */
-      g_usleep ( 1000 );
+      /* Espera fins que toque el següent frame. */
+      target+= (gint64) ((1000000.0/PSX_CYCLES_PER_SEC)*cc + 0.5);
+      t= g_get_monotonic_time ();
+      if ( t < target ) g_usleep ( (gulong) (target-t) );
+      else if ( t-target > MAX_DELAY ) target= t;
       
     }
   
@@ -2715,7 +2704,7 @@ PSX_init_module (
   _tracer.steps= 0;
 
   // Inicialitza el simulador.
-  PSX_init ( _bios, &frontend, NULL, _renderer );
+  PSX_init ( _bios, &frontend, NULL, _renderer, NULL );
   PSX_plug_controllers ( PSX_CONTROLLER_STANDARD, PSX_CONTROLLER_STANDARD);
   _tracer.pc= PSX_cpu_regs.pc;
 
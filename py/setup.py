@@ -35,6 +35,7 @@ module= Extension ( 'PSX',
                                '../src/cpu_decode.c',
                                '../src/default_renderer.c',
                                '../src/stats_renderer.c',
+                               '../src/threaded_renderer.c',
                                '../src/gpu.c',
                                '../src/spu.c',
                                '../src/int.c',
@@ -48,6 +49,9 @@ module= Extension ( 'PSX',
                                '../src/cd.c',
                                '../src/timers.c',
                                '../src/joy.c',
+                               '../src/exe.c',
+                               '../src/rewind.c',
+                               '../src/movie.c',
                                'CD/src/crc.c',
                                'CD/src/cue.c',
                                'CD/src/info.c',
@@ -62,7 +66,9 @@ module= Extension ( 'PSX',
                                'CD/src/cue.h',
                                'CD/src/utils.h'],
                     libraries= sdl_libs+glib_libs,
-                    extra_compile_args= sdl_cflags+glib_cflags+['-UNDEBUG'],
+                    extra_compile_args= sdl_cflags+glib_cflags+['-UNDEBUG',
+                                                                '-pthread'],
+                    extra_link_args= ['-pthread'],
                     define_macros= [('__LITTLE_ENDIAN__',None)],
                     include_dirs= [ '../src', 'CD/src' ])
 
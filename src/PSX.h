@@ -57,6 +57,69 @@
 #error Per favor defineix __LITTLE_ENDIAN__ o __BIG_ENDIAN__
 #endif
 
+/* Si es defineix PSX_MULTI_INSTANCE tot l'estat del simulador està
+ * en un context (PSX_Context) i no en variables globals. Cada fil té
+ * un context actiu (PSX_context_make_current) i totes les funcions
+ * públiques operen sobre ell. D'aquesta manera es poden tindre
+ * diverses PlayStation independents en el mateix procés, i una
+ * PlayStation pot passar d'un fil a un altre. Sense definir hi ha una
+ * sola PlayStation en variables estàtiques i no té cap cost.
+ */
+#ifdef PSX_MULTI_INSTANCE
+
+/* Blocs d'estat d'un context, un per mòdul. */
+typedef enum
+  {
+    PSX_CTX_CORE= 0,
+    PSX_CTX_MAIN,
+    PSX_CTX_CPU,
+    PSX_CTX_CPU_CACHE,
+    PSX_CTX_CPU_REC,
+    PSX_CTX_CPU_HLE,
+    PSX_CTX_GTE,
+    PSX_CTX_MEM,
+    PSX_CTX_INT,
+    PSX_CTX_DMA,
+    PSX_CTX_MDEC,
+    PSX_CTX_TIMERS,
+    PSX_CTX_GPU,
+    PSX_CTX_CD,
+    PSX_CTX_SPU,
+    PSX_CTX_JOY,
+    PSX_CTX_MOVIE,
+    PSX_CTX_EXE,
+    PSX_CTX_REWIND,
+    PSX_CTX_NUM
+  } PSX_ContextBlock;
+
+/* Blocs del context actiu en el fil. */
+extern _Thread_local void *PSX_ctx_blocks[PSX_CTX_NUM];
+
+/* Grandària de cada bloc. La defineix cada mòdul amb PSX_CTX_DEFINE. */
+extern const size_t PSX_ctx_size_CORE, PSX_ctx_size_MAIN, PSX_ctx_size_CPU,
+  PSX_ctx_size_CPU_CACHE, PSX_ctx_size_CPU_REC, PSX_ctx_size_CPU_HLE,
+  PSX_ctx_size_GTE, PSX_ctx_size_MEM, PSX_ctx_size_INT, PSX_ctx_size_DMA,
+  PSX_ctx_size_MDEC, PSX_ctx_size_TIMERS, PSX_ctx_size_GPU, PSX_ctx_size_CD,
+  PSX_ctx_size_SPU, PSX_ctx_size_JOY, PSX_ctx_size_MOVIE, PSX_ctx_size_EXE,
+  PSX_ctx_size_REWIND;
+
+#define PSX_CTX_DEFINE(TYPE,BLOCK)        	\
+  const size_t PSX_ctx_size_ ## BLOCK= sizeof(TYPE)
+#define PSX_CTX_STATE(TYPE,BLOCK)        			\
+  (*((TYPE *) PSX_ctx_blocks[PSX_CTX_ ## BLOCK]))
+
+#else
+
+#define PSX_CTX_DEFINE(TYPE,BLOCK) static TYPE _ctx_ ## BLOCK
+#define PSX_CTX_STATE(TYPE,BLOCK) (_ctx_ ## BLOCK)
+
+#endif
+
+/* Cada mòdul declara el seu estat com un tipus (TYPE) i el defineix
+ * amb PSX_CTX_DEFINE. Després hi accedeix amb PSX_CTX_STATE, que amb
+ * PSX_MULTI_INSTANCE és el bloc BLOCK del context actiu.
+ */
+
 
 /*********/
 /* TIPUS */
@@ -88,6 +151,39 @@ typedef void
                ...
                );
 
+/* Buffer per a guardar i carregar l'estat dels mòduls (vore
+ * PSX_state_save). En guardar, si 'out' és NULL sols es compten els
+ * bytes. Qualsevol error (buffer menut o dades incorrectes) activa
+ * 'error' i la resta d'operacions no fan res.
+ */
+typedef struct
+{
+
+  uint8_t       *out;
+  const uint8_t *in;
+  size_t         size;
+  size_t         pos;
+  bool           error;
+  
+} PSX_State;
+
+void
+PSX_state_write (
+        	 PSX_State    *st,
+        	 const void   *data,
+        	 const size_t  nbytes
+        	 );
+
+void
+PSX_state_read (
+        	PSX_State    *st,
+        	void         *data,
+        	const size_t  nbytes
+        	);
+
+#define PSX_STATE_WRITE(ST,VAR) PSX_state_write ( (ST), &(VAR), sizeof(VAR) )
+#define PSX_STATE_READ(ST,VAR) PSX_state_read ( (ST), &(VAR), sizeof(VAR) )
+
 
 /*******/
 /* CPU */
@@ -151,7 +247,11 @@ typedef struct
 /* Estat compartit de la CPU (regitres) per les diferents
  * implementacions.
  */
+#ifdef PSX_MULTI_INSTANCE
+#define PSX_cpu_regs (PSX_CTX_STATE ( PSX_Core, CORE ).cpu_regs)
+#else
 extern PSX_CPU PSX_cpu_regs;
+#endif
 
 /* Mnemonics. */
 typedef enum
@@ -326,15 +426,113 @@ PSX_cpu_next_inst (void);
 bool
 PSX_cpu_test_next_inst (void);
 
+/* Executa instruccions fins a consumir CC_BUDGET cicles. Torna abans
+ * si PSX_Clock arriba a PSX_NextEventCC, si la UCP deixa de ser la
+ * propietària del bus o si s'atén una interrupció. Els cicles
+ * executats es van sumant a PSX_Clock (els altres mòduls el
+ * consulten durant l'execució) i també es tornen. Empra la
+ * implementació seleccionada en PSX_cpu_init.
+ */
+int
+PSX_cpu_run (
+             const int cc_budget
+             );
+
+/* Implementacions de la UCP. */
+typedef enum
+  {
+    PSX_CPU_INTERPRETER= 0, // Intèrpret, és la implementació de referència.
+    PSX_CPU_RECOMPILER,     // Recompilador dinàmic a x86-64. Si no està
+        		    // disponible s'empra l'intèrpret.
+    PSX_CPU_CACHED_INTERPRETER // Intèrpret amb una cau de blocs
+        		       // d'instruccions ja descodificades.
+  } PSX_CPUBackend;
+
 /* Inícia l'estat de l'intèrpret. Aquest mètode crida a
  * 'PSX_cpu_init_regs' i a 'PSX_cpu_reset'.
  */
 void
 PSX_cpu_init (
-              PSX_Warning *warning,
-              void        *udata
+              const PSX_CPUBackend  backend,
+              PSX_Warning          *warning,
+              void                 *udata
+              );
+
+// Allibera la memòria reservada pel recompilador i la cau de blocs.
+void
+PSX_cpu_close (void);
+
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_cpu_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_cpu_state_load (
+                    PSX_State *st
+                    );
+
+/* Activa o desactiva la detecció de bucles d'espera (per defecte
+ * activada). Quan PSX_cpu_run detecta un bucle curt que sols llig
+ * memòria que no pot canviar fins al següent event, bota directament
+ * a PSX_NextEventCC.
+ */
+void
+PSX_cpu_set_idle_skip (
+        	       const bool enabled
+        	       );
+
+/* Cicles botats en bucles d'espera des de PSX_cpu_init. */
+uint64_t
+PSX_cpu_get_idle_cc (void);
+
+/* Nombre de funcions de la taula A0h de la BIOS. */
+#define PSX_BIOS_HLE_FUNCS 256
+
+/* Activa o desactiva l'emulació d'alt nivell (HLE) d'algunes funcions
+ * de la BIOS (per defecte desactivada). Sols s'implementen funcions de
+ * la taula A0h. Les crides que no estan implementades, o que no es
+ * poden fer sense risc, s'executen amb el codi de la BIOS.
+ */
+void
+PSX_cpu_set_bios_hle (
+        	      const bool enabled
+        	      );
+
+/* Nombre de crides a la funció A(FUNC) de la BIOS ateses per l'HLE
+ * des de PSX_cpu_init.
+ */
+uint64_t
+PSX_cpu_get_bios_hle_hits (
+        		   const int func
+        		   );
+
+/* Activa o desactiva el ganxo del shell. Quan està activat i la UCP
+ * arriba a 80030000h (la BIOS ja ha inicialitzat el kernel i va a
+ * executar el shell) es crida a PSX_exe_shell i es desactiva.
+ */
+void
+PSX_cpu_set_shell_hook (
+        		const bool enabled
+        		);
+
+/* Continua l'execució en ADDR. Es descarta el salt pendent, si n'hi
+ * ha.
+ */
+void
+PSX_cpu_jump (
+              const uint32_t addr
               );
 
+/* El mòdul MEM crida a aquesta funció quan s'escriu en una pàgina de
+ * codi vigilada (vore PSX_mem_watch_code_page).
+ */
+void
+PSX_cpu_code_modified (
+        	       const int page
+        	       );
+
 // Canvia l'estat d'una senyal d'interrupció. id ha de ser 0..5.
 void
 PSX_cpu_set_int (
@@ -420,6 +618,17 @@ PSX_gte_init (
               void             *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_gte_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_gte_state_load (
+                    PSX_State *st
+                    );
+
 /* Llig un el contingut d'un registre. Torna número de cicles
  * emprats. 64 registres en total, els 32 primers son de dades, els 32
  * següents de control.
@@ -514,6 +723,7 @@ typedef void (PSX_MemAccess8) (
 void
 PSX_mem_init (
               const uint8_t    bios[PSX_BIOS_SIZE],
+              const bool       shared_bios, /* No copia 'bios' */
               PSX_MemChanged  *mem_changed, /* Pot ser NULL */
               PSX_MemAccess   *mem_access, /* Pot ser NULL */
               PSX_MemAccess16 *mem_access16, /* Pot ser NULL */
@@ -521,6 +731,17 @@ PSX_mem_init (
               void            *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_mem_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_mem_state_load (
+                    PSX_State *st
+                    );
+
 /* Llig una paraula de l'adreça especificada. Torna false en cas
  * d'error de bus. Adreça màxima 1FFFFFFF.
  */
@@ -593,6 +814,70 @@ PSX_mem_get_map (
         	 PSX_MemMap *map
         	 );
 
+/* Pàgines de codi. Les implementacions de la UCP que tradueixen codi
+ * treballen amb pàgines de 4KB de RAM (sense espills) i BIOS. Primer
+ * van les pàgines de la RAM i després les de la BIOS.
+ */
+#define PSX_MEM_CODE_PAGE_SIZE 4096
+#define PSX_MEM_CODE_RAM_PAGES ((2*1024*1024)/PSX_MEM_CODE_PAGE_SIZE)
+#define PSX_MEM_CODE_PAGES                                        \
+  (PSX_MEM_CODE_RAM_PAGES + PSX_BIOS_SIZE/PSX_MEM_CODE_PAGE_SIZE)
+
+/* Torna un punter a l'inici de la pàgina de codi que conté l'adreça
+ * física indicada, i en PAGE el seu identificador. Les paraules estan
+ * en l'ordre de la màquina. Torna NULL si l'adreça no és de RAM ni de
+ * BIOS.
+ */
+const uint32_t *
+PSX_mem_get_code_page (
+        	       const uint32_t  addr,
+        	       int            *page
+        	       );
+
+/* Vigila les escriptures en una pàgina de codi. La primera escriptura
+ * en la pàgina crida a PSX_cpu_code_modified i desactiva la
+ * vigilància.
+ */
+void
+PSX_mem_watch_code_page (
+        		 const int page
+        		 );
+
+/* Taules de pàgines de 4KB per a l'accés ràpid a l'espai físic
+ * (00000000-1FFFFFFF). Cada entrada indica on està la pàgina en la
+ * memòria de l'amfitrió i quants bytes des de l'inici de la pàgina es
+ * poden accedir directament. Si l'adreça no cau dins, cal emprar
+ * PSX_mem_read/PSX_mem_write. Les dades estan en l'ordre de la
+ * màquina i sols són vàlides per a accessos little-endian. Les
+ * pàgines de RAM vigilades (PSX_mem_watch_code_page) no apareixen en
+ * les taules d'escriptura, i en mode traça no hi ha cap pàgina.
+ */
+#define PSX_MEM_FAST_PAGE_SIZE 4096
+#define PSX_MEM_FAST_PAGES (0x20000000/PSX_MEM_FAST_PAGE_SIZE)
+
+typedef struct
+{
+  uint8_t  *p;
+  uint32_t  size;
+} PSX_MemFastPage;
+
+typedef enum
+  {
+    PSX_MEM_FAST_READ= 0,    // Lectura.
+    PSX_MEM_FAST_READ_NOSP,  // Lectura amb el scratchpad desactivat.
+    PSX_MEM_FAST_WRITE,      // Escriptura.
+    PSX_MEM_FAST_WRITE_NOSP, // Escriptura amb el scratchpad desactivat.
+    PSX_MEM_FAST_NONE        // Cap pàgina.
+  } PSX_MemFastTable;
+
+/* Torna la taula indicada. El punter és vàlid sempre, el contingut
+ * s'actualitza quan canvia la configuració de la memòria.
+ */
+const PSX_MemFastPage *
+PSX_mem_get_fast_pages (
+        		const PSX_MemFastTable table
+        		);
+
 /*******/
 /* INT */
 /*******/
@@ -635,6 +920,17 @@ PSX_int_init (
               void         *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_int_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_int_state_load (
+                    PSX_State *st
+                    );
+
 // Per a indicar que hem acabat una iteració.
 void
 PSX_int_end_iter (void);
@@ -694,6 +990,17 @@ PSX_dma_init (
               void            *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_dma_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_dma_state_load (
+                    PSX_State *st
+                    );
+
 void
 PSX_dma_reset (void);
 
@@ -713,6 +1020,11 @@ PSX_dma_run_cc (
                 const int cc
                 );
 
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_dma_clock (void);
+
 // Processa cicles pendents (sols té sentit quan el choping del mode0
 // està activat)
 void
@@ -813,6 +1125,17 @@ PSX_mdec_init (
                void        *udata
                );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_mdec_state_save (
+                     PSX_State *st
+                     );
+
+void
+PSX_mdec_state_load (
+                     PSX_State *st
+                     );
+
 uint32_t
 PSX_mdec_data_read (void);
 
@@ -861,9 +1184,14 @@ PSX_mdec_out_write (
 uint32_t
 PSX_mdec_out_read (void);
 
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_mdec_clock (void);
+
 // Processa cicles pendents.
 void
-PSX_mdec_end_iter(void);
+PSX_mdec_end_iter (void);
 
 // Torna els cicles que queden per al proper event. Mai torna -1.
 int
@@ -899,7 +1227,7 @@ typedef struct
   }              transparency;
   bool           dithering;
   bool           gouraud;
-  enum {
+  enum PSX_TextureMode_ {
     PSX_TEX_4b= 0,
     PSX_TEX_8b= 1,
     PSX_TEX_15b= 2,
@@ -984,7 +1312,14 @@ typedef struct
   /* Line. Sols torna npixels en stats. */        			\
   void (*line) (struct PSX_Renderer_ *,        				\
         	PSX_RendererArgs  *args,				\
-        	PSX_RendererStats *stats);
+        	PSX_RendererStats *stats);				\
+  /* La GPU ha escrit en la regió indicada del fb mentre estava		\
+     bloquejat (emplenats i còpies). X+WIDTH i Y+HEIGHT poden		\
+     passar de 1024 i 512, aleshores es fa la volta. Pot ser NULL	\
+     si el renderer no guarda res derivat de la VRAM. */		\
+  void (*vram_written) (struct PSX_Renderer_ *,        			\
+        		const int x,const int y,        		\
+        		const int width,const int height);
 
 typedef struct PSX_Renderer_ PSX_Renderer;
 
@@ -1026,14 +1361,10 @@ typedef void (PSX_UpdateScreen) (
 /**********/
 /* Comptadors. */
 
-/*
-// Processa cicles d'UCP. S'ha d'indicar si estem o no en el final de
-// la iteració.
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
 void
-PSX_timers_clock (
-        	  const bool end_iter
-        	  );
-*/
+PSX_timers_clock (void);
 
 // Processa cicles pendents i possibles events.
 void
@@ -1047,6 +1378,17 @@ PSX_timers_next_event_cc (void);
 void
 PSX_timers_init (void);
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_timers_state_save (
+                       PSX_State *st
+                       );
+
+void
+PSX_timers_state_load (
+                       PSX_State *st
+                       );
+
 /* Emprat per la GPU per a indicar que comença el HBlank. */
 void
 PSX_timers_hblank_in (void);
@@ -1198,6 +1540,11 @@ typedef void (PSX_GPUCmdTrace) (
 void
 PSX_gpu_reset (void);
   
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_gpu_clock (void);
+
 // Processa cicles pendents i possibles events.
 void
 PSX_gpu_end_iter (void);
@@ -1216,6 +1563,21 @@ PSX_gpu_init (
               void            *udata
               );
 
+// Allibera el renderer del frameskip (vore PSX_gpu_set_frameskip).
+void
+PSX_gpu_close (void);
+
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_gpu_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_gpu_state_load (
+                    PSX_State *st
+                    );
+
 /* Comandaments GP0 (Renderitzat i VRAM). */
 void
 PSX_gpu_gp0 (
@@ -1268,6 +1630,28 @@ PSX_gpu_set_mode_trace (
         		const bool val
         		);
 
+// Activa/Desactiva l'enviament dels frames al renderer (draw). La GPU
+// continua dibuixant en la VRAM igualment. Per defecte està activat.
+void
+PSX_gpu_set_output (
+        	    const bool enable
+        	    );
+
+// Frameskip per a l'avanç ràpid. De cada NFRAMES+1 frames sols
+// s'envia l'últim al renderer. Les primitives dels frames que no es
+// mostren es passen a un stats_renderer, que no dibuixa però
+// proporciona els píxels per a calcular el temps de la GPU. El frame
+// que es mostra i l'anterior (amb doble buffer és el que es veu) es
+// dibuixen amb el renderer normal, i també la resta d'un frame en el
+// que es llig o es copia la VRAM. Per tant amb NFRAMES=1 sols
+// s'estalvia l'enviament dels frames. NFRAMES=0 el desactiva (per
+// defecte). La simulació no és idèntica a la normal perquè el temps
+// de dibuixat és una estimació.
+void
+PSX_gpu_set_frameskip (
+        	       const int nframes
+        	       );
+
 
 /******/
 /* CD */
@@ -1332,6 +1716,11 @@ typedef void (PSX_CDCmdTrace) (
 void
 PSX_cd_reset (void);
 
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_cd_clock (void);
+
 // Processa cicles pendents i possibles events. ¿¿¿Pel tema de l'àudio
 // cal executar açò abans de la SPU.???
 void
@@ -1349,6 +1738,21 @@ PSX_cd_init (
              void           *udata
              );
 
+// Allibera la informació del disc actual.
+void
+PSX_cd_close (void);
+
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_cd_state_save (
+                   PSX_State *st
+                   );
+
+void
+PSX_cd_state_load (
+                   PSX_State *st
+                   );
+
 // Fixa l'índex del registre a emprar.
 void
 PSX_cd_set_index (
@@ -1359,6 +1763,11 @@ PSX_cd_set_index (
 uint8_t
 PSX_cd_status (void);
 
+// Torna el disc actual (pot ser NULL). Si s'està insertant un disc
+// el dona per insertat immediatament.
+CD_Disc *
+PSX_cd_get_disc (void);
+
 // Escriu en el port1.
 void
 PSX_cd_port1_write (
@@ -1438,6 +1847,18 @@ typedef void (PSX_PlaySound) (
 void
 PSX_spu_reset (void);
 
+// Activa/Desactiva les crides a PLAY_SOUND. Les mostres es generen
+// igualment però es descarten. Per defecte està activat.
+void
+PSX_spu_set_output (
+        	    const bool enable
+        	    );
+
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_spu_clock (void);
+
 // Processa cicles pendents i possibles events. ¿¿¿Pel tema de l'àudio
 // cal executar açò desprès del CD.???
 void
@@ -1455,6 +1876,17 @@ PSX_spu_init (
               void          *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_spu_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_spu_state_load (
+                    PSX_State *st
+                    );
+
 // Torna l'adreça inicial d'una veu.
 uint16_t
 PSX_spu_voice_get_start_addr (
@@ -1879,6 +2311,17 @@ PSX_joy_init (
               void                   *udata
               );
 
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_joy_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_joy_state_load (
+                    PSX_State *st
+                    );
+
 void
 PSX_joy_tx_data (
         	 const uint32_t data
@@ -1914,6 +2357,11 @@ PSX_joy_baud_write (
 uint16_t
 PSX_joy_baud_read (void);
 
+// Processa cicles pendents i, si toca, l'event, sense acabar la
+// iteració (vore PSX_schedule).
+void
+PSX_joy_clock (void);
+
 // Processa cicles pendents i possibles events.
 void
 PSX_joy_end_iter (void);
@@ -1923,6 +2371,193 @@ int
 PSX_joy_next_event_cc (void);
 
 
+/*******/
+/* EXE */
+/*******/
+/* Càrrega d'executables PS-X EXE, directament o des del disc. */
+
+/* Inicialització. Si BOOT_DISC és cert, quan la BIOS arriba al shell
+ * es carrega l'executable indicat en el SYSTEM.CNF del disc actual.
+ */
+void
+PSX_exe_init (
+              const bool   boot_disc,
+              PSX_Warning *warning,
+              void        *udata
+              );
+
+// Allibera l'executable pendent de carregar.
+void
+PSX_exe_close (void);
+
+// Guarda/Carrega l'estat del mòdul (vore PSX_state_save).
+void
+PSX_exe_state_save (
+                    PSX_State *st
+                    );
+
+void
+PSX_exe_state_load (
+                    PSX_State *st
+                    );
+
+// Es crida en cada reset.
+void
+PSX_exe_reset (void);
+
+/* La UCP crida a aquesta funció quan la BIOS arriba al shell (vore
+ * PSX_cpu_set_shell_hook). Torna cert si s'ha carregat un executable
+ * i la UCP ja està en el seu punt d'entrada.
+ */
+bool
+PSX_exe_shell (void);
+
+/* Carrega un executable PS-X EXE (capçalera de 2048 bytes seguida
+ * del codi) en RAM i fixa PC, GP, SP i FP segons la capçalera. Si la
+ * BIOS encara no ha inicialitzat el kernel, es guarda una còpia i es
+ * carrega quan la BIOS arriba al shell, d'aquesta manera
+ * l'executable pot gastar les funcions de la BIOS. Torna fals si la
+ * capçalera no és vàlida.
+ */
+bool
+PSX_load_exe (
+              const uint8_t *exe,
+              const size_t   size
+              );
+
+
+/**********/
+/* REWIND */
+/**********/
+/* Rebobinat. Cada cert número de frames es captura un estat (vore
+ * PSX_state_save) al final de la crida a PSX_iter on s'arriba al
+ * frame. Les captures es guarden com a deltes comprimits respecte a
+ * la següent en un anell de memòria fixa; quan s'ompli es descarten
+ * les més antigues.
+ */
+
+// Es crida en PSX_init. Desactiva el rebobinat.
+void
+PSX_rewind_init (void);
+
+// Es crida al final de cada PSX_iter amb el número de frames
+// generats (vore PSX_get_frame_count).
+void
+PSX_rewind_end_iter (
+        	     const uint64_t frames
+        	     );
+
+/* Activa el rebobinat descartant l'historial anterior. MAX_BYTES és
+ * la memòria màxima que es reservarà (ha de poder contindre almenys
+ * dos estats sencers) i INTERVAL els frames entre captures. Torna
+ * fals si no hi ha prou memòria.
+ */
+bool
+PSX_rewind_enable (
+        	   const size_t max_bytes,
+        	   const int    interval
+        	   );
+
+// Desactiva el rebobinat i allibera la memòria.
+void
+PSX_rewind_disable (void);
+
+/* Torna a l'última captura i la lleva de l'historial, per tant
+ * cridades successives van cap arrere INTERVAL frames cada
+ * vegada. Torna fals si no queden captures. Sols es pot cridar entre
+ * crides a PSX_iter.
+ */
+bool
+PSX_rewind_step (void);
+
+// Número de captures disponibles.
+int
+PSX_rewind_count (void);
+
+
+/*********/
+/* MOVIE */
+/*********/
+/* Pel·lícules. Graven l'entrada dels controladors per frame per a
+ * poder reproduir exactament una execució (per exemple per a
+ * comparar rendiments), i un hash de la UCP, la RAM i la VRAM al
+ * final de cada frame per a detectar de seguida quan dues execucions
+ * divergeixen. La pel·lícula comença en el frame actual, per tant
+ * per a reproduir-la cal estar en el mateix estat que quan es va
+ * començar a gravar (normalment just després de PSX_init).
+ */
+
+typedef enum
+  {
+    PSX_MOVIE_OFF,
+    PSX_MOVIE_RECORDING,
+    PSX_MOVIE_PLAYING,
+    PSX_MOVIE_FINISHED // S'ha acabat de reproduir.
+  } PSX_MovieStatus;
+
+// Es crida en PSX_init. GET_CTRL_STATE és el callback del frontend.
+void
+PSX_movie_init (
+        	PSX_GetControllerState *get_ctrl_state,
+        	PSX_Warning            *warning,
+        	void                   *udata
+        	);
+
+// Allibera la pel·lícula actual, si n'hi ha.
+void
+PSX_movie_close (void);
+
+// El mòdul JOY consulta l'estat dels controladors amb aquesta
+// funció, que el trau de la pel·lícula o del frontend.
+const PSX_ControllerState *
+PSX_movie_get_ctrl_state (
+        		  const int  joy,
+        		  void      *udata
+        		  );
+
+// Es crida al final de cada frame (vore PSX_end_frame).
+void
+PSX_movie_end_frame (
+        	     const uint64_t frame
+        	     );
+
+// Comença a gravar des del frame actual. Descarta qualsevol
+// pel·lícula anterior.
+void
+PSX_movie_record (void);
+
+/* Comença a reproduir una pel·lícula gravada. Mentre es reprodueix
+ * no es crida al GET_CTRL_STATE del frontend. Torna fals si la
+ * pel·lícula no és vàlida o no comença en el frame actual.
+ */
+bool
+PSX_movie_play (
+        	const uint8_t *data,
+        	const size_t   size
+        	);
+
+/* Para la gravació o reproducció. Si s'estava gravant torna la
+ * pel·lícula i la seua grandària en SIZE. La memòria és vàlida fins
+ * a la següent crida a PSX_movie_*.
+ */
+const uint8_t *
+PSX_movie_stop (
+        	size_t *size
+        	);
+
+PSX_MovieStatus
+PSX_movie_status (void);
+
+// Primer frame reproduït on el hash no coincideix amb el gravat, o
+// -1.
+int64_t
+PSX_movie_diverged_frame (void);
+
+// Hash de l'últim frame gravat o reproduït.
+uint32_t
+PSX_movie_last_hash (void);
+
+
 /********/
 /* MAIN */
 /********/
@@ -1934,12 +2569,183 @@ PSX_joy_next_event_cc (void);
 // Número de cicles per instrucció
 #define PSX_CYCLES_INST 2
 
-// Clocks que es porten executats en l'actual iteració. Pot anar
-// canviant durant la iteració.
+// Clocks que es porten executats en l'actual crida a PSX_iter. Pot
+// anar canviant durant la iteració.
+#ifdef PSX_MULTI_INSTANCE
+#define PSX_Clock (PSX_CTX_STATE ( PSX_Core, CORE ).clock)
+#else
 extern int PSX_Clock;
+#endif
 
-// Cicles interns fins al següent event.
+// Cicles interns fins al següent event (relatius a l'inici de
+// l'actual crida a PSX_iter).
+#ifdef PSX_MULTI_INSTANCE
+#define PSX_NextEventCC (PSX_CTX_STATE ( PSX_Core, CORE ).next_event_cc)
+#else
 extern int PSX_NextEventCC;
+#endif
+
+// Fonts d'events. L'ordre és el mateix en el que es processen els
+// events que coincideixen en el mateix cicle.
+// NOTA!! GTE no genera events.
+typedef enum {
+      PSX_EVENT_DMA= 0,
+      PSX_EVENT_MDEC,
+      PSX_EVENT_GPU,
+      PSX_EVENT_CD,
+      PSX_EVENT_SPU,
+      PSX_EVENT_JOY,
+      PSX_EVENT_TIMERS,
+      PSX_EVENT_NUM
+} PSX_EventSource;
+
+// Planifica el següent event d'un mòdul. 'cc' són els cicles que
+// falten des de PSX_Clock fins a l'event, -1 vol dir que no hi ha
+// cap event pendent. Substitueix qualsevol planificació prèvia del
+// mateix mòdul. Quan arriba el moment el planificador crida a
+// PSX_<mòdul>_clock i torna a demanar PSX_<mòdul>_next_event_cc.
+void
+PSX_schedule (
+              const PSX_EventSource src,
+              const int             cc
+              );
+
+// Torna el número de cicles executats des de PSX_init (comptador
+// monòton de 64 bits).
+uint64_t
+PSX_get_timestamp (void);
+
+// La GPU crida a aquesta funció cada vegada que acaba de generar un
+// frame (inici del VBlank). DRAWN indica si el frame s'ha enviat al
+// renderer (no s'envia amb el frameskip o sense eixida).
+void
+PSX_end_frame (
+               const bool drawn
+               );
+
+// La GPU crida a aquesta funció cada vegada que comença el VBlank
+// (just després de PSX_timers_vblank_in). Si s'està executant
+// PSX_run_frame para la iteració en aquest cicle.
+void
+PSX_vblank_in (void);
+
+// Torna el número de frames generats des de PSX_init.
+uint64_t
+PSX_get_frame_count (void);
+
+/* Perfilat. Si es compila amb PSX_PROFILE es mesura el temps de
+ * l'amfitrió que es passa en cada subsistema. El temps és exclusiu:
+ * si la UCP escriu en un registre de la GPU i açò fa que la GPU
+ * execute un comandament, el temps del comandament és de la GPU. Les
+ * crides al frontend (renderer, so) compten en el subsistema que les
+ * fa. Sense definir PSX_PROFILE la instrumentació desapareix i
+ * PSX_get_profile sempre torna fals.
+ */
+typedef enum
+  {
+    PSX_PROFILE_CPU= 0, // UCP i GTE.
+    PSX_PROFILE_GPU,    // Comandaments, rasterització i frames.
+    PSX_PROFILE_SPU,    // Síntesi del so.
+    PSX_PROFILE_MDEC,   // Descodificació.
+    PSX_PROFILE_DMA,    // Transferències.
+    PSX_PROFILE_CD,
+    PSX_PROFILE_OTHER,  // Planificador i la resta de mòduls.
+    PSX_PROFILE_NUM
+  } PSX_ProfileSection;
+
+typedef struct
+{
+  uint64_t ns[PSX_PROFILE_NUM];    // Temps en nanosegons.
+  uint64_t calls[PSX_PROFILE_NUM]; // Vegades que s'ha entrat.
+} PSX_Profile;
+
+#ifdef PSX_PROFILE
+// Comença/acaba un tram d'un subsistema. Els trams es poden niar.
+void
+PSX_profile_begin (
+        	   const PSX_ProfileSection sec
+        	   );
+
+void
+PSX_profile_end (void);
+
+#define PSX_PROFILE_BEGIN(SEC) PSX_profile_begin ( SEC )
+#define PSX_PROFILE_END PSX_profile_end ()
+#else
+#define PSX_PROFILE_BEGIN(SEC)
+#define PSX_PROFILE_END
+#endif
+
+// Copia en PROF el temps acumulat des de l'última crida a
+// PSX_reset_profile (o PSX_init). Torna fals si no s'ha compilat amb
+// PSX_PROFILE.
+bool
+PSX_get_profile (
+        	 PSX_Profile *prof
+        	 );
+
+void
+PSX_reset_profile (void);
+
+/* Comptadors. Si es compila amb PSX_COUNTERS es compta el que fa la
+ * màquina simulada (no l'amfitrió): instruccions executades, accessos
+ * a memòria per regió, comandaments de GTE, primitives de GPU,
+ * transferències DMA, mostres de so, sectors de CD i
+ * interrupcions. Els frames que es tornen a executar (run-ahead,
+ * rebobinat) també es compten. Sense definir PSX_COUNTERS la
+ * instrumentació desapareix i PSX_get_counters sempre torna fals.
+ */
+typedef enum
+  {
+    PSX_COUNTERS_RAM= 0,
+    PSX_COUNTERS_SCRATCHPAD,
+    PSX_COUNTERS_BIOS,
+    PSX_COUNTERS_IO,
+    PSX_COUNTERS_OTHER,  // Expansions, control de cache, etc.
+    PSX_COUNTERS_NUM_REGIONS
+  } PSX_CountersRegion;
+
+#define PSX_COUNTERS_NUM_INTS 11 // Un per bit de PSX_Interruption.
+
+typedef struct
+{
+  uint64_t cycles;       // Cicles des de PSX_init (PSX_get_timestamp).
+  uint64_t insts;        // Instructions executades per la UCP.
+  uint64_t loads[PSX_COUNTERS_NUM_REGIONS];  // Sols dades.
+  uint64_t stores[PSX_COUNTERS_NUM_REGIONS];
+  uint64_t gte_cmds[64]; // Per opcode (bits 0-5 del comandament).
+  uint64_t gpu_prims[PSX_GP0_UNK]; // Sols primitives que dibuixen.
+  uint64_t gpu_pixels;   // Segons PSX_RendererStats.
+  uint64_t dma_words[7]; // Per canal.
+  uint64_t spu_samples;
+  uint64_t cd_sectors;   // Sectors llegits del disc.
+  uint64_t ints[PSX_COUNTERS_NUM_INTS]; // Peticions per font.
+} PSX_Counters;
+
+#ifdef PSX_COUNTERS
+#ifdef PSX_MULTI_INSTANCE
+#define PSX_Cnt (PSX_CTX_STATE ( PSX_Core, CORE ).cnt)
+#else
+extern PSX_Counters PSX_Cnt;
+#endif
+
+#define PSX_COUNT(FIELD) (++PSX_Cnt.FIELD)
+#define PSX_COUNT_N(FIELD,N) (PSX_Cnt.FIELD+= (uint64_t) (N))
+#else
+#define PSX_COUNT(FIELD)
+#define PSX_COUNT_N(FIELD,N)
+#endif
+
+// Copia en CNT els comptadors acumulats des de l'última crida a
+// PSX_reset_counters (o PSX_init). El camp 'cycles' és absolut i no
+// es reinicia. Torna fals si no s'ha compilat amb PSX_COUNTERS.
+bool
+PSX_get_counters (
+        	  PSX_Counters *cnt
+        	  );
+
+void
+PSX_reset_counters (void);
 
 typedef enum {
       PSX_BUS_OWNER_CPU= 0,
@@ -1947,7 +2753,27 @@ typedef enum {
       PSX_BUS_OWNER_CPU_DMA
 } PSX_BusOwnerType;
 
+#ifdef PSX_MULTI_INSTANCE
+#define PSX_BusOwner (PSX_CTX_STATE ( PSX_Core, CORE ).bus_owner)
+#else
 extern PSX_BusOwnerType PSX_BusOwner;
+#endif
+
+#ifdef PSX_MULTI_INSTANCE
+/* Variables públiques del simulador (PSX_cpu_regs, PSX_Clock...),
+ * primer bloc del context.
+ */
+typedef struct
+{
+
+  PSX_CPU          cpu_regs;
+  int              clock;
+  int              next_event_cc;
+  PSX_BusOwnerType bus_owner;
+  PSX_Counters     cnt;
+  
+} PSX_Core;
+#endif
 
 /* Tipus de funció amb la que el 'frontend' indica a la llibreria si
  * s'ha produït alguna senyal. A més esta funció pot ser emprada per
@@ -2044,16 +2870,111 @@ PSX_create_default_renderer (
 PSX_Renderer *
 PSX_create_stats_renderer (void);
 
-/* Inicialitza la llibreria. */
+/* Renderer que executa un altre renderer (INNER) en un fil a
+ * banda. Les primitives es copien en una cua circular i el fil les
+ * dibuixa mentre la simulació continua. lock, unlock, draw i
+ * enable_display esperen que el fil haja acabat i es criden en el fil
+ * de la simulació, per tant la VRAM que veu la GPU és coherent i el
+ * frontend rep els frames en el mateix fil de sempre. Els estadístics
+ * que necessita la GPU es calculen en el moment amb un
+ * stats_renderer, per tant el temps de dibuixat és una estimació (la
+ * simulació no és idèntica a la d'INNER a soles). INNER no
+ * s'allibera. Torna NULL si no s'ha pogut crear el fil.
+ */
+PSX_Renderer *
+PSX_create_threaded_renderer (
+        		      PSX_Renderer *inner
+        		      );
+
+/* Com PSX_create_threaded_renderer però amb NTHREADS fils
+ * (1..16). La VRAM es divideix en NTHREADS bandes horitzontals i cada
+ * fil dibuixa, en ordre, les primitives que toquen la seua banda
+ * retallant clip_y1/clip_y2. Si una primitiva llig com a textura una
+ * regió que altra ha dibuixat (o al revés) s'espera a tots els fils,
+ * per tant amb les mateixes primitives la VRAM és idèntica a la de
+ * PSX_create_threaded_renderer. Els estadístics per a la GPU també
+ * són l'estimació del stats_renderer, i com amb un sol fil el temps
+ * de dibuixat i la simulació no són idèntics als d'INNER a
+ * soles. INNER ha de
+ * suportar que es criden els seus mètodes de dibuixat des de diversos
+ * fils a la vegada amb regions de retall disjuntes (el
+ * default_renderer ho suporta). INNER no s'allibera. Torna NULL si no
+ * s'han pogut crear els fils.
+ */
+PSX_Renderer *
+PSX_create_band_renderer (
+        		  PSX_Renderer *inner,
+        		  const int     nthreads
+        		  );
+
+#ifdef PSX_MULTI_INSTANCE
+/* Context. Conté tot l'estat d'una PlayStation. Abans de cridar a
+ * qualsevol funció del simulador (començant per PSX_init) el fil ha
+ * de tindre un context actiu. Un context sols pot estar actiu en un
+ * fil al mateix temps, però es pot activar en un altre fil quan el
+ * primer ja no l'empra (ha activat un altre context o NULL). El
+ * renderer, el disc i les memory cards són del frontend, com sempre,
+ * i poden ser compartits sols si ells ho permeten.
+ */
+typedef struct PSX_Context PSX_Context;
+
+// Crea un context nou. Torna NULL si no hi ha prou memòria.
+PSX_Context *
+PSX_context_new (void);
+
+// Allibera el context i la memòria que ha reservat el simulador
+// (recompilador, rebobinat, pel·lícules...). No pot estar actiu en
+// cap altre fil. Si està actiu en el fil que crida es desactiva.
+void
+PSX_context_free (
+        	  PSX_Context *ctx
+        	  );
+
+// Activa CTX (pot ser NULL) en el fil que crida.
+void
+PSX_context_make_current (
+        		  PSX_Context *ctx
+        		  );
+
+// Torna el context actiu en el fil que crida (o NULL).
+PSX_Context *
+PSX_context_get_current (void);
+#endif
+
+/* Opcions de configuració del simulador. */
+typedef struct
+{
+
+  PSX_CPUBackend cpu;          // Implementació de la UCP.
+  bool           no_idle_skip; // Desactiva la detecció de bucles
+        			// d'espera.
+  bool           bios_hle;     // Activa l'HLE de funcions de la BIOS.
+  bool           fast_boot;    // Bota la intro de la BIOS i arranca
+        			// directament l'executable del disc.
+  bool           shared_bios;  // No copia la BIOS, la gasta
+        			// directament (ha de continuar sent vàlida
+        			// i no canviar). Permet que diverses
+        			// contextos (PSX_MULTI_INSTANCE)
+        			// compartisquen la mateixa BIOS. Ha
+        			// d'estar alineada a 4 bytes. Sols té
+        			// efecte en little-endian.
+  
+} PSX_Options;
+
+/* Inicialitza la llibreria. Si OPTS és NULL s'empren les opcions per
+ * defecte.
+ */
 void
 PSX_init (
           const uint8_t       bios[PSX_BIOS_SIZE],
           const PSX_Frontend *frontend,       /* Frontend. */
           void               *udata,          /* Dades frontend. */
-          PSX_Renderer       *renderer
+          PSX_Renderer       *renderer,
+          const PSX_Options  *opts            /* Pot ser NULL. */
           );
 
-// Modifica la bios.
+// Modifica la bios. Si s'ha inicialitzat amb 'shared_bios' la nova
+// BIOS tampoc es copia.
 void
 PSX_change_bios (
                  const uint8_t bios[PSX_BIOS_SIZE]
@@ -2072,6 +2993,37 @@ PSX_iter (
           bool      *stop
           );
 
+/* Run-ahead. Executa un frame (igual que PSX_run_frame) però el que
+ * s'envia al renderer és el frame que es generaria FRAMES frames
+ * després amb la mateixa entrada, d'aquesta manera la latència de
+ * l'entrada es redueix en FRAMES frames. Per a fer-ho es guarda
+ * l'estat després del frame real, s'executen els frames
+ * especulatius (sense so, i sols l'últim es dibuixa) i es torna a
+ * l'estat guardat. Amb FRAMES<=0, o si no hi ha memòria per a
+ * guardar l'estat, executa un frame normal. Si no es pot tornar a
+ * l'estat guardat (no hauria de passar) s'avisa i es reinicia la
+ * màquina. Igual que PSX_iter crida a CHECKSIGNALS al final i torna
+ * els cicles executats (sols els del frame real).
+ */
+int
+PSX_run_ahead (
+               const int  frames,
+               bool      *stop
+               );
+
+/* Executa fins al següent inici del VBlank, de manera que el
+ * frontend pot anar frame a frame sense haver d'endevinar quants
+ * cicles executar. Si la pantalla està mal configurada i no hi ha
+ * VBlanks para després de dos frames PAL. En UPDATED (pot ser NULL)
+ * indica si s'ha enviat un frame nou al renderer. Igual que PSX_iter
+ * crida a CHECKSIGNALS al final i torna els cicles executats.
+ */
+int
+PSX_run_frame (
+               bool *updated,
+               bool *stop
+               );
+
 /* Fa un reset quan no hi ha checksignals. */
 void
 PSX_reset (void);
@@ -2108,4 +3060,34 @@ PSX_plug_mem_cards (
         	    uint8_t *memc2
         	    );
 
+/* Estats. Guarden tot l'estat de la màquina (UCP, GTE, RAM, VRAM,
+ * SPU, CD, DMA, temporitzadors...) en un bloc binari versionat i
+ * dividit en blocs (chunks). Sols es poden cridar entre crides a
+ * PSX_iter/PSX_trace. No es guarda: el disc (s'assumeix que és el
+ * mateix i sols es guarda la posició de lectura), les memory cards,
+ * les opcions ni els callbacks. El format depén de la compilació.
+ */
+#define PSX_STATE_VERSION 1
+
+// Torna la grandària en bytes que ocuparia ara l'estat.
+size_t
+PSX_state_size (void);
+
+// Guarda l'estat en BUF. Torna els bytes escrits o 0 si no cap.
+size_t
+PSX_state_save (
+        	uint8_t      *buf,
+        	const size_t  size
+        	);
+
+// Carrega un estat guardat amb PSX_state_save. Torna false si no és
+// un estat vàlid per a aquesta versió, i en eixe cas l'estat del
+// simulador no canvia (si un bloc falla a mitjan càrrega es restaura
+// l'estat anterior).
+bool
+PSX_state_load (
+        	const uint8_t *buf,
+        	const size_t   size
+        	);
+
 #endif /* __PSX_H__*/
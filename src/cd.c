@@ -228,211 +228,244 @@ static const int64_t adpcm_interpolate_tables[7][29]=
 /* ESTAT */
 /*********/
 
-// Callbacks.
-static PSX_Warning *_warning;
-static void *_udata;
-static PSX_CDCmdTrace *_cd_cmd_trace;
-
-// Per a executar el comandament.
-static void (*_run_cmd) (void);
-
-// Índex
-static int _index;
-
-// FIFO paràmetres.
-static struct
+typedef struct
 {
-  uint8_t v[FIFO_SIZE];
-  int     N;
-} _fifop;
 
-// FIFO resposta.
-static struct
-{
-  uint8_t v[FIFO_SIZE];
-  int     N;
-  int     p;
-} _fifor;
+  // Callbacks.
+  PSX_Warning *_warning;
+  void *_udata;
+  PSX_CDCmdTrace *_cd_cmd_trace;
 
-// FIFO dades.
-static struct
-{
-  uint8_t v[MAXBUFSIZE];
-  int     N;
-  int     p;
-} _fifod;
+  // Per a executar el comandament.
+  void (*_run_cmd) (void);
 
-// timing.
-static struct
-{
+  // Índex
+  int _index;
 
-  int cc;
-  int cc_used;
-  int cc2first_response;
-  int cc2second_response;
-  int cc2disc_inserted;
-  int cc2read;
-  int cc2reset;
-  int cc2seek;
-  int cc2irq_expired;
-  int cctoEvent;
-  
-} _timing;
-
-// Comandament.
-static struct
-{
-  uint8_t cmd; // Codi
-  bool    pendent; // Cal executar cmd
-  int     first_response; // Pendent, ha de ficar-se quan toque.
-  int     second_response; // Pendent, ha de ficar-se quan toque.
-  int     irq_pendent_response; // -1 vol dir que no hi ha res.
+  // FIFO paràmetres.
   struct
   {
+    uint8_t v[FIFO_SIZE];
     int     N;
+  } _fifop;
+
+  // FIFO resposta.
+  struct
+  {
     uint8_t v[FIFO_SIZE];
-    uint8_t set_bits;
-    uint8_t reset_bits;
-  }       first,second,irq_pendent; // fifor per a la primera i segona resposta
-  bool    waiting_first_response;
-  bool    waiting_second_response;
-  bool    waiting_read;
-  bool    waiting_reset;
-  bool    waiting_seek;
-  bool    waiting_irq_expired;
-  bool    ack; // Indica que el comandament ja ha sigut 'acknwoledged'.
-  bool    paused; // Flag especial per al calc_seek.
-  uint8_t stat;
-  // NOTES de nocash sobre l'ignore bit!!!  The "Ignore Bit" does
-  // reportedly force a sector size of 2328 bytes (918h), however,
-  // that doesn't seem to be true. Instead, Bit4 seems to cause the
-  // controller to ignore the sector size in Bit5 (instead, the size
-  // is kept from the most recent Setmode command which didn't have
-  // Bit4 set). Also, Bit4 seems to cause the controller to ignore the
-  // <exact> Setloc position (instead, data is randomly returned from
-  // the "Setloc position minus 0..3 sectors"). And, Bit4 causes INT1
-  // to return status.Bit3=set (IdError). Purpose of Bit4 is unknown?
+    int     N;
+    int     p;
+  } _fifor;
+
+  // FIFO dades.
   struct
   {
-    bool double_speed;
-    bool xa_adpcm_enabled;
-    bool sector_size_924h_bit; // <-- Sols s'aplica si ignore bit és cert.
-    bool ignore_bit;
-    bool use_xa_filter;
-    bool enable_report_ints;
-    bool audio_pause;
-    bool enable_read_cdda_sectors;
-    bool sector_size_924h;
-  }       mode;
+    uint8_t v[MAXBUFSIZE];
+    int     N;
+    int     p;
+  } _fifod;
+
+  // timing.
   struct
   {
-    int  amm; // Minut
-    int  ass; // Segon
-    int  asect; // Sector
-    bool data_mode;
-    bool processed; // Indica si s'ha processat
-    enum
-      {
-       AFTER_SEEK_STAT= 0,
-       AFTER_SEEK_READ,
-       AFTER_SEEK_PLAY
-      }  after; // Què es fa després del seek????
-  }       seek; // Per als comandaments de seek
+
+    int cc;
+    int cc_used;
+    int cc2first_response;
+    int cc2second_response;
+    int cc2disc_inserted;
+    int cc2read;
+    int cc2reset;
+    int cc2seek;
+    int cc2irq_expired;
+    int cctoEvent;
+
+  } _timing;
+
+  // Comandament.
   struct
   {
-    uint8_t file;
-    uint8_t channel;
-  } filter;
-} _cmd;
-
-// Interruptions.
-static struct
-{
-  int mask;
-  int v;
-} _ints;
-
-// Requests
-static struct
-{
-  bool smen;
-  bool bfwr;
-  bool bfrd;
-} _request;
-
-// Per al disc.
-static struct
-{
-  CD_Info *info;
-  CD_Disc *current;
-  CD_Disc *next;
-  bool     inserted;
-  region_t region;
-} _disc;
-
-// Buffer lectura
-
-// NOTA!!! Intentant seguir les obsevacions de NOCASH i el que fa
-// Mednafen vaig a ficar 2 nivells de buffers. El primer nivell amb
-// espai per a 2 sectors, cada vegada que s'intenta insertar un sector
-// que no cap passa al 2 nivell de 6. Quan es es carrega un sector en
-// fifod sempre es llig el més antic del segon nivell i a continuació
-// es buida.
-static struct
-{
-
-  // Primer nivell
-  int          p1;
-  int          N1;
-  raw_sector_t v1[2];
-
-  // Segon nivell
-  int      p2;
-  int      N2;
-  sector_t v2[NBUFS];
-  
-  // Altres
-  uint8_t  subq[CD_SUBCH_SIZE];
-  uint8_t  last_header[HEADERSIZE];
-  bool     last_header_ok;
-  int      counter; // Compta sectors raw llegits.
-  
-} _bread;
-
-// Audio enviat a la SPU.
-static struct
-{
-
-  bool    playing; // Açò sols per a audio no comprimit.
-  int     track; // Track actual quan estem en mode playing.
-  int     remaining_sectors; // Sectors que queden per llegir. Sols en
-        		     // mode paying.
-  int     total_sectors; // Número total de sectors.
-  bool    mute;
-  int16_t buf[0x930/2]; // L,R,L,R,L,R ....
-  int     p; // Posició actual en buf
-  int     inc; // Increment
-  bool    backward_mode;
-  
-  // ADPCM
+    uint8_t cmd; // Codi
+    bool    pendent; // Cal executar cmd
+    int     first_response; // Pendent, ha de ficar-se quan toque.
+    int     second_response; // Pendent, ha de ficar-se quan toque.
+    int     irq_pendent_response; // -1 vol dir que no hi ha res.
+    struct
+    {
+      int     N;
+      uint8_t v[FIFO_SIZE];
+      uint8_t set_bits;
+      uint8_t reset_bits;
+    }       first,second,irq_pendent; // fifor per a la primera i segona resposta
+    bool    waiting_first_response;
+    bool    waiting_second_response;
+    bool    waiting_read;
+    bool    waiting_reset;
+    bool    waiting_seek;
+    bool    waiting_irq_expired;
+    bool    ack; // Indica que el comandament ja ha sigut 'acknwoledged'.
+    bool    paused; // Flag especial per al calc_seek.
+    uint8_t stat;
+    // NOTES de nocash sobre l'ignore bit!!!  The "Ignore Bit" does
+    // reportedly force a sector size of 2328 bytes (918h), however,
+    // that doesn't seem to be true. Instead, Bit4 seems to cause the
+    // controller to ignore the sector size in Bit5 (instead, the size
+    // is kept from the most recent Setmode command which didn't have
+    // Bit4 set). Also, Bit4 seems to cause the controller to ignore the
+    // <exact> Setloc position (instead, data is randomly returned from
+    // the "Setloc position minus 0..3 sectors"). And, Bit4 causes INT1
+    // to return status.Bit3=set (IdError). Purpose of Bit4 is unknown?
+    struct
+    {
+      bool double_speed;
+      bool xa_adpcm_enabled;
+      bool sector_size_924h_bit; // <-- Sols s'aplica si ignore bit és cert.
+      bool ignore_bit;
+      bool use_xa_filter;
+      bool enable_report_ints;
+      bool audio_pause;
+      bool enable_read_cdda_sectors;
+      bool sector_size_924h;
+    }       mode;
+    struct
+    {
+      int  amm; // Minut
+      int  ass; // Segon
+      int  asect; // Sector
+      bool data_mode;
+      bool processed; // Indica si s'ha processat
+      enum
+        {
+         AFTER_SEEK_STAT= 0,
+         AFTER_SEEK_READ,
+         AFTER_SEEK_PLAY
+        }  after; // Què es fa després del seek????
+    }       seek; // Per als comandaments de seek
+    struct
+    {
+      uint8_t file;
+      uint8_t channel;
+    } filter;
+  } _cmd;
+
+  // Interruptions.
   struct
   {
-    bool        demute;
-    adpcm_buf_t v[ADPCM_NBUFS];
-    int         current; // Posició primer buffer
-    int         p; // Posició dins del buffer.
-    int         N; // Nñumero de buffers plens
-    int16_t     old_l,older_l,old_r,older_r;
-    ringbuf_t   rbl,rbr;
-  } adpcm;
+    int mask;
+    int v;
+  } _ints;
 
-  // Volume
-  uint8_t tmp_vol_l2l,vol_l2l;
-  uint8_t tmp_vol_l2r,vol_l2r;
-  uint8_t tmp_vol_r2l,vol_r2l;
-  uint8_t tmp_vol_r2r,vol_r2r;
+  // Requests
+  struct
+  {
+    bool smen;
+    bool bfwr;
+    bool bfrd;
+  } _request;
 
-} _audio;
+  // Per al disc.
+  struct
+  {
+    CD_Info *info;
+    CD_Disc *current;
+    CD_Disc *next;
+    bool     inserted;
+    region_t region;
+  } _disc;
+
+  // Buffer lectura
+
+  // NOTA!!! Intentant seguir les obsevacions de NOCASH i el que fa
+  // Mednafen vaig a ficar 2 nivells de buffers. El primer nivell amb
+  // espai per a 2 sectors, cada vegada que s'intenta insertar un sector
+  // que no cap passa al 2 nivell de 6. Quan es es carrega un sector en
+  // fifod sempre es llig el més antic del segon nivell i a continuació
+  // es buida.
+  struct
+  {
+
+    // Primer nivell
+    int          p1;
+    int          N1;
+    raw_sector_t v1[2];
+
+    // Segon nivell
+    int      p2;
+    int      N2;
+    sector_t v2[NBUFS];
+
+    // Altres
+    uint8_t  subq[CD_SUBCH_SIZE];
+    uint8_t  last_header[HEADERSIZE];
+    bool     last_header_ok;
+    int      counter; // Compta sectors raw llegits.
+
+  } _bread;
+
+  // Audio enviat a la SPU.
+  struct
+  {
+
+    bool    playing; // Açò sols per a audio no comprimit.
+    int     track; // Track actual quan estem en mode playing.
+    int     remaining_sectors; // Sectors que queden per llegir. Sols en
+          		     // mode paying.
+    int     total_sectors; // Número total de sectors.
+    bool    mute;
+    int16_t buf[0x930/2]; // L,R,L,R,L,R ....
+    int     p; // Posició actual en buf
+    int     inc; // Increment
+    bool    backward_mode;
+
+    // ADPCM
+    struct
+    {
+      bool        demute;
+      adpcm_buf_t v[ADPCM_NBUFS];
+      int         current; // Posició primer buffer
+      int         p; // Posició dins del buffer.
+      int         N; // Nñumero de buffers plens
+      int16_t     old_l,older_l,old_r,older_r;
+      ringbuf_t   rbl,rbr;
+    } adpcm;
+
+    // Volume
+    uint8_t tmp_vol_l2l,vol_l2l;
+    uint8_t tmp_vol_l2r,vol_l2r;
+    uint8_t tmp_vol_r2l,vol_r2l;
+    uint8_t tmp_vol_r2r,vol_r2r;
+
+  } _audio;
+
+  // Buffers de treball de decode_adpcm_sector.
+  struct
+  {
+    int16_t auxl[ADPCM_MAXLEN_BUF];
+    int16_t auxr[ADPCM_MAXLEN_BUF];
+    int16_t tmp[ADPCM_MAXLEN_BUF];
+  } _adpcm_dec;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, CD );
+
+#define STATE PSX_CTX_STATE ( state_t, CD )
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _cd_cmd_trace (STATE._cd_cmd_trace)
+#define _run_cmd (STATE._run_cmd)
+#define _index (STATE._index)
+#define _fifop (STATE._fifop)
+#define _fifor (STATE._fifor)
+#define _fifod (STATE._fifod)
+#define _timing (STATE._timing)
+#define _cmd (STATE._cmd)
+#define _ints (STATE._ints)
+#define _request (STATE._request)
+#define _disc (STATE._disc)
+#define _bread (STATE._bread)
+#define _audio (STATE._audio)
+#define _adpcm_dec (STATE._adpcm_dec)
 
 
 
@@ -446,9 +479,6 @@ static void
 update_timing_event (void)
 {
 
-  int tmp;
-
-  
   // Actualitza cctoEvent
   _timing.cctoEvent= MAXCC;
   if ( _cmd.waiting_first_response &&
@@ -468,10 +498,8 @@ update_timing_event (void)
   if ( _disc.inserted && _timing.cc2disc_inserted < _timing.cctoEvent )
     _timing.cctoEvent= _timing.cc2disc_inserted;
 
-  // Update PSX_NextEventCC
-  tmp= PSX_Clock + PSX_cd_next_event_cc ();
-  if ( tmp < PSX_NextEventCC )
-    PSX_NextEventCC= tmp;
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_CD, PSX_cd_next_event_cc () );
   
 } // end update_timing_event
 
@@ -960,9 +988,9 @@ decode_adpcm_sector (
         	     )
 {
 
-  static int16_t auxl[ADPCM_MAXLEN_BUF];
-  static int16_t auxr[ADPCM_MAXLEN_BUF];
-  static int16_t tmp[ADPCM_MAXLEN_BUF];
+  int16_t *auxl= _adpcm_dec.auxl;
+  int16_t *auxr= _adpcm_dec.auxr;
+  int16_t *tmp= _adpcm_dec.tmp;
   bool stereo,bps4,rate_189;
   int length;
   adpcm_buf_t *buf;
@@ -1737,6 +1765,7 @@ read_next_sector (void)
       if ( crc_ok ) memcpy ( _bread.subq, tmp_subq, CD_SUBCH_SIZE );
       ++_bread.N1;
       ++_bread.counter;
+      PSX_COUNT ( cd_sectors );
     }
   else ret= READ_NEXT_SECTOR_ERROR;
   
@@ -2989,6 +3018,7 @@ clock (
       _timing.cc+= cc;
       _timing.cc_used+= cc;
     }
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_CD );
 
   // NOTA!!! És important que siga el primer, perquè més avall es pot
   // activar.
@@ -3048,6 +3078,7 @@ clock (
   // Actualitza.
   _timing.cc= 0;
   if ( update_timing ) update_timing_event ();
+  PSX_PROFILE_END;
   
 } // end clock
 
@@ -3114,8 +3145,7 @@ apply_volume (
 /**********************/
 
 void
-PSX_cd_end_iter (void)
-
+PSX_cd_clock (void)
 {
 
   int cc;
@@ -3129,6 +3159,15 @@ PSX_cd_end_iter (void)
       if ( _timing.cc >= _timing.cctoEvent )
         clock ( true );
     }
+  
+} // end PSX_cd_clock
+
+
+void
+PSX_cd_end_iter (void)
+{
+
+  PSX_cd_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_cd_end_iter
@@ -3217,6 +3256,159 @@ PSX_cd_init (
 } // end PSX_cd_init
 
 
+void
+PSX_cd_close (void)
+{
+
+  if ( _disc.info != NULL ) { CD_info_free ( _disc.info ); _disc.info= NULL; }
+  
+} // end PSX_cd_close
+
+
+void
+PSX_cd_state_save (
+                   PSX_State *st
+                   )
+{
+
+  bool has_current,has_next;
+  CD_Position pos;
+  
+
+  PSX_STATE_WRITE ( st, _index );
+  PSX_STATE_WRITE ( st, _fifop );
+  PSX_STATE_WRITE ( st, _fifor );
+  PSX_STATE_WRITE ( st, _fifod );
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _cmd );
+  PSX_STATE_WRITE ( st, _ints );
+  PSX_STATE_WRITE ( st, _request );
+  PSX_STATE_WRITE ( st, _bread );
+  PSX_STATE_WRITE ( st, _audio );
+
+  // Disc. Sols es guarda si n'hi ha i la posició de lectura.
+  has_current= _disc.current!=NULL;
+  has_next= _disc.next!=NULL;
+  if ( has_current ) pos= CD_disc_tell ( _disc.current );
+  else               memset ( &pos, 0, sizeof(pos) );
+  PSX_STATE_WRITE ( st, _disc.inserted );
+  PSX_STATE_WRITE ( st, _disc.region );
+  PSX_STATE_WRITE ( st, has_current );
+  PSX_STATE_WRITE ( st, has_next );
+  PSX_STATE_WRITE ( st, pos );
+  
+} // end PSX_cd_state_save
+
+
+void
+PSX_cd_state_load (
+                   PSX_State *st
+                   )
+{
+
+  bool has_current,has_next;
+  CD_Position pos;
+  CD_Disc *disc;
+  int n;
+  
+  
+  PSX_STATE_READ ( st, _index );
+  if ( _index < 0 || _index > 3 ) goto error;
+
+  // FIFOs.
+  PSX_STATE_READ ( st, _fifop );
+  if ( _fifop.N < 0 || _fifop.N > FIFO_SIZE ) goto error;
+  PSX_STATE_READ ( st, _fifor );
+  if ( _fifor.N < 0 || _fifor.N > FIFO_SIZE ||
+       _fifor.p < 0 || _fifor.p >= FIFO_SIZE ) goto error;
+  PSX_STATE_READ ( st, _fifod );
+  if ( _fifod.N < 0 || _fifod.p < 0 ||
+       _fifod.N > MAXBUFSIZE-_fifod.p ) goto error;
+  PSX_STATE_READ ( st, _timing );
+
+  // Comandament.
+  PSX_STATE_READ ( st, _cmd );
+  if ( _cmd.first.N < 0 || _cmd.first.N > FIFO_SIZE ||
+       _cmd.second.N < 0 || _cmd.second.N > FIFO_SIZE ||
+       _cmd.irq_pendent.N < 0 || _cmd.irq_pendent.N > FIFO_SIZE )
+    goto error;
+  PSX_STATE_READ ( st, _ints );
+  PSX_STATE_READ ( st, _request );
+
+  // Buffer lectura.
+  PSX_STATE_READ ( st, _bread );
+  if ( _bread.N1 < 0 || _bread.N1 > 2 ||
+       _bread.p1 < 0 || _bread.p1 > 1 ||
+       _bread.N2 < 0 || _bread.N2 > NBUFS ||
+       _bread.p2 < 0 || _bread.p2 >= NBUFS ) goto error;
+  for ( n= 0; n < NBUFS; ++n )
+    if ( _bread.v2[n].nbytes < 0 || _bread.v2[n].nbytes > MAXBUFSIZE )
+      goto error;
+
+  // Àudio.
+  PSX_STATE_READ ( st, _audio );
+  if ( _audio.p < 0 || _audio.p > 0x930/2 || (_audio.p&1) ||
+       _audio.adpcm.N < 0 || _audio.adpcm.N > ADPCM_NBUFS ||
+       _audio.adpcm.current < 0 || _audio.adpcm.current >= ADPCM_NBUFS ||
+       (_audio.adpcm.rbl.p&~0x1F) || (_audio.adpcm.rbr.p&~0x1F) )
+    goto error;
+  for ( n= 0; n < ADPCM_NBUFS; ++n )
+    if ( _audio.adpcm.v[n].length < 0 ||
+         _audio.adpcm.v[n].length > ADPCM_MAXLEN_BUF )
+      goto error;
+  if ( _audio.adpcm.p < 0 ||
+       (_audio.adpcm.N > 0 &&
+        _audio.adpcm.p >= _audio.adpcm.v[_audio.adpcm.current].length) )
+    goto error;
+
+  // Disc. S'assumeix que el disc actual del frontend és el mateix.
+  disc= _disc.inserted ? _disc.next : _disc.current;
+  PSX_STATE_READ ( st, _disc.inserted );
+  PSX_STATE_READ ( st, _disc.region );
+  PSX_STATE_READ ( st, has_current );
+  PSX_STATE_READ ( st, has_next );
+  PSX_STATE_READ ( st, pos );
+  if ( st->error ) return;
+  if ( (has_current || has_next) && disc == NULL )
+    _warning ( _udata, "CD (state): l'estat té un disc però no hi ha"
+               " cap disc insertat" );
+  if ( _disc.info != NULL ) { CD_info_free ( _disc.info ); _disc.info= NULL; }
+  _disc.current= has_current ? disc : NULL;
+  _disc.next= has_next ? disc : NULL;
+  if ( _disc.current != NULL )
+    {
+      _disc.info= CD_disc_get_info ( _disc.current );
+      if ( _disc.info == NULL )
+        {
+          fprintf ( stderr,
+                    "[EE] Load state, get info - cannot"
+                    " allocate memory" );
+          exit ( EXIT_FAILURE );
+        }
+      if ( !CD_disc_seek ( _disc.current, BCD2DEC(pos.mm),
+                           BCD2DEC(pos.ss), BCD2DEC(pos.sec) ) )
+        _warning ( _udata,
+                   "CD (state): no s'ha pogut tornar a la posició"
+                   " %d.%d.%d", pos.mm, pos.ss, pos.sec );
+    }
+
+  return;
+  
+ error:
+  _index= 0;
+  _fifop.N= 0;
+  _fifor.N= _fifor.p= 0;
+  _fifod.N= _fifod.p= 0;
+  _cmd.first.N= _cmd.second.N= _cmd.irq_pendent.N= 0;
+  _bread.N1= _bread.p1= _bread.N2= _bread.p2= 0;
+  _audio.p= 0;
+  _audio.adpcm.N= _audio.adpcm.current= _audio.adpcm.p= 0;
+  _audio.adpcm.rbl.p= _audio.adpcm.rbr.p= 0;
+  st->error= true;
+  
+} // end PSX_cd_state_load
+
+
 void
 PSX_cd_set_index (
         	  const uint8_t data
@@ -3521,6 +3713,19 @@ PSX_set_disc (
 } // end PSX_set_disc
 
 
+CD_Disc *
+PSX_cd_get_disc (void)
+{
+
+  clock ( false );
+  if ( _disc.inserted ) clock_disc ();
+  update_timing_event ();
+
+  return _disc.current;
+  
+} // end PSX_cd_get_disc
+
+
 void
 PSX_cd_set_mode_trace (
         	       const bool val
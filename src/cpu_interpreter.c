@@ -31,9 +31,15 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "PSX.h"
 
+#if defined __x86_64__ && defined __unix__ && !defined PSX_NO_REC
+#define REC_X86_64
+#include <sys/mman.h>
+#endif
+
 
 
 
@@ -65,6 +71,24 @@
 /* Torna a executar l'última instrucció. */
 #define HALT (new_PC-= 4)
 
+/* Grandària màxima d'un bucle d'espera. */
+#define IDLE_MAX_INSTS 16
+
+/* Entrada de la taula d'accés ràpid (r o w) d'una adreça virtual. */
+#define FASTMEM_PAGE(TABLE,ADDR)        				\
+  (&(_fastmem.TABLE[(ADDR)>>29][((ADDR)/PSX_MEM_FAST_PAGE_SIZE)&        \
+        			(PSX_MEM_FAST_PAGES-1)]))
+#define FASTMEM_OFF(ADDR) ((ADDR)&(PSX_MEM_FAST_PAGE_SIZE-1))
+
+/* Comptadors d'accessos a memòria (vore PSX_get_counters). */
+#ifdef PSX_COUNTERS
+#define COUNT_LOAD(ADDR) PSX_COUNT ( loads[counters_region ( (ADDR) )] )
+#define COUNT_STORE(ADDR) PSX_COUNT ( stores[counters_region ( (ADDR) )] )
+#else
+#define COUNT_LOAD(ADDR) ((void) 0)
+#define COUNT_STORE(ADDR) ((void) 0)
+#endif
+
 
 /*********/
 /* TIPUS */
@@ -179,118 +203,183 @@ mem_read (
 /* ESTAT */
 /*********/
 
-/* Callbacks. */
-static PSX_Warning *_warning;
-static void *_udata;
-
-/* Per a descodificar la instrucció. ATENCIÓ!!! Açò realment no és
-   estat. */
-static PSX_Word _inst_word;
-static uint32_t _opcode;
-static uint32_t _rs_field;
-static uint32_t _rt_field;
-static uint32_t _rd_field;
-static uint32_t _sa_field;
-static uint32_t _func_field;
-static uint32_t _index_field;
-static uint16_t _imm_field;
-
-/* Contador de delays pendents. Açò sí que és estat. */
-static int _delayed_ops;
-
-// Bàsicament, per a aconsseguir que el l'excepció provocada en un RFE
-// es produisca en la instrucció al tornar.
-// NOTA!! En realitat ho podria llevar, però ara mateixa és una
-// optimització, ja que sols fa la comprovació de les interrupcions
-// quan ha canviat alguna cosa que pot afectar a les interrupcions.
-static bool _check_int;
-
-// Nou valor del PC.
-static uint32_t new_PC;
-
-/* Per al branch. Açò sí que és estat. */
-static struct
+typedef struct
 {
 
-  enum {
-    BRANCH_EMPTY,
-    BRANCH_WAITING,
-    BRANCH_READY
-  }        state;
-  uint32_t addr;
-  bool     cond;
-  
-} _branch;
+  /* Callbacks. */
+  PSX_Warning *_warning;
+  void *_udata;
+
+  /* Per a descodificar la instrucció. ATENCIÓ!!! Açò realment no és
+     estat. */
+  PSX_Word _inst_word;
+  uint32_t _opcode;
+  uint32_t _rs_field;
+  uint32_t _rt_field;
+  uint32_t _rd_field;
+  uint32_t _sa_field;
+  uint32_t _func_field;
+  uint32_t _index_field;
+  uint16_t _imm_field;
+
+  /* Contador de delays pendents. Açò sí que és estat. */
+  int _delayed_ops;
+
+  // Bàsicament, per a aconsseguir que el l'excepció provocada en un RFE
+  // es produisca en la instrucció al tornar.
+  // NOTA!! En realitat ho podria llevar, però ara mateixa és una
+  // optimització, ja que sols fa la comprovació de les interrupcions
+  // quan ha canviat alguna cosa que pot afectar a les interrupcions.
+  bool _check_int;
+
+  // Nou valor del PC.
+  uint32_t new_PC;
+
+  // Valor de PSX_Clock en el que ha de parar PSX_cpu_run.
+  int _run_end;
+
+  // Detecció de bucles d'espera.
+  struct
+  {
 
-/* Per a la lecture aplaçada. Açò sí que és estat. */
-static struct
-{
-  
+    bool     enabled;
+    bool     active;       // Sols dins de PSX_cpu_run.
+    uint64_t cc;           // Cicles botats.
+    // Últim bucle analitzat. END és l'adreça del slot del bot.
+    uint32_t begin;
+    uint32_t end;
+    int      N;
+    uint32_t words[IDLE_MAX_INSTS];
+    bool     ok;
+    // Estat al final de l'última iteració.
+    bool     valid;
+    int      clock;
+    uint32_t gpr[32];
+    uint32_t hi,lo;
+
+  } _idle;
+
+  /* Per al branch. Açò sí que és estat. */
   struct
   {
+
     enum {
-      LDELAYED_EMPTY,
-      LDELAYED_WAITING,
-      LDELAYED_READY
+      BRANCH_EMPTY,
+      BRANCH_WAITING,
+      BRANCH_READY
     }        state;
-    uint32_t val;
-    bool     proceed;
-    bool     is_lwlr;
-  } v[32];
-  int as[32];
-  int N;
-  
-} _ldelayed;
+    uint32_t addr;
+    bool     cond;
 
-// Per a l'escriptura aplaçada en el COP0.
-static struct
-{
+  } _branch;
 
+  /* Per a la lecture aplaçada. Açò sí que és estat. */
   struct
   {
-    enum {
-      COP0WRITE_EMPTY,
-      COP0WRITE_WAITING,
-      COP0WRITE_READY
-    }        state;
-    uint32_t val;
-  }   v[64];
-  int as[64];
-  int N;
-  
-} _cop0write;
 
-// Per a l'escriptura aplaçada en el COP2.
-static struct
-{
+    struct
+    {
+      enum {
+        LDELAYED_EMPTY,
+        LDELAYED_WAITING,
+        LDELAYED_READY
+      }        state;
+      uint32_t val;
+      bool     proceed;
+      bool     is_lwlr;
+    } v[32];
+    int as[32];
+    int N;
+
+  } _ldelayed;
+
+  // Per a l'escriptura aplaçada en el COP0.
+  struct
+  {
 
+    struct
+    {
+      enum {
+        COP0WRITE_EMPTY,
+        COP0WRITE_WAITING,
+        COP0WRITE_READY
+      }        state;
+      uint32_t val;
+    }   v[64];
+    int as[64];
+    int N;
+
+  } _cop0write;
+
+  // Per a l'escriptura aplaçada en el COP2.
   struct
   {
-    enum {
-      COP2WRITE_EMPTY,
-      COP2WRITE_WAITING,
-      COP2WRITE_READY
-    }        state;
-    uint32_t val;
-  }   v[64];
-  int as[64];
-  int N;
-  
-} _cop2write;
 
-/* Estat auxiliar que es calcula a partir dels registres i que serveix
-   per a consultar ràpidament l'estat. */
-static struct
-{
+    struct
+    {
+      enum {
+        COP2WRITE_EMPTY,
+        COP2WRITE_WAITING,
+        COP2WRITE_READY
+      }        state;
+      uint32_t val;
+    }   v[64];
+    int as[64];
+    int N;
+
+  } _cop2write;
+
+  /* Estat auxiliar que es calcula a partir dels registres i que serveix
+     per a consultar ràpidament l'estat. */
+  struct
+  {
 
-  bool cache_isolated;
-  bool scratchpad_enabled;
-  bool user_mode;
-  bool is_le;
-  bool cop0_enabled;
-  bool cop2_enabled;
-  
-} _qflags;
+    bool cache_isolated;
+    bool scratchpad_enabled;
+    bool user_mode;
+    bool is_le;
+    bool cop0_enabled;
+    bool cop2_enabled;
+
+  } _qflags;
+
+  /* Taules d'accés ràpid a memòria de cada segment (adreça>>29). Depenen
+     de _qflags i es recalculen en update_qflags. */
+  struct
+  {
+
+    const PSX_MemFastPage *r[8];
+    const PSX_MemFastPage *w[8];
+
+  } _fastmem;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, CPU );
+
+#define STATE PSX_CTX_STATE ( state_t, CPU )
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _inst_word (STATE._inst_word)
+#define _opcode (STATE._opcode)
+#define _rs_field (STATE._rs_field)
+#define _rt_field (STATE._rt_field)
+#define _rd_field (STATE._rd_field)
+#define _sa_field (STATE._sa_field)
+#define _func_field (STATE._func_field)
+#define _index_field (STATE._index_field)
+#define _imm_field (STATE._imm_field)
+#define _delayed_ops (STATE._delayed_ops)
+#define _check_int (STATE._check_int)
+#define new_PC (STATE.new_PC)
+#define _run_end (STATE._run_end)
+#define _idle (STATE._idle)
+#define _branch (STATE._branch)
+#define _ldelayed (STATE._ldelayed)
+#define _cop0write (STATE._cop0write)
+#define _cop2write (STATE._cop2write)
+#define _qflags (STATE._qflags)
+#define _fastmem (STATE._fastmem)
 
 
 
@@ -300,6 +389,47 @@ static struct
 /*********************/
 
 /* Altres *********************************************************************/
+static void
+update_fastmem (void)
+{
+
+  const PSX_MemFastPage *none,*r,*w;
+  int n;
+  
+  
+  none= PSX_mem_get_fast_pages ( PSX_MEM_FAST_NONE );
+  for ( n= 0; n < 8; ++n )
+    _fastmem.r[n]= _fastmem.w[n]= none;
+  if ( !_qflags.is_le ) return;
+  
+  // kuseg i kseg0. Amb la memòria cau aïllada les lectures avisen i
+  // les escriptures s'ignoren, ho fan les funcions normals.
+  if ( !_qflags.cache_isolated )
+    {
+      if ( _qflags.scratchpad_enabled )
+        {
+          r= PSX_mem_get_fast_pages ( PSX_MEM_FAST_READ );
+          w= PSX_mem_get_fast_pages ( PSX_MEM_FAST_WRITE );
+        }
+      else
+        {
+          r= PSX_mem_get_fast_pages ( PSX_MEM_FAST_READ_NOSP );
+          w= PSX_mem_get_fast_pages ( PSX_MEM_FAST_WRITE_NOSP );
+        }
+      _fastmem.r[0]= r; _fastmem.w[0]= w;
+      if ( !_qflags.user_mode ) { _fastmem.r[4]= r; _fastmem.w[4]= w; }
+    }
+
+  // kseg1. No té scratchpad.
+  if ( !_qflags.user_mode )
+    {
+      _fastmem.r[5]= PSX_mem_get_fast_pages ( PSX_MEM_FAST_READ_NOSP );
+      _fastmem.w[5]= PSX_mem_get_fast_pages ( PSX_MEM_FAST_WRITE_NOSP );
+    }
+  
+} // end update_fastmem
+
+
 #if 0
 static void
 clear_ldelayed (void)
@@ -492,6 +622,8 @@ update_qflags (void)
   _qflags.cop0_enabled= !_qflags.user_mode || ((COP0R12_SR&COP0_SR_CU0)!=0);
   _qflags.cop2_enabled= ((COP0R12_SR&COP0_SR_CU2)!=0);
 
+  update_fastmem ();
+
   /* <--- S'activa per algun motiu, però no pareix que importe res.
   if ( (COP0R12_SR&COP0_SR_SWC) != 0 )
     {
@@ -527,6 +659,8 @@ exception (
   uint32_t tmp;
 
   
+  _idle.valid= false;
+  
   /* Fixa EPC. */
   /* PC ja s'ha incrementat quan estem ací. */
   if ( _branch.state == BRANCH_READY ) 
@@ -608,6 +742,31 @@ check_interruptions (void)
 
 
 /* Memòria ********************************************************************/
+#ifdef PSX_COUNTERS
+static PSX_CountersRegion
+counters_region (
+        	 const uint32_t addr
+        	 )
+{
+
+  uint32_t paddr;
+
+
+  if ( addr >= 0xC0000000 ) return PSX_COUNTERS_OTHER;
+  paddr= addr&0x1FFFFFFF;
+  if ( paddr < 0x00800000 ) return PSX_COUNTERS_RAM;
+  else if ( paddr >= 0x1F800000 && paddr < 0x1F800400 )
+    return PSX_COUNTERS_SCRATCHPAD;
+  else if ( paddr >= 0x1F801000 && paddr < 0x1F803000 )
+    return PSX_COUNTERS_IO;
+  else if ( paddr >= 0x1FC00000 && paddr < 0x1FC80000 )
+    return PSX_COUNTERS_BIOS;
+  else return PSX_COUNTERS_OTHER;
+  
+} // end counters_region
+#endif
+
+
 /* Torna true si s'ha llegit correctament. */
 static bool
 mem_read (
@@ -616,9 +775,26 @@ mem_read (
           const bool      read_data
           )
 {
+
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
   
   if ( addr&0x3 ) goto error_addr;
+  if ( read_data ) COUNT_LOAD ( addr );
+
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( r, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      *dst= *((const uint32_t *) (fp->p+off));
+      return true;
+    }
 
+  // Fora de I_STAT i I_MASK les lectures no són estables.
+  if ( (addr&0x1FFFFFF8) != 0x1F801070 ) _idle.valid= false;
+  
   /* kuseg */
   if ( addr < 0x80000000 )
     {
@@ -718,8 +894,25 @@ mem_read16 (
             )
 {
 
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
+
   if ( addr&0x1 ) goto error_addr;
+  COUNT_LOAD ( addr );
+
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( r, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      *dst= *((const uint16_t *) (fp->p+off));
+      return true;
+    }
 
+  // Fora de I_STAT i I_MASK les lectures no són estables.
+  if ( (addr&0x1FFFFFF8) != 0x1F801070 ) _idle.valid= false;
+  
   /* kuseg */
   if ( addr < 0x80000000 )
     {
@@ -826,6 +1019,24 @@ mem_read8 (
            )
 {
 
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
+
+  COUNT_LOAD ( addr );
+  
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( r, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      *dst= fp->p[off];
+      return true;
+    }
+
+  // Fora de I_STAT i I_MASK les lectures no són estables.
+  if ( (addr&0x1FFFFFF8) != 0x1F801070 ) _idle.valid= false;
+  
   /* kuseg */
   if ( addr < 0x80000000 )
     {
@@ -932,8 +1143,22 @@ mem_write (
            const uint32_t data
            )
 {
+
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
   
   if ( addr&0x3 ) goto error_addr;
+  COUNT_STORE ( addr );
+  
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( w, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      *((uint32_t *) (fp->p+off))= data;
+      return true;
+    }
   
   /* kuseg */
   if ( addr < 0x80000000 )
@@ -1046,7 +1271,21 @@ mem_write16 (
              )
 {
 
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
+
   if ( addr&0x1 ) goto error_addr;
+  COUNT_STORE ( addr );
+  
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( w, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      *((uint16_t *) (fp->p+off))= data;
+      return true;
+    }
   
   /* kuseg */
   if ( addr < 0x80000000 )
@@ -1166,6 +1405,21 @@ mem_write8 (
             )
 {
 
+  const PSX_MemFastPage *fp;
+  uint32_t off;
+  
+
+  COUNT_STORE ( addr );
+  
+  // Accés ràpid.
+  fp= FASTMEM_PAGE ( w, addr );
+  off= FASTMEM_OFF ( addr );
+  if ( off < fp->size )
+    {
+      fp->p[off]= data;
+      return true;
+    }
+  
   /* kuseg */
   if ( addr < 0x80000000 )
     {
@@ -1486,18 +1740,200 @@ exec_decoded_inst (void)
 } /* end exec_decoded_inst */
 
 
+/* Bucles d'espera ************************************************************/
+// Un bucle d'espera és un bucle curt sense bots interns ni
+// escriptures, que sols llig de memòria o de registres que no canvien
+// fins al següent event (I_STAT, I_MASK). Si després d'una iteració
+// sencera els registres són els mateixos que al final de l'anterior,
+// la UCP no pot eixir del bucle fins al següent event i es pot botar
+// directament a PSX_NextEventCC.
+static bool
+idle_inst_ok (
+              const uint32_t word
+              )
+{
+
+  switch ( word>>26 )
+    {
+    case 0x00:
+      switch ( word&0x3F )
+        {
+        case 0x00: case 0x02: case 0x03: case 0x04: case 0x06: case 0x07:
+        case 0x10: case 0x12:
+        case 0x21: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+        case 0x2A: case 0x2B:
+          return true;
+        default: return false;
+        }
+    case 0x09: case 0x0A: case 0x0B: case 0x0C: case 0x0D: case 0x0E:
+    case 0x0F:
+    case 0x20: case 0x21: case 0x23: case 0x24: case 0x25:
+      return true;
+    default: return false;
+    }
+  
+} // end idle_inst_ok
+
+
+static bool
+idle_branch_ok (
+        	const uint32_t word
+        	)
+{
+
+  switch ( word>>26 )
+    {
+    case 0x01: return ((word>>16)&0x1E) == 0; // BLTZ, BGEZ
+    case 0x02: // J
+    case 0x04: // BEQ
+    case 0x05: // BNE
+    case 0x06: // BLEZ
+    case 0x07: // BGTZ
+      return true;
+    default: return false;
+    }
+  
+} // end idle_branch_ok
+
+
+// Torna les instruccions del bucle BEGIN..END, o NULL si no estan en
+// RAM/BIOS o creuen una pàgina.
+static const uint32_t *
+idle_get_words (
+        	const uint32_t begin,
+        	const uint32_t end
+        	)
+{
+
+  const uint32_t *page;
+  uint32_t addr;
+  int id;
+  
+
+  if ( (begin^end)&~(PSX_MEM_CODE_PAGE_SIZE-1) ) return NULL;
+  if ( begin < 0x20000000 ) addr= begin;
+  else if ( begin >= 0x80000000 && begin < 0xC0000000 && !_qflags.user_mode )
+    addr= begin&0x1FFFFFFF;
+  else return NULL;
+  page= PSX_mem_get_code_page ( addr, &id );
+  if ( page == NULL ) return NULL;
+  
+  return page + ((addr&(PSX_MEM_CODE_PAGE_SIZE-1))>>2);
+  
+} // end idle_get_words
+
+
+static void
+idle_analyse (
+              const uint32_t begin,
+              const uint32_t end
+              )
+{
+
+  const uint32_t *words;
+  int n;
+  
+
+  _idle.begin= begin;
+  _idle.end= end;
+  _idle.N= (int) ((end-begin)>>2) + 1;
+  _idle.ok= false;
+  _idle.valid= false;
+  if ( _idle.N < 2 || _idle.N > IDLE_MAX_INSTS ) return;
+  words= idle_get_words ( begin, end );
+  if ( words == NULL ) return;
+  memcpy ( _idle.words, words, _idle.N*sizeof(uint32_t) );
+  for ( n= 0; n < _idle.N-2; ++n )
+    if ( !idle_inst_ok ( words[n] ) ) return;
+  if ( !idle_branch_ok ( words[_idle.N-2] ) ||
+       !idle_inst_ok ( words[_idle.N-1] ) )
+    return;
+  _idle.ok= true;
+  
+} // end idle_analyse
+
+
+// Es crida quan el bot del slot que està en PC torna a BEGIN.
+static void
+idle_loop (
+           const uint32_t begin
+           )
+{
+
+  const uint32_t *words;
+  int n,target;
+  
+
+  if ( begin != _idle.begin || PC != _idle.end ) idle_analyse ( begin, PC );
+  if ( !_idle.ok ) return;
+
+  // Les operacions pendents no formen part de l'estat comparat.
+  if ( _ldelayed.N != 0 || _cop0write.N != 0 || _cop2write.N != 0 )
+    {
+      _idle.valid= false;
+      return;
+    }
+
+  // Compara amb l'anterior iteració.
+  if ( _idle.valid &&
+       PSX_Clock-_idle.clock == _idle.N*PSX_CYCLES_INST &&
+       HI == _idle.hi && LO == _idle.lo )
+    {
+      for ( n= 1; n < 32 && GPR[n].v == _idle.gpr[n]; ++n );
+      if ( n == 32 )
+        {
+          // Comprova que el codi no ha canviat.
+          words= idle_get_words ( _idle.begin, _idle.end );
+          if ( words == NULL ||
+               memcmp ( words, _idle.words, _idle.N*sizeof(uint32_t) ) )
+            {
+              idle_analyse ( _idle.begin, _idle.end );
+              return;
+            }
+          // El slot encara no ha sumat els seus cicles.
+          target= PSX_NextEventCC < _run_end ? PSX_NextEventCC : _run_end;
+          target-= PSX_CYCLES_INST;
+          if ( target > PSX_Clock )
+            {
+              _idle.cc+= (uint64_t) (target-PSX_Clock);
+              PSX_Clock= target;
+            }
+          _idle.valid= false;
+          return;
+        }
+    }
+  
+  // Guarda l'estat.
+  for ( n= 1; n < 32; ++n )
+    _idle.gpr[n]= GPR[n].v;
+  _idle.hi= HI;
+  _idle.lo= LO;
+  _idle.clock= PSX_Clock;
+  _idle.valid= true;
+  
+} // end idle_loop
+
+
 static void
 run_delayed_ops (void)
 {
   
+  bool loop;
+  
+
   /* Branch. */
+  loop= false;
   switch ( _branch.state )
     {
     case BRANCH_WAITING:
       _branch.state= BRANCH_READY;
       break;
     case BRANCH_READY:
-      if ( _branch.cond ) new_PC= _branch.addr;
+      if ( _branch.cond )
+        {
+          new_PC= _branch.addr;
+          loop= _idle.active && new_PC <= PC;
+        }
       _branch.state= BRANCH_EMPTY;
       --_delayed_ops;
       break;
@@ -1512,31 +1948,23 @@ run_delayed_ops (void)
   
   // Escritura cop2.
   if ( _cop2write.N > 0 ) update_cop2write ();
+
+  // Bucles d'espera.
+  if ( loop ) idle_loop ( new_PC );
   
 } // end run_delayed_ops
 
 
-
-
-/**********************/
-/* FUNCIONS PÚBLIQUES */
-/**********************/
-
-int
-PSX_cpu_next_inst (void)
+// Llig, executa i actualitza el PC. Torna els cicles executats.
+static int
+exec_next_inst (void)
 {
 
   int ret;
 
   
-  // Comprova excepció pendent (RFE).
-  if ( _check_int )
-    {
-      _check_int= false;
-      if ( check_interruptions () ) return PSX_CYCLES_INST;
-    }
-  
   // Decodifica la instrucció.
+  PSX_COUNT ( insts );
   mem_read ( PC, &_inst_word.v, false );
   new_PC= PC + 4;
   OPCODE= _inst_word.v>>26;
@@ -1552,9 +1980,85 @@ PSX_cpu_next_inst (void)
 
   return ret;
   
+} // end exec_next_inst
+
+
+#include "cpu_interpreter_hle.h"
+#include "cpu_interpreter_cache.h"
+#include "cpu_interpreter_rec.h"
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+int
+PSX_cpu_next_inst (void)
+{
+  
+  // Comprova excepció pendent (RFE).
+  if ( _check_int )
+    {
+      _check_int= false;
+      if ( check_interruptions () ) return PSX_CYCLES_INST;
+    }
+
+  return exec_next_inst ();
+  
 } /* end PSX_cpu_next_inst */
 
 
+int
+PSX_cpu_run (
+             const int cc_budget
+             )
+{
+
+  int cc_start,cc;
+
+  
+  cc_start= PSX_Clock;
+  _run_end= PSX_Clock + cc_budget;
+  _idle.active= _idle.enabled;
+  _idle.valid= false;
+  if ( _rec.enabled ) rec_run ();
+  else if ( _cache.enabled ) cache_run ();
+  else
+    {
+      do {
+        
+        // Comprova excepció pendent (RFE).
+        if ( _check_int )
+          {
+            _check_int= false;
+            if ( check_interruptions () )
+              {
+        	PSX_Clock+= PSX_CYCLES_INST;
+        	break;
+              }
+          }
+
+        // NOTA!! exec_next_inst pot modificar PSX_Clock.
+        if ( _hle.active && hle_hook ( &cc ) )
+          PSX_Clock+= cc;
+        else
+          {
+            cc= exec_next_inst ();
+            PSX_Clock+= cc;
+          }
+        
+      } while ( PSX_Clock < _run_end && PSX_Clock < PSX_NextEventCC &&
+        	PSX_BusOwner == PSX_BUS_OWNER_CPU );
+    }
+  _idle.active= false;
+
+  return PSX_Clock - cc_start;
+  
+} // end PSX_cpu_run
+
+
 bool
 PSX_cpu_test_next_inst (void)
 {
@@ -1568,8 +2072,9 @@ PSX_cpu_test_next_inst (void)
 
 void
 PSX_cpu_init (
-              PSX_Warning *warning,
-              void        *udata
+              const PSX_CPUBackend  backend,
+              PSX_Warning          *warning,
+              void                 *udata
               )
 {
 
@@ -1592,10 +2097,105 @@ PSX_cpu_init (
 
   // Reseteja.
   first_reset ();
+
+  // Blocs.
+  memset ( _code.versions, 0, sizeof(_code.versions) );
+  _code.modified= false;
+  _rec.enabled= false;
+  _cache.enabled= false;
+  if ( backend == PSX_CPU_RECOMPILER ) rec_init ();
+  else if ( backend == PSX_CPU_CACHED_INTERPRETER ) cache_init ();
+
+  // Bucles d'espera.
+  _idle.enabled= true;
+  _idle.active= false;
+  _idle.cc= 0;
+  _idle.begin= _idle.end= 0xFFFFFFFF;
+  _idle.ok= false;
+  _idle.valid= false;
+
+  // HLE.
+  memset ( &_hle, 0, sizeof(_hle) );
   
 } /* end PSX_cpu_init */
 
 
+void
+PSX_cpu_close (void)
+{
+
+  rec_close ();
+  cache_close ();
+  
+} // end PSX_cpu_close
+
+
+void
+PSX_cpu_set_idle_skip (
+        	       const bool enabled
+        	       )
+{
+  _idle.enabled= enabled;
+} // end PSX_cpu_set_idle_skip
+
+
+uint64_t
+PSX_cpu_get_idle_cc (void)
+{
+  return _idle.cc;
+} // end PSX_cpu_get_idle_cc
+
+
+void
+PSX_cpu_set_bios_hle (
+        	      const bool enabled
+        	      )
+{
+  _hle.enabled= enabled;
+  _hle.active= _hle.enabled || _hle.shell;
+} // end PSX_cpu_set_bios_hle
+
+
+uint64_t
+PSX_cpu_get_bios_hle_hits (
+        		   const int func
+        		   )
+{
+  
+  if ( func < 0 || func >= PSX_BIOS_HLE_FUNCS ) return 0;
+  return _hle.hits[func];
+  
+} // end PSX_cpu_get_bios_hle_hits
+
+
+void
+PSX_cpu_set_shell_hook (
+        		const bool enabled
+        		)
+{
+  _hle.shell= enabled;
+  _hle.active= _hle.enabled || _hle.shell;
+} // end PSX_cpu_set_shell_hook
+
+
+void
+PSX_cpu_jump (
+              const uint32_t addr
+              )
+{
+
+  // Com en una excepció, les càrregues pendents es completen.
+  if ( _branch.state != BRANCH_EMPTY )
+    {
+      _branch.state= BRANCH_EMPTY;
+      --_delayed_ops;
+    }
+  _idle.valid= false;
+  new_PC= PC= addr;
+  
+} // end PSX_cpu_jump
+
+
 void
 PSX_cpu_set_int (
                  const int  id,
@@ -1636,8 +2236,83 @@ PSX_cpu_reset (void)
 } /* end PSX_cpu_reset */
 
 
+void
+PSX_cpu_state_save (
+                    PSX_State *st
+                    )
+{
+
+  uint64_t cc;
+  
+  
+  PSX_STATE_WRITE ( st, PSX_cpu_regs );
+  PSX_STATE_WRITE ( st, _delayed_ops );
+  PSX_STATE_WRITE ( st, _check_int );
+  PSX_STATE_WRITE ( st, new_PC );
+  PSX_STATE_WRITE ( st, _branch );
+  PSX_STATE_WRITE ( st, _ldelayed );
+  PSX_STATE_WRITE ( st, _cop0write );
+  PSX_STATE_WRITE ( st, _cop2write );
+  // Les estadístiques no es guarden perquè dos estats iguals siguen
+  // idèntics byte a byte.
+  cc= _idle.cc;
+  _idle.cc= 0;
+  PSX_STATE_WRITE ( st, _idle );
+  _idle.cc= cc;
+  PSX_STATE_WRITE ( st, _hle.shell );
+
+} // end PSX_cpu_state_save
+
+
+void
+PSX_cpu_state_load (
+                    PSX_State *st
+                    )
+{
+
+  bool enabled,shell;
+  uint64_t cc;
+
+
+  PSX_STATE_READ ( st, PSX_cpu_regs );
+  PSX_STATE_READ ( st, _delayed_ops );
+  PSX_STATE_READ ( st, _check_int );
+  PSX_STATE_READ ( st, new_PC );
+  PSX_STATE_READ ( st, _branch );
+  PSX_STATE_READ ( st, _ldelayed );
+  PSX_STATE_READ ( st, _cop0write );
+  PSX_STATE_READ ( st, _cop2write );
+
+  // Bucles d'espera. La configuració i les estadístiques no són estat.
+  enabled= _idle.enabled;
+  cc= _idle.cc;
+  PSX_STATE_READ ( st, _idle );
+  _idle.enabled= enabled;
+  _idle.active= false;
+  _idle.cc= cc;
+
+  // HLE.
+  PSX_STATE_READ ( st, shell );
+  PSX_cpu_set_shell_hook ( shell );
+
+  // Estat derivat. El codi traduït de les pàgines de RAM que canvien
+  // l'invalida PSX_mem_state_load.
+  update_qflags ();
+
+} // end PSX_cpu_state_load
+
+
 void
 PSX_cpu_update_state_interpreter (void)
 {
   update_qflags ();
 } /* end PSX_cpu_update_state_interpreter */
+
+
+void
+PSX_cpu_code_modified (
+        	       const int page
+        	       )
+{
+  code_modified ( page );
+} // end PSX_cpu_code_modified
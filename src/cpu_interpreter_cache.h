@@ -0,0 +1,519 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  cpu_interpreter_cache.h - Blocs bàsics de codi i cau de blocs
+ *                            descodificats.
+ *
+ */
+/*
+ * NOTA: Un bloc comença en qualsevol adreça de RAM o BIOS i acaba
+ * després del slot d'un salt, al final de la pàgina de codi (4KB), o
+ * després d'instruccions que poden canviar el mode (COP0) o que
+ * sempre provoquen excepció. Com l'estat 'delayed' és el de
+ * l'intèrpret, un bloc es pot interrompre després de qualsevol
+ * instrucció sense problemes.
+ *
+ * Els blocs es busquen per adreça física (pàgina i paraula), però com
+ * alguns càlculs depenen de l'adreça virtual (JAL, branch...) cada
+ * bloc recorda també l'adreça virtual. Cada pàgina té una versió que
+ * s'incrementa quan es modifica, els blocs amb una versió antiga es
+ * tornen a generar.
+ */
+
+
+#define BLOCK_MAX_INSTS 128
+#define BLOCK_PAGE_WORDS (PSX_MEM_CODE_PAGE_SIZE>>2)
+#define BLOCK_MAP_SIZE (PSX_MEM_CODE_PAGES*BLOCK_PAGE_WORDS)
+
+#define CACHE_MAX_BLOCKS (64*1024)
+#define CACHE_MAX_INSTS (1024*1024)
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+// Instrucció descodificada.
+typedef struct
+{
+
+  void     (*fun) (void);   // Si és NULL es crida a 'fun_cc'.
+  int      (*fun_cc) (void);
+  uint32_t   word;
+  uint16_t   imm;
+  uint8_t    rs;
+  uint8_t    rt;
+  uint8_t    rd;
+  uint8_t    sa;
+  uint8_t    func;
+
+} cache_inst_t;
+
+typedef struct
+{
+
+  cache_inst_t *v;
+  int           N;
+  uint32_t      pc;      // Adreça virtual de la primera instrucció.
+  int           page;    // Pàgina de codi.
+  uint32_t      version; // Versió de la pàgina quan es va descodificar.
+
+} cache_block_t;
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  // Pàgines de codi.
+  struct
+  {
+
+    uint32_t versions[PSX_MEM_CODE_PAGES];
+    bool     modified; // S'ha modificat codi des de l'última comprovació.
+
+  } _code;
+
+  // Cau de blocs descodificats.
+  struct
+  {
+
+    bool            enabled;
+    cache_block_t  *blocks;
+    int             N;
+    cache_inst_t   *insts;
+    int             Ninsts;
+    cache_block_t **map;
+
+  } _cache;
+
+} cache_state_t;
+
+PSX_CTX_DEFINE ( cache_state_t, CPU_CACHE );
+
+#define CACHE_STATE PSX_CTX_STATE ( cache_state_t, CPU_CACHE )
+#define _code (CACHE_STATE._code)
+#define _cache (CACHE_STATE._cache)
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+/* Blocs **********************************************************************/
+// Torna la pàgina de codi on està PC, o NULL si PC no es pot llegir
+// sense provocar excepcions o no està en RAM/BIOS. En IND torna
+// l'índex de la paraula (pàgina i desplaçament).
+static const uint32_t *
+code_get_page (
+               int *page,
+               int *ind
+               )
+{
+
+  const uint32_t *ret;
+  uint32_t addr;
+
+
+  if ( PC&0x3 ) return NULL;
+  if ( PC < 0x20000000 ) addr= PC;
+  else if ( PC >= 0x80000000 && PC < 0xC0000000 && !_qflags.user_mode )
+    addr= PC&0x1FFFFFFF;
+  else return NULL;
+  ret= PSX_mem_get_code_page ( addr, page );
+  if ( ret != NULL )
+    *ind= (*page)*BLOCK_PAGE_WORDS + ((addr>>2)&(BLOCK_PAGE_WORDS-1));
+
+  return ret;
+
+} // end code_get_page
+
+
+static void
+code_modified (
+               const int page
+               )
+{
+
+  ++_code.versions[page];
+  _code.modified= true;
+
+} // end code_modified
+
+
+static bool
+inst_is_branch (
+        	const uint32_t word
+        	)
+{
+
+  switch ( word>>26 )
+    {
+    case 0x00: return (word&0x3E) == 0x08; // JR, JALR
+    case 0x01:
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+    case 0x07:
+      return true;
+    default: return false;
+    }
+
+} // end inst_is_branch
+
+
+// Instruccions després de les quals no te sentit continuar el bloc.
+static bool
+inst_ends_block (
+        	 const uint32_t word
+        	 )
+{
+
+  switch ( word>>26 )
+    {
+    case 0x00: return (word&0x3E) == 0x0C; // SYSCALL, BREAK
+    case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06:
+    case 0x07: case 0x08: case 0x09: case 0x0A: case 0x0B: case 0x0C:
+    case 0x0D: case 0x0E: case 0x0F:
+    case 0x12:
+    case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x25:
+    case 0x26:
+    case 0x28: case 0x29: case 0x2A: case 0x2B:
+    case 0x2E:
+    case 0x32:
+    case 0x3A:
+      return false;
+    default: return true; // COP0 (pot canviar el mode) i desconegudes.
+    }
+
+} // end inst_ends_block
+
+
+// Torna el número d'instruccions del bloc que comença en la paraula
+// OFF de la pàgina WORDS.
+static int
+block_size (
+            const uint32_t *words,
+            const int       off
+            )
+{
+
+  int n;
+  bool in_slot;
+  uint32_t word;
+
+
+  in_slot= false;
+  for ( n= 0; n < BLOCK_MAX_INSTS && off+n < BLOCK_PAGE_WORDS; )
+    {
+      word= words[off+n++];
+      if ( in_slot || inst_ends_block ( word ) ) break;
+      in_slot= inst_is_branch ( word );
+    }
+
+  return n;
+
+} // end block_size
+
+
+/* Cau ************************************************************************/
+static void
+cache_decode (
+              cache_inst_t   *inst,
+              const uint32_t  word
+              )
+{
+
+  inst->word= word;
+  inst->rs= (word>>21)&0x1F;
+  inst->rt= (word>>16)&0x1F;
+  inst->rd= (word>>11)&0x1F;
+  inst->sa= (word>>6)&0x1F;
+  inst->func= word&0x3F;
+  inst->imm= (uint16_t) (word&0xFFFF);
+  inst->fun= NULL;
+  inst->fun_cc= NULL;
+  switch ( word>>26 )
+    {
+
+      // SPECIAL i BCOND es descodifiquen ací.
+    case 0x00:
+      switch ( inst->func )
+        {
+        case 0x00: inst->fun= sll; break;
+        case 0x02: inst->fun= srl; break;
+        case 0x03: inst->fun= sra; break;
+        case 0x04: inst->fun= sllv; break;
+        case 0x06: inst->fun= srlv; break;
+        case 0x07: inst->fun= srav; break;
+        case 0x08: inst->fun= jr; break;
+        case 0x09: inst->fun= jalr; break;
+        case 0x0C: inst->fun= syscall; break;
+        case 0x0D: inst->fun= break_; break;
+        case 0x10: inst->fun= mfhi; break;
+        case 0x11: inst->fun= mthi; break;
+        case 0x12: inst->fun= mflo; break;
+        case 0x13: inst->fun= mtlo; break;
+        case 0x18: inst->fun= mult; break;
+        case 0x19: inst->fun= multu; break;
+        case 0x1A: inst->fun= div_; break;
+        case 0x1B: inst->fun= divu; break;
+        case 0x20: inst->fun= add; break;
+        case 0x21: inst->fun= addu; break;
+        case 0x22: inst->fun= sub; break;
+        case 0x23: inst->fun= subu; break;
+        case 0x24: inst->fun= and; break;
+        case 0x25: inst->fun= or; break;
+        case 0x26: inst->fun= xor; break;
+        case 0x27: inst->fun= nor; break;
+        case 0x2A: inst->fun= slt; break;
+        case 0x2B: inst->fun= sltu; break;
+        default: inst->fun= unk_special_inst; break;
+        }
+      break;
+    case 0x01:
+      switch ( inst->rt )
+        {
+        case 0x00: inst->fun= bltz; break;
+        case 0x01: inst->fun= bgez; break;
+        case 0x10: inst->fun= bltzal; break;
+        case 0x11: inst->fun= bgezal; break;
+        default: inst->fun= unk_bcond_inst; break;
+        }
+      break;
+
+      // La resta descodifiquen ells mateixa.
+    case 0x02: inst->fun= j; break;
+    case 0x03: inst->fun= jal; break;
+    case 0x04: inst->fun= beq; break;
+    case 0x05: inst->fun= bne; break;
+    case 0x06: inst->fun= blez; break;
+    case 0x07: inst->fun= bgtz; break;
+    case 0x08: inst->fun= addi; break;
+    case 0x09: inst->fun= addiu; break;
+    case 0x0A: inst->fun= slti; break;
+    case 0x0B: inst->fun= sltiu; break;
+    case 0x0C: inst->fun= andi; break;
+    case 0x0D: inst->fun= ori; break;
+    case 0x0E: inst->fun= xori; break;
+    case 0x0F: inst->fun= lui; break;
+    case 0x10: inst->fun= cop0; break;
+    case 0x12: inst->fun_cc= cop2; break;
+    case 0x20: inst->fun= lb; break;
+    case 0x21: inst->fun= lh; break;
+    case 0x22: inst->fun= lwl; break;
+    case 0x23: inst->fun= lw; break;
+    case 0x24: inst->fun= lbu; break;
+    case 0x25: inst->fun= lhu; break;
+    case 0x26: inst->fun= lwr; break;
+    case 0x28: inst->fun= sb; break;
+    case 0x29: inst->fun= sh; break;
+    case 0x2A: inst->fun= swl; break;
+    case 0x2B: inst->fun= sw; break;
+    case 0x2E: inst->fun= swr; break;
+    case 0x32: inst->fun= lwc2; break;
+    case 0x3A: inst->fun_cc= swc2; break;
+    default: inst->fun= unk_inst; break;
+    }
+
+} // end cache_decode
+
+
+static void
+cache_flush (void)
+{
+
+  memset ( _cache.map, 0, sizeof(cache_block_t *)*BLOCK_MAP_SIZE );
+  _cache.N= 0;
+  _cache.Ninsts= 0;
+
+} // end cache_flush
+
+
+// Torna el bloc que comença en PC, o NULL si PC no es pot cachejar.
+static cache_block_t *
+cache_get_block (void)
+{
+
+  cache_block_t *b;
+  const uint32_t *words;
+  int page,ind,off,n;
+
+
+  // Busca.
+  words= code_get_page ( &page, &ind );
+  if ( words == NULL ) return NULL;
+  b= _cache.map[ind];
+  if ( b != NULL && b->pc == PC && b->version == _code.versions[page] )
+    return b;
+
+  // Descodifica.
+  if ( _cache.N == CACHE_MAX_BLOCKS ||
+       _cache.Ninsts+BLOCK_MAX_INSTS > CACHE_MAX_INSTS )
+    cache_flush ();
+  b= &_cache.blocks[_cache.N++];
+  off= ind%BLOCK_PAGE_WORDS;
+  b->v= &_cache.insts[_cache.Ninsts];
+  b->N= block_size ( words, off );
+  b->pc= PC;
+  b->page= page;
+  b->version= _code.versions[page];
+  for ( n= 0; n < b->N; ++n )
+    cache_decode ( &(b->v[n]), words[off+n] );
+  _cache.Ninsts+= b->N;
+  _cache.map[ind]= b;
+  PSX_mem_watch_code_page ( page );
+
+  return b;
+
+} // end cache_get_block
+
+
+static bool
+cache_init (void)
+{
+
+  // Ja inicialitzat.
+  if ( _cache.map != NULL )
+    {
+      cache_flush ();
+      _cache.enabled= true;
+      return true;
+    }
+
+  // Reserva.
+  _cache.blocks= (cache_block_t *)
+    malloc ( sizeof(cache_block_t)*CACHE_MAX_BLOCKS );
+  _cache.insts= (cache_inst_t *)
+    malloc ( sizeof(cache_inst_t)*CACHE_MAX_INSTS );
+  _cache.map= (cache_block_t **)
+    malloc ( sizeof(cache_block_t *)*BLOCK_MAP_SIZE );
+  if ( _cache.blocks == NULL || _cache.insts == NULL || _cache.map == NULL )
+    {
+      free ( _cache.blocks ); _cache.blocks= NULL;
+      free ( _cache.insts ); _cache.insts= NULL;
+      free ( _cache.map ); _cache.map= NULL;
+      WW ( UDATA, "no s'ha pogut reservar memòria per a la cau de blocs,"
+           " s'emprarà l'intèrpret" );
+      _cache.enabled= false;
+      return false;
+    }
+  cache_flush ();
+  _cache.enabled= true;
+
+  return true;
+
+} // end cache_init
+
+
+static void
+cache_close (void)
+{
+
+  free ( _cache.blocks ); _cache.blocks= NULL;
+  free ( _cache.insts ); _cache.insts= NULL;
+  free ( _cache.map ); _cache.map= NULL;
+  _cache.enabled= false;
+  
+} // end cache_close
+
+
+static void
+cache_run (void)
+{
+
+  const cache_block_t *b;
+  const cache_inst_t *inst,*end;
+  uint32_t next_PC;
+  int cc;
+
+
+  do {
+
+    // Comprova excepció pendent (RFE).
+    if ( _check_int )
+      {
+        _check_int= false;
+        if ( check_interruptions () )
+          {
+            PSX_Clock+= PSX_CYCLES_INST;
+            break;
+          }
+      }
+
+    // Funcions de la BIOS i shell.
+    if ( _hle.active && hle_hook ( &cc ) )
+      {
+        PSX_Clock+= cc;
+        continue;
+      }
+    
+    // Instruccions fora de RAM/BIOS.
+    b= cache_get_block ();
+    if ( b == NULL )
+      {
+        cc= exec_next_inst ();
+        PSX_Clock+= cc;
+        continue;
+      }
+
+    // Executa el bloc.
+    _code.modified= false;
+    for ( inst= b->v, end= inst+b->N; inst != end; ++inst )
+      {
+        _inst_word.v= inst->word;
+        OPCODE= inst->word>>26;
+        RS= inst->rs;
+        RT= inst->rt;
+        RD= inst->rd;
+        SA= inst->sa;
+        FUNCTION= inst->func;
+        IMMEDIATE= inst->imm;
+        next_PC= new_PC= PC + 4;
+        PSX_COUNT ( insts );
+        if ( inst->fun != NULL )
+          {
+            inst->fun ();
+            cc= PSX_CYCLES_INST;
+          }
+        else cc= inst->fun_cc ();
+        if ( _delayed_ops ) run_delayed_ops ();
+        PC= new_PC;
+        PSX_Clock+= cc;
+        if ( PC != next_PC || _check_int || _code.modified ||
+             PSX_BusOwner != PSX_BUS_OWNER_CPU ||
+             PSX_Clock >= PSX_NextEventCC || PSX_Clock >= _run_end )
+          break;
+      }
+
+  } while ( PSX_Clock < _run_end && PSX_Clock < PSX_NextEventCC &&
+            PSX_BusOwner == PSX_BUS_OWNER_CPU );
+
+} // end cache_run
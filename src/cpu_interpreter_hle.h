@@ -0,0 +1,475 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  cpu_interpreter_hle.h - Emulació d'alt nivell d'algunes funcions
+ *                          de la BIOS (taula A0h).
+ *
+ */
+/*
+ * NOTA: Quan PSX_cpu_run va a executar la instrucció de 000000A0h
+ * (en qualsevol segment), es mira la funció demanada (T1). Si és una
+ * de les implementades, l'entrada de la taula de la BIOS en RAM
+ * encara apunta a la ROM, i tots els accessos són a RAM, s'executa
+ * ací i es torna a RA. En cas contrari s'executa el codi de la
+ * BIOS. Els cicles que es sumen són una estimació del que tarda la
+ * BIOS, i sols es fa si caben abans del següent event (o són com a
+ * molt HLE_MIN_BYTES bytes), per a no retardar massa les
+ * interrupcions.
+ *
+ * Les taules B0h i C0h no es miren. Les seues funcions treballen
+ * amb estructures del kernel (events, fils, dispositius, targetes)
+ * i no n'hi ha cap que siga alhora freqüent i sense efectes
+ * laterals, així que sempre s'executen amb el codi de la BIOS.
+ *
+ * Els comportaments en casos extrems (punters a 0, longituds
+ * negatives) són els que descriu la documentació de NOCASH.
+ *
+ * A banda, si està activat el ganxo del shell, quan s'arriba a
+ * 80030000h (la BIOS ja ha inicialitzat el kernel i va a executar el
+ * shell) es crida a PSX_exe_shell, que pot carregar directament un
+ * executable.
+ */
+
+
+#define HLE_IS_VECTOR(ADDR) (((ADDR)&0x1FFFFFFF) == 0xA0)
+
+// Adreça física on comença el shell.
+#define HLE_SHELL_ADDR 0x00030000
+
+// Adreça física de la taula de funcions A0h en RAM.
+#define HLE_A0_TABLE 0x00000200
+
+// Cost estimat en instruccions.
+#define HLE_CALL_INSTS 10
+#define HLE_BYTE_INSTS 4
+
+// Bytes que sempre es poden processar encara que es passe del
+// següent event. Sense açò quasi cap crida cabria entre mostres de
+// l'SPU.
+#define HLE_MIN_BYTES 64
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  bool     active; // enabled || shell
+  bool     enabled;
+  bool     shell;
+  uint64_t hits[PSX_BIOS_HLE_FUNCS];
+
+} hle_state_t;
+
+PSX_CTX_DEFINE ( hle_state_t, CPU_HLE );
+
+#define _hle PSX_CTX_STATE ( hle_state_t, CPU_HLE )
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+/* Memòria ********************************************************************/
+// Comprova que [ADDR,ADDR+LEN) és RAM accessible des del mode
+// actual.
+static bool
+hle_ram_ok (
+            const uint32_t addr,
+            const uint32_t len
+            )
+{
+
+  PSX_MemMap map;
+  uint32_t last;
+
+
+  if ( len == 0 ) return true;
+  last= addr + (len-1);
+  if ( last < addr || (addr>>29) != (last>>29) ) return false;
+  switch ( addr>>29 )
+    {
+    case 0: case 4: case 5: break;
+    default: return false;
+    }
+  PSX_mem_get_map ( &map );
+
+  return (last&0x1FFFFFFF) < map.ram.end_ram;
+
+} // end hle_ram_ok
+
+
+static uint8_t
+hle_read8 (
+           const uint32_t addr
+           )
+{
+
+  const PSX_MemFastPage *fp;
+  uint8_t ret;
+
+
+  fp= FASTMEM_PAGE ( r, addr );
+  if ( FASTMEM_OFF ( addr ) < fp->size ) return fp->p[FASTMEM_OFF ( addr )];
+  PSX_mem_read8 ( addr&0x1FFFFFFF, &ret, true );
+
+  return ret;
+
+} // end hle_read8
+
+
+static void
+hle_write8 (
+            const uint32_t addr,
+            const uint8_t  data
+            )
+{
+
+  const PSX_MemFastPage *fp;
+
+
+  // Les pàgines de codi vigilades no estan en la taula.
+  fp= FASTMEM_PAGE ( w, addr );
+  if ( FASTMEM_OFF ( addr ) < fp->size ) fp->p[FASTMEM_OFF ( addr )]= data;
+  else PSX_mem_write8 ( addr&0x1FFFFFFF, data, data, true );
+
+} // end hle_write8
+
+
+// Torna la longitud de la cadena, o -1 si no està tota en RAM o és
+// més llarga que MAX.
+static int
+hle_strlen (
+            const uint32_t addr,
+            const int      max
+            )
+{
+
+  int ret;
+
+
+  for ( ret= 0; ret <= max; ++ret )
+    {
+      if ( !hle_ram_ok ( addr+ret, 1 ) ) return -1;
+      if ( hle_read8 ( addr+ret ) == 0 ) return ret;
+    }
+
+  return -1;
+
+} // end hle_strlen
+
+
+/* Funcions A0h ***************************************************************/
+// Totes tornen el nombre de bytes processats, o -1 si cal executar la
+// BIOS. El valor de retorn de la funció es deixa en RET.
+
+// A(0Eh) abs(val), A(0Fh) labs(val).
+static int
+hle_abs (
+         uint32_t *ret
+         )
+{
+
+  *ret= ((int32_t) GPR[4].v < 0) ? (uint32_t) -GPR[4].v : GPR[4].v;
+
+  return 0;
+
+} // end hle_abs
+
+
+// A(17h) strcmp(str1,str2), A(18h) strncmp(str1,str2,maxlen). Torna
+// la diferència entre els primers caràcters distints. Si algun d'ells
+// és major que 7Fh es deixa a la BIOS, perquè el resultat depén de si
+// els tracta amb signe.
+static int
+hle_strcmp (
+            const bool  bounded,
+            const int   max,
+            uint32_t   *ret
+            )
+{
+
+  uint32_t s1,s2,len;
+  uint8_t c1,c2;
+  int n;
+
+
+  s1= GPR[4].v;
+  s2= GPR[5].v;
+  if ( s1 == 0 || s2 == 0 )
+    {
+      *ret= s1 == s2 ? 0 : (s1 == 0 ? (uint32_t) -1 : 1);
+      return 0;
+    }
+  len= bounded ? GPR[6].v : 0xFFFFFFFF;
+  if ( bounded && len > 0x7FFFFFFF ) return -1;
+  for ( n= 0; (uint32_t) n < len; ++n )
+    {
+      if ( n > max || !hle_ram_ok ( s1+n, 1 ) || !hle_ram_ok ( s2+n, 1 ) )
+        return -1;
+      c1= hle_read8 ( s1+n );
+      c2= hle_read8 ( s2+n );
+      if ( c1 != c2 )
+        {
+          if ( (c1|c2)&0x80 ) return -1;
+          *ret= (uint32_t) ((int) c1 - (int) c2);
+          return n+1;
+        }
+      if ( c1 == 0 ) { *ret= 0; return n+1; }
+    }
+  *ret= 0;
+
+  return n;
+
+} // end hle_strcmp
+
+
+// A(19h) strcpy(dst,src).
+static int
+hle_strcpy (
+            const int  max,
+            uint32_t  *ret
+            )
+{
+
+  uint32_t dst,src;
+  int len,n;
+
+
+  dst= GPR[4].v;
+  src= GPR[5].v;
+  if ( dst == 0 || src == 0 ) { *ret= 0; return 0; }
+  len= hle_strlen ( src, max );
+  if ( len == -1 || !hle_ram_ok ( dst, len+1 ) ) return -1;
+  for ( n= 0; n <= len; ++n )
+    hle_write8 ( dst+n, hle_read8 ( src+n ) );
+  *ret= dst;
+
+  return len+1;
+
+} // end hle_strcpy
+
+
+// A(1Bh) strlen(src).
+static int
+hle_strlen_ (
+             const int  max,
+             uint32_t  *ret
+             )
+{
+
+  int len;
+
+
+  if ( GPR[4].v == 0 ) { *ret= 0; return 0; }
+  len= hle_strlen ( GPR[4].v, max );
+  if ( len == -1 ) return -1;
+  *ret= (uint32_t) len;
+
+  return len;
+
+} // end hle_strlen_
+
+
+// A(25h) toupper(char), A(26h) tolower(char).
+static int
+hle_case (
+          const bool  upper,
+          uint32_t   *ret
+          )
+{
+
+  uint8_t c;
+
+
+  c= (uint8_t) GPR[4].v;
+  if ( upper && c >= 'a' && c <= 'z' ) c-= 'a'-'A';
+  else if ( !upper && c >= 'A' && c <= 'Z' ) c+= 'a'-'A';
+  *ret= c;
+
+  return 0;
+
+} // end hle_case
+
+
+// A(28h) bzero(dst,len), A(2Bh) memset(dst,fillbyte,len).
+static int
+hle_memset (
+            const uint32_t  dst,
+            const uint8_t   val,
+            const uint32_t  len,
+            const int       max,
+            uint32_t       *ret
+            )
+{
+
+  uint32_t n;
+
+
+  if ( dst == 0 || len == 0 || len > 0x7FFFFFFF ) { *ret= 0; return 0; }
+  if ( len > (uint32_t) max || !hle_ram_ok ( dst, len ) ) return -1;
+  for ( n= 0; n < len; ++n )
+    hle_write8 ( dst+n, val );
+  *ret= dst;
+
+  return (int) len;
+
+} // end hle_memset
+
+
+// A(2Ah) memcpy(dst,src,len). Es copia byte a byte cap avant, com la
+// BIOS, per a que el resultat siga el mateix si es solapen.
+static int
+hle_memcpy (
+            const int  max,
+            uint32_t  *ret
+            )
+{
+
+  uint32_t dst,src,len,n;
+
+
+  dst= GPR[4].v;
+  src= GPR[5].v;
+  len= GPR[6].v;
+  *ret= dst;
+  if ( dst == 0 || src == 0 || len == 0 || len > 0x7FFFFFFF ) return 0;
+  if ( len > (uint32_t) max ||
+       !hle_ram_ok ( dst, len ) || !hle_ram_ok ( src, len ) )
+    return -1;
+  for ( n= 0; n < len; ++n )
+    hle_write8 ( dst+n, hle_read8 ( src+n ) );
+
+  return (int) len;
+
+} // end hle_memcpy
+
+
+/* Crides *********************************************************************/
+// Torna true si l'entrada de la taula encara apunta a la ROM.
+static bool
+hle_entry_is_rom (
+        	  const uint32_t table,
+        	  const uint32_t func
+        	  )
+{
+
+  uint32_t entry;
+
+
+  if ( !PSX_mem_read ( table + func*4, &entry ) ) return false;
+  entry&= 0x1FFFFFFF;
+
+  return entry >= 0x1FC00000 && entry < 0x1FC00000+PSX_BIOS_SIZE;
+
+} // end hle_entry_is_rom
+
+
+// Intenta executar la funció de la BIOS a la que es crida. Torna
+// true si s'ha executat, i en CC els cicles.
+static bool
+hle_call (
+          int *cc
+          )
+{
+
+  uint32_t func,ret;
+  int n,max,end;
+
+
+  // Estat de la UCP.
+  if ( _delayed_ops != 0 || _qflags.cache_isolated ||
+       _qflags.user_mode || !_qflags.is_le )
+    return false;
+
+  // Funció.
+  func= GPR[9].v;
+  if ( func >= PSX_BIOS_HLE_FUNCS ) return false;
+  switch ( func )
+    {
+    case 0x0E: case 0x0F: case 0x17: case 0x18: case 0x19: case 0x1B:
+    case 0x25: case 0x26: case 0x28: case 0x2A: case 0x2B: break;
+    default: return false; // No implementada.
+    }
+  if ( !hle_entry_is_rom ( HLE_A0_TABLE, func ) ) return false;
+
+  // Bytes que es poden processar abans del següent event.
+  end= PSX_NextEventCC < _run_end ? PSX_NextEventCC : _run_end;
+  max= ((end-PSX_Clock)/PSX_CYCLES_INST - HLE_CALL_INSTS)/HLE_BYTE_INSTS;
+  if ( max < HLE_MIN_BYTES ) max= HLE_MIN_BYTES;
+
+  // Executa.
+  n= -1;
+  switch ( func )
+    {
+    case 0x0E: // abs
+    case 0x0F: n= hle_abs ( &ret ); break; // labs
+    case 0x17: n= hle_strcmp ( false, max, &ret ); break;
+    case 0x18: n= hle_strcmp ( true, max, &ret ); break; // strncmp
+    case 0x19: n= hle_strcpy ( max, &ret ); break;
+    case 0x1B: n= hle_strlen_ ( max, &ret ); break;
+    case 0x25: n= hle_case ( true, &ret ); break; // toupper
+    case 0x26: n= hle_case ( false, &ret ); break; // tolower
+    case 0x28: // bzero
+      n= hle_memset ( GPR[4].v, 0, GPR[5].v, max, &ret );
+      break;
+    case 0x2A: n= hle_memcpy ( max, &ret ); break;
+    case 0x2B: // memset
+      n= hle_memset ( GPR[4].v, (uint8_t) GPR[5].v, GPR[6].v, max, &ret );
+      break;
+    default: break;
+    }
+  if ( n == -1 ) return false;
+
+  // Torna.
+  GPR[2].v= ret;
+  PC= new_PC= GPR[31].v;
+  ++_hle.hits[func];
+  *cc= (HLE_CALL_INSTS + n*HLE_BYTE_INSTS)*PSX_CYCLES_INST;
+
+  return true;
+
+} // end hle_call
+
+
+// Comprova si la instrucció en PC s'ha d'emular. Torna true si s'ha
+// executat, i en CC els cicles.
+static bool
+hle_hook (
+          int *cc
+          )
+{
+
+  if ( _hle.shell && (PC&0x1FFFFFFF) == HLE_SHELL_ADDR )
+    {
+      _hle.shell= false;
+      _hle.active= _hle.enabled;
+      if ( PSX_exe_shell () ) { *cc= PSX_CYCLES_INST; return true; }
+      return false;
+    }
+  
+  return _hle.enabled && HLE_IS_VECTOR ( PC ) && hle_call ( cc );
+  
+} // end hle_hook
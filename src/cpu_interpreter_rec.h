@@ -0,0 +1,864 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  cpu_interpreter_rec.h - Recompilador dinàmic a x86-64.
+ *
+ */
+/*
+ * NOTA: El recompilador no és un simulador a banda, tradueix blocs
+ * bàsics de codi a crides a les mateixes funcions de l'intèrpret. Les
+ * instruccions aritmètiques més habituals es tradueixen directament a
+ * codi natiu, la resta es criden. L'estat 'delayed' (branch, lectures
+ * aplaçades, escriptures en COP0/COP2) continua sent el de
+ * l'intèrpret, per tant un bloc es pot interrompre després de
+ * qualsevol instrucció. Després de cada instrucció es comprova el
+ * mateix que comprova PSX_cpu_run (PSX_NextEventCC, límit de cicles,
+ * propietari del bus, interrupcions pendents, excepcions, codi
+ * modificat), i si cal es torna al bucle.
+ *
+ * El codi natiu accedeix a tot l'estat a partir de RBX, que apunta a
+ * PSX_cpu_regs.
+ */
+
+
+#ifdef REC_X86_64
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define REC_CODE_SIZE (16*1024*1024)
+#define REC_MAX_BLOCKS (64*1024)
+#define REC_MAX_INST_BYTES 256
+#define REC_MAX_BLOCK_BYTES ((BLOCK_MAX_INSTS*REC_MAX_INST_BYTES)+64)
+#define REC_MAX_EXITS (BLOCK_MAX_INSTS*8)
+
+/* Registres x86. */
+#define REC_EAX 0
+#define REC_ECX 1
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+
+  uint8_t  *code;    // Codi natiu.
+  uint32_t  pc;      // Adreça virtual de la primera instrucció.
+  int       page;    // Pàgina de codi.
+  uint32_t  version; // Versió de la pàgina quan es va traduir.
+
+} rec_block_t;
+
+typedef void (rec_code_t) (PSX_CPU *base);
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  bool          enabled;
+  uint8_t      *mem;          // Buffer de codi.
+  size_t        used;
+  uint8_t      *p;            // Punter d'escriptura.
+  rec_block_t  *blocks;
+  int           N;
+  rec_block_t **map;          // Blocs indexats per paraula de codi.
+  uint8_t      *exits[REC_MAX_EXITS]; // Salts pendents a l'eixida.
+  int           Nexits;
+
+} rec_state_t;
+
+PSX_CTX_DEFINE ( rec_state_t, CPU_REC );
+
+#define _rec PSX_CTX_STATE ( rec_state_t, CPU_REC )
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+/* Emissió de codi ************************************************************/
+static void
+rec_b (
+       const uint8_t v
+       )
+{
+  *(_rec.p++)= v;
+} // end rec_b
+
+
+static void
+rec_d (
+       const uint32_t v
+       )
+{
+  memcpy ( _rec.p, &v, 4 );
+  _rec.p+= 4;
+} // end rec_d
+
+
+static void
+rec_q (
+       const uint64_t v
+       )
+{
+  memcpy ( _rec.p, &v, 8 );
+  _rec.p+= 8;
+} // end rec_q
+
+
+// Desplaçament respecte a RBX.
+static int32_t
+rec_off (
+         const void *var
+         )
+{
+  return (int32_t) ((intptr_t) var - (intptr_t) &PSX_cpu_regs);
+} // end rec_off
+
+
+static bool
+rec_off_ok (
+            const void *var
+            )
+{
+
+  intptr_t off;
+
+
+  off= (intptr_t) var - (intptr_t) &PSX_cpu_regs;
+
+  return off >= INT32_MIN && off <= INT32_MAX;
+
+} // end rec_off_ok
+
+
+// OP reg,[rbx+disp32] o OP [rbx+disp32],reg.
+static void
+rec_op_rm (
+           const uint8_t  op,
+           const int      reg,
+           const void    *var
+           )
+{
+
+  rec_b ( op );
+  rec_b ( 0x83|(reg<<3) );
+  rec_d ( (uint32_t) rec_off ( var ) );
+
+} // end rec_op_rm
+
+
+// MOV dword [rbx+disp32],imm32.
+static void
+rec_mov_m32_imm (
+        	 const void     *var,
+        	 const uint32_t  imm
+        	 )
+{
+
+  rec_b ( 0xC7 ); rec_b ( 0x83 );
+  rec_d ( (uint32_t) rec_off ( var ) );
+  rec_d ( imm );
+
+} // end rec_mov_m32_imm
+
+
+// MOV byte [rbx+disp32],imm8.
+static void
+rec_mov_m8_imm (
+        	const void    *var,
+        	const uint8_t  imm
+        	)
+{
+
+  rec_b ( 0xC6 ); rec_b ( 0x83 );
+  rec_d ( (uint32_t) rec_off ( var ) );
+  rec_b ( imm );
+
+} // end rec_mov_m8_imm
+
+
+// CMP dword [rbx+disp32],imm8.
+static void
+rec_cmp_m32_imm8 (
+        	  const void    *var,
+        	  const uint8_t  imm
+        	  )
+{
+
+  rec_b ( 0x83 ); rec_b ( 0xBB );
+  rec_d ( (uint32_t) rec_off ( var ) );
+  rec_b ( imm );
+
+} // end rec_cmp_m32_imm8
+
+
+// CMP byte [rbx+disp32],imm8.
+static void
+rec_cmp_m8_imm8 (
+        	 const void    *var,
+        	 const uint8_t  imm
+        	 )
+{
+
+  rec_b ( 0x80 ); rec_b ( 0xBB );
+  rec_d ( (uint32_t) rec_off ( var ) );
+  rec_b ( imm );
+
+} // end rec_cmp_m8_imm8
+
+
+// MOV RAX,imm64; CALL RAX.
+static void
+rec_call (
+          const void *fun
+          )
+{
+
+  rec_b ( 0x48 ); rec_b ( 0xB8 );
+  rec_q ( (uint64_t) (uintptr_t) fun );
+  rec_b ( 0xFF ); rec_b ( 0xD0 );
+
+} // end rec_call
+
+
+// Jcc rel32 cap a l'eixida del bloc. CC és el segon byte de
+// l'opcode (0x80-0x8F), o 0 per a JMP.
+static void
+rec_jmp_exit (
+              const uint8_t cc
+              )
+{
+
+  if ( cc == 0 ) rec_b ( 0xE9 );
+  else { rec_b ( 0x0F ); rec_b ( cc ); }
+  _rec.exits[_rec.Nexits++]= _rec.p;
+  rec_d ( 0 );
+
+} // end rec_jmp_exit
+
+
+// Jcc rel32 cap avant. Torna el punter per a resoldre'l.
+static uint8_t *
+rec_jmp_fwd (
+             const uint8_t cc
+             )
+{
+
+  uint8_t *ret;
+
+
+  if ( cc == 0 ) rec_b ( 0xE9 );
+  else { rec_b ( 0x0F ); rec_b ( cc ); }
+  ret= _rec.p;
+  rec_d ( 0 );
+
+  return ret;
+
+} // end rec_jmp_fwd
+
+
+static void
+rec_resolve (
+             uint8_t *fix
+             )
+{
+
+  uint32_t rel;
+
+
+  rel= (uint32_t) (_rec.p - (fix+4));
+  memcpy ( fix, &rel, 4 );
+
+} // end rec_resolve
+
+
+#define REC_JNE 0x85
+#define REC_JE  0x84
+#define REC_JGE 0x8D
+
+
+/* Traducció ******************************************************************/
+// Emet la instrucció directament si és una de les instruccions
+// aritmètiques suportades. Torna false si no.
+static bool
+rec_emit_alu (
+              const uint32_t word
+              )
+{
+
+  uint32_t op,rs,rt,rd,sa,simm,imm,dst;
+
+
+  op= word>>26;
+  rs= (word>>21)&0x1F;
+  rt= (word>>16)&0x1F;
+  rd= (word>>11)&0x1F;
+  sa= (word>>6)&0x1F;
+  imm= word&0xFFFF;
+  simm= SIGN_EXTEND16 ( (uint16_t) imm );
+
+  // Si el destí és 0 l'intèrpret no fa res.
+  if ( op == 0x00 )
+    {
+      dst= rd;
+      switch ( word&0x3F )
+        {
+        case 0x00: // SLL
+        case 0x02: // SRL
+        case 0x03: // SRA
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rt].v );
+          if ( sa != 0 )
+            {
+              rec_b ( 0xC1 );
+              rec_b ( (word&0x3F)==0x00 ? 0xE0 :
+        	      ((word&0x3F)==0x02 ? 0xE8 : 0xF8) );
+              rec_b ( (uint8_t) sa );
+            }
+          break;
+        case 0x04: // SLLV
+        case 0x06: // SRLV
+        case 0x07: // SRAV
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_ECX, &GPR[rs].v );
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rt].v );
+          rec_b ( 0xD3 );
+          rec_b ( (word&0x3F)==0x04 ? 0xE0 :
+        	  ((word&0x3F)==0x06 ? 0xE8 : 0xF8) );
+          break;
+        case 0x21: // ADDU
+        case 0x23: // SUBU
+        case 0x24: // AND
+        case 0x25: // OR
+        case 0x26: // XOR
+        case 0x27: // NOR
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rs].v );
+          switch ( word&0x3F )
+            {
+            case 0x21: rec_op_rm ( 0x03, REC_EAX, &GPR[rt].v ); break;
+            case 0x23: rec_op_rm ( 0x2B, REC_EAX, &GPR[rt].v ); break;
+            case 0x24: rec_op_rm ( 0x23, REC_EAX, &GPR[rt].v ); break;
+            case 0x25: rec_op_rm ( 0x0B, REC_EAX, &GPR[rt].v ); break;
+            case 0x26: rec_op_rm ( 0x33, REC_EAX, &GPR[rt].v ); break;
+            case 0x27:
+              rec_op_rm ( 0x0B, REC_EAX, &GPR[rt].v );
+              rec_b ( 0xF7 ); rec_b ( 0xD0 ); // NOT EAX
+              break;
+            }
+          break;
+        case 0x2A: // SLT
+        case 0x2B: // SLTU
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rs].v );
+          rec_op_rm ( 0x3B, REC_EAX, &GPR[rt].v );
+          rec_b ( 0x0F ); rec_b ( (word&0x3F)==0x2A ? 0x9C : 0x92 );
+          rec_b ( 0xC0 ); // SETL/SETB AL
+          rec_b ( 0x0F ); rec_b ( 0xB6 ); rec_b ( 0xC0 ); // MOVZX EAX,AL
+          break;
+        default: return false;
+        }
+    }
+  else
+    {
+      dst= rt;
+      switch ( op )
+        {
+        case 0x09: // ADDIU
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rs].v );
+          rec_b ( 0x05 ); rec_d ( simm );
+          break;
+        case 0x0A: // SLTI
+        case 0x0B: // SLTIU
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rs].v );
+          rec_b ( 0x3D ); rec_d ( simm );
+          rec_b ( 0x0F ); rec_b ( op==0x0A ? 0x9C : 0x92 ); rec_b ( 0xC0 );
+          rec_b ( 0x0F ); rec_b ( 0xB6 ); rec_b ( 0xC0 );
+          break;
+        case 0x0C: // ANDI
+        case 0x0D: // ORI
+        case 0x0E: // XORI
+          if ( dst == 0 ) return true;
+          rec_op_rm ( 0x8B, REC_EAX, &GPR[rs].v );
+          rec_b ( op==0x0C ? 0x25 : (op==0x0D ? 0x0D : 0x35) );
+          rec_d ( imm );
+          break;
+        case 0x0F: // LUI
+          if ( dst == 0 ) return true;
+          rec_b ( 0xB8 ); rec_d ( imm<<16 );
+          break;
+        default: return false;
+        }
+    }
+
+  // SET_REG.
+  rec_op_rm ( 0x89, REC_EAX, &GPR[dst].v );
+  rec_mov_m8_imm ( &_ldelayed.v[dst].proceed, 0 );
+
+  return true;
+
+} // end rec_emit_alu
+
+
+// Torna la funció de l'intèrpret que executa la instrucció, o NULL
+// si cal passar per exec_decoded_inst.
+static void *
+rec_get_handler (
+        	 const uint32_t word
+        	 )
+{
+
+  switch ( word>>26 )
+    {
+    case 0x00: return special;
+    case 0x01: return bcond;
+    case 0x02: return j;
+    case 0x03: return jal;
+    case 0x04: return beq;
+    case 0x05: return bne;
+    case 0x06: return blez;
+    case 0x07: return bgtz;
+    case 0x08: return addi;
+    case 0x09: return addiu;
+    case 0x0A: return slti;
+    case 0x0B: return sltiu;
+    case 0x0C: return andi;
+    case 0x0D: return ori;
+    case 0x0E: return xori;
+    case 0x0F: return lui;
+    case 0x10: return cop0;
+    case 0x20: return lb;
+    case 0x21: return lh;
+    case 0x22: return lwl;
+    case 0x23: return lw;
+    case 0x24: return lbu;
+    case 0x25: return lhu;
+    case 0x26: return lwr;
+    case 0x28: return sb;
+    case 0x29: return sh;
+    case 0x2A: return swl;
+    case 0x2B: return sw;
+    case 0x2E: return swr;
+    case 0x32: return lwc2;
+    default: return NULL;
+    }
+
+} // end rec_get_handler
+
+
+// Comprovacions després d'executar una instrucció cridant a
+// l'intèrpret. Assumeix que EAX conté el nou PC.
+static void
+rec_emit_checks (
+        	 const uint32_t next_pc
+        	 )
+{
+
+  // Excepció o salt.
+  rec_b ( 0x3D ); rec_d ( next_pc );
+  rec_jmp_exit ( REC_JNE );
+
+  // Interrupció pendent.
+  rec_cmp_m8_imm8 ( &_check_int, 0 );
+  rec_jmp_exit ( REC_JNE );
+
+  // Codi modificat.
+  rec_cmp_m8_imm8 ( &_code.modified, 0 );
+  rec_jmp_exit ( REC_JNE );
+
+  // DMA.
+  rec_cmp_m32_imm8 ( &PSX_BusOwner, PSX_BUS_OWNER_CPU );
+  rec_jmp_exit ( REC_JNE );
+
+} // end rec_emit_checks
+
+
+static void
+rec_emit_check_event (void)
+{
+
+  rec_op_rm ( 0x8B, REC_EAX, &PSX_Clock );
+  rec_op_rm ( 0x3B, REC_EAX, &PSX_NextEventCC );
+  rec_jmp_exit ( REC_JGE );
+  rec_op_rm ( 0x3B, REC_EAX, &_run_end );
+  rec_jmp_exit ( REC_JGE );
+
+} // end rec_emit_check_event
+
+
+static void
+rec_emit_inst (
+               const uint32_t pc,
+               const uint32_t word,
+               const bool     last
+               )
+{
+
+  uint8_t *fix_slow,*fix_next,*fix_nodelay;
+  void *handler;
+  bool ret_cc;
+
+
+#ifdef PSX_COUNTERS
+  rec_b ( 0x48 ); rec_b ( 0x83 ); rec_b ( 0x83 ); // ADD qword [insts],1
+  rec_d ( (uint32_t) rec_off ( &PSX_Cnt.insts ) );
+  rec_b ( 1 );
+#endif
+  
+  // Instruccions natives.
+  if ( rec_emit_alu ( word ) )
+    {
+      rec_cmp_m32_imm8 ( &_delayed_ops, 0 );
+      fix_slow= rec_jmp_fwd ( REC_JNE );
+      rec_mov_m32_imm ( &PC, pc+4 );
+      rec_b ( 0x83 ); rec_b ( 0x83 ); // ADD dword [PSX_Clock],imm8
+      rec_d ( (uint32_t) rec_off ( &PSX_Clock ) );
+      rec_b ( PSX_CYCLES_INST );
+      if ( last ) rec_jmp_exit ( 0 );
+      else rec_emit_check_event ();
+      fix_next= rec_jmp_fwd ( 0 );
+
+      // Operacions 'delayed' pendents.
+      rec_resolve ( fix_slow );
+      rec_mov_m32_imm ( &new_PC, pc+4 );
+      rec_call ( run_delayed_ops );
+      rec_op_rm ( 0x8B, REC_EAX, &new_PC );
+      rec_op_rm ( 0x89, REC_EAX, &PC );
+      rec_b ( 0x83 ); rec_b ( 0x83 );
+      rec_d ( (uint32_t) rec_off ( &PSX_Clock ) );
+      rec_b ( PSX_CYCLES_INST );
+      if ( last ) rec_jmp_exit ( 0 );
+      else
+        {
+          rec_emit_checks ( pc+4 );
+          rec_emit_check_event ();
+        }
+      rec_resolve ( fix_next );
+      return;
+    }
+
+  // Crida a l'intèrpret.
+  handler= rec_get_handler ( word );
+  rec_mov_m32_imm ( &_inst_word.v, word );
+  rec_mov_m32_imm ( &new_PC, pc+4 );
+  if ( handler != NULL )
+    {
+      rec_call ( handler );
+      ret_cc= false;
+    }
+  else
+    {
+      rec_mov_m32_imm ( &_opcode, word>>26 );
+      rec_call ( exec_decoded_inst );
+      rec_b ( 0x41 ); rec_b ( 0x89 ); rec_b ( 0xC4 ); // MOV R12D,EAX
+      ret_cc= true;
+    }
+  rec_cmp_m32_imm8 ( &_delayed_ops, 0 );
+  fix_nodelay= rec_jmp_fwd ( REC_JE );
+  rec_call ( run_delayed_ops );
+  rec_resolve ( fix_nodelay );
+  rec_op_rm ( 0x8B, REC_EAX, &new_PC );
+  rec_op_rm ( 0x89, REC_EAX, &PC );
+  if ( ret_cc ) // ADD [PSX_Clock],R12D
+    {
+      rec_b ( 0x44 ); rec_b ( 0x01 ); rec_b ( 0xA3 );
+      rec_d ( (uint32_t) rec_off ( &PSX_Clock ) );
+    }
+  else
+    {
+      rec_b ( 0x83 ); rec_b ( 0x83 );
+      rec_d ( (uint32_t) rec_off ( &PSX_Clock ) );
+      rec_b ( PSX_CYCLES_INST );
+    }
+  if ( last ) rec_jmp_exit ( 0 );
+  else
+    {
+      rec_emit_checks ( pc+4 );
+      rec_emit_check_event ();
+    }
+
+} // end rec_emit_inst
+
+
+static void
+rec_flush (void)
+{
+
+  memset ( _rec.map, 0, sizeof(rec_block_t *)*BLOCK_MAP_SIZE );
+  _rec.N= 0;
+  _rec.used= 0;
+
+} // end rec_flush
+
+
+static rec_block_t *
+rec_translate (
+               const uint32_t  pc,
+               const uint32_t *words,
+               const int       page,
+               const int       ind
+               )
+{
+
+  rec_block_t *b;
+  uint8_t *exit;
+  uint32_t rel;
+  int n,off,N;
+
+
+  if ( _rec.N == REC_MAX_BLOCKS ||
+       _rec.used+REC_MAX_BLOCK_BYTES > REC_CODE_SIZE )
+    rec_flush ();
+
+  // Prepara.
+  b= &_rec.blocks[_rec.N++];
+  b->pc= pc;
+  b->page= page;
+  b->version= _code.versions[page];
+  b->code= _rec.p= _rec.mem + _rec.used;
+  _rec.Nexits= 0;
+  _rec.map[ind]= b;
+  PSX_mem_watch_code_page ( page );
+
+  // Pròleg: PUSH RBX; PUSH R12; SUB RSP,8; MOV RBX,RDI.
+  rec_b ( 0x53 );
+  rec_b ( 0x41 ); rec_b ( 0x54 );
+  rec_b ( 0x48 ); rec_b ( 0x83 ); rec_b ( 0xEC ); rec_b ( 0x08 );
+  rec_b ( 0x48 ); rec_b ( 0x89 ); rec_b ( 0xFB );
+
+  // Instruccions.
+  off= ind%BLOCK_PAGE_WORDS;
+  N= block_size ( words, off );
+  for ( n= 0; n < N; ++n )
+    rec_emit_inst ( pc+4*n, words[off+n], n == N-1 );
+
+  // Epíleg: ADD RSP,8; POP R12; POP RBX; RET.
+  exit= _rec.p;
+  rec_b ( 0x48 ); rec_b ( 0x83 ); rec_b ( 0xC4 ); rec_b ( 0x08 );
+  rec_b ( 0x41 ); rec_b ( 0x5C );
+  rec_b ( 0x5B );
+  rec_b ( 0xC3 );
+  for ( n= 0; n < _rec.Nexits; ++n )
+    {
+      rel= (uint32_t) (exit - (_rec.exits[n]+4));
+      memcpy ( _rec.exits[n], &rel, 4 );
+    }
+  _rec.used= (size_t) (_rec.p - _rec.mem);
+
+  return b;
+
+} // end rec_translate
+
+
+// Torna el bloc que comença en PC, o NULL si PC no es pot traduir.
+static rec_block_t *
+rec_get_block (void)
+{
+
+  rec_block_t *b;
+  const uint32_t *words;
+  int page,ind;
+
+
+  // Busca.
+  words= code_get_page ( &page, &ind );
+  if ( words == NULL ) return NULL;
+  b= _rec.map[ind];
+  if ( b != NULL && b->pc == PC && b->version == _code.versions[page] )
+    return b;
+
+  return rec_translate ( PC, words, page, ind );
+
+} // end rec_get_block
+
+
+static bool
+rec_init (void)
+{
+
+  void *mem;
+
+
+  // Ja inicialitzat.
+  if ( _rec.mem != NULL )
+    {
+      rec_flush ();
+      _rec.enabled= true;
+      return true;
+    }
+
+  // Tot l'estat ha d'estar a menys de 2GB de PSX_cpu_regs.
+  if ( !rec_off_ok ( &_inst_word ) || !rec_off_ok ( &_opcode ) ||
+       !rec_off_ok ( &new_PC ) || !rec_off_ok ( &_delayed_ops ) ||
+       !rec_off_ok ( &_check_int ) || !rec_off_ok ( &_ldelayed ) ||
+       !rec_off_ok ( &_code.modified ) || !rec_off_ok ( &PSX_Clock ) ||
+       !rec_off_ok ( &PSX_NextEventCC ) || !rec_off_ok ( &PSX_BusOwner ) ||
+       !rec_off_ok ( &_run_end ) )
+    goto error;
+#ifdef PSX_COUNTERS
+  if ( !rec_off_ok ( &PSX_Cnt.insts ) ) goto error;
+#endif
+
+  // Memòria.
+  mem= mmap ( NULL, REC_CODE_SIZE, PROT_READ|PROT_WRITE|PROT_EXEC,
+              MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+  if ( mem == MAP_FAILED ) goto error;
+  _rec.blocks= (rec_block_t *) malloc ( sizeof(rec_block_t)*REC_MAX_BLOCKS );
+  _rec.map= (rec_block_t **)
+    malloc ( sizeof(rec_block_t *)*BLOCK_MAP_SIZE );
+  if ( _rec.blocks == NULL || _rec.map == NULL )
+    {
+      free ( _rec.blocks );
+      free ( _rec.map );
+      munmap ( mem, REC_CODE_SIZE );
+      goto error;
+    }
+  _rec.mem= (uint8_t *) mem;
+  rec_flush ();
+  _rec.enabled= true;
+
+  return true;
+
+ error:
+  WW ( UDATA, "no s'ha pogut inicialitzar el recompilador,"
+       " s'emprarà l'intèrpret" );
+  _rec.enabled= false;
+  return false;
+
+} // end rec_init
+
+
+static void
+rec_close (void)
+{
+
+  if ( _rec.mem == NULL ) return;
+  munmap ( _rec.mem, REC_CODE_SIZE ); _rec.mem= NULL;
+  free ( _rec.blocks ); _rec.blocks= NULL;
+  free ( _rec.map ); _rec.map= NULL;
+  _rec.enabled= false;
+  
+} // end rec_close
+
+
+static void
+rec_run (void)
+{
+
+  rec_block_t *b;
+  int cc;
+
+
+  do {
+
+    // Comprova excepció pendent (RFE).
+    if ( _check_int )
+      {
+        _check_int= false;
+        if ( check_interruptions () )
+          {
+            PSX_Clock+= PSX_CYCLES_INST;
+            break;
+          }
+      }
+
+    // Funcions de la BIOS i shell.
+    if ( _hle.active && hle_hook ( &cc ) )
+      {
+        PSX_Clock+= cc;
+        continue;
+      }
+    
+    // Executa.
+    b= rec_get_block ();
+    if ( b != NULL )
+      {
+        _code.modified= false;
+        ((rec_code_t *) b->code) ( &PSX_cpu_regs );
+      }
+    else
+      {
+        cc= exec_next_inst ();
+        PSX_Clock+= cc;
+      }
+
+  } while ( PSX_Clock < _run_end && PSX_Clock < PSX_NextEventCC &&
+            PSX_BusOwner == PSX_BUS_OWNER_CPU );
+
+} // end rec_run
+
+
+
+
+#else /* !REC_X86_64 */
+
+typedef struct
+{
+  bool enabled;
+} rec_state_t;
+
+PSX_CTX_DEFINE ( rec_state_t, CPU_REC );
+
+#define _rec PSX_CTX_STATE ( rec_state_t, CPU_REC )
+
+
+static bool
+rec_init (void)
+{
+
+  WW ( UDATA, "el recompilador no està disponible en aquesta plataforma,"
+       " s'emprarà l'intèrpret" );
+  _rec.enabled= false;
+
+  return false;
+
+} // end rec_init
+
+
+static void
+rec_close (void)
+{
+} // end rec_close
+
+
+static void
+rec_run (void)
+{
+} // end rec_run
+
+#endif /* REC_X86_64 */
@@ -36,7 +36,9 @@
 /* ESTAT PÚBLIC */
 /****************/
 
+#ifndef PSX_MULTI_INSTANCE
 PSX_CPU PSX_cpu_regs;
+#endif
 
 
 
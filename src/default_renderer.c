@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -33,6 +34,12 @@
 
 #include "PSX.h"
 
+#if !defined(PSX_NO_SIMD) && defined(__GNUC__) &&        	\
+  (defined(__x86_64__) || defined(__i386__))
+#define SPAN_SIMD
+#include <immintrin.h>
+#endif
+
 
 
 /**********/
@@ -59,28 +66,57 @@
    (((uint16_t) ((G)>>3))<<5) |        		\
    (((uint16_t) ((B)>>3))<<10))
 
-// NOTA!! Açò del round_double pretenia truncar els resultats de
-// l'ecuació lineal per fer que resultats que són distints quan es
-// canvien d'ordre els operants per qüestió de precissió foren igual,
-// pero probablement mareja més que ajuda, així que ho he desactivat.
-//#define ROUND_DOUBLE(VAL) (((int64_t) ((VAL)*100000)) / (double) 100000.0)
-#define ROUND_DOUBLE(VAL) (VAL)
-
-//#define TOINT(VAL) ((int) ((VAL) + 0.5))
-
-// Aparentment el mapeig que fa de reals a sencers és el següent:
-//
-//  0    -> 0
-// ]0,1] -> 1
-// ]1,2] -> 2
-//  ...
+// Coma fixa. Els gradients dels atributs (u,v,r,g,b) es calculen
+// una vegada per triangle amb GRAD_BITS bits de fracció, i en cada
+// línia es passen a acumuladors de 32 bits amb ACC_BITS bits de
+// fracció que s'incrementen per píxel. Dins del triangle els
+// atributs van de 0 a 255, i dos píxels veïns no poden diferir més
+// de 255, així que amb ACC_BITS a 22 caben 255.5 més un pas de
+// ACC_MAX_STEP (el pas es limita a això per als triangles tan prims
+// que sols tenen un píxel per fila).
 //
-// La manera de aproximar açò és molt cutre, però pareix que
-// funciona. Molt de compte que la coma real juga males
-// passades. Idealment estaria bé moure a coma fixa amb sencers.
-#define TOINT(VAL) ((int) ((VAL) + 0.999))
-
-//#define TOINT(VAL) (((int) (VAL)) + (((VAL)!=((int) (VAL))) ? 1 : 0))
+// NOTA!! Tots els arredoniments (gradients, valor inicial i pas) es
+// fan cap amunt, així l'acumulador mai queda per davall del valor
+// real i els valors que cauen just en la frontera entre dos texels
+// (o dos nivells de color) van sempre al de dalt, com en aritmètica
+// exacta. La versió amb doubles en eixos casos anava a un costat o a
+// l'altre segons l'error de la coma real.
+#define GRAD_BITS 32
+#define ACC_BITS 22
+#define ACC_MAX_STEP (256<<ACC_BITS)
+#define GRAD_ONE (((int64_t) 1)<<GRAD_BITS)
+#define ACC_ONE (1<<ACC_BITS)
+#define ACC_INT(ACC) ((ACC)>>ACC_BITS)
+#define GRAD2ACC(VAL) /* Cap amunt */        			\
+  (((VAL) + ((((int64_t) 1)<<(GRAD_BITS-ACC_BITS))-1))>>(GRAD_BITS-ACC_BITS))
+
+// Cache de textures. Les pàgines de 4 i 8 bits es guarden ja
+// traduïdes amb la CLUT (256x256 colors de 16 bits), per franges de
+// VBLOCK_H files. Per a saber què cal tornar a traduir la VRAM es
+// divideix en blocs de VBLOCK_W x VBLOCK_H i es guarda quan es va
+// escriure cada bloc per última vegada.
+#define TCACHE_SIZE 16
+#define VBLOCK_W 64
+#define VBLOCK_H 16
+#define VBLOCK_COLS (NCOLS/VBLOCK_W)
+#define VBLOCK_ROWS (NLINES/VBLOCK_H)
+#define TCACHE_STRIPES (256/VBLOCK_H)
+
+// Claus vistes recentment que encara no tenen entrada. Una textura
+// sols entra en la cache la segona vegada que s'empra (o si la
+// primitiva és prou gran), d'aquesta manera les textures que
+// s'empren una sola vegada no trauen de la cache a les bones.
+#define TCACHE_SEEN 32
+
+// Mode de textura intern (després de PSX_TEX_*): textura traduïda de
+// la cache, es llig com una pàgina de 256 colors per fila.
+#define TEX_CACHED 4
+
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
 
 
 
@@ -90,13 +126,26 @@
 /* TIPUS */
 /*********/
 
+// Aparentment el mapeig que fa de reals a sencers és el següent:
+//
+//  0    -> 0
+// ]0,1] -> 1
+// ]1,2] -> 2
+//  ...
+//
+// és a dir, la columna és el sostre de la X real de l'aresta. Per no
+// dependre de la coma real, la X es recorre amb sencers com en
+// Bresenham: X*dy - (x0*dy + dx*(y-y0)) = err, amb 0 <= err < dy.
 typedef struct
 {
 
-  int    y_max;
-  int    y_min;
-  double x;
-  double slope;
+  int y_max;
+  int y_min;
+  int x;        // Sostre de la X real.
+  int err;
+  int dy;
+  int step;     // floor(dx/dy)
+  int step_err; // dx - step*dy
   
 } edge_t;
 
@@ -115,35 +164,99 @@ typedef struct
   
 } pol_state_t;
   
+// Atribut interpolat en un triangle. El valor en (x,y) és
+// base + dx*(x-x0) + dy*(y-y0), amb GRAD_BITS bits de fracció. En
+// 'base' ja està sumat 0.5 per a que truncar siga redondejar.
+// (x0,y0) és la cantonada superior esquerra del triangle, de manera
+// que els desplaçaments mai són negatius i l'error sempre suma.
 typedef struct
 {
+
+  int64_t base;
+  int64_t dx;
+  int64_t dy;
+  int32_t step; // dx amb ACC_BITS bits de fracció.
   
-  PSX_RENDERER_CLASS;
-  uint16_t            *fb;
-  uint8_t              out_fb[MAXWIDTH*MAXHEIGHT*4];
-  void                *udata;
-  PSX_UpdateScreen    *update_screen;
-  bool                 display_enabled;
-  pol_state_t          pol;
+} attr_t;
+
+// Valors dels atributs en la primera columna d'un tram, i increment
+// per columna. Amb ACC_BITS bits de fracció.
+typedef struct
+{
+
+  int32_t u,v,r,g,b;
+  int32_t du,dv,dr,dg,db;
   
-} default_renderer_t;
+} span_t;
 
-// Per a dibuixar la textura d'un polígon
+// Entrada de la cache de textures.
 typedef struct
+{
+
+  bool                  used;
+  enum PSX_TextureMode_ mode; // PSX_TEX_4b o PSX_TEX_8b
+  int                   page_x,page_y; // Com texpage_x i texpage_y.
+  int                   clut_x,clut_y; // Com texclut_x i texclut_y.
+  uint32_t              decoded; // Un bit per franja.
+  uint64_t              stamp[TCACHE_STRIPES]; // 'gen' en traduir-la.
+  uint64_t              last_use;
+  int                   refs; // Primitives que l'estan emprant ara.
+  uint16_t              texels[256*256];
+  
+} tcache_entry_t;
+
+typedef struct pol_tex pol_tex_t;
+
+// Dibuixa les columnes C0..C1 de la fila ROW. Torna el número de
+// píxels escrits.
+typedef int (span_fn_t) (uint16_t *line,const int row,
+        		 const int c0,const int c1,
+        		 const span_t *s,const pol_tex_t *tex,
+        		 const PSX_RendererArgs *a);
+
+// Per a dibuixar la textura d'un polígon. També s'empra en
+// rectangles i línies per a triar el kernel.
+struct pol_tex
 {
   
   bool            tex_enabled;
   bool            gouraud_enabled;
-  bool            raw_texture;
-  double          a,b,c; // Per a u.
-  double          d,e,f; // Per a v.
-  double          r_a,r_b,r_c; // Per a r.
-  double          g_a,g_b,g_c; // Per a g.
-  double          b_a,b_b,b_c; // Per a b.
+  int             x0,y0; // Punt de referència.
+  attr_t          u,v;
+  attr_t          r,g,b;
   const uint16_t *clut;
   const uint16_t *page;
+  tcache_entry_t *entry; // NULL si no s'empra la cache.
+  span_fn_t      *span;
+  uint16_t        check_mask; // 0x8000 o 0x0000
+  uint16_t        set_mask; // 0x8000 o 0x0000
   
-} pol_tex_t;
+};
+
+typedef struct
+{
+  
+  PSX_RENDERER_CLASS;
+  uint16_t            *fb;
+  uint8_t              out_fb[MAXWIDTH*MAXHEIGHT*4];
+  void                *udata;
+  PSX_UpdateScreen    *update_screen;
+  bool                 display_enabled;
+  pol_state_t          pol;
+  // Kernels SIMD per a trams sense textura [GOURAUD][BLEND][DITHER],
+  // NULL si no n'hi ha.
+  span_fn_t   *const (*simd_spans)[5][2];
+  // Cache de textures. El band renderer pot cridar des de varis fils
+  // a la vegada, per això va protegida amb un mutex.
+  pthread_mutex_t      tcache_mutex;
+  uint64_t             gen; // S'incrementa en cada escriptura.
+  uint64_t             vram_gen[VBLOCK_ROWS][VBLOCK_COLS];
+  uint64_t             tick;
+  tcache_entry_t       tcache[TCACHE_SIZE];
+  int                  seen[TCACHE_SEEN];
+  int                  seen_pos;
+  
+} default_renderer_t;
 
 
 
@@ -320,6 +433,9 @@ read_tex_color (
       ind= page[v*1024 + (u>>1)]; // ACÍ !!!! Use of uninitialised value of size 8
       color= clut[u&0x1 ? ind>>8 : ind&0xFF];
       break;
+    case TEX_CACHED:
+      color= page[v*256 + u];
+      break;
     case PSX_TEX_15b:
     default:
       color= page[v*1024 + u];
@@ -331,34 +447,6 @@ read_tex_color (
 } /* end read_tex_color */
 
 
-static uint16_t
-tex_get_color (
-               const pol_tex_t        *tex,
-               double                 *uf,
-               double                 *vf,
-               const PSX_RendererArgs *a
-               )
-{
-
-  int u,v;
-  uint16_t color;
-  
-
-  // NOTA!!! Aquest redondeig no és baladí. Bàsicament, en l'espai
-  // real el 0 és el centre del píxel 0, l'1 és el centre del píxel 1,
-  // etc. Això vol dir que [-0.5,0.5[ -> píxel 0, [0.5,1.5[ -> píxel
-  // 1, etc.
-  u= (int) (*uf+0.5); u= ((u&a->texwinmask_x) | a->texwinoff_x);
-  v= (int) (*vf+0.5); v= ((v&a->texwinmask_y) | a->texwinoff_y);
-  color= read_tex_color ( u, v, a->texture_mode, tex->page, tex->clut );
-  (*uf)+= tex->a;
-  (*vf)+= tex->d;
-
-  return color;
-  
-} // end tex_get_color
-
-
 static void
 modulate_color (
         	uint8_t        *r,
@@ -383,6 +471,80 @@ modulate_color (
 } // end modulate_color
 
 
+#include "default_renderer_span.h"
+#include "default_renderer_simd.h"
+
+
+// Sostre de NUM/DEN, amb DEN positiu.
+static int64_t
+div_ceil (
+          const int64_t num,
+          const int64_t den
+          )
+{
+  return num >= 0 ? (num+den-1)/den : -((-num)/den);
+} // end div_ceil
+
+
+// Calcula els gradients d'un atribut que val A0, A1 i A2 en els
+// vèrtexs. DX1,DY1,DX2,DY2 són les distàncies de v1 i v2 respecte a
+// v0, DET el determinant (positiu) i OFF_X,OFF_Y la distància del
+// punt de referència respecte a v0.
+static void
+attr_init (
+           attr_t    *attr,
+           const int  a0,
+           const int  a1,
+           const int  a2,
+           const int  dx1,
+           const int  dy1,
+           const int  dx2,
+           const int  dy2,
+           const int  det,
+           const int  off_x,
+           const int  off_y
+           )
+{
+
+  int64_t num_x,num_y,num,q,step;
+
+
+  num_x= ((int64_t) (a1-a0))*dy2 - ((int64_t) (a2-a0))*dy1;
+  num_y= ((int64_t) (a2-a0))*dx1 - ((int64_t) (a1-a0))*dx2;
+  attr->dx= div_ceil ( num_x*GRAD_ONE, det );
+  attr->dy= div_ceil ( num_y*GRAD_ONE, det );
+  
+  // Valor en el punt de referència: a0 + num/det. Es separa la part
+  // sencera per a que num*GRAD_ONE no desborde.
+  num= ((int64_t) a0)*det + num_x*off_x + num_y*off_y;
+  q= num/det; if ( q*det > num ) --q; // floor
+  attr->base= q*GRAD_ONE + div_ceil ( (num-q*det)*GRAD_ONE, det ) + GRAD_ONE/2;
+  
+  step= GRAD2ACC ( attr->dx );
+  if ( step > ACC_MAX_STEP ) step= ACC_MAX_STEP;
+  else if ( step < -ACC_MAX_STEP ) step= -ACC_MAX_STEP;
+  attr->step= (int32_t) step;
+  
+} // end attr_init
+
+
+// Valor de l'atribut en (COL,ROW) amb ACC_BITS bits de fracció.
+static int32_t
+attr_get (
+          const attr_t    *attr,
+          const pol_tex_t *tex,
+          const int        col,
+          const int        row
+          )
+{
+  return (int32_t)
+    GRAD2ACC ( attr->base +
+               attr->dx*(col-tex->x0) +
+               attr->dy*(row-tex->y0) );
+} // end attr_get
+
+
+// Cal fixar tex->entry abans de cridar-la.
 static void
 pol_tex_gouraud_init (
                      pol_tex_t              *tex,
@@ -394,9 +556,7 @@ pol_tex_gouraud_init (
                      )
 {
 
-  double vals[8*3],tmp;
-  double *m[3];
-  double *swt;
+  int dx1,dy1,dx2,dy2,det,off_x,off_y;
   bool tex_enabled;
 
 
@@ -404,138 +564,363 @@ pol_tex_gouraud_init (
   tex_enabled= (a->texture_mode!=PSX_TEX_NONE);
   tex->gouraud_enabled= false;
   tex->tex_enabled= false;
-  tex->raw_texture= false;
   if ( !tex_enabled && !a->gouraud ) return;
   
   /* Transformació afí.
    *
-   * u= a*x + b*y + c
-   * v= d*x + e*y + f
+   * u= u0 + du/dx*(x-x0) + du/dy*(y-y0)
+   *
+   * Els gradients es trauen amb la regla de Cramer, sols calen
+   * unes poques divisions senceres per atribut i triangle.
    */
-
-  // Plena matriu
-  m[0]= &vals[0]; m[1]= &vals[8]; m[2]= &vals[16];
-  m[0][0]= (double) v0->x; m[0][1]= (double) v0->y; m[0][2]= 1.0;
-  m[1][0]= (double) v1->x; m[1][1]= (double) v1->y; m[1][2]= 1.0;
-  m[2][0]= (double) v2->x; m[2][1]= (double) v2->y; m[2][2]= 1.0;
+  dx1= v1->x - v0->x; dy1= v1->y - v0->y;
+  dx2= v2->x - v0->x; dy2= v2->y - v0->y;
+  det= dx1*dy2 - dx2*dy1;
+  if ( det == 0 ) return; // No es pot!!!
+  if ( det < 0 )
+    {
+      det= -det;
+      dx1= -dx1; dy1= -dy1;
+      dx2= -dx2; dy2= -dy2;
+    }
+  tex->x0= v0->x;
+  if ( v1->x < tex->x0 ) tex->x0= v1->x;
+  if ( v2->x < tex->x0 ) tex->x0= v2->x;
+  tex->y0= v0->y;
+  if ( v1->y < tex->y0 ) tex->y0= v1->y;
+  if ( v2->y < tex->y0 ) tex->y0= v2->y;
+  off_x= tex->x0 - v0->x;
+  off_y= tex->y0 - v0->y;
   if ( tex_enabled )
     {
-      m[0][3]= (double) v0->u; m[0][4]= (double) v0->v;
-      m[1][3]= (double) v1->u; m[1][4]= (double) v1->v;
-      m[2][3]= (double) v2->u; m[2][4]= (double) v2->v;
+      attr_init ( &tex->u, v0->u, v1->u, v2->u,
+        	  dx1, dy1, dx2, dy2, det, off_x, off_y );
+      attr_init ( &tex->v, v0->v, v1->v, v2->v,
+        	  dx1, dy1, dx2, dy2, det, off_x, off_y );
+
+      // clut i page.
+      tex->clut= &(fb[a->texclut_y*1024 + a->texclut_x*16]);
+      tex->page= tex->entry != NULL ?
+        tex->entry->texels : &(fb[a->texpage_y*256*1024 + a->texpage_x*64]);
     }
   if ( a->gouraud )
     {
-      m[0][5]= (double) v0->r; m[0][6]= (double) v0->g; m[0][7]= (double) v0->b;
-      m[1][5]= (double) v1->r; m[1][6]= (double) v1->g; m[1][7]= (double) v1->b;
-      m[2][5]= (double) v2->r; m[2][6]= (double) v2->g; m[2][7]= (double) v2->b;
+      attr_init ( &tex->r, v0->r, v1->r, v2->r,
+        	  dx1, dy1, dx2, dy2, det, off_x, off_y );
+      attr_init ( &tex->g, v0->g, v1->g, v2->g,
+        	  dx1, dy1, dx2, dy2, det, off_x, off_y );
+      attr_init ( &tex->b, v0->b, v1->b, v2->b,
+        	  dx1, dy1, dx2, dy2, det, off_x, off_y );
     }
+  tex->gouraud_enabled= a->gouraud;
+  tex->tex_enabled= tex_enabled;
+  
+} // end pol_tex_gouraud_init
+
+
+// Tria el kernel per a dibuixar trams. Cal cridar-la després de
+// fixar tex_enabled, gouraud_enabled i entry.
+static void
+pol_tex_select_span (
+                     pol_tex_t                *tex,
+                     const default_renderer_t *renderer,
+                     const PSX_RendererArgs   *a,
+                     const bool                dithering
+                     )
+{
+
+  int mode;
+  bool mod,gouraud,dither;
+
+
+  if ( !tex->tex_enabled )     mode= PSX_TEX_NONE;
+  else if ( tex->entry != NULL ) mode= TEX_CACHED;
+  else                         mode= a->texture_mode;
+  mod= tex->tex_enabled && a->modulate_texture;
+  // Si la textura no es modula el color no s'empra.
+  gouraud= tex->gouraud_enabled && (!tex->tex_enabled || mod);
+  dither= dithering && (!tex->tex_enabled || mod);
+  if ( mode == PSX_TEX_NONE && renderer->simd_spans != NULL )
+    tex->span= renderer->simd_spans[gouraud][a->transparency][dither];
+  else
+    tex->span= SPAN_KERNELS[mode][mod][gouraud][a->transparency][dither];
+  tex->check_mask= a->check_mask ? 0x8000 : 0x0000;
+  tex->set_mask= a->set_mask ? 0x8000 : 0x0000;
+  
+} // end pol_tex_select_span
+
+
+/* Cache de textures **********************************************************/
+// Marca com escrita la regió (X,Y,WIDTH,HEIGHT) de la VRAM. Es fa la
+// volta si passa de la VRAM.
+static void
+vram_mark (
+           default_renderer_t *renderer,
+           const int           x,
+           const int           y,
+           const int           width,
+           const int           height
+           )
+{
+
+  int br,bc,nr,nc,i,j;
+  uint64_t gen;
+  
+  
+  if ( width <= 0 || height <= 0 ) return;
+  bc= x/VBLOCK_W;
+  nc= (x+width-1)/VBLOCK_W - bc + 1;
+  if ( nc > VBLOCK_COLS ) nc= VBLOCK_COLS;
+  br= y/VBLOCK_H;
+  nr= (y+height-1)/VBLOCK_H - br + 1;
+  if ( nr > VBLOCK_ROWS ) nr= VBLOCK_ROWS;
+  pthread_mutex_lock ( &renderer->tcache_mutex );
+  gen= ++renderer->gen;
+  for ( i= 0; i < nr; ++i )
+    for ( j= 0; j < nc; ++j )
+      renderer->vram_gen[(br+i)%VBLOCK_ROWS][(bc+j)%VBLOCK_COLS]= gen;
+  pthread_mutex_unlock ( &renderer->tcache_mutex );
+  
+} // end vram_mark
+
+
+// Última escriptura en els NC blocs de la fila BR a partir de BC.
+static uint64_t
+vram_gen_max (
+              const default_renderer_t *renderer,
+              const int                 br,
+              const int                 bc,
+              const int                 nc
+              )
+{
+
+  uint64_t ret;
+  int j;
+
+
+  ret= 0;
+  for ( j= 0; j < nc; ++j )
+    if ( renderer->vram_gen[br][bc+j] > ret )
+      ret= renderer->vram_gen[br][bc+j];
+
+  return ret;
+  
+} // end vram_gen_max
+
+
+static void
+tcache_decode (
+               const uint16_t *fb,
+               tcache_entry_t *e,
+               const int       stripe
+               )
+{
+
+  const uint16_t *page,*clut;
+  uint16_t *p;
+  int u,v;
+
 
-  // Primer pivot
-  // --> Reordena si cal
-  if ( m[0][0] == 0.0 )
+  page= &(fb[e->page_y*256*1024 + e->page_x*64]);
+  clut= &(fb[e->clut_y*1024 + e->clut_x*16]);
+  for ( v= stripe*VBLOCK_H; v < (stripe+1)*VBLOCK_H; ++v )
     {
-      if ( m[1][0] != 0.0 ) { swt= m[1]; m[1]= m[0]; }
-      else if ( m[2][0] != 0.0 ) { swt= m[2]; m[2]= m[0]; }
-      else return; // No es pot!!!
-      m[0]= swt;
+      p= &(e->texels[v*256]);
+      if ( e->mode == PSX_TEX_4b )
+        for ( u= 0; u < 256; ++u )
+          p[u]= read_tex_color ( u, v, PSX_TEX_4b, page, clut );
+      else
+        for ( u= 0; u < 256; ++u )
+          p[u]= read_tex_color ( u, v, PSX_TEX_8b, page, clut );
     }
-  // --> Normalitza
-  tmp= m[0][0]; m[0][1]/= tmp; m[0][2]/= tmp;
-  if ( tex_enabled ) { m[0][3]/= tmp; m[0][4]/= tmp; }
-  if ( a->gouraud ) { m[0][5]/= tmp; m[0][6]/= tmp; m[0][7]/= tmp; }
-  // --> Elimina pivot (no cal en el primer)
-  if ( (tmp= m[1][0]) != 0.0 )
+  
+} // end tcache_decode
+
+
+static bool
+area_overlap (
+              const int x0,
+              const int y0,
+              const int x1,
+              const int y1,
+              const int area[4]
+              )
+{
+  return x0 <= area[2] && area[0] <= x1 && y0 <= area[3] && area[1] <= y1;
+} // end area_overlap
+
+
+// Torna l'entrada de la cache amb la textura de A ja traduïda, o
+// NULL si la textura s'ha de llegir directament de la VRAM. V0..V1
+// són les files de la textura que pot llegir la primitiva (abans
+// d'aplicar la finestra de textura) i AREA (x0,y0,x1,y1) la regió on
+// escriu. Cal cridar tcache_release després de dibuixar.
+static tcache_entry_t *
+tcache_acquire (
+        	default_renderer_t     *renderer,
+        	const PSX_RendererArgs *a,
+        	int                     v0,
+        	int                     v1,
+        	const int               area[4]
+        	)
+{
+
+  int px,py,pw,cx,cy,cw,s,n,key;
+  uint32_t stale;
+  uint64_t clut_gen,gen;
+  tcache_entry_t *e,*victim,*ret;
+  
+  
+  if ( a->texture_mode != PSX_TEX_4b && a->texture_mode != PSX_TEX_8b )
+    return NULL;
+
+  // Regions de la VRAM que es lligen. Si la pàgina o la CLUT fan la
+  // volta, o la primitiva escriu damunt d'elles, es llig directament
+  // de la VRAM.
+  px= a->texpage_x*64; py= a->texpage_y*256;
+  pw= a->texture_mode == PSX_TEX_4b ? 64 : 128;
+  cx= a->texclut_x*16; cy= a->texclut_y;
+  cw= a->texture_mode == PSX_TEX_4b ? 16 : 256;
+  if ( px+pw > NCOLS || cx+cw > NCOLS ) return NULL;
+  if ( area_overlap ( px, py, px+pw-1, py+255, area ) ||
+       area_overlap ( cx, cy, cx+cw-1, cy, area ) )
+    return NULL;
+
+  // Files de la textura.
+  if ( a->texwinmask_y != 0xFF || a->texwinoff_y != 0 ||
+       v0 < 0 || v1 > 255 )
+    { v0= 0; v1= 255; }
+  
+  ret= NULL;
+  pthread_mutex_lock ( &renderer->tcache_mutex );
+
+  // Busca.
+  victim= NULL;
+  for ( n= 0; n < TCACHE_SIZE; ++n )
     {
-      m[1][1]-= tmp*m[0][1]; m[1][2]-= tmp*m[0][2];
-      if ( tex_enabled ) { m[1][3]-= tmp*m[0][3]; m[1][4]-= tmp*m[0][4]; }
-      if ( a->gouraud )
+      e= &(renderer->tcache[n]);
+      if ( !e->used )
         {
-          m[1][5]-= tmp*m[0][5]; m[1][6]-= tmp*m[0][6]; m[1][7]-= tmp*m[0][7];
+          if ( victim == NULL || victim->used ) victim= e;
+          continue;
         }
+      if ( e->mode == a->texture_mode &&
+           e->page_x == a->texpage_x && e->page_y == a->texpage_y &&
+           e->clut_x == a->texclut_x && e->clut_y == a->texclut_y )
+        break;
+      if ( e->refs == 0 &&
+           (victim == NULL ||
+            (victim->used && e->last_use < victim->last_use)) )
+        victim= e;
     }
-  if ( (tmp= m[2][0]) != 0.0 )
+  if ( n == TCACHE_SIZE )
     {
-      m[2][1]-= tmp*m[0][1]; m[2][2]-= tmp*m[0][2];
-      if ( tex_enabled ) { m[2][3]-= tmp*m[0][3]; m[2][4]-= tmp*m[0][4]; }
-      if ( a->gouraud )
+      if ( victim == NULL ) goto end; // Totes en ús.
+      key= (a->texture_mode<<20) | (a->texpage_x<<16) | (a->texpage_y<<15) |
+        (a->texclut_x<<9) | a->texclut_y;
+      if ( (area[2]-area[0]+1)*(area[3]-area[1]+1) < (v1-v0+1)*256 )
         {
-          m[2][5]-= tmp*m[0][5]; m[2][6]-= tmp*m[0][6]; m[2][7]-= tmp*m[0][7];
+          for ( n= 0; n < TCACHE_SEEN && renderer->seen[n] != key; ++n );
+          if ( n == TCACHE_SEEN )
+            {
+              renderer->seen[renderer->seen_pos]= key;
+              renderer->seen_pos= (renderer->seen_pos+1)%TCACHE_SEEN;
+              goto end;
+            }
         }
+      e= victim;
+      e->used= true;
+      e->mode= a->texture_mode;
+      e->page_x= a->texpage_x; e->page_y= a->texpage_y;
+      e->clut_x= a->texclut_x; e->clut_y= a->texclut_y;
+      e->decoded= 0;
     }
-  
-  // Segon pivot
-  // --> Reordena si cal
-  if ( m[1][1] == 0.0 )
-    {
-      if ( m[2][1] != 0.0 ) { swt= m[2]; m[2]= m[1]; }
-      else return; // No es pot!!!
-      m[1]= swt;
-    }
-  // --> Normalitza
-  tmp= m[1][1]; m[1][2]/= tmp;
-  if ( tex_enabled ) { m[1][3]/= tmp; m[1][4]/= tmp; }
-  if ( a->gouraud ) { m[1][5]/= tmp; m[1][6]/= tmp; m[1][7]/= tmp; }
-  // --> Elimina pivot (no cal en el primer)
-  if ( (tmp= m[2][1]) != 0.0 )
+
+  // Tradueix les franges que falten o que s'han escrit. Els blocs són
+  // més grans que el que realment s'escriu, per tant una franja pot
+  // pareixer modificada mentre altre fil la llig. En eixe cas no es
+  // pot tornar a traduir i es llig directament de la VRAM.
+  clut_gen= vram_gen_max ( renderer, cy/VBLOCK_H, cx/VBLOCK_W,
+        		   (cx+cw-1)/VBLOCK_W - cx/VBLOCK_W + 1 );
+  stale= 0;
+  for ( s= v0/VBLOCK_H; s <= v1/VBLOCK_H; ++s )
     {
-      m[2][2]-= tmp*m[1][2];
-      if ( tex_enabled ) { m[2][3]-= tmp*m[1][3]; m[2][4]-= tmp*m[1][4]; }
-      if ( a->gouraud )
+      gen= vram_gen_max ( renderer, py/VBLOCK_H + s, px/VBLOCK_W,
+        		  pw/VBLOCK_W );
+      if ( clut_gen > gen ) gen= clut_gen;
+      if ( !(e->decoded&(1<<s)) ) stale|= 1<<s;
+      else if ( gen > e->stamp[s] )
         {
-          m[2][5]-= tmp*m[1][5]; m[2][6]-= tmp*m[1][6]; m[2][7]-= tmp*m[1][7];
+          if ( e->refs > 0 ) goto end;
+          stale|= 1<<s;
         }
     }
+  for ( s= v0/VBLOCK_H; s <= v1/VBLOCK_H; ++s )
+    if ( stale&(1<<s) )
+      {
+        tcache_decode ( renderer->fb, e, s );
+        e->decoded|= 1<<s;
+        e->stamp[s]= renderer->gen;
+      }
+  ++(e->refs);
+  e->last_use= ++renderer->tick;
+  ret= e;
   
-  // Tercer pivot
-  if ( m[2][2] == 0.0 ) return; // No es pot!!!
-  tmp= m[2][2];
-  if ( tex_enabled ) { m[2][3]/= tmp; m[2][4]/= tmp; }
-  if ( a->gouraud ) { m[2][5]/= tmp; m[2][6]/= tmp; m[2][7]/= tmp; }
+ end:
+  pthread_mutex_unlock ( &renderer->tcache_mutex );
 
-  // Calcula coeficients
-  if ( tex_enabled )
-    {
-      tex->c= ROUND_DOUBLE(m[2][3]);
-      tex->b= ROUND_DOUBLE(m[1][3] - tex->c*m[1][2]);
-      tex->a= ROUND_DOUBLE(m[0][3] - tex->c*m[0][2] - tex->b*m[0][1]);
-      tex->f= ROUND_DOUBLE(m[2][4]);
-      tex->e= ROUND_DOUBLE(m[1][4] - tex->f*m[1][2]);
-      tex->d= ROUND_DOUBLE(m[0][4] - tex->f*m[0][2] - tex->e*m[0][1]);
+  return ret;
+  
+} // end tcache_acquire
 
-      // clut i page.
-      tex->clut= &(fb[a->texclut_y*1024 + a->texclut_x*16]);
-      tex->page= &(fb[a->texpage_y*256*1024 + a->texpage_x*64]);
-    }
-  if ( a->gouraud )
+
+static void
+tcache_release (
+        	default_renderer_t *renderer,
+        	tcache_entry_t     *e
+        	)
+{
+
+  if ( e == NULL ) return;
+  pthread_mutex_lock ( &renderer->tcache_mutex );
+  --(e->refs);
+  pthread_mutex_unlock ( &renderer->tcache_mutex );
+  
+} // end tcache_release
+
+
+// Regió (x0,y0,x1,y1) que pot escriure una primitiva amb els
+// vèrtexs A->v[0..N-1]. Torna fals si està buida.
+static bool
+prim_area (
+          const PSX_RendererArgs *a,
+          const int               n,
+          int                     area[4]
+          )
+{
+
+  int i;
+  const PSX_VertexInfo *v;
+
+
+  area[0]= area[2]= a->v[0].x;
+  area[1]= area[3]= a->v[0].y;
+  for ( i= 1; i < n; ++i )
     {
-      tex->r_c= ROUND_DOUBLE(m[2][5]);
-      tex->r_b= ROUND_DOUBLE(m[1][5] - tex->r_c*m[1][2]);
-      tex->r_a= ROUND_DOUBLE(m[0][5] - tex->r_c*m[0][2] - tex->r_b*m[0][1]);
-      tex->g_c= ROUND_DOUBLE(m[2][6]);
-      tex->g_b= ROUND_DOUBLE(m[1][6] - tex->g_c*m[1][2]);
-      tex->g_a= ROUND_DOUBLE(m[0][6] - tex->g_c*m[0][2] - tex->g_b*m[0][1]);
-      tex->b_c= ROUND_DOUBLE(m[2][7]);
-      tex->b_b= ROUND_DOUBLE(m[1][7] - tex->b_c*m[1][2]);
-      tex->b_a= ROUND_DOUBLE(m[0][7] - tex->b_c*m[0][2] - tex->b_b*m[0][1]);
-      /*
-      tex->r_c= (double) v0->r;
-      tex->r_b= 0;
-      tex->r_a= 0;
-      tex->g_c= (double) v0->g;
-      tex->g_b= 0;
-      tex->g_a= 0;
-      tex->b_c= (double) v0->b;
-      tex->b_b= 0;
-      tex->b_a= 0;
-      */
+      v= &(a->v[i]);
+      if ( v->x < area[0] ) area[0]= v->x;
+      if ( v->x > area[2] ) area[2]= v->x;
+      if ( v->y < area[1] ) area[1]= v->y;
+      if ( v->y > area[3] ) area[3]= v->y;
     }
-  tex->gouraud_enabled= a->gouraud;
-  tex->tex_enabled= tex_enabled;
-  tex->raw_texture=
-    (tex_enabled && (a->transparency==PSX_TR_NONE) && !a->modulate_texture);
+  if ( area[0] < a->clip_x1 ) area[0]= a->clip_x1;
+  if ( area[2] > a->clip_x2 ) area[2]= a->clip_x2;
+  if ( area[1] < a->clip_y1 ) area[1]= a->clip_y1;
+  if ( area[3] > a->clip_y2 ) area[3]= a->clip_y2;
   
-} // end pol_tex_gouraud_init
+  return area[0] <= area[2] && area[1] <= area[3];
+  
+} // end prim_area
 
 
 static void
@@ -547,8 +932,7 @@ add_edge (
           )
 {
 
-  double slope;
-  int n,n2;
+  int n,n2,dx,dy,step;
   const PSX_VertexInfo *tmp;
     
 
@@ -556,7 +940,10 @@ add_edge (
   if ( a->y == b->y ) return;
   else if ( b->y < a->y ) { tmp= b; b= a; a= tmp; }
 
-  slope= (b->x-a->x) / (double) (b->y-a->y);
+  dx= b->x - a->x;
+  dy= b->y - a->y;
+  step= dx/dy;
+  if ( step*dy > dx ) --step; // floor
   for ( n= 0;
         n < *N &&
           (get[n].y_min < a->y ||
@@ -568,8 +955,11 @@ add_edge (
     get[n2]= get[n2-1];
   get[n].y_min= a->y;
   get[n].y_max= b->y;
-  get[n].x= (double) a->x;
-  get[n].slope= slope;
+  get[n].x= a->x;
+  get[n].err= 0;
+  get[n].dy= dy;
+  get[n].step= step;
+  get[n].step_err= dx - step*dy;
   ++(*N);
   
 } // end add_edge
@@ -666,12 +1056,8 @@ draw_triangle_fill_line (
                          )
 {
   
-  int c0,c1,c;
-  uint16_t icolor,color;
-  const int *d_row;
-  uint16_t *line;
-  double uf,vf,rf,gf,bf;
-  uint8_t r,g,b;
+  int c0,c1;
+  span_t s;
 
   
   assert ( renderer->fb != NULL );
@@ -685,135 +1071,23 @@ draw_triangle_fill_line (
   c1= col1;
   if ( c1 > a->clip_x2 ) c1= a->clip_x2; // OJO!!!!
   if ( c0 > c1 ) return;
-  d_row= &(DITHERING[row&0x3][0]);
-  line= renderer->fb + row*NCOLS;
-  
-  // Textura plana
-  if ( tex->raw_texture )
+  if ( tex->tex_enabled )
     {
-      uf= ((double) c0)*tex->a + ((double) row)*tex->b + tex->c;
-      vf= ((double) c0)*tex->d + ((double) row)*tex->e + tex->f;
-      for ( c= c0; c <= c1; ++c )
-        {
-          assert ( tex->tex_enabled );
-          color= tex_get_color ( tex, &uf, &vf, a );
-          if ( color == 0 ) continue;
-          if ( a->check_mask && (line[c]&0x8000) ) continue;
-          if ( a->set_mask ) color|= 0x8000;
-          line[c]= color;
-          ++(stats->npixels);
-        }
+      s.u= attr_get ( &tex->u, tex, c0, row ); s.du= tex->u.step;
+      s.v= attr_get ( &tex->v, tex, c0, row ); s.dv= tex->v.step;
     }
-
-  // Color sòlid fons
-  else if ( !tex->gouraud_enabled )
+  else s.u= s.du= s.v= s.dv= 0;
+  if ( tex->gouraud_enabled )
     {
-      if ( tex->tex_enabled )
-        {
-          uf= ((double) c0)*tex->a + ((double) row)*tex->b + tex->c;
-          vf= ((double) c0)*tex->d + ((double) row)*tex->e + tex->f;
-          icolor= 0;
-        }
-      else icolor= TORGB15b ( a->r, a->g, a->b );
-      for ( c= c0; c <= c1; ++c )
-        {
-          if ( tex->tex_enabled )
-            {
-              color= tex_get_color ( tex, &uf, &vf, a );
-              if ( color == 0 ) continue;
-              if ( a->modulate_texture )
-                {
-                  r= a->r; g= a->g; b= a->b;
-                  modulate_color ( &r, &g, &b, color );
-                  color=
-                    (color&0x8000) |
-                    (a->dithering ?
-                     apply_dithering ( d_row[c&0x3], r, g, b ) :
-                     TORGB15b ( r, g, b ));
-                }
-              if ( a->transparency != PSX_TR_NONE && (color&0x8000) )
-                color= apply_color_blending ( a->transparency,
-                                              line[c], color );
-              if ( a->check_mask && (line[c]&0x8000) ) continue;
-              if ( a->set_mask ) color|= 0x8000;
-              line[c]= color;
-              ++(stats->npixels);
-            }
-          else
-            {
-              if ( a->dithering )
-                color= apply_dithering ( d_row[c&0x3], a->r, a->g, a->b );
-              else color= icolor;
-              if ( a->transparency != PSX_TR_NONE )
-                color= apply_color_blending ( a->transparency,
-                                              line[c], color );
-              if ( a->check_mask && (line[c]&0x8000) ) continue;
-              if ( a->set_mask ) color|= 0x8000;
-              line[c]= color;
-              ++(stats->npixels);
-            }
-        }
+      s.r= attr_get ( &tex->r, tex, c0, row ); s.dr= tex->r.step;
+      s.g= attr_get ( &tex->g, tex, c0, row ); s.dg= tex->g.step;
+      s.b= attr_get ( &tex->b, tex, c0, row ); s.db= tex->b.step;
     }
+  else s.r= s.dr= s.g= s.dg= s.b= s.db= 0;
   
-  // Gouraud
-  else
-    {
-      rf= ((double) c0)*tex->r_a + ((double) row)*tex->r_b + tex->r_c;
-      gf= ((double) c0)*tex->g_a + ((double) row)*tex->g_b + tex->g_c;
-      bf= ((double) c0)*tex->b_a + ((double) row)*tex->b_b + tex->b_c;
-      if ( tex->tex_enabled )
-        {
-          uf= ((double) c0)*tex->a + ((double) row)*tex->b + tex->c;
-          vf= ((double) c0)*tex->d + ((double) row)*tex->e + tex->f;
-        }
-      for ( c= c0; c <= c1; ++c )
-        {
-          if ( rf < 0.0 ) r= 0;
-          else if ( rf > 255.0 ) r= 255;
-          else r= (uint8_t) (rf + 0.5);
-          if ( gf < 0.0 ) g= 0;
-          else if ( gf > 255.0 ) g= 255;
-          else g= (uint8_t) (gf + 0.5);
-          if ( bf < 0.0 ) b= 0;
-          else if ( bf > 255.0 ) b= 255;
-          else b= (uint8_t) (bf + 0.5);
-          rf+= tex->r_a; gf+= tex->g_a; bf+= tex->b_a;
-          if ( tex->tex_enabled )
-            {
-              color= tex_get_color ( tex, &uf, &vf, a );
-              if ( color == 0 ) continue;
-              if ( a->modulate_texture )
-                {
-                  modulate_color ( &r, &g, &b, color );
-                  color=
-                    (color&0x8000) |
-                    (a->dithering ?
-                     apply_dithering ( d_row[c&0x3], r, g, b ) :
-                     TORGB15b ( r, g, b ));
-                }
-              if ( a->transparency != PSX_TR_NONE && (color&0x8000) )
-                color= apply_color_blending ( a->transparency,
-                                              line[c], color );
-              if ( a->check_mask && (line[c]&0x8000) ) continue;
-              if ( a->set_mask ) color|= 0x8000;
-              line[c]= color;
-              ++(stats->npixels);
-            }
-          else
-            {
-              if ( a->dithering )
-                color= apply_dithering ( d_row[c&0x3], r, g, b );
-              else color= TORGB15b ( r, g, b );
-              if ( a->transparency != PSX_TR_NONE )
-                color= apply_color_blending ( a->transparency,
-                                              line[c], color );
-              if ( a->check_mask && (line[c]&0x8000) ) continue;
-              if ( a->set_mask ) color|= 0x8000;
-              line[c]= color;
-              ++(stats->npixels);
-            }
-        }
-    }
+  // Dibuixa.
+  stats->npixels+= tex->span ( renderer->fb + row*NCOLS,
+        		       row, c0, c1, &s, tex, a );
   
 } // end draw_triangle_fill_line
 
@@ -855,9 +1129,8 @@ draw_triangle (
       // Obté columnes. Típicament sols hi han 2, però hi ha un cas
       // especial amb un únic vertex.
       assert ( p_aet+1 != p_get );
-      col0= TOINT(edges[p_aet].x);
-      col1= TOINT(edges[p_aet+1].x);
-      --col1;
+      col0= edges[p_aet].x;
+      col1= edges[p_aet+1].x-1;
       
       // Renderitza
       if ( col0 <= col1 )
@@ -869,7 +1142,13 @@ draw_triangle (
       for ( p= p_aet; p != p_get; ++p )
         {
           ++edges[p].y_min;
-          edges[p].x+= edges[p].slope;
+          edges[p].x+= edges[p].step;
+          edges[p].err-= edges[p].step_err;
+          if ( edges[p].err < 0 )
+            {
+              ++edges[p].x;
+              edges[p].err+= edges[p].dy;
+            }
         }
       // --> Elimina arestes
       p_aet= remove_edges_aet ( p_aet, p_get, edges );
@@ -885,6 +1164,47 @@ draw_triangle (
 } // end draw_triangle
 
 
+// Dibuixa un polígon de NVERTICES (3 o 4) vèrtexs com a triangles.
+static void
+draw_polygon (
+              default_renderer_t     *renderer,
+              const PSX_RendererArgs *a,
+              const int               nvertices,
+              PSX_RendererStats      *stats
+              )
+{
+
+  pol_tex_t tex;
+  int area[4],tv0,tv1,i;
+  bool empty;
+
+
+  // Encara que no s'escriga res cal recórrer el triangle, les files
+  // retallades en X compten en stats->nlines.
+  empty= !prim_area ( a, nvertices, area );
+  tv0= tv1= a->v[0].v;
+  for ( i= 1; i < nvertices; ++i )
+    {
+      if ( a->v[i].v < tv0 ) tv0= a->v[i].v;
+      if ( a->v[i].v > tv1 ) tv1= a->v[i].v;
+    }
+  tex.entry= empty ? NULL : tcache_acquire ( renderer, a, tv0, tv1, area );
+  for ( i= 0; i+2 < nvertices; ++i )
+    {
+      pol_tex_gouraud_init ( &tex, renderer->fb, &(a->v[i]),
+        		     &(a->v[i+1]), &(a->v[i+2]), a );
+      pol_tex_select_span ( &tex, renderer, a, a->dithering );
+      draw_triangle ( renderer, a, &(a->v[i]), &(a->v[i+1]), &(a->v[i+2]),
+        	      &tex, stats );
+    }
+  tcache_release ( renderer, tex.entry );
+  if ( !empty )
+    vram_mark ( renderer, area[0], area[1],
+        	area[2]-area[0]+1, area[3]-area[1]+1 );
+  
+} // end draw_polygon
+
+
 
 
 /***********/
@@ -896,6 +1216,7 @@ free_ (
        PSX_Renderer *rend
        )
 {
+  pthread_mutex_destroy ( &(DR(rend)->tcache_mutex) );
   free ( rend );
 } /* end free_ */
 
@@ -928,15 +1249,9 @@ pol3 (
       )
 {
   
-  const PSX_VertexInfo *v0,*v1,*v2;
-  pol_tex_t tex;
-  
-  
   stats->npixels= 0;
   stats->nlines= 0;
-  v0= &(a->v[0]); v1= &(a->v[1]); v2= &(a->v[2]);
-  pol_tex_gouraud_init ( &tex, DR(renderer)->fb, v0, v1, v2, a );
-  draw_triangle ( DR(renderer), a, v0, v1, v2, &tex, stats );
+  draw_polygon ( DR(renderer), a, 3, stats );
   
 } // end pol3
 
@@ -949,22 +1264,86 @@ pol4 (
       )
 {
 
-  const PSX_VertexInfo *va0,*va1,*va2,*vb0,*vb1,*vb2;
-  pol_tex_t tex;
-
-  
   stats->npixels= 0;
   stats->nlines= 0;
-  va0= &(a->v[0]); va1= &(a->v[1]); va2= &(a->v[2]);
-  pol_tex_gouraud_init ( &tex, DR(renderer)->fb, va0, va1, va2, a );
-  draw_triangle ( DR(renderer), a, va0, va1, va2, &tex, stats );
-  vb0= &(a->v[1]); vb1= &(a->v[2]); vb2= &(a->v[3]);
-  pol_tex_gouraud_init ( &tex, DR(renderer)->fb, vb0, vb1, vb2, a );
-  draw_triangle ( DR(renderer), a, vb0, vb1, vb2, &tex, stats );
+  draw_polygon ( DR(renderer), a, 4, stats );
   
 } // end pol4
 
 
+// Dibuixa les columnes C0..C1 de la fila ROW d'un rectangle amb
+// finestra de textura en X. TU té la U de cada columna a partir de
+// C0. Es divideix en trams on la U finestrejada pel kernel coincideix
+// amb TU, de com a molt 256 columnes (vore draw_rect_row).
+static int
+draw_rect_texwin_row (
+        	      default_renderer_t     *renderer,
+        	      const PSX_RendererArgs *a,
+        	      const pol_tex_t        *tex,
+        	      const int               row,
+        	      const int               c0,
+        	      const int               c1,
+        	      const uint8_t          *tu,
+        	      span_t                 *s
+        	      )
+{
+
+  int c,start,du,n;
+
+
+  du= s->du/ACC_ONE;
+  n= 0;
+  for ( c= c0; c <= c1; )
+    {
+      start= c;
+      for ( ++c;
+            c <= c1 && c-start < 256 &&
+              tu[c-c0] == (((tu[start-c0] + (c-start)*du)&a->texwinmask_x) |
+        		   a->texwinoff_x);
+            ++c );
+      s->u= tu[start-c0]*ACC_ONE;
+      n+= tex->span ( renderer->fb + row*NCOLS, row, start, c-1, s, tex, a );
+    }
+
+  return n;
+  
+} // end draw_rect_texwin_row
+
+
+// Dibuixa una fila d'un rectangle sense finestra de textura en X. U
+// és la coordenada en C0. Es dibuixa en trossos de 256 columnes per a
+// que l'acumulador de U no isca del rang (vore ACC_BITS), la textura
+// es repeteix cada 256 texels.
+static int
+draw_rect_row (
+               default_renderer_t     *renderer,
+               const PSX_RendererArgs *a,
+               const pol_tex_t        *tex,
+               const int               row,
+               const int               c0,
+               const int               c1,
+               const int               u,
+               span_t                 *s
+               )
+{
+
+  int c,end,du,n;
+
+
+  du= s->du/ACC_ONE;
+  n= 0;
+  for ( c= c0; c <= c1; c= end+1 )
+    {
+      end= c+255 < c1 ? c+255 : c1;
+      s->u= ((u + (c-c0)*du)&0xFF)*ACC_ONE;
+      n+= tex->span ( renderer->fb + row*NCOLS, row, c, end, s, tex, a );
+    }
+
+  return n;
+  
+} // end draw_rect_row
+
+
 static void
 rect (
       PSX_Renderer      *renderer,
@@ -975,66 +1354,123 @@ rect (
       )
 {
 
-  uint16_t *off,*p,color;
-  int r,c,cx1,cx2,cy1,cy2;
-  uint8_t u,v,R,g,b;
-  bool tex_enabled;
-  const uint16_t *clut;
-  const uint16_t *page;
+  int r,r0,r1,c0,c1,u,v,du,dv,area[4];
+  bool texwin_x;
+  uint8_t tv,tu[NCOLS];
+  pol_tex_t tex;
+  span_t s;
   
   
   stats->npixels= 0;
   stats->nlines= 0;
-  tex_enabled= (a->texture_mode!=PSX_TEX_NONE);
-  if ( tex_enabled )
+
+  /* Retalla. */
+  c0= a->v[0].x; c1= a->v[0].x + width - 1;
+  if ( c0 < a->clip_x1 ) c0= a->clip_x1;
+  if ( c1 > a->clip_x2 ) c1= a->clip_x2;
+  r0= a->v[0].y; r1= a->v[0].y + height - 1;
+  if ( r0 < a->clip_y1 ) r0= a->clip_y1;
+  if ( r1 > a->clip_y2 ) r1= a->clip_y2;
+  if ( c0 > c1 || r0 > r1 ) return;
+  area[0]= c0; area[1]= r0; area[2]= c1; area[3]= r1;
+
+  /* Coordenades de textura en (c0,r0). */
+  du= a->texflip_x ? -1 : 1;
+  dv= a->texflip_y ? -1 : 1;
+  u= (a->texflip_x ? (a->v[0].u-1) : a->v[0].u) + (c0-a->v[0].x)*du;
+  v= (a->texflip_y ? (a->v[0].v-1) : a->v[0].v) + (r0-a->v[0].y)*dv;
+  
+  /* Textura. */
+  tex.tex_enabled= (a->texture_mode!=PSX_TEX_NONE);
+  tex.gouraud_enabled= false;
+  if ( r1-r0 >= 255 )
+    tex.entry= tcache_acquire ( DR(renderer), a, 0, 255, area );
+  else if ( dv > 0 )
+    tex.entry= tcache_acquire ( DR(renderer), a, v, v+(r1-r0), area );
+  else tex.entry= tcache_acquire ( DR(renderer), a, v-(r1-r0), v, area );
+  if ( tex.entry != NULL ) tex.page= tex.entry->texels;
+  else if ( tex.tex_enabled )
     {
-      clut= &(DR(renderer)->fb[a->texclut_y*1024 + a->texclut_x*16]);
-      page= &(DR(renderer)->fb[a->texpage_y*256*1024 + a->texpage_x*64]);
+      tex.clut= &(DR(renderer)->fb[a->texclut_y*1024 + a->texclut_x*16]);
+      tex.page= &(DR(renderer)->fb[a->texpage_y*256*1024 + a->texpage_x*64]);
     }
-  else page= clut= NULL; /* CALLA!!! */
-  off= &(DR(renderer)->fb[a->v[0].y*1024 + a->v[0].x]);
-  v= a->texflip_y ? (a->v[0].v-1) : a->v[0].v;
-  cy1= a->clip_y1 - a->v[0].y; cy2= a->clip_y2 - a->v[0].y;
-  cx1= a->clip_x1 - a->v[0].x; cx2= a->clip_x2 - a->v[0].x;
-  for ( r= 0; r < height; ++r )
+  else tex.page= tex.clut= NULL; /* CALLA!!! */
+  pol_tex_select_span ( &tex, DR(renderer), a, false ); // Sense dithering.
+
+  /* Finestra de textura. La coordenada es finestreja i després
+   * s'incrementa, començant en el vèrtex encara que estiga retallat,
+   * per tant amb finestra no és lineal. En X es guarda el valor de
+   * cada columna, en Y es recalcula per fila.
+   */
+  texwin_x= tex.tex_enabled &&
+    (a->texwinmask_x != 0xFF || a->texwinoff_x != 0);
+  if ( texwin_x )
     {
       u= a->texflip_x ? (a->v[0].u-1) : a->v[0].u;
-      v= (v&a->texwinmask_y) | a->texwinoff_y;
-      if ( r >= cy1 && r <= cy2 )
+      for ( r= a->v[0].x; r <= c1; ++r )
         {
-          for ( p= off, c= 0; c < width; ++c, ++p )
-            {
-              if ( tex_enabled ) /* Textura, sense dithering però amb flip. */
-        	{
-        	  u= (u&a->texwinmask_x) | a->texwinoff_x;
-        	  color= read_tex_color ( u, v, a->texture_mode, page, clut );
-        	  if ( a->texflip_x ) --u; else ++u;
-                  if ( color == 0 ) continue;
-        	  if ( a->modulate_texture )
-        	    {
-        	      R= a->r; g= a->g; b= a->b;
-        	      modulate_color ( &R, &g, &b, color );
-        	      color= (color&0x8000) | TORGB15b ( R, g, b );
-        	    }
-        	}
-              else color= TORGB15b ( a->r, a->g, a->b );
-              if ( c < cx1 || c > cx2 ) continue;
-              if ( a->transparency != PSX_TR_NONE &&
-        	   (!tex_enabled || (color&0x8000) ) )
-        	color= apply_color_blending ( a->transparency, *p, color );
-              if ( a->check_mask && (*p&0x8000) ) continue;
-              if ( a->set_mask ) color|= 0x8000;
-              *p= color;
-              ++(stats->npixels);
-            }
+          u= (u&a->texwinmask_x) | a->texwinoff_x;
+          if ( r >= c0 ) tu[r-c0]= (uint8_t) u;
+          u= (u+du)&0xFF;
         }
-      if ( a->texflip_y ) --v; else ++v;
-      off+= 1024;
     }
+  tv= a->texflip_y ? (a->v[0].v-1) : a->v[0].v;
+  for ( r= a->v[0].y; r < r0; ++r )
+    tv= ((tv&a->texwinmask_y) | a->texwinoff_y) + dv;
+
+  /* Dibuixa. */
+  s.du= du*ACC_ONE;
+  s.dv= 0;
+  s.r= s.dr= s.g= s.dg= s.b= s.db= 0;
+  for ( r= r0; r <= r1; ++r )
+    {
+      tv= (tv&a->texwinmask_y) | a->texwinoff_y;
+      s.v= tv*ACC_ONE;
+      if ( texwin_x )
+        stats->npixels+= draw_rect_texwin_row ( DR(renderer), a, &tex, r,
+        					c0, c1, tu, &s );
+      else
+        stats->npixels+= draw_rect_row ( DR(renderer), a, &tex, r,
+        				 c0, c1, u, &s );
+      tv+= dv;
+    }
+  tcache_release ( DR(renderer), tex.entry );
+  vram_mark ( DR(renderer), c0, r0, c1-c0+1, r1-r0+1 );
   
 } /* end rect */
 
 
+// Dibuixa les columnes LEFT..RIGHT de la fila ROW d'una línia. S té
+// els valors en LEFT.
+static int
+draw_line_run (
+               default_renderer_t     *renderer,
+               const PSX_RendererArgs *a,
+               const pol_tex_t        *tex,
+               const int               row,
+               const int               left,
+               const int               right,
+               span_t                 *s
+               )
+{
+
+  int c0,c1,n;
+
+  
+  if ( row < a->clip_y1 || row > a->clip_y2 ) return 0;
+  c0= left < a->clip_x1 ? a->clip_x1 : left;
+  c1= right > a->clip_x2 ? a->clip_x2 : right;
+  if ( c0 > c1 ) return 0;
+  n= c0-left;
+  s->r+= n*s->dr; s->g+= n*s->dg; s->b+= n*s->db;
+  
+  return tex->span ( renderer->fb + row*NCOLS, row, c0, c1, s, tex, a );
+  
+} // end draw_line_run
+
+
+// NOTA!! La línia es dibuixa per trams horitzontals per a poder
+// emprar els mateixos kernels que els polígons.
 static void
 line (
       PSX_Renderer      *renderer,
@@ -1043,11 +1479,11 @@ line (
       )
 {
 
-  bool changed;
-  int dx,dy,signx,signy,tmp,i,x,y,e;
-  double dr,dg,db,aux,rf,gf,bf;
-  uint16_t color,*pixel;
-  uint8_t r,g,b;
+  bool changed,run;
+  int dx,dy,signx,signy,tmp,i,x,y,e,left,right,row,area[4];
+  int32_t dr,dg,db,racc,gacc,bacc;
+  pol_tex_t tex;
+  span_t s;
   
   
   stats->npixels= 0;
@@ -1068,49 +1504,55 @@ line (
       changed= true;
     }
   else changed= false;
-
+  
+  tex.tex_enabled= false;
+  tex.gouraud_enabled= a->gouraud;
+  tex.entry= NULL;
+  pol_tex_select_span ( &tex, DR(renderer), a, a->dithering );
+  memset ( &s, 0, sizeof(s) );
+  
   /* Renderitza. */
   if ( a->gouraud )
     {
-      aux= 1.0 / ((double) dx);
-      dr= (((int) a->v[1].r) - ((int) a->v[0].r)) * aux;
-      dg= (((int) a->v[1].g) - ((int) a->v[0].g)) * aux;
-      db= (((int) a->v[1].b) - ((int) a->v[0].b)) * aux;
-      rf= (double) a->v[0].r;
-      gf= (double) a->v[0].g;
-      bf= (double) a->v[0].b;
+      if ( dx > 0 )
+        {
+          // Cap amunt, com en els triangles.
+          dr= (int32_t) div_ceil ( (((int64_t) a->v[1].r) -
+        			    ((int64_t) a->v[0].r))*ACC_ONE, dx );
+          dg= (int32_t) div_ceil ( (((int64_t) a->v[1].g) -
+        			    ((int64_t) a->v[0].g))*ACC_ONE, dx );
+          db= (int32_t) div_ceil ( (((int64_t) a->v[1].b) -
+        			    ((int64_t) a->v[0].b))*ACC_ONE, dx );
+        }
+      else dr= dg= db= 0;
+      racc= ((int32_t) a->v[0].r)*ACC_ONE + ACC_ONE/2;
+      gacc= ((int32_t) a->v[0].g)*ACC_ONE + ACC_ONE/2;
+      bacc= ((int32_t) a->v[0].b)*ACC_ONE + ACC_ONE/2;
     }
-  else { rf= gf= bf= dr= dg= db= 0.0; }
+  else { racc= gacc= bacc= dr= dg= db= 0; }
+  // Els trams es dibuixen d'esquerra a dreta.
+  s.dr= signx*dr; s.dg= signx*dg; s.db= signx*db;
   e= 2*dy - dx;
   x= a->v[0].x; y= a->v[0].y;
+  left= right= row= 0; run= false;
   for ( i= 0; i <= dx; ++i )
     {
-
-      /* Dibuixa. */
-      if ( a->gouraud )
+      
+      /* Afegeix al tram. */
+      if ( run && y == row )
         {
-          r= (uint8_t) (rf + 0.5);
-          g= (uint8_t) (gf + 0.5);
-          b= (uint8_t) (bf + 0.5);
-          rf+= dr; gf+= dg; bf+= db;
+          if ( signx > 0 ) right= x;
+          else { left= x; s.r= racc; s.g= gacc; s.b= bacc; }
         }
-      else { r= a->r; g= a->g; b= a->b; }
-      if ( y >= a->clip_y1 && y <= a->clip_y2 &&
-           x >= a->clip_x1 && x <= a->clip_x2 )
+      else
         {
-          pixel= &(DR(renderer)->fb[y*1024 + x]);
-          if ( a->dithering )
-            color= apply_dithering ( DITHERING[y&0x3][x&0x3], r, g, b );
-          else color= TORGB15b ( r, g, b );
-          if ( a->transparency != PSX_TR_NONE )
-            color= apply_color_blending ( a->transparency, *pixel, color );
-          if ( !a->check_mask || !((*pixel)&0x8000) )
-            {
-              if ( a->set_mask ) color|= 0x8000;
-              *pixel= color;
-              ++(stats->npixels);
-            }
+          if ( run )
+            stats->npixels+= draw_line_run ( DR(renderer), a, &tex,
+        				     row, left, right, &s );
+          left= right= x; row= y; run= true;
+          s.r= racc; s.g= gacc; s.b= bacc;
         }
+      racc+= dr; gacc+= dg; bacc+= db;
       
       /* Actualitza. */
       if ( e > 0 )
@@ -1124,6 +1566,11 @@ line (
       e+= 2*dy;
       
     }
+  stats->npixels+= draw_line_run ( DR(renderer), a, &tex,
+        			   row, left, right, &s );
+  if ( prim_area ( a, 2, area ) )
+    vram_mark ( DR(renderer), area[0], area[1],
+        	area[2]-area[0]+1, area[3]-area[1]+1 );
   
 } /* end line */
 
@@ -1269,6 +1716,19 @@ enable_display (
 } /* end enable_display */
 
 
+static void
+vram_written (
+              PSX_Renderer *renderer,
+              const int     x,
+              const int     y,
+              const int     width,
+              const int     height
+              )
+{
+  vram_mark ( DR(renderer), x&0x3FF, y&0x1FF, width, height );
+} /* end vram_written */
+
+
 
 
 /**********************/
@@ -1283,7 +1743,7 @@ PSX_create_default_renderer (
 {
 
   default_renderer_t *new;
-  int r;
+  int r,n;
   
 
   new= mem_alloc ( default_renderer_t, 1 );
@@ -1298,16 +1758,36 @@ PSX_create_default_renderer (
   new->line= line;
   new->draw= draw;
   new->enable_display= enable_display;
+  new->vram_written= vram_written;
   
   /* Altres. */
   new->fb= NULL;
   new->udata= udata;
   new->update_screen= update_screen;
   new->display_enabled= false;
+#ifdef SPAN_SIMD
+  new->simd_spans= span_simd_kernels ();
+#else
+  new->simd_spans= NULL;
+#endif
   for ( r= 0; r < NLINES; ++r )
     new->pol.p[r].enabled= false;
   new->pol.r0= NLINES;
   new->pol.r1= -1;
+
+  /* Cache de textures. */
+  pthread_mutex_init ( &(new->tcache_mutex), NULL );
+  new->gen= 0;
+  memset ( new->vram_gen, 0, sizeof(new->vram_gen) );
+  new->tick= 0;
+  for ( n= 0; n < TCACHE_SEEN; ++n )
+    new->seen[n]= -1;
+  new->seen_pos= 0;
+  for ( n= 0; n < TCACHE_SIZE; ++n )
+    {
+      new->tcache[n].used= false;
+      new->tcache[n].refs= 0;
+    }
   
   return PSX_RENDERER(new);
   
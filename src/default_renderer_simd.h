@@ -0,0 +1,553 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  default_renderer_simd.h - Kernels SSE4.1/AVX2 per a trams sense
+ *                            textura (color pla o gouraud).
+ *
+ */
+/*
+ * NOTA: Cada iteració processa 8 (SSE4.1) o 16 (AVX2) píxels amb un
+ * canal de 16 bits per píxel. Els píxels que sobren al final es
+ * dibuixen amb span_generic, per tant el resultat és idèntic al dels
+ * kernels escalars. El kernel es tria en temps d'execució segons el
+ * que suporte la UCP (span_simd_kernels).
+ */
+
+
+#ifdef SPAN_SIMD
+
+
+/* SSE4.1 *********************************************************************/
+__attribute__((target("sse4.1")))
+static ALWAYS_INLINE __m128i
+blend_sse41 (
+             const int     mode,
+             const __m128i old,
+             const __m128i new
+             )
+{
+
+  __m128i m,o_r,o_g,o_b,n_r,n_g,n_b,r,g,b;
+
+
+  m= _mm_set1_epi16 ( 0x1F );
+  o_r= _mm_and_si128 ( old, m );
+  o_g= _mm_and_si128 ( _mm_srli_epi16 ( old, 5 ), m );
+  o_b= _mm_and_si128 ( _mm_srli_epi16 ( old, 10 ), m );
+  n_r= _mm_and_si128 ( new, m );
+  n_g= _mm_and_si128 ( _mm_srli_epi16 ( new, 5 ), m );
+  n_b= _mm_and_si128 ( _mm_srli_epi16 ( new, 10 ), m );
+  switch ( mode )
+    {
+    case PSX_TR_MODE0: // D/2 + S/2
+      r= _mm_srli_epi16 ( _mm_add_epi16 ( o_r, n_r ), 1 );
+      g= _mm_srli_epi16 ( _mm_add_epi16 ( o_g, n_g ), 1 );
+      b= _mm_srli_epi16 ( _mm_add_epi16 ( o_b, n_b ), 1 );
+      break;
+    case PSX_TR_MODE1: // D + S
+      r= _mm_min_epi16 ( _mm_add_epi16 ( o_r, n_r ), m );
+      g= _mm_min_epi16 ( _mm_add_epi16 ( o_g, n_g ), m );
+      b= _mm_min_epi16 ( _mm_add_epi16 ( o_b, n_b ), m );
+      break;
+    case PSX_TR_MODE2: // D - S
+      r= _mm_subs_epu16 ( o_r, n_r );
+      g= _mm_subs_epu16 ( o_g, n_g );
+      b= _mm_subs_epu16 ( o_b, n_b );
+      break;
+    case PSX_TR_MODE3: // D + S/4
+    default:
+      r= _mm_min_epi16 ( _mm_add_epi16 ( o_r, _mm_srli_epi16 ( n_r, 2 ) ), m );
+      g= _mm_min_epi16 ( _mm_add_epi16 ( o_g, _mm_srli_epi16 ( n_g, 2 ) ), m );
+      b= _mm_min_epi16 ( _mm_add_epi16 ( o_b, _mm_srli_epi16 ( n_b, 2 ) ), m );
+      break;
+    }
+
+  return _mm_or_si128 ( _mm_and_si128 ( new, _mm_set1_epi16 ( (short) 0x8000 ) ),
+                        _mm_or_si128 ( r,
+                                       _mm_or_si128 ( _mm_slli_epi16 ( g, 5 ),
+                                                      _mm_slli_epi16 ( b, 10 ) ) ) );
+
+} // end blend_sse41
+
+
+// Passa dos acumuladors de 4 píxels a 8 canals de 16 bits en 0..255.
+__attribute__((target("sse4.1")))
+static ALWAYS_INLINE __m128i
+acc2chn_sse41 (
+               const __m128i lo,
+               const __m128i hi
+               )
+{
+
+  __m128i ret;
+
+
+  ret= _mm_packs_epi32 ( _mm_srai_epi32 ( lo, ACC_BITS ),
+                         _mm_srai_epi32 ( hi, ACC_BITS ) );
+  ret= _mm_max_epi16 ( ret, _mm_setzero_si128 () );
+
+  return _mm_min_epi16 ( ret, _mm_set1_epi16 ( 255 ) );
+
+} // end acc2chn_sse41
+
+
+__attribute__((target("sse4.1")))
+static ALWAYS_INLINE __m128i
+dither_sse41 (
+              const __m128i chn,
+              const __m128i off
+              )
+{
+
+  __m128i ret;
+
+
+  ret= _mm_add_epi16 ( chn, off );
+  ret= _mm_max_epi16 ( ret, _mm_setzero_si128 () );
+
+  return _mm_min_epi16 ( ret, _mm_set1_epi16 ( 255 ) );
+
+} // end dither_sse41
+
+
+__attribute__((target("sse4.1")))
+static ALWAYS_INLINE __m128i
+rgb2color_sse41 (
+                 const __m128i r,
+                 const __m128i g,
+                 const __m128i b
+                 )
+{
+  return _mm_or_si128 ( _mm_srli_epi16 ( r, 3 ),
+                        _mm_or_si128 ( _mm_slli_epi16 ( _mm_srli_epi16 ( g, 3 ), 5 ),
+                                       _mm_slli_epi16 ( _mm_srli_epi16 ( b, 3 ), 10 ) ) );
+} // end rgb2color_sse41
+
+
+__attribute__((target("sse4.1")))
+static ALWAYS_INLINE int
+span_sse41_generic (
+                    uint16_t               *line,
+                    const int               row,
+                    const int               c0,
+                    const int               c1,
+                    const span_t           *s,
+                    const pol_tex_t        *tex,
+                    const PSX_RendererArgs *a,
+                    const bool              GOURAUD,
+                    const int               BLEND,
+                    const bool              DITHER
+                    )
+{
+
+  const int *d_row;
+  int c,n;
+  span_t tail;
+  __m128i off,check,set,zero,flat,r,g,b,color,old,keep;
+  __m128i r_lo,r_hi,g_lo,g_hi,b_lo,b_hi,dr,dg,db,idx;
+
+
+  // Prepara.
+  d_row= &(DITHERING[row&0x3][0]);
+  off= _mm_setr_epi16 ( d_row[c0&0x3], d_row[(c0+1)&0x3],
+                        d_row[(c0+2)&0x3], d_row[(c0+3)&0x3],
+                        d_row[c0&0x3], d_row[(c0+1)&0x3],
+                        d_row[(c0+2)&0x3], d_row[(c0+3)&0x3] );
+  check= _mm_set1_epi16 ( tex->check_mask );
+  set= _mm_set1_epi16 ( tex->set_mask );
+  zero= _mm_setzero_si128 ();
+  r= _mm_set1_epi16 ( a->r );
+  g= _mm_set1_epi16 ( a->g );
+  b= _mm_set1_epi16 ( a->b );
+  if ( DITHER && !GOURAUD )
+    {
+      r= dither_sse41 ( r, off );
+      g= dither_sse41 ( g, off );
+      b= dither_sse41 ( b, off );
+    }
+  flat= rgb2color_sse41 ( r, g, b );
+  idx= _mm_setr_epi32 ( 0, 1, 2, 3 );
+  dr= _mm_set1_epi32 ( s->dr );
+  dg= _mm_set1_epi32 ( s->dg );
+  db= _mm_set1_epi32 ( s->db );
+  r_lo= _mm_add_epi32 ( _mm_set1_epi32 ( s->r ), _mm_mullo_epi32 ( idx, dr ) );
+  g_lo= _mm_add_epi32 ( _mm_set1_epi32 ( s->g ), _mm_mullo_epi32 ( idx, dg ) );
+  b_lo= _mm_add_epi32 ( _mm_set1_epi32 ( s->b ), _mm_mullo_epi32 ( idx, db ) );
+  dr= _mm_slli_epi32 ( dr, 2 );
+  dg= _mm_slli_epi32 ( dg, 2 );
+  db= _mm_slli_epi32 ( db, 2 );
+  r_hi= _mm_add_epi32 ( r_lo, dr );
+  g_hi= _mm_add_epi32 ( g_lo, dg );
+  b_hi= _mm_add_epi32 ( b_lo, db );
+  dr= _mm_slli_epi32 ( dr, 1 );
+  dg= _mm_slli_epi32 ( dg, 1 );
+  db= _mm_slli_epi32 ( db, 1 );
+
+  // Blocs de 8 píxels.
+  n= 0;
+  for ( c= c0; c+7 <= c1; c+= 8 )
+    {
+      if ( GOURAUD )
+        {
+          r= acc2chn_sse41 ( r_lo, r_hi );
+          g= acc2chn_sse41 ( g_lo, g_hi );
+          b= acc2chn_sse41 ( b_lo, b_hi );
+          r_lo= _mm_add_epi32 ( r_lo, dr ); r_hi= _mm_add_epi32 ( r_hi, dr );
+          g_lo= _mm_add_epi32 ( g_lo, dg ); g_hi= _mm_add_epi32 ( g_hi, dg );
+          b_lo= _mm_add_epi32 ( b_lo, db ); b_hi= _mm_add_epi32 ( b_hi, db );
+          if ( DITHER )
+            {
+              r= dither_sse41 ( r, off );
+              g= dither_sse41 ( g, off );
+              b= dither_sse41 ( b, off );
+            }
+          color= rgb2color_sse41 ( r, g, b );
+        }
+      else color= flat;
+      old= _mm_loadu_si128 ( (const __m128i *) &line[c] );
+      if ( BLEND != PSX_TR_NONE ) color= blend_sse41 ( BLEND, old, color );
+      keep= _mm_cmpeq_epi16 ( _mm_and_si128 ( old, check ), zero );
+      color= _mm_blendv_epi8 ( old, _mm_or_si128 ( color, set ), keep );
+      _mm_storeu_si128 ( (__m128i *) &line[c], color );
+      n+= __builtin_popcount ( _mm_movemask_epi8 ( keep ) )>>1;
+    }
+
+  // Resta.
+  if ( c <= c1 )
+    {
+      tail= *s;
+      tail.r+= (c-c0)*s->dr;
+      tail.g+= (c-c0)*s->dg;
+      tail.b+= (c-c0)*s->db;
+      n+= span_generic ( line, row, c, c1, &tail, tex, a,
+                         PSX_TEX_NONE, false, GOURAUD, BLEND, DITHER );
+    }
+
+  return n;
+
+} // end span_sse41_generic
+
+
+/* AVX2 ***********************************************************************/
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256i
+blend_avx2 (
+            const int     mode,
+            const __m256i old,
+            const __m256i new
+            )
+{
+
+  __m256i m,o_r,o_g,o_b,n_r,n_g,n_b,r,g,b;
+
+
+  m= _mm256_set1_epi16 ( 0x1F );
+  o_r= _mm256_and_si256 ( old, m );
+  o_g= _mm256_and_si256 ( _mm256_srli_epi16 ( old, 5 ), m );
+  o_b= _mm256_and_si256 ( _mm256_srli_epi16 ( old, 10 ), m );
+  n_r= _mm256_and_si256 ( new, m );
+  n_g= _mm256_and_si256 ( _mm256_srli_epi16 ( new, 5 ), m );
+  n_b= _mm256_and_si256 ( _mm256_srli_epi16 ( new, 10 ), m );
+  switch ( mode )
+    {
+    case PSX_TR_MODE0: // D/2 + S/2
+      r= _mm256_srli_epi16 ( _mm256_add_epi16 ( o_r, n_r ), 1 );
+      g= _mm256_srli_epi16 ( _mm256_add_epi16 ( o_g, n_g ), 1 );
+      b= _mm256_srli_epi16 ( _mm256_add_epi16 ( o_b, n_b ), 1 );
+      break;
+    case PSX_TR_MODE1: // D + S
+      r= _mm256_min_epi16 ( _mm256_add_epi16 ( o_r, n_r ), m );
+      g= _mm256_min_epi16 ( _mm256_add_epi16 ( o_g, n_g ), m );
+      b= _mm256_min_epi16 ( _mm256_add_epi16 ( o_b, n_b ), m );
+      break;
+    case PSX_TR_MODE2: // D - S
+      r= _mm256_subs_epu16 ( o_r, n_r );
+      g= _mm256_subs_epu16 ( o_g, n_g );
+      b= _mm256_subs_epu16 ( o_b, n_b );
+      break;
+    case PSX_TR_MODE3: // D + S/4
+    default:
+      r= _mm256_min_epi16 ( _mm256_add_epi16 ( o_r,
+                                               _mm256_srli_epi16 ( n_r, 2 ) ),
+                            m );
+      g= _mm256_min_epi16 ( _mm256_add_epi16 ( o_g,
+                                               _mm256_srli_epi16 ( n_g, 2 ) ),
+                            m );
+      b= _mm256_min_epi16 ( _mm256_add_epi16 ( o_b,
+                                               _mm256_srli_epi16 ( n_b, 2 ) ),
+                            m );
+      break;
+    }
+
+  return _mm256_or_si256 ( _mm256_and_si256 ( new,
+                                              _mm256_set1_epi16 ( (short) 0x8000 ) ),
+                           _mm256_or_si256 ( r,
+                                             _mm256_or_si256 ( _mm256_slli_epi16 ( g, 5 ),
+                                                               _mm256_slli_epi16 ( b, 10 ) ) ) );
+
+} // end blend_avx2
+
+
+// Passa dos acumuladors de 8 píxels a 16 canals de 16 bits en 0..255.
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256i
+acc2chn_avx2 (
+              const __m256i lo,
+              const __m256i hi
+              )
+{
+
+  __m256i ret;
+
+
+  // packs treballa per meitats de 128 bits, cal reordenar.
+  ret= _mm256_packs_epi32 ( _mm256_srai_epi32 ( lo, ACC_BITS ),
+                            _mm256_srai_epi32 ( hi, ACC_BITS ) );
+  ret= _mm256_permute4x64_epi64 ( ret, 0xD8 );
+  ret= _mm256_max_epi16 ( ret, _mm256_setzero_si256 () );
+
+  return _mm256_min_epi16 ( ret, _mm256_set1_epi16 ( 255 ) );
+
+} // end acc2chn_avx2
+
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256i
+dither_avx2 (
+             const __m256i chn,
+             const __m256i off
+             )
+{
+
+  __m256i ret;
+
+
+  ret= _mm256_add_epi16 ( chn, off );
+  ret= _mm256_max_epi16 ( ret, _mm256_setzero_si256 () );
+
+  return _mm256_min_epi16 ( ret, _mm256_set1_epi16 ( 255 ) );
+
+} // end dither_avx2
+
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256i
+rgb2color_avx2 (
+                const __m256i r,
+                const __m256i g,
+                const __m256i b
+                )
+{
+  return _mm256_or_si256 ( _mm256_srli_epi16 ( r, 3 ),
+                           _mm256_or_si256 ( _mm256_slli_epi16 ( _mm256_srli_epi16 ( g, 3 ), 5 ),
+                                             _mm256_slli_epi16 ( _mm256_srli_epi16 ( b, 3 ), 10 ) ) );
+} // end rgb2color_avx2
+
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int
+span_avx2_generic (
+                   uint16_t               *line,
+                   const int               row,
+                   const int               c0,
+                   const int               c1,
+                   const span_t           *s,
+                   const pol_tex_t        *tex,
+                   const PSX_RendererArgs *a,
+                   const bool              GOURAUD,
+                   const int               BLEND,
+                   const bool              DITHER
+                   )
+{
+
+  const int *d_row;
+  int c,n,o0,o1,o2,o3;
+  span_t tail;
+  __m256i off,check,set,zero,flat,r,g,b,color,old,keep;
+  __m256i r_lo,r_hi,g_lo,g_hi,b_lo,b_hi,dr,dg,db,idx;
+
+
+  // Prepara.
+  d_row= &(DITHERING[row&0x3][0]);
+  o0= d_row[c0&0x3]; o1= d_row[(c0+1)&0x3];
+  o2= d_row[(c0+2)&0x3]; o3= d_row[(c0+3)&0x3];
+  off= _mm256_setr_epi16 ( o0, o1, o2, o3, o0, o1, o2, o3,
+                           o0, o1, o2, o3, o0, o1, o2, o3 );
+  check= _mm256_set1_epi16 ( tex->check_mask );
+  set= _mm256_set1_epi16 ( tex->set_mask );
+  zero= _mm256_setzero_si256 ();
+  r= _mm256_set1_epi16 ( a->r );
+  g= _mm256_set1_epi16 ( a->g );
+  b= _mm256_set1_epi16 ( a->b );
+  if ( DITHER && !GOURAUD )
+    {
+      r= dither_avx2 ( r, off );
+      g= dither_avx2 ( g, off );
+      b= dither_avx2 ( b, off );
+    }
+  flat= rgb2color_avx2 ( r, g, b );
+  idx= _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 );
+  dr= _mm256_set1_epi32 ( s->dr );
+  dg= _mm256_set1_epi32 ( s->dg );
+  db= _mm256_set1_epi32 ( s->db );
+  r_lo= _mm256_add_epi32 ( _mm256_set1_epi32 ( s->r ),
+                           _mm256_mullo_epi32 ( idx, dr ) );
+  g_lo= _mm256_add_epi32 ( _mm256_set1_epi32 ( s->g ),
+                           _mm256_mullo_epi32 ( idx, dg ) );
+  b_lo= _mm256_add_epi32 ( _mm256_set1_epi32 ( s->b ),
+                           _mm256_mullo_epi32 ( idx, db ) );
+  dr= _mm256_slli_epi32 ( dr, 3 );
+  dg= _mm256_slli_epi32 ( dg, 3 );
+  db= _mm256_slli_epi32 ( db, 3 );
+  r_hi= _mm256_add_epi32 ( r_lo, dr );
+  g_hi= _mm256_add_epi32 ( g_lo, dg );
+  b_hi= _mm256_add_epi32 ( b_lo, db );
+  dr= _mm256_slli_epi32 ( dr, 1 );
+  dg= _mm256_slli_epi32 ( dg, 1 );
+  db= _mm256_slli_epi32 ( db, 1 );
+
+  // Blocs de 16 píxels.
+  n= 0;
+  for ( c= c0; c+15 <= c1; c+= 16 )
+    {
+      if ( GOURAUD )
+        {
+          r= acc2chn_avx2 ( r_lo, r_hi );
+          g= acc2chn_avx2 ( g_lo, g_hi );
+          b= acc2chn_avx2 ( b_lo, b_hi );
+          r_lo= _mm256_add_epi32 ( r_lo, dr );
+          r_hi= _mm256_add_epi32 ( r_hi, dr );
+          g_lo= _mm256_add_epi32 ( g_lo, dg );
+          g_hi= _mm256_add_epi32 ( g_hi, dg );
+          b_lo= _mm256_add_epi32 ( b_lo, db );
+          b_hi= _mm256_add_epi32 ( b_hi, db );
+          if ( DITHER )
+            {
+              r= dither_avx2 ( r, off );
+              g= dither_avx2 ( g, off );
+              b= dither_avx2 ( b, off );
+            }
+          color= rgb2color_avx2 ( r, g, b );
+        }
+      else color= flat;
+      old= _mm256_loadu_si256 ( (const __m256i *) &line[c] );
+      if ( BLEND != PSX_TR_NONE ) color= blend_avx2 ( BLEND, old, color );
+      keep= _mm256_cmpeq_epi16 ( _mm256_and_si256 ( old, check ), zero );
+      color= _mm256_blendv_epi8 ( old, _mm256_or_si256 ( color, set ), keep );
+      _mm256_storeu_si256 ( (__m256i *) &line[c], color );
+      n+= __builtin_popcount ( (unsigned int) _mm256_movemask_epi8 ( keep ) )>>1;
+    }
+
+  // Resta.
+  if ( c <= c1 )
+    {
+      tail= *s;
+      tail.r+= (c-c0)*s->dr;
+      tail.g+= (c-c0)*s->dg;
+      tail.b+= (c-c0)*s->db;
+      n+= span_generic ( line, row, c, c1, &tail, tex, a,
+                         PSX_TEX_NONE, false, GOURAUD, BLEND, DITHER );
+    }
+
+  return n;
+
+} // end span_avx2_generic
+
+
+/* Taules *********************************************************************/
+#define SIMD_SPAN_NAME(ISA,GOU,BLE,DIT)        				\
+  span_ ## ISA ## _ ## GOU ## _ ## BLE ## _ ## DIT
+
+#define DEF_SIMD_SPAN(ISA,TARGET,GOU,BLE,DIT)        			\
+  __attribute__((target(TARGET)))        				\
+  static int        							\
+  SIMD_SPAN_NAME(ISA,GOU,BLE,DIT) (        				\
+        			   uint16_t               *line,        \
+        			   const int               row,        	\
+        			   const int               c0,        	\
+        			   const int               c1,        	\
+        			   const span_t           *s,        	\
+        			   const pol_tex_t        *tex,        	\
+        			   const PSX_RendererArgs *a        	\
+        			   )        				\
+  {        								\
+    return span_ ## ISA ## _generic ( line, row, c0, c1, s, tex, a,        \
+        			      GOU, BLE, DIT );        		\
+  }
+
+#define DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,BLE)        			\
+  DEF_SIMD_SPAN(ISA,TARGET,GOU,BLE,0)        				\
+  DEF_SIMD_SPAN(ISA,TARGET,GOU,BLE,1)
+
+#define DEF_SIMD_SPAN_BLE(ISA,TARGET,GOU)        			\
+  DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,0)        				\
+  DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,1)        				\
+  DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,2)        				\
+  DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,3)        				\
+  DEF_SIMD_SPAN_DIT(ISA,TARGET,GOU,4)
+
+#define DEF_SIMD_SPAN_GOU(ISA,TARGET)        				\
+  DEF_SIMD_SPAN_BLE(ISA,TARGET,0)        				\
+  DEF_SIMD_SPAN_BLE(ISA,TARGET,1)
+
+DEF_SIMD_SPAN_GOU(sse41,"sse4.1")
+DEF_SIMD_SPAN_GOU(avx2,"avx2")
+
+
+#define SIMD_SPAN_DIT(ISA,GOU,BLE)        				\
+  { SIMD_SPAN_NAME(ISA,GOU,BLE,0), SIMD_SPAN_NAME(ISA,GOU,BLE,1) }
+
+#define SIMD_SPAN_BLE(ISA,GOU)        					\
+  {        								\
+    SIMD_SPAN_DIT(ISA,GOU,0),        					\
+    SIMD_SPAN_DIT(ISA,GOU,1),        					\
+    SIMD_SPAN_DIT(ISA,GOU,2),        					\
+    SIMD_SPAN_DIT(ISA,GOU,3),        					\
+    SIMD_SPAN_DIT(ISA,GOU,4)        					\
+  }
+
+// [GOURAUD][BLEND][DITHER]
+static span_fn_t *const SPAN_SSE41[2][5][2]=
+  {
+    SIMD_SPAN_BLE(sse41,0),
+    SIMD_SPAN_BLE(sse41,1)
+  };
+
+static span_fn_t *const SPAN_AVX2[2][5][2]=
+  {
+    SIMD_SPAN_BLE(avx2,0),
+    SIMD_SPAN_BLE(avx2,1)
+  };
+
+
+// Torna la taula de kernels per a trams sense textura que millor
+// s'adapta a la UCP, o NULL si no en suporta cap.
+static span_fn_t *const (*
+span_simd_kernels (void))[5][2]
+{
+
+  __builtin_cpu_init ();
+  if ( __builtin_cpu_supports ( "avx2" ) ) return SPAN_AVX2;
+  else if ( __builtin_cpu_supports ( "sse4.1" ) ) return SPAN_SSE41;
+  else return NULL;
+
+} // end span_simd_kernels
+
+
+#endif // SPAN_SIMD
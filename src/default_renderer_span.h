@@ -0,0 +1,188 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  default_renderer_span.h - Funcions que dibuixen un tram d'una
+ *                            línia, especialitzades per a cada
+ *                            combinació de l'estat del rasteritzador.
+ *
+ */
+/*
+ * NOTA: Tots els kernels es generen a partir de span_generic, que es
+ * força a ser inline amb els paràmetres de l'estat constants. D'aquesta
+ * manera el compilador elimina totes les comprovacions per píxel
+ * (textura, modulació, gouraud, transparència i dithering). Els bits
+ * de màscara es fan sense bots amb tex->check_mask i tex->set_mask.
+ */
+
+
+static ALWAYS_INLINE int
+span_generic (
+              uint16_t               *line,
+              const int               row,
+              const int               c0,
+              const int               c1,
+              const span_t           *s,
+              const pol_tex_t        *tex,
+              const PSX_RendererArgs *a,
+              const int               TEX,
+              const bool              MOD,
+              const bool              GOURAUD,
+              const int               BLEND,
+              const bool              DITHER
+              )
+{
+
+  int c,n,u,v,tmp;
+  int32_t uacc,vacc,racc,gacc,bacc;
+  uint16_t color,flat;
+  uint8_t r,g,b;
+  const int *d_row;
+
+
+  n= 0;
+  uacc= s->u; vacc= s->v;
+  racc= s->r; gacc= s->g; bacc= s->b;
+  r= a->r; g= a->g; b= a->b;
+  flat= TORGB15b ( a->r, a->g, a->b );
+  d_row= &(DITHERING[row&0x3][0]);
+  for ( c= c0; c <= c1; ++c )
+    {
+      if ( GOURAUD )
+        {
+          tmp= ACC_INT ( racc );
+          r= tmp < 0 ? 0 : (tmp > 255 ? 255 : (uint8_t) tmp);
+          tmp= ACC_INT ( gacc );
+          g= tmp < 0 ? 0 : (tmp > 255 ? 255 : (uint8_t) tmp);
+          tmp= ACC_INT ( bacc );
+          b= tmp < 0 ? 0 : (tmp > 255 ? 255 : (uint8_t) tmp);
+          racc+= s->dr; gacc+= s->dg; bacc+= s->db;
+        }
+      if ( TEX != PSX_TEX_NONE )
+        {
+          u= (ACC_INT ( uacc )&a->texwinmask_x) | a->texwinoff_x;
+          v= (ACC_INT ( vacc )&a->texwinmask_y) | a->texwinoff_y;
+          uacc+= s->du; vacc+= s->dv;
+          color= read_tex_color ( u, v, TEX, tex->page, tex->clut );
+          if ( color == 0 ) continue;
+          if ( MOD )
+            {
+              if ( !GOURAUD ) { r= a->r; g= a->g; b= a->b; }
+              modulate_color ( &r, &g, &b, color );
+              color=
+                (color&0x8000) |
+                (DITHER ?
+                 apply_dithering ( d_row[c&0x3], r, g, b ) :
+                 TORGB15b ( r, g, b ));
+            }
+          if ( BLEND != PSX_TR_NONE && (color&0x8000) )
+            color= apply_color_blending ( BLEND, line[c], color );
+        }
+      else
+        {
+          if ( DITHER )
+            color= apply_dithering ( d_row[c&0x3], r, g, b );
+          else if ( GOURAUD ) color= TORGB15b ( r, g, b );
+          else color= flat;
+          if ( BLEND != PSX_TR_NONE )
+            color= apply_color_blending ( BLEND, line[c], color );
+        }
+      if ( line[c]&tex->check_mask ) continue;
+      line[c]= color|tex->set_mask;
+      ++n;
+    }
+
+  return n;
+
+} // end span_generic
+
+
+// Els valors de TEX i BLEND coincideixen amb PSX_TEX_* (més
+// TEX_CACHED) i PSX_TR_*.
+#define SPAN_NAME(TEX,MOD,GOU,BLE,DIT)        				\
+  span_ ## TEX ## _ ## MOD ## _ ## GOU ## _ ## BLE ## _ ## DIT
+
+#define DEF_SPAN(TEX,MOD,GOU,BLE,DIT)        				\
+  static int        							\
+  SPAN_NAME(TEX,MOD,GOU,BLE,DIT) (        				\
+        			  uint16_t               *line,        	\
+        			  const int               row,        	\
+        			  const int               c0,        	\
+        			  const int               c1,        	\
+        			  const span_t           *s,        	\
+        			  const pol_tex_t        *tex,        	\
+        			  const PSX_RendererArgs *a        	\
+        			  )        				\
+  {        								\
+    return span_generic ( line, row, c0, c1, s, tex, a,        		\
+        		  TEX, MOD, GOU, BLE, DIT );        		\
+  }
+
+#define DEF_SPAN_DIT(TEX,MOD,GOU,BLE)        				\
+  DEF_SPAN(TEX,MOD,GOU,BLE,0)        					\
+  DEF_SPAN(TEX,MOD,GOU,BLE,1)
+
+#define DEF_SPAN_BLE(TEX,MOD,GOU)        				\
+  DEF_SPAN_DIT(TEX,MOD,GOU,0)        					\
+  DEF_SPAN_DIT(TEX,MOD,GOU,1)        					\
+  DEF_SPAN_DIT(TEX,MOD,GOU,2)        					\
+  DEF_SPAN_DIT(TEX,MOD,GOU,3)        					\
+  DEF_SPAN_DIT(TEX,MOD,GOU,4)
+
+#define DEF_SPAN_GOU(TEX,MOD)        					\
+  DEF_SPAN_BLE(TEX,MOD,0)        					\
+  DEF_SPAN_BLE(TEX,MOD,1)
+
+#define DEF_SPAN_MOD(TEX)        					\
+  DEF_SPAN_GOU(TEX,0)        						\
+  DEF_SPAN_GOU(TEX,1)
+
+DEF_SPAN_MOD(0)
+DEF_SPAN_MOD(1)
+DEF_SPAN_MOD(2)
+DEF_SPAN_MOD(3)
+DEF_SPAN_MOD(4)
+
+
+#define SPAN_DIT(TEX,MOD,GOU,BLE)        				\
+  { SPAN_NAME(TEX,MOD,GOU,BLE,0), SPAN_NAME(TEX,MOD,GOU,BLE,1) }
+
+#define SPAN_BLE(TEX,MOD,GOU)        					\
+  {        								\
+    SPAN_DIT(TEX,MOD,GOU,0),        					\
+    SPAN_DIT(TEX,MOD,GOU,1),        					\
+    SPAN_DIT(TEX,MOD,GOU,2),        					\
+    SPAN_DIT(TEX,MOD,GOU,3),        					\
+    SPAN_DIT(TEX,MOD,GOU,4)        					\
+  }
+
+#define SPAN_GOU(TEX,MOD)        					\
+  { SPAN_BLE(TEX,MOD,0), SPAN_BLE(TEX,MOD,1) }
+
+#define SPAN_MOD(TEX)        						\
+  { SPAN_GOU(TEX,0), SPAN_GOU(TEX,1) }
+
+// [TEX][MOD][GOURAUD][BLEND][DITHER]
+static span_fn_t *const SPAN_KERNELS[5][2][2][5][2]=
+  {
+    SPAN_MOD(0),
+    SPAN_MOD(1),
+    SPAN_MOD(2),
+    SPAN_MOD(3),
+    SPAN_MOD(4)
+  };
@@ -135,14 +135,6 @@ struct channel
   
 };
 
-// Gestiona cicles pendents i utilitzats.
-struct
-{
-  bool waiting_event; // Esperant a que es deperte el canal en mode 0.
-  int cc_used;
-  int cc;
-} _timing;
-
 
 
 
@@ -150,29 +142,56 @@ struct
 /* ESTAT */
 /*********/
 
-/* Callbacks. */
-static PSX_DMATransfer *_dma_transfer;
-static PSX_Warning *_warning;
-static void *_udata;
+typedef struct
+{
 
-static bool (*_transfer_data) (channel_t *chn);
+  // Gestiona cicles pendents i utilitzats.
+  struct
+  {
+    bool waiting_event; // Esperant a que es deperte el canal en mode 0.
+    int cc_used;
+    int cc;
+  } _timing;
 
-/* Canals. */
-static channel_t _chans[NUM_CHANS];
+  /* Callbacks. */
+  PSX_DMATransfer *_dma_transfer;
+  PSX_Warning *_warning;
+  void *_udata;
 
-/* Canals actius. */
-static struct
-{
-  channel_t *v[NUM_CHANS];
-  int N;
-} _actives;
+  bool (*_transfer_data) (channel_t *chn);
 
-// Canal que s'està executant actualment.
-static channel_t *_current_chn;
+  /* Canals. */
+  channel_t _chans[NUM_CHANS];
 
-/* Altres registres. */
-static uint32_t _dpcr;
-static uint32_t _dicr;
+  /* Canals actius. */
+  struct
+  {
+    channel_t *v[NUM_CHANS];
+    int N;
+  } _actives;
+
+  // Canal que s'està executant actualment.
+  channel_t *_current_chn;
+
+  /* Altres registres. */
+  uint32_t _dpcr;
+  uint32_t _dicr;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, DMA );
+
+#define STATE PSX_CTX_STATE ( state_t, DMA )
+#define _timing (STATE._timing)
+#define _dma_transfer (STATE._dma_transfer)
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _transfer_data (STATE._transfer_data)
+#define _chans (STATE._chans)
+#define _actives (STATE._actives)
+#define _current_chn (STATE._current_chn)
+#define _dpcr (STATE._dpcr)
+#define _dicr (STATE._dicr)
 
 
 
@@ -218,7 +237,6 @@ static void
 update_dma_running_mode (void)
 {
 
-  int tmp;
   const channel_t *top;
   
 
@@ -232,14 +250,8 @@ update_dma_running_mode (void)
                           top->mode == 0 &&
                           top->v.m0.cc);
   
-  // Update PSX_NextEventCC
-  tmp= PSX_dma_next_event_cc ();
-  if ( tmp != -1 )
-    {
-      tmp+= PSX_Clock;
-      if ( tmp < PSX_NextEventCC )
-        PSX_NextEventCC= tmp;
-    }
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_DMA, PSX_dma_next_event_cc () );
 
   // Take control of the bus.
   if ( top==NULL || _timing.waiting_event ) // El timing és sempre mode 0 chop.
@@ -520,6 +532,7 @@ transfer_data (
   uint32_t word;
 
   
+  PSX_COUNT ( dma_words[chn->id] );
   if ( chn->toram )
     {
       word= chn->read ();
@@ -917,6 +930,89 @@ PSX_dma_init (
 } /* end PSX_dma_init */
 
 
+void
+PSX_dma_state_save (
+                    PSX_State *st
+                    )
+{
+
+  channel_t chn;
+  int n,id;
+  
+
+  // Canals. Els callbacks no són estat.
+  for ( n= 0; n < NUM_CHANS; ++n )
+    {
+      chn= _chans[n];
+      chn.sync= NULL;
+      chn.write= NULL;
+      chn.read= NULL;
+      PSX_STATE_WRITE ( st, chn );
+    }
+
+  // Actius i actual com a índexs.
+  PSX_STATE_WRITE ( st, _actives.N );
+  for ( n= 0; n < _actives.N; ++n )
+    PSX_STATE_WRITE ( st, _actives.v[n]->id );
+  id= _current_chn!=NULL ? _current_chn->id : -1;
+  PSX_STATE_WRITE ( st, id );
+
+  // Altres.
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _dpcr );
+  PSX_STATE_WRITE ( st, _dicr );
+  
+} // end PSX_dma_state_save
+
+
+void
+PSX_dma_state_load (
+                    PSX_State *st
+                    )
+{
+
+  channel_t chn;
+  int n,id;
+  
+
+  // Canals.
+  for ( n= 0; n < NUM_CHANS; ++n )
+    {
+      PSX_STATE_READ ( st, chn );
+      chn.sync= _chans[n].sync;
+      chn.write= _chans[n].write;
+      chn.read= _chans[n].read;
+      _chans[n]= chn;
+    }
+
+  // Actius i actual.
+  PSX_STATE_READ ( st, _actives.N );
+  if ( _actives.N < 0 || _actives.N > NUM_CHANS ) goto error;
+  for ( n= 0; n < _actives.N; ++n )
+    {
+      PSX_STATE_READ ( st, id );
+      if ( id < 0 || id >= NUM_CHANS ) goto error;
+      _actives.v[n]= &(_chans[id]);
+    }
+  PSX_STATE_READ ( st, id );
+  if ( id < -1 || id >= NUM_CHANS ) goto error;
+  _current_chn= id!=-1 ? &(_chans[id]) : NULL;
+
+  // Altres.
+  PSX_STATE_READ ( st, _timing );
+  PSX_STATE_READ ( st, _dpcr );
+  PSX_STATE_READ ( st, _dicr );
+
+  return;
+  
+ error:
+  _actives.N= 0;
+  _current_chn= NULL;
+  st->error= true;
+  
+} // end PSX_dma_state_load
+
+
 int
 PSX_dma_run (void)
 {
@@ -999,11 +1095,20 @@ PSX_dma_run_cc (
 
 
 void
-PSX_dma_end_iter (void)
+PSX_dma_clock (void)
 {
 
   if ( _timing.waiting_event )
     clock ();
+  
+} // end PSX_dma_clock
+
+
+void
+PSX_dma_end_iter (void)
+{
+
+  PSX_dma_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_dma_end_iter
@@ -0,0 +1,690 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  exe.c - Càrrega d'executables PS-X EXE i arrancada ràpida des del
+ *          disc.
+ *
+ */
+/*
+ * NOTA: Per a arrancar ràpid es deixa que la BIOS inicialitze el
+ * kernel i, quan va a executar el shell (80030000h), en compte de
+ * mostrar la intro es fa el mateix que faria el shell: es llig el
+ * SYSTEM.CNF del disc (sistema de fitxers ISO9660), es carrega
+ * l'executable de BOOT i es salta al seu punt d'entrada. Si alguna
+ * cosa falla es continua amb el shell normal.
+ */
+
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define HEADER_SIZE 0x800
+
+#define SEC_DATA_SIZE 2048
+
+#define MAX_EXE_SIZE (HEADER_SIZE+0x200000)
+
+#define MAX_CNF_SIZE 4096
+
+#define MAX_PATH_LEN 256
+
+// Valor per defecte de STACK en el SYSTEM.CNF.
+#define DEFAULT_STACK 0x801FFF00
+
+#define BCD2DEC(BYTE) (((BYTE)>>4)*10 + ((BYTE)&0xF))
+
+#define RD32(P)                                                 \
+  ((uint32_t) (P)[0] | ((uint32_t) (P)[1]<<8) |                 \
+   ((uint32_t) (P)[2]<<16) | ((uint32_t) (P)[3]<<24))
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+// Entrada d'un directori ISO9660.
+typedef struct
+{
+  uint32_t lba;
+  uint32_t size;
+  bool     is_dir;
+} entry_t;
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  // Callbacks.
+  PSX_Warning *_warning;
+  void *_udata;
+
+  // Arrancada.
+  struct
+  {
+    bool     disc;  // Arrancar l'executable del disc.
+    bool     shell; // La BIOS ja ha arribat al shell.
+    uint8_t *exe;   // Executable pendent de carregar (o NULL).
+    size_t   size;
+  } _boot;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, EXE );
+
+#define STATE PSX_CTX_STATE ( state_t, EXE )
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _boot (STATE._boot)
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+/* Executables ****************************************************************/
+static bool
+check_header (
+              const uint8_t *exe,
+              const size_t   size
+              )
+{
+
+  PSX_MemMap map;
+  uint32_t t_addr,t_size;
+
+
+  if ( size < HEADER_SIZE || memcmp ( exe, "PS-X EXE", 8 ) ) return false;
+  t_addr= RD32 ( &exe[0x18] )&0x1FFFFFFF;
+  t_size= RD32 ( &exe[0x1C] );
+  if ( t_size > size-HEADER_SIZE ) return false;
+  PSX_mem_get_map ( &map );
+
+  return t_addr < map.ram.end_ram && t_size <= map.ram.end_ram-t_addr;
+
+} // end check_header
+
+
+// Escriu en memòria física. Si DATA és NULL escriu zeros.
+static void
+write_ram (
+           const uint32_t  addr,
+           const uint8_t  *data,
+           const uint32_t  size
+           )
+{
+
+  uint32_t n,a,word;
+  int sh;
+
+
+  n= 0;
+  while ( n < size )
+    {
+      a= addr+n;
+      if ( (a&0x3) == 0 && size-n >= 4 )
+        {
+          PSX_mem_write ( a, data!=NULL ? RD32 ( &data[n] ) : 0 );
+          n+= 4;
+        }
+      else
+        {
+          PSX_mem_read ( a&~0x3, &word );
+          sh= (a&0x3)*8;
+          word&= ~(0xFFu<<sh);
+          if ( data != NULL ) word|= ((uint32_t) data[n])<<sh;
+          PSX_mem_write ( a&~0x3, word );
+          ++n;
+        }
+    }
+
+} // end write_ram
+
+
+// EXE ha de tindre una capçalera vàlida.
+static void
+load_exe (
+          const uint8_t  *exe,
+          const uint32_t  stack
+          )
+{
+
+  PSX_MemMap map;
+  uint32_t b_addr,b_size,s_addr,sp;
+
+
+  // Codi i dades.
+  write_ram ( RD32 ( &exe[0x18] )&0x1FFFFFFF, &exe[HEADER_SIZE],
+              RD32 ( &exe[0x1C] ) );
+
+  // BSS.
+  b_addr= RD32 ( &exe[0x28] )&0x1FFFFFFF;
+  b_size= RD32 ( &exe[0x2C] );
+  PSX_mem_get_map ( &map );
+  if ( b_size != 0 )
+    {
+      if ( b_addr < map.ram.end_ram && b_size <= map.ram.end_ram-b_addr )
+        write_ram ( b_addr, NULL, b_size );
+      else
+        _warning ( _udata,
+                   "EXE: la secció BSS (%08X, %u bytes) no està en RAM",
+                   b_addr, b_size );
+    }
+
+  // Registres.
+  s_addr= RD32 ( &exe[0x30] );
+  sp= s_addr!=0 ? s_addr + RD32 ( &exe[0x34] ) : stack;
+  PSX_cpu_regs.gpr[28].v= RD32 ( &exe[0x14] );
+  PSX_cpu_regs.gpr[29].v= sp;
+  PSX_cpu_regs.gpr[30].v= sp;
+  PSX_cpu_jump ( RD32 ( &exe[0x10] ) );
+
+} // end load_exe
+
+
+/* Disc ***********************************************************************/
+static bool
+read_next_sector (
+        	  CD_Disc *disc,
+        	  uint8_t  data[SEC_DATA_SIZE]
+        	  )
+{
+
+  uint8_t buf[CD_SEC_SIZE];
+  bool audio;
+
+
+  if ( !CD_disc_read ( disc, buf, &audio, true ) || audio ) return false;
+  switch ( buf[0xF] ) // Mode
+    {
+    case 0x1: memcpy ( data, &buf[0x10], SEC_DATA_SIZE ); break;
+    case 0x2: memcpy ( data, &buf[0x18], SEC_DATA_SIZE ); break;
+    default: return false;
+    }
+
+  return true;
+
+} // end read_next_sector
+
+
+static bool
+seek (
+      CD_Disc        *disc,
+      const uint32_t  lba
+      )
+{
+
+  uint32_t pos;
+
+
+  pos= lba + 150; // 2 segons de pregap.
+
+  return CD_disc_seek ( disc, pos/(60*75), (pos/75)%60, pos%75 );
+
+} // end seek
+
+
+static bool
+read_file (
+           CD_Disc        *disc,
+           const entry_t  *e,
+           uint8_t        *dst,
+           const uint32_t  size
+           )
+{
+
+  uint8_t sec[SEC_DATA_SIZE];
+  uint32_t n,len;
+
+
+  if ( !seek ( disc, e->lba ) ) return false;
+  for ( n= 0; n < size; n+= len )
+    {
+      if ( !read_next_sector ( disc, sec ) ) return false;
+      len= size-n < SEC_DATA_SIZE ? size-n : SEC_DATA_SIZE;
+      memcpy ( &dst[n], sec, len );
+    }
+
+  return true;
+
+} // end read_file
+
+
+// Compara noms de fitxer sense tindre en compte majúscules, la
+// versió (";1") ni un punt final.
+static bool
+name_eq (
+         const char   *a,
+         size_t        alen,
+         const char   *b,
+         size_t        blen
+         )
+{
+
+  size_t n;
+
+
+  for ( n= 0; n < alen && a[n] != ';'; ++n );
+  alen= n;
+  if ( alen > 0 && a[alen-1] == '.' ) --alen;
+  for ( n= 0; n < blen && b[n] != ';'; ++n );
+  blen= n;
+  if ( blen > 0 && b[blen-1] == '.' ) --blen;
+  if ( alen != blen ) return false;
+  for ( n= 0; n < alen; ++n )
+    if ( toupper ( (unsigned char) a[n] ) != toupper ( (unsigned char) b[n] ) )
+      return false;
+
+  return true;
+
+} // end name_eq
+
+
+static bool
+find_entry (
+            CD_Disc       *disc,
+            const entry_t *dir,
+            const char    *name,
+            const size_t   len,
+            entry_t       *ret
+            )
+{
+
+  uint8_t sec[SEC_DATA_SIZE];
+  const uint8_t *rec;
+  uint32_t n,nsecs,off;
+
+
+  nsecs= (dir->size+SEC_DATA_SIZE-1)/SEC_DATA_SIZE;
+  if ( !seek ( disc, dir->lba ) ) return false;
+  for ( n= 0; n < nsecs; ++n )
+    {
+      if ( !read_next_sector ( disc, sec ) ) return false;
+      off= 0;
+      // Els registres no creuen sectors, un 0 indica que la resta del
+      // sector està buida.
+      while ( off+33 <= SEC_DATA_SIZE && sec[off] != 0 )
+        {
+          rec= &sec[off];
+          if ( rec[0] < 33 || off+rec[0] > SEC_DATA_SIZE ||
+               33+rec[32] > rec[0] )
+            break;
+          if ( name_eq ( (const char *) &rec[33], rec[32], name, len ) )
+            {
+              ret->lba= RD32 ( &rec[2] );
+              ret->size= RD32 ( &rec[10] );
+              ret->is_dir= (rec[25]&0x02)!=0;
+              return true;
+            }
+          off+= rec[0];
+        }
+    }
+
+  return false;
+
+} // end find_entry
+
+
+// PATH és relatiu a ROOT, els components poden separar-se amb '\' o
+// '/'.
+static bool
+find_path (
+           CD_Disc       *disc,
+           const entry_t *root,
+           const char    *path,
+           entry_t       *ret
+           )
+{
+
+  entry_t dir;
+  size_t len;
+
+
+  dir= *root;
+  for (;;)
+    {
+      while ( *path == '\\' || *path == '/' ) ++path;
+      for ( len= 0; path[len] != '\0' && path[len] != '\\' &&
+              path[len] != '/'; ++len );
+      if ( len == 0 ) return false;
+      if ( !dir.is_dir || !find_entry ( disc, &dir, path, len, &dir ) )
+        return false;
+      path+= len;
+      while ( *path == '\\' || *path == '/' ) ++path;
+      if ( *path == '\0' ) break;
+    }
+  *ret= dir;
+
+  return true;
+
+} // end find_path
+
+
+// Llig BOOT i STACK. Torna fals si no hi ha BOOT.
+static bool
+parse_cnf (
+           const char *cnf,
+           char        path[MAX_PATH_LEN],
+           uint32_t   *stack
+           )
+{
+
+  const char *key,*val;
+  size_t klen,vlen;
+  bool boot;
+
+
+  boot= false;
+  while ( *cnf != '\0' )
+    {
+
+      // Clau.
+      while ( *cnf == ' ' || *cnf == '\t' || *cnf == '\r' || *cnf == '\n' )
+        ++cnf;
+      key= cnf;
+      while ( *cnf != '\0' && *cnf != '=' && *cnf != ' ' && *cnf != '\t' &&
+              *cnf != '\r' && *cnf != '\n' )
+        ++cnf;
+      klen= cnf-key;
+
+      // Valor.
+      while ( *cnf == ' ' || *cnf == '\t' || *cnf == '=' ) ++cnf;
+      val= cnf;
+      while ( *cnf != '\0' && *cnf != ' ' && *cnf != '\t' &&
+              *cnf != '\r' && *cnf != '\n' )
+        ++cnf;
+      vlen= cnf-val;
+
+      // Processa.
+      if ( klen == 4 && !strncmp ( key, "BOOT", 4 ) )
+        {
+          if ( vlen >= 6 && name_eq ( val, 6, "cdrom:", 6 ) )
+            { val+= 6; vlen-= 6; }
+          if ( vlen > 0 && vlen < MAX_PATH_LEN )
+            {
+              memcpy ( path, val, vlen );
+              path[vlen]= '\0';
+              boot= true;
+            }
+        }
+      else if ( klen == 5 && !strncmp ( key, "STACK", 5 ) && vlen > 0 )
+        *stack= (uint32_t) strtoul ( val, NULL, 16 );
+
+      // Bota la resta de la línia.
+      while ( *cnf != '\0' && *cnf != '\n' ) ++cnf;
+
+    }
+
+  return boot;
+
+} // end parse_cnf
+
+
+static bool
+boot_disc (void)
+{
+
+  CD_Disc *disc;
+  CD_Position pos;
+  uint8_t sec[SEC_DATA_SIZE],*exe;
+  char cnf[MAX_CNF_SIZE+1],path[MAX_PATH_LEN];
+  entry_t root,e;
+  uint32_t stack,size;
+  bool ret;
+
+
+  disc= PSX_cd_get_disc ();
+  if ( disc == NULL ) return false;
+  pos= CD_disc_tell ( disc );
+  ret= false;
+  exe= NULL;
+
+  // Descriptor de volum primari.
+  if ( !seek ( disc, 16 ) || !read_next_sector ( disc, sec ) ||
+       sec[0] != 0x01 || memcmp ( &sec[1], "CD001", 5 ) )
+    {
+      _warning ( _udata, "EXE: el disc no té un sistema de fitxers ISO9660" );
+      goto end;
+    }
+  root.lba= RD32 ( &sec[156+2] );
+  root.size= RD32 ( &sec[156+10] );
+  root.is_dir= true;
+
+  // SYSTEM.CNF. Si no n'hi ha la BIOS prova amb PSX.EXE.
+  stack= DEFAULT_STACK;
+  strcpy ( path, "PSX.EXE;1" );
+  if ( find_path ( disc, &root, "SYSTEM.CNF;1", &e ) && !e.is_dir )
+    {
+      size= e.size < MAX_CNF_SIZE ? e.size : MAX_CNF_SIZE;
+      if ( !read_file ( disc, &e, (uint8_t *) cnf, size ) )
+        {
+          _warning ( _udata, "EXE: no s'ha pogut llegir SYSTEM.CNF" );
+          goto end;
+        }
+      cnf[size]= '\0';
+      if ( !parse_cnf ( cnf, path, &stack ) )
+        {
+          _warning ( _udata, "EXE: SYSTEM.CNF no conté BOOT" );
+          goto end;
+        }
+    }
+
+  // Executable.
+  if ( !find_path ( disc, &root, path, &e ) || e.is_dir )
+    {
+      _warning ( _udata, "EXE: no s'ha trobat '%s' en el disc", path );
+      goto end;
+    }
+  if ( e.size > MAX_EXE_SIZE )
+    {
+      _warning ( _udata, "EXE: '%s' és massa gran (%u bytes)", path, e.size );
+      goto end;
+    }
+  exe= (uint8_t *) malloc ( e.size );
+  if ( exe == NULL )
+    {
+      fprintf ( stderr, "[EE] [PSX] cannot allocate memory\n" );
+      exit ( EXIT_FAILURE );
+    }
+  if ( !read_file ( disc, &e, exe, e.size ) )
+    {
+      _warning ( _udata, "EXE: no s'ha pogut llegir '%s'", path );
+      goto end;
+    }
+  if ( !check_header ( exe, e.size ) )
+    {
+      _warning ( _udata, "EXE: '%s' no és un PS-X EXE vàlid", path );
+      goto end;
+    }
+  load_exe ( exe, stack );
+  ret= true;
+
+ end:
+  free ( exe );
+  CD_disc_seek ( disc, BCD2DEC ( pos.mm ), BCD2DEC ( pos.ss ),
+        	 BCD2DEC ( pos.sec ) );
+
+  return ret;
+
+} // end boot_disc
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+void
+PSX_exe_init (
+              const bool   boot_disc,
+              PSX_Warning *warning,
+              void        *udata
+              )
+{
+
+  // Callbacks.
+  _warning= warning;
+  _udata= udata;
+
+  // Arrancada.
+  _boot.disc= boot_disc;
+  free ( _boot.exe );
+  _boot.exe= NULL;
+  _boot.size= 0;
+  PSX_exe_reset ();
+
+} // end PSX_exe_init
+
+
+void
+PSX_exe_close (void)
+{
+
+  free ( _boot.exe );
+  _boot.exe= NULL;
+  _boot.size= 0;
+  
+} // end PSX_exe_close
+
+
+void
+PSX_exe_state_save (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_WRITE ( st, _boot.shell );
+  PSX_STATE_WRITE ( st, _boot.size );
+  if ( _boot.exe != NULL )
+    PSX_state_write ( st, _boot.exe, _boot.size );
+
+} // end PSX_exe_state_save
+
+
+void
+PSX_exe_state_load (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_READ ( st, _boot.shell );
+  free ( _boot.exe );
+  _boot.exe= NULL;
+  PSX_STATE_READ ( st, _boot.size );
+  if ( st->error || _boot.size == 0 ) { _boot.size= 0; return; }
+  if ( _boot.size > st->size-st->pos ) goto error;
+  _boot.exe= (uint8_t *) malloc ( _boot.size );
+  if ( _boot.exe == NULL )
+    {
+      fprintf ( stderr, "[EE] [PSX] cannot allocate memory\n" );
+      exit ( EXIT_FAILURE );
+    }
+  PSX_state_read ( st, _boot.exe, _boot.size );
+  if ( st->error ) goto error;
+
+  return;
+  
+ error:
+  free ( _boot.exe );
+  _boot.exe= NULL;
+  _boot.size= 0;
+  st->error= true;
+  
+} // end PSX_exe_state_load
+
+
+void
+PSX_exe_reset (void)
+{
+
+  // NOTA!! El ganxo sempre s'activa per saber quan el kernel ja està
+  // inicialitzat. Es desactiva sol al arribar al shell.
+  _boot.shell= false;
+  PSX_cpu_set_shell_hook ( true );
+
+} // end PSX_exe_reset
+
+
+bool
+PSX_exe_shell (void)
+{
+
+  _boot.shell= true;
+  if ( _boot.exe != NULL )
+    {
+      load_exe ( _boot.exe, DEFAULT_STACK );
+      free ( _boot.exe );
+      _boot.exe= NULL;
+      _boot.size= 0;
+      return true;
+    }
+  else if ( _boot.disc ) return boot_disc ();
+  else return false;
+
+} // end PSX_exe_shell
+
+
+bool
+PSX_load_exe (
+              const uint8_t *exe,
+              const size_t   size
+              )
+{
+
+  if ( !check_header ( exe, size ) ) return false;
+  if ( _boot.shell ) load_exe ( exe, DEFAULT_STACK );
+  else
+    {
+      free ( _boot.exe );
+      _boot.exe= (uint8_t *) malloc ( size );
+      if ( _boot.exe == NULL )
+        {
+          fprintf ( stderr, "[EE] [PSX] cannot allocate memory\n" );
+          exit ( EXIT_FAILURE );
+        }
+      memcpy ( _boot.exe, exe, size );
+      _boot.size= size;
+    }
+
+  return true;
+
+} // end PSX_load_exe
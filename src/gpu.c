@@ -104,6 +104,16 @@
       _renderer->lock ( _renderer, _fb );        \
     }
 
+// El mètode vram_written és opcional.
+#define VRAM_WRITTEN(X,Y,WIDTH,HEIGHT)        			\
+  if ( _renderer->vram_written != NULL )        		\
+    _renderer->vram_written ( _renderer, (X), (Y), (WIDTH), (HEIGHT) )
+
+// Comptadors de primitives (vore PSX_get_counters).
+#define COUNT_PRIM(NAME,NPIXELS)        		\
+  PSX_COUNT ( gpu_prims[(NAME)] );        		\
+  PSX_COUNT_N ( gpu_pixels, (NPIXELS) )
+
 #define TORGB15b(R,G,B)                         \
   (((uint16_t) ((R)>>3)) |                      \
    (((uint16_t) ((G)>>3))<<5) |                 \
@@ -225,166 +235,217 @@ static const double RENDER_CC_CORRECTION= (11.0/7.0)/2.0;
 /* ESTAT */
 /*********/
 
-/* Callbacks. */
-static PSX_Renderer *_renderer;
-static PSX_Warning *_warning;
-static void *_udata;
+typedef struct
+{
 
-/* Frame buffer. */
-static uint16_t _fb[FB_WIDTH*FB_HEIGHT];
-static bool _renderer_locked;
+  /* Callbacks. */
+  PSX_Renderer *_renderer;
+  PSX_Warning *_warning;
+  void *_udata;
 
-/* Display. */
-static struct
-{
+  /* Frame buffer. */
+  uint16_t _fb[FB_WIDTH*FB_HEIGHT];
+  bool _renderer_locked;
+  bool _output; // Envia els frames al renderer.
 
-  bool enabled;
-  bool irq1;
-  enum
+  /* Frameskip. */
+  struct
   {
-    TM_OFF= 0,
-    TM_FIFO= 1,
-    TM_DMA_WRITE= 2,
-    TM_DMA_READ= 3
-  }    transfer_mode; /* Mode de transferència. En realitat sols
-        		 afecta al DMA i a al status. */
-  int  x,y; /* Offset dins de fb que es dibuixa. */
-  uint32_t x1,x2; /* Horizontal display range registers. */
-  double screen_x0,screen_x1; /* Per a una tele 4:3, valors
-        			 normalitzats [0,1]. Pot ser
-        			 negatiu. */
-  uint32_t y1,y2; /* Vertical display range registers. */
-  double screen_y0,screen_y1; /* Per a una tele 4:3, valors
-        			 normalitzats [0,1]. Pot ser
-        			 negatiu. */
-  int  hres;
-  int  fb_line_width;
-  int  vres;
-  int  vres_original;
-  bool vertical_interlace;
-  int  interlace_field;
-  bool color_depth_24bit;
-  bool reverseflag;
-  int  tv_mode;
-  bool texture_disable;
-  
-} _display;
-
-/* Estat per a renderitzar. */
-static struct
-{
 
-  enum {
-    WAIT_CMD= 0,
-    WAIT_WORDS,
-    WAIT_V1_POLY_MLINE,
-    WAIT_V2_POLY_MLINE,
-    WAIT_VN_POLY_MLINE,
-    WAIT_C1_POLY_SLINE,
-    WAIT_V1_POLY_SLINE,
-    WAIT_C2_POLY_SLINE,
-    WAIT_V2_POLY_SLINE,
-    WAIT_CN_POLY_SLINE,
-    WAIT_VN_POLY_SLINE,
-    WAIT_WRITE_XY_COPY,
-    WAIT_WRITE_WIDTH_HEIGHT_COPY,
-    WAIT_WRITE_DATA_COPY,
-    WAIT_READ_XY_COPY,
-    WAIT_READ_WIDTH_HEIGHT_COPY,
-    WAIT_READ_DATA_COPY
-  }                state;
-  int              nwords; // Paraules que s'esperen per al següent cmd.
-  PSX_RendererArgs args;
-  PSX_RendererArgs def_args;
-  bool             drawing_da_enabled;
-  bool             texture_disabled;
-  int              off_x,off_y;
-  uint32_t         e2_info;
-  uint32_t         e3_info;
-  uint32_t         e4_info;
-  uint32_t         e5_info;
-  bool             is_pol4;
-  bool             is_poly;
-  int              rec_w,rec_h; /* Rectangles, fill i copy. */
-  int              min_x,max_x;
-  int              min_y,max_y;
-  bool             copy_mode_write;
-  
-} _render;
-
-
-/* Estat per a la operació copy. */
-static struct
-{
+    int           nframes; // Frames que no es mostren (0 desactivat).
+    int           count;   // Posició del frame actual dins del cicle.
+    bool          active;  // Les primitives van a 'stats'.
+    bool          output;  // El frame actual es mostra.
+    PSX_Renderer *stats;   // L'allibera PSX_gpu_close.
 
-  int x,y;
-  int r,c;
-  int end_r,end_c;
-  
-} _copy;
+  } _skip;
+  PSX_Renderer *_draw_renderer; // Renderer de les primitives.
 
+  /* Display. */
+  struct
+  {
 
-/* Gpuread. */
-static struct
-{
+    bool enabled;
+    bool irq1;
+    enum
+    {
+      TM_OFF= 0,
+      TM_FIFO= 1,
+      TM_DMA_WRITE= 2,
+      TM_DMA_READ= 3
+    }    transfer_mode; /* Mode de transferència. En realitat sols
+          		 afecta al DMA i a al status. */
+    int  x,y; /* Offset dins de fb que es dibuixa. */
+    uint32_t x1,x2; /* Horizontal display range registers. */
+    double screen_x0,screen_x1; /* Per a una tele 4:3, valors
+          			 normalitzats [0,1]. Pot ser
+          			 negatiu. */
+    uint32_t y1,y2; /* Vertical display range registers. */
+    double screen_y0,screen_y1; /* Per a una tele 4:3, valors
+          			 normalitzats [0,1]. Pot ser
+          			 negatiu. */
+    int  hres;
+    int  fb_line_width;
+    int  vres;
+    int  vres_original;
+    bool vertical_interlace;
+    int  interlace_field;
+    bool color_depth_24bit;
+    bool reverseflag;
+    int  tv_mode;
+    bool texture_disable;
+
+  } _display;
+
+  /* Estat per a renderitzar. */
+  struct
+  {
 
-  uint32_t data;
-  bool     vram_transfer;
-  
-} _read;
+    enum {
+      WAIT_CMD= 0,
+      WAIT_WORDS,
+      WAIT_V1_POLY_MLINE,
+      WAIT_V2_POLY_MLINE,
+      WAIT_VN_POLY_MLINE,
+      WAIT_C1_POLY_SLINE,
+      WAIT_V1_POLY_SLINE,
+      WAIT_C2_POLY_SLINE,
+      WAIT_V2_POLY_SLINE,
+      WAIT_CN_POLY_SLINE,
+      WAIT_VN_POLY_SLINE,
+      WAIT_WRITE_XY_COPY,
+      WAIT_WRITE_WIDTH_HEIGHT_COPY,
+      WAIT_WRITE_DATA_COPY,
+      WAIT_READ_XY_COPY,
+      WAIT_READ_WIDTH_HEIGHT_COPY,
+      WAIT_READ_DATA_COPY
+    }                state;
+    int              nwords; // Paraules que s'esperen per al següent cmd.
+    PSX_RendererArgs args;
+    PSX_RendererArgs def_args;
+    bool             drawing_da_enabled;
+    bool             texture_disabled;
+    int              off_x,off_y;
+    uint32_t         e2_info;
+    uint32_t         e3_info;
+    uint32_t         e4_info;
+    uint32_t         e5_info;
+    bool             is_pol4;
+    bool             is_poly;
+    int              rec_w,rec_h; /* Rectangles, fill i copy. */
+    int              min_x,max_x;
+    int              min_y,max_y;
+    bool             copy_mode_write;
+
+  } _render;
+
+
+  /* Estat per a la operació copy. */
+  struct
+  {
 
-// FIFO
-static struct
-{
-  uint32_t v[FIFO_SIZE];
-  int      p; // Posició.
-  int      N; // Número de paraules
-  int      nactions; // Número d'accions esperant a ser executades.
-  enum {
-    FIFO_WAIT_CMD,
-    FIFO_WAIT_POLY_MLINE,
-    FIFO_WAIT_POLY_SLINE,
-    FIFO_WAIT_READ_DATA_COPY,
-    FIFO_WAIT_WRITE_DATA_COPY
-  }        state;
-  bool     busy;
-} _fifo;
-
-/* Per a controlar els temps. Els cicles són CPU*7. */
-static struct
-{
+    int x,y;
+    int r,c;
+    int end_r,end_c;
 
-  int  cc;
-  int  cc_used;
-  bool enabled_VBlank;
-  bool enabled_HBlank;
-  bool signal_HBlank;
-  int  cctoVBlankIn;
-  int  cctoVBlankOut;
-  int  cctoHBlankIn;
-  int  cctoHBlankOut;
-  int  cctoEndFrame;
-  int  cctoEvent;
-  int  cctoIdle; // Cicles que falten per què acabe el comandament actual.
-  int  line; /* Línia actual. */
-  int  ccline; /* Cicles en la línia actual. */
-  int  ccperline; /* Depen de si és PAL o NTSC */
-  int  nlines; /* Depen de si és PAL o NTSC */
-  bool update_timing_event;
-  
-} _timing;
-
-// DMA sync pendent.
-static struct
-{
-  bool request;
-} _dma_sync;
+  } _copy;
+
+
+  /* Gpuread. */
+  struct
+  {
+
+    uint32_t data;
+    bool     vram_transfer;
+
+  } _read;
 
-// Callbacks per als commandaments.
-static PSX_GPUCmdTrace *_gpu_cmd_trace;
-static void (*_gp0_cmd) (const uint32_t cmd);
-static void (*_gp1_cmd) (const uint32_t cmd);
-static void (*_run_fifo_cmd)(void);
+  // FIFO
+  struct
+  {
+    uint32_t v[FIFO_SIZE];
+    int      p; // Posició.
+    int      N; // Número de paraules
+    int      nactions; // Número d'accions esperant a ser executades.
+    enum {
+      FIFO_WAIT_CMD,
+      FIFO_WAIT_POLY_MLINE,
+      FIFO_WAIT_POLY_SLINE,
+      FIFO_WAIT_READ_DATA_COPY,
+      FIFO_WAIT_WRITE_DATA_COPY
+    }        state;
+    bool     busy;
+  } _fifo;
+
+  /* Per a controlar els temps. Els cicles són CPU*7. */
+  struct
+  {
+
+    int  cc;
+    int  cc_used;
+    bool enabled_VBlank;
+    bool enabled_HBlank;
+    bool signal_HBlank;
+    int  cctoVBlankIn;
+    int  cctoVBlankOut;
+    int  cctoHBlankIn;
+    int  cctoHBlankOut;
+    int  cctoEndFrame;
+    int  cctoEvent;
+    int  cctoIdle; // Cicles que falten per què acabe el comandament actual.
+    int  line; /* Línia actual. */
+    int  ccline; /* Cicles en la línia actual. */
+    int  ccperline; /* Depen de si és PAL o NTSC */
+    int  nlines; /* Depen de si és PAL o NTSC */
+    bool update_timing_event;
+
+  } _timing;
+
+  // DMA sync pendent.
+  struct
+  {
+    bool request;
+  } _dma_sync;
+
+  // Callbacks per als commandaments.
+  PSX_GPUCmdTrace *_gpu_cmd_trace;
+  void (*_gp0_cmd) (const uint32_t cmd);
+  void (*_gp1_cmd) (const uint32_t cmd);
+  void (*_run_fifo_cmd)(void);
+
+  // Comandaments en curs de les funcions de traça.
+  struct
+  {
+    PSX_GPUCmd fifo;
+    PSX_GPUCmd gp0;
+    PSX_GPUCmd gp1;
+  } _trace_cmd;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, GPU );
+
+#define STATE PSX_CTX_STATE ( state_t, GPU )
+#define _renderer (STATE._renderer)
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _fb (STATE._fb)
+#define _renderer_locked (STATE._renderer_locked)
+#define _output (STATE._output)
+#define _skip (STATE._skip)
+#define _draw_renderer (STATE._draw_renderer)
+#define _display (STATE._display)
+#define _render (STATE._render)
+#define _copy (STATE._copy)
+#define _read (STATE._read)
+#define _fifo (STATE._fifo)
+#define _timing (STATE._timing)
+#define _dma_sync (STATE._dma_sync)
+#define _gpu_cmd_trace (STATE._gpu_cmd_trace)
+#define _gp0_cmd (STATE._gp0_cmd)
+#define _gp1_cmd (STATE._gp1_cmd)
+#define _run_fifo_cmd (STATE._run_fifo_cmd)
+#define _trace_cmd (STATE._trace_cmd)
 
 
 
@@ -475,9 +536,6 @@ static void
 update_timing_event (void)
 {
 
-  int tmp;
-
-
   if ( !_timing.update_timing_event ) return;
   
   // Actualitza cctoEvent
@@ -502,14 +560,8 @@ update_timing_event (void)
   else if ( !_timing.cctoEvent || _timing.cctoEndFrame < _timing.cctoEvent )
     _timing.cctoEvent= _timing.cctoEndFrame;
   
-  // Update PSX_NextEventCC
-  tmp= PSX_gpu_next_event_cc ();
-  if ( tmp != -1 )
-    {
-      tmp+= PSX_Clock;
-      if ( tmp < PSX_NextEventCC )
-        PSX_NextEventCC= tmp;
-    }
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_GPU, PSX_gpu_next_event_cc () );
 
 } // end update_timing_event
 
@@ -646,6 +698,39 @@ update_timing (void)
 } // end update_timing
 
 
+static void
+skip_update (void)
+{
+
+  _skip.output= _skip.nframes == 0 || _skip.count == _skip.nframes;
+  _skip.active= _skip.nframes > 0 && _skip.count < _skip.nframes-1;
+  _draw_renderer= _skip.active ? _skip.stats : _renderer;
+  
+} // end skip_update
+
+
+// Abans de llegir o copiar la VRAM.
+static void
+skip_stop (void)
+{
+
+  _skip.active= false;
+  _draw_renderer= _renderer;
+  
+} // end skip_stop
+
+
+static void
+skip_next_frame (void)
+{
+
+  if ( _skip.nframes == 0 ) return;
+  _skip.count= _skip.count == _skip.nframes ? 0 : _skip.count+1;
+  skip_update ();
+  
+} // end skip_next_frame
+
+
 static void
 run (
      const int line_b,
@@ -656,6 +741,7 @@ run (
 {
 
   PSX_FrameGeometry g;
+  bool drawn;
   
   
   // NOTA!! De moment ací sols m'encarregue de generar el frame.
@@ -667,7 +753,9 @@ run (
       if ( (uint32_t) line_e >= _display.y2 )
         {
           // NOTA!!! Quan siga 480 vaig a mostrar tots els frames !!!!!
-          if ( /*_display.vres == VRES_240 || !_timing.even_frame*/ true )
+          drawn= /*_display.vres == VRES_240 || !_timing.even_frame*/
+            _output && _skip.output;
+          if ( drawn )
             {
               UNLOCK_RENDERER;
               g.x= _display.x; g.y= _display.y;
@@ -680,6 +768,8 @@ run (
               g.d_y0= _display.screen_y0; g.d_y1= _display.screen_y1;
               _renderer->draw ( _renderer, &g );
             }
+          PSX_end_frame ( drawn );
+          skip_next_frame ();
           if ( _display.vertical_interlace ) _display.interlace_field^= 1;
           else                               _display.interlace_field= 0;
         }
@@ -699,6 +789,7 @@ clock (void)
   bool update;
   
 
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_GPU );
   cc= PSX_Clock-_timing.cc_used;
   if ( cc > 0 ) { _timing.cc+= 11*cc; _timing.cc_used+= cc; }
   
@@ -758,6 +849,7 @@ clock (void)
           PSX_int_interruption ( PSX_INT_VBLANK, true );
           PSX_int_interruption ( PSX_INT_VBLANK, false ); // Simule puls.
           PSX_timers_vblank_in ();
+          PSX_vblank_in ();
         }
       if ( _timing.cctoVBlankOut <= 0 )
         {
@@ -789,6 +881,7 @@ clock (void)
     update_timing_end_frame ();
   
   update_timing_event ();
+  PSX_PROFILE_END;
   
 } /* end clock */
 
@@ -1347,8 +1440,12 @@ draw_mpol (void)
   _render.args.texture_mode= PSX_TEX_NONE;
   _render.args.dithering= false; // No afecta polígons mono !!!!
   UNLOCK_RENDERER;
-  if ( _render.is_pol4 ) _renderer->pol4 ( _renderer, &(_render.args), &stats );
-  else                   _renderer->pol3 ( _renderer, &(_render.args), &stats );
+  if ( _render.is_pol4 )
+    _draw_renderer->pol4 ( _draw_renderer, &(_render.args), &stats );
+  else
+    _draw_renderer->pol3 ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( _render.is_pol4 ? PSX_GP0_POL4 : PSX_GP0_POL3,
+               stats.npixels );
 
   // Timing.
   calc_timing_draw_pol ( &stats        );
@@ -1382,8 +1479,12 @@ draw_tpol (void)
     _render.args.texture_mode= _render.def_args.texture_mode;
   */
   UNLOCK_RENDERER;
-  if ( _render.is_pol4 ) _renderer->pol4 ( _renderer, &(_render.args), &stats );
-  else                   _renderer->pol3 ( _renderer, &(_render.args), &stats );
+  if ( _render.is_pol4 )
+    _draw_renderer->pol4 ( _draw_renderer, &(_render.args), &stats );
+  else
+    _draw_renderer->pol3 ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( _render.is_pol4 ? PSX_GP0_POL4 : PSX_GP0_POL3,
+               stats.npixels );
 
   // Timing.
   calc_timing_draw_pol ( &stats        );
@@ -1417,8 +1518,12 @@ draw_stpol (void)
     _render.args.texture_mode= _render.def_args.texture_mode;
   */
   UNLOCK_RENDERER;
-  if ( _render.is_pol4 ) _renderer->pol4 ( _renderer, &(_render.args), &stats );
-  else                   _renderer->pol3 ( _renderer, &(_render.args), &stats );
+  if ( _render.is_pol4 )
+    _draw_renderer->pol4 ( _draw_renderer, &(_render.args), &stats );
+  else
+    _draw_renderer->pol3 ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( _render.is_pol4 ? PSX_GP0_POL4 : PSX_GP0_POL3,
+               stats.npixels );
 
   // Timing.
   calc_timing_draw_pol ( &stats        );
@@ -1441,8 +1546,12 @@ draw_spol (void)
   _render.args.texture_mode= PSX_TEX_NONE;
   _render.args.dithering= _render.def_args.dithering;
   UNLOCK_RENDERER;
-  if ( _render.is_pol4 ) _renderer->pol4 ( _renderer, &(_render.args), &stats );
-  else                   _renderer->pol3 ( _renderer, &(_render.args), &stats );
+  if ( _render.is_pol4 )
+    _draw_renderer->pol4 ( _draw_renderer, &(_render.args), &stats );
+  else
+    _draw_renderer->pol3 ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( _render.is_pol4 ? PSX_GP0_POL4 : PSX_GP0_POL3,
+               stats.npixels );
 
   // Timing.
   calc_timing_draw_pol ( &stats        );
@@ -1498,7 +1607,8 @@ draw_mline (void)
   _render.args.gouraud= false;
   _render.args.dithering= _render.def_args.dithering;
   UNLOCK_RENDERER;
-  _renderer->line ( _renderer, &(_render.args), &stats );
+  _draw_renderer->line ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( PSX_GP0_LINE, stats.npixels );
 
   // Timing.
   calc_timing_draw_line ( &stats );
@@ -1520,7 +1630,8 @@ draw_sline (void)
   _render.args.gouraud= true;
   _render.args.dithering= _render.def_args.dithering;
   UNLOCK_RENDERER;
-  _renderer->line ( _renderer, &(_render.args), &stats );
+  _draw_renderer->line ( _draw_renderer, &(_render.args), &stats );
+  COUNT_PRIM ( PSX_GP0_LINE, stats.npixels );
 
   // Timing.
   calc_timing_draw_line ( &stats );
@@ -1571,8 +1682,9 @@ draw_mrec (void)
   _render.args.texture_mode= PSX_TEX_NONE;
   _render.args.dithering= false;
   UNLOCK_RENDERER;
-  _renderer->rect ( _renderer, &(_render.args), _render.rec_w, _render.rec_h,
-        	    &stats );
+  _draw_renderer->rect ( _draw_renderer, &(_render.args),
+        		_render.rec_w, _render.rec_h, &stats );
+  COUNT_PRIM ( PSX_GP0_RECT, stats.npixels );
 
   // Timing.
   calc_timing_draw_rec ( &stats );
@@ -1602,8 +1714,9 @@ draw_trec (void)
   else
     _render.args.texture_mode= _render.def_args.texture_mode;
   UNLOCK_RENDERER;
-  _renderer->rect ( _renderer, &(_render.args), _render.rec_w, _render.rec_h,
-        	    &stats );
+  _draw_renderer->rect ( _draw_renderer, &(_render.args),
+        		_render.rec_w, _render.rec_h, &stats );
+  COUNT_PRIM ( PSX_GP0_RECT, stats.npixels );
 
   // Timing.
   calc_timing_draw_rec ( &stats );
@@ -1633,6 +1746,8 @@ fill_rec (void)
       for ( c= x; c < end_x; ++c )
         line[c&0x3FF]= color;
     }
+  VRAM_WRITTEN ( x&0x3FF, y&0x1FF, width, height );
+  COUNT_PRIM ( PSX_GP0_FILL, width*height );
 
   // Timing. Aparentment dibuixa 16 pixels de colp, hi han també unes
   // constants rares que no sé d'in ixen.
@@ -1665,6 +1780,7 @@ copy_vram2vram (void)
   npixels= 0;
   
   // Copia.
+  skip_stop ();
   LOCK_RENDERER;
   for ( r0= y0, r1= y1; r0 < end_y0; ++r0, ++r1 )
     {
@@ -1680,6 +1796,9 @@ copy_vram2vram (void)
           ++npixels;
         }
     }
+  VRAM_WRITTEN ( x1&0x3FF, y1&0x1FF, width, height );
+  
+  COUNT_PRIM ( PSX_GP0_COPY_VRAM2VRAM, npixels );
   
   // Timing inspirat per mednafen
   //gpucc= npixels>>3;
@@ -2022,8 +2141,17 @@ run_fifo_cmd_copy (void)
     {
       _fifo.state= FIFO_WAIT_READ_DATA_COPY;
       _read.vram_transfer= true;
+      skip_stop ();
+    }
+  else
+    {
+      // Es marca tota la regió des del principi, fins que no acabe la
+      // transferència no es pot dibuixar res.
+      LOCK_RENDERER;
+      VRAM_WRITTEN ( _copy.x, _copy.y,
+                     _copy.end_c-_copy.x, _copy.end_r-_copy.y );
+      _fifo.state= FIFO_WAIT_WRITE_DATA_COPY;
     }
-  else _fifo.state= FIFO_WAIT_WRITE_DATA_COPY;
   
 } // end run_fifo_cmd_copy
 
@@ -2913,7 +3041,7 @@ run_fifo_cmd_trace (void)
 {
 
   uint32_t real_cmd;
-  static PSX_GPUCmd cmd;
+  PSX_GPUCmd *cmd= &(_trace_cmd.fifo);
   bool ready;
   
   
@@ -2926,9 +3054,9 @@ run_fifo_cmd_trace (void)
       real_cmd= FIFO_BUF(0);
       if ( real_cmd != 0x55555555 && real_cmd != 0x50005000 )
         {
-          cmd.word= PSX_GP0_POLYLINE_CONT;
-          cmd.Nv= 0;
-          set_vertex_xy_trace ( 0, real_cmd, &cmd );
+          cmd->word= PSX_GP0_POLYLINE_CONT;
+          cmd->Nv= 0;
+          set_vertex_xy_trace ( 0, real_cmd, cmd );
           ready= true;
         }
       break;
@@ -2938,11 +3066,11 @@ run_fifo_cmd_trace (void)
       real_cmd= FIFO_BUF(0);
       if ( real_cmd != 0x55555555 && real_cmd != 0x50005000 )
         {
-          cmd.word= PSX_GP0_POLYLINE_CONT;
-          cmd.Nv= 0;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
+          cmd->word= PSX_GP0_POLYLINE_CONT;
+          cmd->Nv= 0;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
           real_cmd= FIFO_BUF(1);
-          set_vertex_xy_trace ( 0, real_cmd, &cmd );
+          set_vertex_xy_trace ( 0, real_cmd, cmd );
           ready= true;
         }
       break;
@@ -2955,445 +3083,445 @@ run_fifo_cmd_trace (void)
     case FIFO_WAIT_CMD:
     default:
       real_cmd= FIFO_BUF(0);
-      cmd.word= real_cmd;
-      cmd.ops= 0;
-      cmd.Nv= 0;
-      cmd.width= cmd.height= -1;
+      cmd->word= real_cmd;
+      cmd->ops= 0;
+      cmd->Nv= 0;
+      cmd->width= cmd->height= -1;
       switch ( real_cmd>>24 )
         {
         case 0x01: // ¿¿Clear Cache ?? <-- No implemente cache.
           break;
         case 0x02: // Fill Rectangle in VRAM
-          cmd.name= PSX_GP0_FILL;
-          cmd.ops|= PSX_GP_COLOR;
+          cmd->name= PSX_GP0_FILL;
+          cmd->ops|= PSX_GP_COLOR;
           real_cmd= FIFO_BUF(1);
-          cmd.v[0].x= real_cmd&0x3F0;
-          cmd.v[0].y= (real_cmd>>16)&0x1FF;
-          cmd.Nv= 1;
+          cmd->v[0].x= real_cmd&0x3F0;
+          cmd->v[0].y= (real_cmd>>16)&0x1FF;
+          cmd->Nv= 1;
           real_cmd= FIFO_BUF(2);
-          cmd.width= ((real_cmd&0x3FF)+0xF) & (~0xF);
-          cmd.height= (real_cmd>>16)&0x1FF;
+          cmd->width= ((real_cmd&0x3FF)+0xF) & (~0xF);
+          cmd->height= (real_cmd>>16)&0x1FF;
           ready= true;
           break;
         case 0x1F: // Interrupt Request (IRQ1)
-          cmd.name= PSX_GP0_IRQ1;
+          cmd->name= PSX_GP0_IRQ1;
           ready=true;
           break;
         case 0x20: // Monochrome three-point polygon, opaque
         case 0x21:
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_COLOR;
-          ready= run_fifo_cmd_mpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_COLOR;
+          ready= run_fifo_cmd_mpol_trace ( cmd );
           break;
         case 0x22: // Monochrome three-point polygon, semi-transparent
         case 0x23:
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          ready= run_fifo_cmd_mpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          ready= run_fifo_cmd_mpol_trace ( cmd );
           break;
         case 0x24: // Textured three-point polygon, opaque, texture-blending
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x25: // Textured three-point polygon, opaque, raw-texture
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x26: // Textured three-point polygon, semi-transparent,
           // texture-blending
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x27: // Textured three-point polygon, semi-transparent,
           // raw-texture
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x28: // Monochrome four-point polygon, opaque
         case 0x29:
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_COLOR;
-          ready= run_fifo_cmd_mpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_COLOR;
+          ready= run_fifo_cmd_mpol_trace ( cmd );
           break;
         case 0x2A: // Monochrome four-point polygon, semi-transparent
         case 0x2B:
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          ready= run_fifo_cmd_mpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          ready= run_fifo_cmd_mpol_trace ( cmd );
           break;
         case 0x2C: // Textured four-point polygon, opaque, texture-blending
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x2D: // Textured four-point polygon, opaque, raw-texture
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x2E: // Textured four-point polygon, semi-transparent,
         	   // texture-blending
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x2F: // Textured four-point polygon, semi-transparent,
         	   // raw-texture
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_tpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_tpol_trace ( cmd );
           break;
         case 0x30: // Shaded three-point polygon, opaque
         case 0x31:
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_spol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_spol_trace ( cmd );
           break;
         case 0x32: // Shaded three-point polygon, semi-transparent
         case 0x33:
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_spol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_spol_trace ( cmd );
           break;
         case 0x34: // Shaded Textured three-point polygon, opaque,
         	   // texture-blending
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TEXT_BLEND;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TEXT_BLEND;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x35: // Shaded Textured three-point polygon, opaque,
         	   // raw-texture ¿¿??
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_RAW_TEXT;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_RAW_TEXT;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x36: // Shaded Textured three-point polygon,
         	   // semi-transparent, texture-blending
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x37: // Shaded Textured three-point polygon,
         	   // semi-transparent, raw-texture ¿¿??
-          cmd.name= PSX_GP0_POL3;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL3;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x38: // Shaded four-point polygon, opaque
         case 0x39:
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_spol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_spol_trace ( cmd );
           break;
         case 0x3A: // Shaded four-point polygon, semi-transparent
         case 0x3B:
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_spol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_spol_trace ( cmd );
           break;
         case 0x3C: // Shaded Textured four-point polygon, opaque,
         	   // texture-blending
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TEXT_BLEND;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TEXT_BLEND;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x3D: // Shaded Textured four-point polygon, opaque,
         	   // raw-texture ¿¿??
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_RAW_TEXT;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_RAW_TEXT;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x3E: // Shaded Textured four-point polygon,
         	   // semi-transparent, texture-blending
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x3F: // Shaded Textured four-point polygon,
         	   // semi-transparent, raw-texture ¿¿??
-          cmd.name= PSX_GP0_POL4;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_stpol_trace ( &cmd );
+          cmd->name= PSX_GP0_POL4;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_stpol_trace ( cmd );
           break;
         case 0x40: // Monochrome line, opaque
         case 0x41:
-          cmd.name= PSX_GP0_LINE;
-          cmd.ops|= PSX_GP_COLOR;
-          ready= run_fifo_cmd_mline_trace ( &cmd );
+          cmd->name= PSX_GP0_LINE;
+          cmd->ops|= PSX_GP_COLOR;
+          ready= run_fifo_cmd_mline_trace ( cmd );
           break;
         case 0x42: // Monochrome line, semi-transparent
         case 0x43:
-          cmd.name= PSX_GP0_LINE;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          ready= run_fifo_cmd_mline_trace ( &cmd );
+          cmd->name= PSX_GP0_LINE;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          ready= run_fifo_cmd_mline_trace ( cmd );
           break;
 
         case 0x48: // Monochrome Poly-line, opaque
         case 0x49:
         case 0x4C:
-          cmd.name= PSX_GP0_POLYLINE;
-          cmd.ops|= PSX_GP_COLOR;
-          ready= run_fifo_cmd_mline_trace ( &cmd );
+          cmd->name= PSX_GP0_POLYLINE;
+          cmd->ops|= PSX_GP_COLOR;
+          ready= run_fifo_cmd_mline_trace ( cmd );
           break;
         case 0x4A: // Monochrome Poly-line, semi-transparent
         case 0x4B:
-          cmd.name= PSX_GP0_POLYLINE;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          ready= run_fifo_cmd_mline_trace ( &cmd );
+          cmd->name= PSX_GP0_POLYLINE;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          ready= run_fifo_cmd_mline_trace ( cmd );
           break;
 
         case 0x50: // Shaded line, opaque
         case 0x51:
         case 0x55:
-          cmd.name= PSX_GP0_LINE;
-          cmd.ops|= PSX_GP_V_COLOR;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_sline_trace ( &cmd );
+          cmd->name= PSX_GP0_LINE;
+          cmd->ops|= PSX_GP_V_COLOR;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_sline_trace ( cmd );
           break;
         case 0x52: // Shaded line, semi-transparent
         case 0x53:
-          cmd.name= PSX_GP0_LINE;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_sline_trace ( &cmd );
+          cmd->name= PSX_GP0_LINE;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_sline_trace ( cmd );
           break;
 
         case 0x58: // Shaded Poly-line, opaque
         case 0x59:
-          cmd.name= PSX_GP0_POLYLINE;
-          cmd.ops|= PSX_GP_V_COLOR;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_sline_trace ( &cmd );
+          cmd->name= PSX_GP0_POLYLINE;
+          cmd->ops|= PSX_GP_V_COLOR;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_sline_trace ( cmd );
           break;
         case 0x5A: // Shaded Poly-line, semi-transparent
         case 0x5B:
         case 0x5E:
-          cmd.name= PSX_GP0_POLYLINE;
-          cmd.ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
-          set_vertex_color_trace ( 0, real_cmd, &cmd );
-          ready= run_fifo_cmd_sline_trace ( &cmd );
+          cmd->name= PSX_GP0_POLYLINE;
+          cmd->ops|= PSX_GP_V_COLOR|PSX_GP_TRANSPARENCY;
+          set_vertex_color_trace ( 0, real_cmd, cmd );
+          ready= run_fifo_cmd_sline_trace ( cmd );
           break;
 
         case 0x60: // Monochrome Rectangle (variable size) (opaque)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x62: // Monochrome Rectangle (variable size)
                    // (semi-transparent)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x64: // Textured Rectangle, variable size, opaque,
         	   // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x65: // Textured Rectangle, variable size, opaque,
         	   // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x66: // Textured Rectangle, variable size, semi-transp,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x67: // Textured Rectangle, variable size, semi-transp,
                    // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x68: // Monochrome Rectangle (1x1) (Dot) (opaque)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x6A: // Monochrome Rectangle (1x1) (Dot)
         	   // (semi-transparent)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x6C: // Textured Rectangle, 1x1 (nonsense), opaque,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x6D: // Textured Rectangle, 1x1 (nonsense), opaque,
                    // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x6E: // Textured Rectangle, 1x1 (nonsense), semi-transp,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x6F: // Textured Rectangle, 1x1 (nonsense), semi-transp,
                    // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          cmd.width= 1;
-          cmd.height= 1;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          cmd->width= 1;
+          cmd->height= 1;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x70: // Monochrome Rectangle (8x8) (opaque)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x72: // Monochrome Rectangle (8x8) (semi-transparent)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x74: // Textured Rectangle, 8x8, opaque,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x75: // Textured Rectangle, 8x8, opaque, raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x76: // Textured Rectangle, 8x8, semi-transparent,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x77: // Textured Rectangle, 8x8, semi-transparent,
                    // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          cmd.width= 8;
-          cmd.height= 8;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          cmd->width= 8;
+          cmd->height= 8;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x78: // Monochrome Rectangle (16x16) (opaque)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x7A: // Monochrome Rectangle (16x16) (semi-transparent)
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_mrec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_mrec_trace ( cmd );
           break;
 
         case 0x7C: // Textured Rectangle, 16x16, opaque,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TEXT_BLEND;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x7D: // Textured Rectangle, 16x16, opaque, raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_RAW_TEXT;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x7E: // Textured Rectangle, 16x16, semi-transparent,
                    // texture-blending
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_TEXT_BLEND;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x7F: // Textured Rectangle, 16x16, semi-transparent,
                    // raw-texture
-          cmd.name= PSX_GP0_RECT;
-          cmd.ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
-          cmd.width= 16;
-          cmd.height= 16;
-          ready= run_fifo_cmd_trec_trace ( &cmd );
+          cmd->name= PSX_GP0_RECT;
+          cmd->ops|= PSX_GP_COLOR|PSX_GP_TRANSPARENCY|PSX_GP_RAW_TEXT;
+          cmd->width= 16;
+          cmd->height= 16;
+          ready= run_fifo_cmd_trec_trace ( cmd );
           break;
         case 0x80 ... 0x9F: // Copy Rectangle (VRAM to VRAM)
-          cmd.name= PSX_GP0_COPY_VRAM2VRAM;
+          cmd->name= PSX_GP0_COPY_VRAM2VRAM;
           ready= true;
           break;
         case 0xA0 ... 0xBF: // Copy Rectangle (CPU to VRAM)
-          cmd.name= PSX_GP0_COPY_CPU2VRAM;
-          ready= run_fifo_cmd_copy_trace ( &cmd );
+          cmd->name= PSX_GP0_COPY_CPU2VRAM;
+          ready= run_fifo_cmd_copy_trace ( cmd );
           break;
         case 0xC0 ... 0xDF: // Copy Rectangle (VRAM to CPU)
-          cmd.name= PSX_GP0_COPY_VRAM2CPU;
-          ready= run_fifo_cmd_copy_trace ( &cmd );
+          cmd->name= PSX_GP0_COPY_VRAM2CPU;
+          ready= run_fifo_cmd_copy_trace ( cmd );
           break;
-        case 0xE1: cmd.name= PSX_GP0_SET_DRAW_MODE; ready= true; break;
-        case 0xE2: cmd.name= PSX_GP0_SET_TEXT_WIN; ready= true; break;
-        case 0xE6: cmd.name= PSX_GP0_SET_MASK_BIT; ready= true; break;
+        case 0xE1: cmd->name= PSX_GP0_SET_DRAW_MODE; ready= true; break;
+        case 0xE2: cmd->name= PSX_GP0_SET_TEXT_WIN; ready= true; break;
+        case 0xE6: cmd->name= PSX_GP0_SET_MASK_BIT; ready= true; break;
         default:
-          cmd.name= PSX_GP0_UNK;
+          cmd->name= PSX_GP0_UNK;
           ready= true;
           break;
         }
       break;
       
     }
-  if ( ready ) _gpu_cmd_trace ( &cmd, _udata );
+  if ( ready ) _gpu_cmd_trace ( cmd, _udata );
   
   // Executa el comandament.
   run_fifo_cmd ();
@@ -3404,9 +3532,11 @@ run_fifo_cmd_trace (void)
 static void
 run_fifo_cmds (void)
 {
-  
+
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_GPU );
   while ( _fifo.nactions && !_fifo.busy )
     _run_fifo_cmd ();
+  PSX_PROFILE_END;
   
 } // end run_fifo_cmds
 
@@ -3845,7 +3975,7 @@ gp0_cmd_trace (
                )
 {
 
-  static PSX_GPUCmd cmd;
+  PSX_GPUCmd *cmd= &(_trace_cmd.gp0);
 
   bool ready;
   
@@ -3857,21 +3987,21 @@ gp0_cmd_trace (
       
       // Espera comandament.
     case WAIT_CMD:
-      cmd.word= real_cmd;
-      cmd.ops= 0;
-      cmd.Nv= 0;
-      cmd.width= cmd.height= -1;
+      cmd->word= real_cmd;
+      cmd->ops= 0;
+      cmd->Nv= 0;
+      cmd->width= cmd->height= -1;
       switch ( real_cmd>>24 )
         {
         case 0x00: // Nop.
-          cmd.name= PSX_GP0_NOP;
+          cmd->name= PSX_GP0_NOP;
           ready= true;
           break;
         case 0x01: break; // Clear Cache??? <-- No implementat.
         case 0x02: break; // Fill rectangle in VRAM
         case 0x03: break; // Desconegut.
         case 0x04 ... 0x1E: // Nop mirror
-          cmd.name= PSX_GP0_NOP;
+          cmd->name= PSX_GP0_NOP;
           ready= true;
           break;
         case 0x1F: break; // Interrupt Request (IRQ1)
@@ -4038,22 +4168,22 @@ gp0_cmd_trace (
         case 0xC0 ... 0xDF: // Copy Rectangle (VRAM to CPU)
           break;
         case 0xE0: // Nop mirror.
-          cmd.name= PSX_GP0_NOP;
+          cmd->name= PSX_GP0_NOP;
           ready= true;
           break;
         case 0xE1: break; // Set Draw Mode
         case 0xE2: break; // Set Texture Window
-        case 0xE3: cmd.name= PSX_GP0_SET_TOP_LEFT; ready= true; break;
-        case 0xE4: cmd.name= PSX_GP0_SET_BOTTOM_RIGHT; ready= true; break;
-        case 0xE5: cmd.name= PSX_GP0_SET_OFFSET; ready= true; break;
+        case 0xE3: cmd->name= PSX_GP0_SET_TOP_LEFT; ready= true; break;
+        case 0xE4: cmd->name= PSX_GP0_SET_BOTTOM_RIGHT; ready= true; break;
+        case 0xE5: cmd->name= PSX_GP0_SET_OFFSET; ready= true; break;
         case 0xE6: break; // Mask Bit Setting
         case 0xE7 ... 0xEF: // Nop mirror.
-          cmd.name= PSX_GP0_NOP;
+          cmd->name= PSX_GP0_NOP;
           ready= true;
           break;
 
         default:
-          cmd.name= PSX_GP0_UNK;
+          cmd->name= PSX_GP0_UNK;
           ready= true;
           break;
         }
@@ -4087,7 +4217,7 @@ gp0_cmd_trace (
     default: break;
       
     }
-  if ( ready ) _gpu_cmd_trace ( &cmd, _udata );
+  if ( ready ) _gpu_cmd_trace ( cmd, _udata );
   
   // Executa de veritat el comandament.
   gp0_cmd ( real_cmd );
@@ -4155,49 +4285,49 @@ gp1_cmd_trace (
                )
 {
   
-  static PSX_GPUCmd cmd;
+  PSX_GPUCmd *cmd= &(_trace_cmd.gp1);
 
 
   // Traça.
-  cmd.Nv= 0;
-  cmd.ops= 0;
-  cmd.word= arg;
-  cmd.width= cmd.height= -1;
+  cmd->Nv= 0;
+  cmd->ops= 0;
+  cmd->word= arg;
+  cmd->width= cmd->height= -1;
   switch ( (arg>>24)&0x3F )
     {
-    case 0x00: cmd.name= PSX_GP1_RESET; break;
-    case 0x01: cmd.name= PSX_GP1_RESET_BUFFER; break;
-    case 0x02: cmd.name= PSX_GP1_ACK; break;
-    case 0x03: cmd.name= PSX_GP1_ENABLE; break;
+    case 0x00: cmd->name= PSX_GP1_RESET; break;
+    case 0x01: cmd->name= PSX_GP1_RESET_BUFFER; break;
+    case 0x02: cmd->name= PSX_GP1_ACK; break;
+    case 0x03: cmd->name= PSX_GP1_ENABLE; break;
     case 0x04: // DMA Direction / Data Request.
-      cmd.name= PSX_GP1_DATA_REQUEST;
+      cmd->name= PSX_GP1_DATA_REQUEST;
       break;
     case 0x05: // Start of display area.
-      cmd.name= PSX_GP1_START_DISP;
-      cmd.v[0].x= arg&0x3FF;
-      cmd.v[0].y= (arg>>10)&0x1FF;
-      cmd.Nv= 1;
+      cmd->name= PSX_GP1_START_DISP;
+      cmd->v[0].x= arg&0x3FF;
+      cmd->v[0].y= (arg>>10)&0x1FF;
+      cmd->Nv= 1;
       break;
     case 0x06:
-      cmd.name= PSX_GP1_HOR_DISP_RANGE;
-      cmd.v[0].x= arg&0xFFF;
-      cmd.v[0].y= (arg>>12)&0xFFF;
-      cmd.Nv= 1;
+      cmd->name= PSX_GP1_HOR_DISP_RANGE;
+      cmd->v[0].x= arg&0xFFF;
+      cmd->v[0].y= (arg>>12)&0xFFF;
+      cmd->Nv= 1;
       break;
     case 0x07:
-      cmd.name= PSX_GP1_VER_DISP_RANGE;
-      cmd.v[0].x= arg&0x3FF;
-      cmd.v[0].y= (arg>>10)&0x3FF;
-      cmd.Nv= 1;
+      cmd->name= PSX_GP1_VER_DISP_RANGE;
+      cmd->v[0].x= arg&0x3FF;
+      cmd->v[0].y= (arg>>10)&0x3FF;
+      cmd->Nv= 1;
       break;
-    case 0x08: cmd.name= PSX_GP1_SET_DISP_MODE; break;
-    case 0x09: cmd.name= PSX_GP1_TEXT_DISABLE; break;
-    case 0x0A: cmd.name= PSX_GP1_UNK; break; // Not used?
-    case 0x0B: cmd.name= PSX_GP1_UNK; break; // Unknown/Internal?
+    case 0x08: cmd->name= PSX_GP1_SET_DISP_MODE; break;
+    case 0x09: cmd->name= PSX_GP1_TEXT_DISABLE; break;
+    case 0x0A: cmd->name= PSX_GP1_UNK; break; // Not used?
+    case 0x0B: cmd->name= PSX_GP1_UNK; break; // Unknown/Internal?
     case 0x0C:
     case 0x0D:
     case 0x0E:
-    case 0x0F: cmd.name= PSX_GP1_UNK; break;
+    case 0x0F: cmd->name= PSX_GP1_UNK; break;
     case 0x10: // Get GPU info
     case 0x11:
     case 0x12:
@@ -4213,15 +4343,15 @@ gp1_cmd_trace (
     case 0x1C:
     case 0x1D:
     case 0x1E:
-    case 0x1F: cmd.name= PSX_GP1_GET_INFO; break;
+    case 0x1F: cmd->name= PSX_GP1_GET_INFO; break;
     case 0x20:
-      cmd.name= PSX_GP1_OLD_TEXT_DISABLE;
+      cmd->name= PSX_GP1_OLD_TEXT_DISABLE;
       break; // Ancient Texture Disable
     default: // Not used?
-      cmd.name= PSX_GP1_UNK;
+      cmd->name= PSX_GP1_UNK;
       break;
     }
-  _gpu_cmd_trace ( &cmd, _udata );
+  _gpu_cmd_trace ( cmd, _udata );
   
   // Executa de veritat el comandament.
   gp1_cmd ( arg );
@@ -4237,6 +4367,27 @@ gpu_read (void)
 } /* end gpu_read */
 
 
+/* Comprova que els índexs d'uns arguments carregats d'un estat són
+   vàlids. */
+static bool
+check_renderer_args (
+        	     const PSX_RendererArgs *args
+        	     )
+{
+  return
+    args->clip_x1 >= 0 && args->clip_x1 < FB_WIDTH &&
+    args->clip_x2 >= 0 && args->clip_x2 < FB_WIDTH &&
+    args->clip_y1 >= 0 && args->clip_y1 < FB_HEIGHT &&
+    args->clip_y2 >= 0 && args->clip_y2 < FB_HEIGHT &&
+    (unsigned) args->transparency <= PSX_TR_NONE &&
+    (unsigned) args->texture_mode <= PSX_TEX_NONE &&
+    args->texpage_x >= 0 && args->texpage_x <= 15 &&
+    args->texpage_y >= 0 && args->texpage_y <= 1 &&
+    args->texclut_x >= 0 && args->texclut_x <= 63 &&
+    args->texclut_y >= 0 && args->texclut_y < FB_HEIGHT;
+} /* end check_renderer_args */
+
+
 
 
 /**********************/
@@ -4244,7 +4395,7 @@ gpu_read (void)
 /**********************/
 
 void
-PSX_gpu_end_iter (void)
+PSX_gpu_clock (void)
 {
 
   int cc;
@@ -4269,6 +4420,15 @@ PSX_gpu_end_iter (void)
       if ( _timing.cctoEvent && _timing.cc >= _timing.cctoEvent )
         clock ();
     }
+  
+} // end PSX_gpu_clock
+
+
+void
+PSX_gpu_end_iter (void)
+{
+
+  PSX_gpu_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_gpu_end_iter
@@ -4312,7 +4472,12 @@ PSX_gpu_init (
   /* Frame buffer. */
   memset ( _fb, 0, sizeof(_fb) );
   _renderer_locked= true; // Assegurem que s'inicialitze almenys una vegada
+  VRAM_WRITTEN ( 0, 0, FB_WIDTH, FB_HEIGHT );
   UNLOCK_RENDERER;
+  _output= true;
+  _skip.nframes= 0;
+  _skip.count= 0;
+  skip_update ();
 
   /* Display. */
   _display.enabled= false;
@@ -4375,6 +4540,123 @@ PSX_gpu_init (
 } /* end PSX_gpu_init */
 
 
+void
+PSX_gpu_close (void)
+{
+
+  _skip.nframes= 0;
+  skip_stop ();
+  if ( _skip.stats != NULL )
+    {
+      PSX_renderer_free ( _skip.stats );
+      _skip.stats= NULL;
+    }
+  
+} // end PSX_gpu_close
+
+
+void
+PSX_gpu_state_save (
+                    PSX_State *st
+                    )
+{
+
+  // El renderer pot tindre la VRAM més actualitzada.
+  LOCK_RENDERER;
+  PSX_STATE_WRITE ( st, _fb );
+  PSX_STATE_WRITE ( st, _display );
+  PSX_STATE_WRITE ( st, _render );
+  PSX_STATE_WRITE ( st, _copy );
+  PSX_STATE_WRITE ( st, _read );
+  PSX_STATE_WRITE ( st, _fifo );
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _dma_sync );
+  
+} // end PSX_gpu_state_save
+
+
+void
+PSX_gpu_state_load (
+                    PSX_State *st
+                    )
+{
+
+  LOCK_RENDERER;
+  PSX_STATE_READ ( st, _fb );
+  
+  // Display.
+  PSX_STATE_READ ( st, _display );
+  if ( (unsigned) _display.transfer_mode > TM_DMA_READ ||
+       _display.x < 0 || _display.x >= FB_WIDTH ||
+       _display.y < 0 || _display.y >= FB_HEIGHT ||
+       _display.x1 >= _display.x2 || _display.x2 > 0xFFF ||
+       _display.y1 >= _display.y2 || _display.y2 > 0x3FF ||
+       _display.hres < 0 || _display.hres >= HRES_SENTINEL ||
+       _display.fb_line_width < 0 || _display.fb_line_width > FB_WIDTH ||
+       _display.vres < 0 || _display.vres >= VRES_SENTINEL ||
+       _display.interlace_field < 0 || _display.interlace_field > 1 ||
+       (_display.tv_mode != NTSC && _display.tv_mode != PAL) )
+    goto error;
+
+  // Render.
+  PSX_STATE_READ ( st, _render );
+  if ( (unsigned) _render.state > WAIT_READ_DATA_COPY ||
+       _render.nwords < 0 ||
+       !check_renderer_args ( &_render.args ) ||
+       !check_renderer_args ( &_render.def_args ) )
+    goto error;
+
+  // Copy.
+  PSX_STATE_READ ( st, _copy );
+  if ( _copy.x < 0 || _copy.x >= FB_WIDTH ||
+       _copy.y < 0 || _copy.y >= FB_HEIGHT ||
+       _copy.end_c < _copy.x || _copy.end_c-_copy.x > FB_WIDTH ||
+       _copy.end_r < _copy.y || _copy.end_r-_copy.y > FB_HEIGHT )
+    goto error;
+  PSX_STATE_READ ( st, _read );
+
+  // FIFO.
+  PSX_STATE_READ ( st, _fifo );
+  if ( _fifo.p < 0 || _fifo.p >= FIFO_SIZE ||
+       _fifo.N < 0 || _fifo.N > FIFO_SIZE ||
+       _fifo.nactions < 0 ||
+       (unsigned) _fifo.state > FIFO_WAIT_WRITE_DATA_COPY )
+    goto error;
+
+  // Timing.
+  PSX_STATE_READ ( st, _timing );
+  if ( _timing.ccperline <= 0 || _timing.nlines <= 0 ||
+       _timing.line < 0 || _timing.line >= _timing.nlines ||
+       _timing.ccline < 0 )
+    goto error;
+  PSX_STATE_READ ( st, _dma_sync );
+
+  // Passa la nova VRAM al renderer.
+  VRAM_WRITTEN ( 0, 0, FB_WIDTH, FB_HEIGHT );
+  UNLOCK_RENDERER;
+  _renderer->enable_display ( _renderer, _display.enabled );
+
+  return;
+  
+ error:
+  _display.transfer_mode= TM_OFF;
+  _display.x= _display.y= 0;
+  _display.hres= HRES_256;
+  _display.vres= VRES_240;
+  _display.tv_mode= NTSC;
+  _render.state= WAIT_CMD;
+  _render.nwords= 0;
+  _copy.x= _copy.y= _copy.c= _copy.r= 0;
+  _copy.end_c= _copy.end_r= 0;
+  _fifo.p= _fifo.N= _fifo.nactions= 0;
+  _fifo.state= FIFO_WAIT_CMD;
+  _timing.line= _timing.ccline= 0;
+  UNLOCK_RENDERER;
+  st->error= true;
+  
+} // end PSX_gpu_state_load
+
+
 void
 PSX_gpu_gp0 (
              const uint32_t cmd
@@ -4613,6 +4895,30 @@ PSX_gpu_set_mode_trace (
 } // end PSX_gpu_set_mode_trace
 
 
+void
+PSX_gpu_set_output (
+        	    const bool enable
+        	    )
+{
+  _output= enable;
+} // end PSX_gpu_set_output
+
+
+void
+PSX_gpu_set_frameskip (
+        	       const int nframes
+        	       )
+{
+
+  if ( nframes > 0 && _skip.stats == NULL )
+    _skip.stats= PSX_create_stats_renderer ();
+  _skip.nframes= nframes > 0 ? nframes : 0;
+  _skip.count= _skip.nframes; // El frame actual es mostra.
+  skip_update ();
+  
+} // end PSX_gpu_set_frameskip
+
+
 void
 PSX_gpu_reset (void)
 {
@@ -211,151 +211,170 @@
 /* ESTAT */
 /*********/
 
-/* Callbacks. */
-static PSX_Warning *_warning;
-static PSX_GTECmdTrace *_cmd_trace;
-static PSX_GTEMemAccess *_mem_access;
-static void *_udata;
-
-// Traça
-static int (*_read) (const int nreg,uint32_t *dst);
-static void (*_write) (const int nreg,const uint32_t data);
-static void (*_execute) (const uint32_t cmd);
-
-// Cicles pendents de processar i ja consumits de l'actual
-// iteració. El motiu és que quan una instrucció encara està pendent
-// no es pot fer una altra cosa.
-static int _cc;
-static int _cc_used;
-
-/* Registres. */
-static struct
+typedef struct
 {
 
-  /* 16bit Vectors (R/W) (1,15,0) o (1,3,12). */
-  int16_t vx0;
-  int16_t vy0;
-  int16_t vz0;
-  
-  int16_t vx1;
-  int16_t vy1;
-  int16_t vz1;
-  
-  int16_t vx2;
-  int16_t vy2;
-  int16_t vz2;
-
-  int16_t ir1;
-  int16_t ir2;
-  int16_t ir3;
-
-  /* Rotation matrix (RT) (1,3,12). */
-  int16_t rt11;
-  int16_t rt12;
-  int16_t rt13;
-  int16_t rt21;
-  int16_t rt22;
-  int16_t rt23;
-  int16_t rt31;
-  int16_t rt32;
-  int16_t rt33;
-
-  /* Light matrix (LM) (1,3,12). */
-  int16_t l11;
-  int16_t l12;
-  int16_t l13;
-  int16_t l21;
-  int16_t l22;
-  int16_t l23;
-  int16_t l31;
-  int16_t l32;
-  int16_t l33;
-
-  /* Light Color matrix (LCM) (1,3,12). */
-  int16_t lr1;
-  int16_t lr2;
-  int16_t lr3;
-  int16_t lg1;
-  int16_t lg2;
-  int16_t lg3;
-  int16_t lb1;
-  int16_t lb2;
-  int16_t lb3;
-
-  /* Translation Vector (TR) (R/W) (1,31,0). */
-  int32_t trx;
-  int32_t try;
-  int32_t trz;
-
-  /* Background Color (BK) (R/W?) (1,19,12). */
-  int32_t rbk;
-  int32_t gbk;
-  int32_t bbk;
-
-  /* Far Color (FC) (R/W?) (1,27,4). */
-  int32_t rfc;
-  int32_t gfc;
-  int32_t bfc;
-  
-  /* Screen Offset and Distance (R/W) */
-  /*  -> (1,15,16). */
-  int32_t ofx;
-  int32_t ofy;
-  /*  -> (0,16,0). */
-  uint16_t h;
-  /*  -> (1,7,8). */
-  int16_t dqa;
-  /*  -> (1,7,24). */
-  int32_t dqb;
-
-  /* Screen XYZ Coordinate FIFOs. */
-  /*  -> (1,15,0). */
-  int16_t sx0;
-  int16_t sy0;
-  int16_t sx1;
-  int16_t sy1;
-  int16_t sx2;
-  int16_t sy2;
-  /*  -> (0,16,0). */
-  uint16_t sz0;
-  uint16_t sz1;
-  uint16_t sz2;
-  uint16_t sz3;
-
-  /* Accumulators (R/W) (1,31,0). */
-  int32_t mac0;
-  int32_t mac1;
-  int32_t mac2;
-  int32_t mac3;
-
-  /* Returns any calculation errors. */
-  uint32_t flag;
-
-  /* Interpolation Factor (R/W) (1,3,12). */
-  int16_t ir0;
-
-  /* Average Z Registers (R/W). */
-  /*  -> (1,3,12). */
-  int16_t zsf3;
-  int16_t zsf4;
-  /*  -> (0,15,0). */
-  uint16_t otz;
-
-  /* Count-Leading-Zeroes/Leading-Ones */
-  int32_t lzcs;
-  uint32_t lzcr;
-
-  /* Color Register and Color FIFO (RW) (CODE,B,G,R). */
-  uint32_t rgbc;
-  uint32_t rgb0;
-  uint32_t rgb1;
-  uint32_t rgb2;
-  uint32_t res1; /* RES1 seems to be unused... looks like an unused
-        	    Fifo stage... RES1 is read/write-able... unlike
-        	    SXYP (for SXYn Fifo) it does not mirror to RGB2,
-        	    nor does it have a move-on-write function... */
-
-} _regs;
+  /* Callbacks. */
+  PSX_Warning *_warning;
+  PSX_GTECmdTrace *_cmd_trace;
+  PSX_GTEMemAccess *_mem_access;
+  void *_udata;
+
+  // Traça
+  int (*_read) (const int nreg,uint32_t *dst);
+  void (*_write) (const int nreg,const uint32_t data);
+  void (*_execute) (const uint32_t cmd);
+
+  // Cicles pendents de processar i ja consumits de l'actual
+  // iteració. El motiu és que quan una instrucció encara està pendent
+  // no es pot fer una altra cosa.
+  int _cc;
+  int _cc_used;
+
+  /* Registres. */
+  struct
+  {
+
+    /* 16bit Vectors (R/W) (1,15,0) o (1,3,12). */
+    int16_t vx0;
+    int16_t vy0;
+    int16_t vz0;
+
+    int16_t vx1;
+    int16_t vy1;
+    int16_t vz1;
+
+    int16_t vx2;
+    int16_t vy2;
+    int16_t vz2;
+
+    int16_t ir1;
+    int16_t ir2;
+    int16_t ir3;
+
+    /* Rotation matrix (RT) (1,3,12). */
+    int16_t rt11;
+    int16_t rt12;
+    int16_t rt13;
+    int16_t rt21;
+    int16_t rt22;
+    int16_t rt23;
+    int16_t rt31;
+    int16_t rt32;
+    int16_t rt33;
+
+    /* Light matrix (LM) (1,3,12). */
+    int16_t l11;
+    int16_t l12;
+    int16_t l13;
+    int16_t l21;
+    int16_t l22;
+    int16_t l23;
+    int16_t l31;
+    int16_t l32;
+    int16_t l33;
+
+    /* Light Color matrix (LCM) (1,3,12). */
+    int16_t lr1;
+    int16_t lr2;
+    int16_t lr3;
+    int16_t lg1;
+    int16_t lg2;
+    int16_t lg3;
+    int16_t lb1;
+    int16_t lb2;
+    int16_t lb3;
+
+    /* Translation Vector (TR) (R/W) (1,31,0). */
+    int32_t trx;
+    int32_t try;
+    int32_t trz;
+
+    /* Background Color (BK) (R/W?) (1,19,12). */
+    int32_t rbk;
+    int32_t gbk;
+    int32_t bbk;
+
+    /* Far Color (FC) (R/W?) (1,27,4). */
+    int32_t rfc;
+    int32_t gfc;
+    int32_t bfc;
+
+    /* Screen Offset and Distance (R/W) */
+    /*  -> (1,15,16). */
+    int32_t ofx;
+    int32_t ofy;
+    /*  -> (0,16,0). */
+    uint16_t h;
+    /*  -> (1,7,8). */
+    int16_t dqa;
+    /*  -> (1,7,24). */
+    int32_t dqb;
+
+    /* Screen XYZ Coordinate FIFOs. */
+    /*  -> (1,15,0). */
+    int16_t sx0;
+    int16_t sy0;
+    int16_t sx1;
+    int16_t sy1;
+    int16_t sx2;
+    int16_t sy2;
+    /*  -> (0,16,0). */
+    uint16_t sz0;
+    uint16_t sz1;
+    uint16_t sz2;
+    uint16_t sz3;
+
+    /* Accumulators (R/W) (1,31,0). */
+    int32_t mac0;
+    int32_t mac1;
+    int32_t mac2;
+    int32_t mac3;
+
+    /* Returns any calculation errors. */
+    uint32_t flag;
+
+    /* Interpolation Factor (R/W) (1,3,12). */
+    int16_t ir0;
+
+    /* Average Z Registers (R/W). */
+    /*  -> (1,3,12). */
+    int16_t zsf3;
+    int16_t zsf4;
+    /*  -> (0,15,0). */
+    uint16_t otz;
+
+    /* Count-Leading-Zeroes/Leading-Ones */
+    int32_t lzcs;
+    uint32_t lzcr;
+
+    /* Color Register and Color FIFO (RW) (CODE,B,G,R). */
+    uint32_t rgbc;
+    uint32_t rgb0;
+    uint32_t rgb1;
+    uint32_t rgb2;
+    uint32_t res1; /* RES1 seems to be unused... looks like an unused
+          	    Fifo stage... RES1 is read/write-able... unlike
+          	    SXYP (for SXYn Fifo) it does not mirror to RGB2,
+          	    nor does it have a move-on-write function... */
+
+  } _regs;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, GTE );
+
+#define STATE PSX_CTX_STATE ( state_t, GTE )
+#define _warning (STATE._warning)
+#define _cmd_trace (STATE._cmd_trace)
+#define _mem_access (STATE._mem_access)
+#define _udata (STATE._udata)
+#define _read (STATE._read)
+#define _write (STATE._write)
+#define _execute (STATE._execute)
+#define _cc (STATE._cc)
+#define _cc_used (STATE._cc_used)
+#define _regs (STATE._regs)
 
 
 
@@ -1936,7 +1955,8 @@ execute (
          const uint32_t cmd
          )
 {
-  
+
+  PSX_COUNT ( gte_cmds[cmd&0x3F] );
   switch ( (cmd&0x3F) )
     {
 
@@ -2158,6 +2178,31 @@ PSX_gte_init (
 } /* end PSX_get_init */
 
 
+void
+PSX_gte_state_save (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_WRITE ( st, _cc );
+  PSX_STATE_WRITE ( st, _regs );
+  
+} // end PSX_gte_state_save
+
+
+void
+PSX_gte_state_load (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_READ ( st, _cc );
+  PSX_STATE_READ ( st, _regs );
+  _cc_used= 0;
+  
+} // end PSX_gte_state_load
+
+
 void
 PSX_gte_end_iter (void)
 
@@ -45,17 +45,33 @@
 /* ESTAT */
 /*********/
 
-// Estat, màscara i senyals d'entrada.
-static uint32_t _i_stat;
-static uint32_t _i_mask;
-static uint32_t _in;
+typedef struct
+{
+
+  // Estat, màscara i senyals d'entrada.
+  uint32_t _i_stat;
+  uint32_t _i_mask;
+  uint32_t _in;
+
+  // Trace.
+  void *_udata;
+  PSX_IntTrace *_int;
+
+  void (*_interruption) (const PSX_Interruption flag, const bool value);
+  void (*_int_ack) (const uint32_t data);
 
-// Trace.
-static void *_udata;
-static PSX_IntTrace *_int;
+} state_t;
 
-static void (*_interruption) (const PSX_Interruption flag, const bool value);
-static void (*_int_ack) (const uint32_t data);
+PSX_CTX_DEFINE ( state_t, INT );
+
+#define STATE PSX_CTX_STATE ( state_t, INT )
+#define _i_stat (STATE._i_stat)
+#define _i_mask (STATE._i_mask)
+#define _in (STATE._in)
+#define _udata (STATE._udata)
+#define _int (STATE._int)
+#define _interruption (STATE._interruption)
+#define _int_ack (STATE._int_ack)
 
 
 
@@ -63,6 +79,23 @@ static void (*_int_ack) (const uint32_t data);
 /* FUNCIONS PRIVADES */
 /*********************/
 
+#ifdef PSX_COUNTERS
+static void
+count_interruption (
+        	    const PSX_Interruption flag
+        	    )
+{
+
+  int i;
+
+
+  for ( i= 0; ((uint32_t) flag>>i) != 1; ++i );
+  PSX_COUNT ( ints[i] );
+  
+} // end count_interruption
+#endif
+
+
 static void
 interruption (
               const PSX_Interruption flag,
@@ -74,6 +107,9 @@ interruption (
     {
       if ( (_in&flag) == 0 ) // Edge triggered
         {
+#ifdef PSX_COUNTERS
+          count_interruption ( flag );
+#endif
           _i_stat|= flag;
           UPDATE_CPU_INT;
         }
@@ -156,6 +192,32 @@ PSX_int_init (
 } // end PSX_int_init
 
 
+void
+PSX_int_state_save (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_WRITE ( st, _i_stat );
+  PSX_STATE_WRITE ( st, _i_mask );
+  PSX_STATE_WRITE ( st, _in );
+  
+} // end PSX_int_state_save
+
+
+void
+PSX_int_state_load (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_READ ( st, _i_stat );
+  PSX_STATE_READ ( st, _i_mask );
+  PSX_STATE_READ ( st, _in );
+  
+} // end PSX_int_state_load
+
+
 void
 PSX_int_interruption (
         	      const PSX_Interruption flag,
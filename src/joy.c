@@ -61,105 +61,124 @@
 /* ESTAT */
 /*********/
 
-// Callbacks.
-static PSX_Warning *_warning;
-static PSX_GetControllerState *_get_ctrl_state;
-static void *_udata;
-
-// Control
-static struct
-{
-
-  bool txen;
-  bool txen_latched;
-  bool joyn_select;
-  bool rxen;
-  bool unk1;
-  bool unk2;
-  int  rx_int_mode; // when RX FIFO contains 1,2,4,8 bytes
-  bool tx_int_enabled;
-  bool rx_int_enabled;
-  bool ack_int_enabled;
-  int  slot_number;
-  
-} _ctrl;
-
-// Mode
-static struct
-{
-
-  int  baudrate_reload_factor; // 1=MUL1, 2=MUL16, 3=MUL64 (or 0=MUL1, too)
-  int  char_length; // 0=5bits, 1=6bits, 2=7bits, 3=8bits
-  bool parity_enabled;
-  bool parity_odd;
-  bool out_polarity_inverse;
-  
-} _mode;
-
-// Baudrate reload value
-static uint16_t _baudrate_reload_value;
-
-// Timing.
-static struct
+typedef struct
 {
-  
-  int32_t baudrate_timer; // 21bit timer
-  int32_t cc;
-  int32_t cc_used;
-  int32_t cc2ack_low;
-  int32_t cc2ack_high;
-  bool    wait_ack;
-  bool    wait_ack_high;
-  int32_t cctoEvent;
-  
-} _timing;
-
-// Transfer state.
-static struct
-{
-
-  uint16_t tx_fifo;
-  int      tx_fifo_N;
-  uint64_t rx_fifo;
-  int      rx_fifo_N;
-  uint8_t  byte;
-  int      nbits; // Número de bits transferits
-  bool     activated;
-  
-} _transfer;
 
-// Status.
-static struct
-{
-
-  bool rx_parity_error; // No implementat !!!
-  bool ack;
-  bool irq_request;
-  
-} _status;
-
-// Estat dels controladors.
-static struct
-{
-
-  bool            selected;
-  PSX_Controller  type;
-  int             step;
-  bool            mode_memcard;
-  uint8_t        *memc;
-  uint8_t         memc_flag;
-  enum {
-    MEMC_READ,
-    MEMC_GET_ID,
-    MEMC_WRITE
-  }               memc_cmd;
-  uint8_t         memc_chk;
-  uint8_t         memc_pre;
-  uint8_t         memc_msb;
-  uint8_t         memc_lsb;
-  unsigned int    memc_p;
-  
-} _devs[2];
+  // Callbacks.
+  PSX_Warning *_warning;
+  PSX_GetControllerState *_get_ctrl_state;
+  void *_udata;
+
+  // Control
+  struct
+  {
+
+    bool txen;
+    bool txen_latched;
+    bool joyn_select;
+    bool rxen;
+    bool unk1;
+    bool unk2;
+    int  rx_int_mode; // when RX FIFO contains 1,2,4,8 bytes
+    bool tx_int_enabled;
+    bool rx_int_enabled;
+    bool ack_int_enabled;
+    int  slot_number;
+
+  } _ctrl;
+
+  // Mode
+  struct
+  {
+
+    int  baudrate_reload_factor; // 1=MUL1, 2=MUL16, 3=MUL64 (or 0=MUL1, too)
+    int  char_length; // 0=5bits, 1=6bits, 2=7bits, 3=8bits
+    bool parity_enabled;
+    bool parity_odd;
+    bool out_polarity_inverse;
+
+  } _mode;
+
+  // Baudrate reload value
+  uint16_t _baudrate_reload_value;
+
+  // Timing.
+  struct
+  {
+
+    int32_t baudrate_timer; // 21bit timer
+    int32_t cc;
+    int32_t cc_used;
+    int32_t cc2ack_low;
+    int32_t cc2ack_high;
+    bool    wait_ack;
+    bool    wait_ack_high;
+    int32_t cctoEvent;
+
+  } _timing;
+
+  // Transfer state.
+  struct
+  {
+
+    uint16_t tx_fifo;
+    int      tx_fifo_N;
+    uint64_t rx_fifo;
+    int      rx_fifo_N;
+    uint8_t  byte;
+    int      nbits; // Número de bits transferits
+    bool     activated;
+
+  } _transfer;
+
+  // Status.
+  struct
+  {
+
+    bool rx_parity_error; // No implementat !!!
+    bool ack;
+    bool irq_request;
+
+  } _status;
+
+  // Estat dels controladors.
+  struct
+  {
+
+    bool            selected;
+    PSX_Controller  type;
+    int             step;
+    bool            mode_memcard;
+    uint8_t        *memc;
+    uint8_t         memc_flag;
+    enum {
+      MEMC_READ,
+      MEMC_GET_ID,
+      MEMC_WRITE
+    }               memc_cmd;
+    uint8_t         memc_chk;
+    uint8_t         memc_pre;
+    uint8_t         memc_msb;
+    uint8_t         memc_lsb;
+    unsigned int    memc_p;
+
+  } _devs[2];
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, JOY );
+
+#define STATE PSX_CTX_STATE ( state_t, JOY )
+#define _warning (STATE._warning)
+#define _get_ctrl_state (STATE._get_ctrl_state)
+#define _udata (STATE._udata)
+#define _ctrl (STATE._ctrl)
+#define _mode (STATE._mode)
+#define _baudrate_reload_value (STATE._baudrate_reload_value)
+#define _timing (STATE._timing)
+#define _transfer (STATE._transfer)
+#define _status (STATE._status)
+#define _devs (STATE._devs)
 
 
 
@@ -172,9 +191,6 @@ static void
 update_timing_event (void)
 {
 
-  int tmp;
-
-  
   // Actualitza cctoEvent
   _timing.cctoEvent= _timing.baudrate_timer;
   if ( _timing.wait_ack && _timing.cc2ack_low < _timing.cctoEvent )
@@ -182,10 +198,8 @@ update_timing_event (void)
   if ( _timing.wait_ack_high && _timing.cc2ack_high < _timing.cctoEvent )
     _timing.cctoEvent= _timing.cc2ack_high;
   
-  // Update PSX_NextEventCC
-  tmp= PSX_Clock + PSX_joy_next_event_cc ();
-  if ( tmp < PSX_NextEventCC )
-    PSX_NextEventCC= tmp;
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_JOY, PSX_joy_next_event_cc () );
   
 } // end update_timing_event
 
@@ -839,6 +853,61 @@ PSX_joy_init (
 } // end PSX_joy_init
 
 
+void
+PSX_joy_state_save (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_WRITE ( st, _ctrl );
+  PSX_STATE_WRITE ( st, _mode );
+  PSX_STATE_WRITE ( st, _baudrate_reload_value );
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _transfer );
+  PSX_STATE_WRITE ( st, _status );
+  PSX_STATE_WRITE ( st, _devs );
+  
+} // end PSX_joy_state_save
+
+
+void
+PSX_joy_state_load (
+                    PSX_State *st
+                    )
+{
+
+  PSX_Controller type[2];
+  uint8_t *memc[2];
+  int i;
+  
+  
+  PSX_STATE_READ ( st, _ctrl );
+  PSX_STATE_READ ( st, _mode );
+  PSX_STATE_READ ( st, _baudrate_reload_value );
+  PSX_STATE_READ ( st, _timing );
+  PSX_STATE_READ ( st, _transfer );
+  PSX_STATE_READ ( st, _status );
+
+  // Els controladors i memory cards connectats són del frontend.
+  for ( i= 0; i < 2; ++i )
+    {
+      type[i]= _devs[i].type;
+      memc[i]= _devs[i].memc;
+    }
+  PSX_STATE_READ ( st, _devs );
+  for ( i= 0; i < 2; ++i )
+    {
+      if ( _devs[i].type != type[i] )
+        {
+          _devs[i].type= type[i];
+          _devs[i].step= 0;
+        }
+      _devs[i].memc= memc[i];
+    }
+  
+} // end PSX_joy_state_load
+
+
 void
 PSX_joy_tx_data (
         	 const uint32_t data
@@ -1049,7 +1118,7 @@ PSX_joy_baud_read (void)
 
 
 void
-PSX_joy_end_iter (void)
+PSX_joy_clock (void)
 {
 
   int cc;
@@ -1063,6 +1132,15 @@ PSX_joy_end_iter (void)
       if ( _timing.cc >= _timing.cctoEvent )
         clock ();
     }
+  
+} // end PSX_joy_clock
+
+
+void
+PSX_joy_end_iter (void)
+{
+
+  PSX_joy_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_joy_end_iter
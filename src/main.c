@@ -22,32 +22,175 @@
  */
 
 
+#include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef PSX_PROFILE
+#include <time.h>
+#endif
 
 #include "PSX.h"
 
 
 
 
+/**********/
+/* MACROS */
+/**********/
+
+#define STATE_ID(A,B,C,D)        					\
+  ((uint32_t) (A) | ((uint32_t) (B)<<8) |        			\
+   ((uint32_t) (C)<<16) | ((uint32_t) (D)<<24))
+
+#define STATE_MAGIC STATE_ID('P','S','X','S')
+
+// Per a detectar estats d'una màquina amb altre ordre de bytes.
+#define STATE_BOM 0x01020304
+
+// Màxim de cicles que s'espera al VBlank (dos frames PAL).
+#define MAX_FRAME_CC (PSX_CYCLES_PER_SEC/25)
+
+// Màxim de trams de perfilat niats.
+#define PROFILE_DEPTH 16
+
+// Alineació dels blocs d'un context.
+#define CTX_ROUND(SIZE) (((SIZE)+63)&~((size_t) 63))
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t bom;
+  uint32_t nchunks;
+} state_header_t;
+
+typedef struct
+{
+  uint32_t id;
+  uint32_t size;
+} state_chunk_t;
+
+#ifdef PSX_MULTI_INSTANCE
+// Els blocs van just darrere d'aquesta capçalera, en la mateixa
+// reserva. Així tot l'estat queda a prop de PSX_cpu_regs, com
+// necessita el recompilador.
+struct PSX_Context
+{
+  void *blocks[PSX_CTX_NUM];
+};
+#endif
+
+
+
+
 /*********/
 /* ESTAT */
 /*********/
 
-/* Senyals. */
-static bool _reset;
+typedef struct
+{
+
+  /* Senyals. */
+  bool _reset;
+
+  /* Frontend. */
+  PSX_CheckSignals *_check;
+  PSX_Warning *_warning;
+  void *_udata;
+
+  /* Callbacks. */
+  PSX_CPUInst *_cpu_inst;
+
+  /* Planificador d'events. Monticle de mínims indexat amb una entrada
+   * per cada font. Els 'deadline' són relatius a l'inici de l'actual
+   * crida a PSX_iter, INT_MAX vol dir que no hi ha event.
+   */
+  struct
+  {
+    int      deadline[PSX_EVENT_NUM];
+    int      heap[PSX_EVENT_NUM];
+    int      pos[PSX_EVENT_NUM]; // Posició de cada font en 'heap'.
+    int      end; // Cicles a executar en l'actual crida a PSX_iter.
+    uint64_t base; // Cicles executats abans de l'actual crida.
+  } _sched;
+
+  /* Frames generats, i d'aquests els enviats al renderer. */
+  uint64_t _frames;
+  uint64_t _frames_drawn;
 
-/* Frontend. */
-static PSX_CheckSignals *_check;
-static PSX_Warning *_warning;
-static void *_udata;
+  /* Para l'actual iteració en el següent inici del VBlank. */
+  bool _stop_at_vblank;
 
-/* Callbacks. */
-static PSX_CPUInst *_cpu_inst;
+#ifdef PSX_PROFILE
+  /* Perfilat. El temps sempre es suma al tram del cim de la pila. */
+  struct
+  {
+    PSX_Profile prof;
+    uint64_t    t; // Últim canvi de tram.
+    int         stack[PROFILE_DEPTH];
+    int         N;
+  } _prof;
+#endif
+
+  /* Estat guardat pel run-ahead. */
+  struct
+  {
+    uint8_t *buf;
+    size_t   capacity;
+    size_t   size;
+  } _ahead;
+
+  /* Còpia de l'estat actual per a desfer un PSX_state_load que falla
+     a mitjan càrrega. */
+  struct
+  {
+    uint8_t *buf;
+    size_t   capacity;
+  } _undo;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, MAIN );
+
+#define STATE PSX_CTX_STATE ( state_t, MAIN )
+#define _reset (STATE._reset)
+#define _check (STATE._check)
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _cpu_inst (STATE._cpu_inst)
+#define _sched (STATE._sched)
+#define _frames (STATE._frames)
+#define _frames_drawn (STATE._frames_drawn)
+#define _stop_at_vblank (STATE._stop_at_vblank)
+#define _prof (STATE._prof)
+#define _ahead (STATE._ahead)
+#define _undo (STATE._undo)
+
+static const struct
+{
+  void (*clock) (void);
+  int  (*next_event_cc) (void);
+} _sources[PSX_EVENT_NUM]=
+  {
+    { PSX_dma_clock, PSX_dma_next_event_cc },
+    { PSX_mdec_clock, PSX_mdec_next_event_cc },
+    { PSX_gpu_clock, PSX_gpu_next_event_cc },
+    { PSX_cd_clock, PSX_cd_next_event_cc },
+    { PSX_spu_clock, PSX_spu_next_event_cc },
+    { PSX_joy_clock, PSX_joy_next_event_cc },
+    { PSX_timers_clock, PSX_timers_next_event_cc }
+  };
 
 
 
@@ -56,6 +199,568 @@ static PSX_CPUInst *_cpu_inst;
 /* FUNCIONS PRIVADES */
 /*********************/
 
+#ifdef PSX_PROFILE
+static uint64_t
+profile_now (void)
+{
+
+  struct timespec t;
+
+
+  clock_gettime ( CLOCK_MONOTONIC, &t );
+
+  return (uint64_t) t.tv_sec*1000000000ULL + (uint64_t) t.tv_nsec;
+
+} // end profile_now
+
+
+// Suma el temps des de l'últim canvi al tram del cim.
+static void
+profile_update (void)
+{
+
+  uint64_t t;
+
+
+  t= profile_now ();
+  if ( _prof.N > 0 )
+    _prof.prof.ns[_prof.stack[_prof.N-1]]+= t-_prof.t;
+  _prof.t= t;
+
+} // end profile_update
+#endif
+
+
+// Per a desfer empats es fa servir l'ordre de les fonts.
+static bool
+sched_less (
+            const int a,
+            const int b
+            )
+{
+  return _sched.deadline[a] < _sched.deadline[b] ||
+    (_sched.deadline[a] == _sched.deadline[b] && a < b);
+} // end sched_less
+
+
+static void
+sched_swap (
+            const int i,
+            const int j
+            )
+{
+
+  int tmp;
+
+  
+  tmp= _sched.heap[i];
+  _sched.heap[i]= _sched.heap[j];
+  _sched.heap[j]= tmp;
+  _sched.pos[_sched.heap[i]]= i;
+  _sched.pos[_sched.heap[j]]= j;
+  
+} // end sched_swap
+
+
+static void
+sched_sift_up (
+               int i
+               )
+{
+
+  int parent;
+
+  
+  while ( i > 0 )
+    {
+      parent= (i-1)>>1;
+      if ( !sched_less ( _sched.heap[i], _sched.heap[parent] ) ) break;
+      sched_swap ( i, parent );
+      i= parent;
+    }
+  
+} // end sched_sift_up
+
+
+static void
+sched_sift_down (
+        	 int i
+        	 )
+{
+
+  int min,child;
+
+  
+  for (;;)
+    {
+      min= i;
+      child= 2*i+1;
+      if ( child < PSX_EVENT_NUM &&
+           sched_less ( _sched.heap[child], _sched.heap[min] ) )
+        min= child;
+      ++child;
+      if ( child < PSX_EVENT_NUM &&
+           sched_less ( _sched.heap[child], _sched.heap[min] ) )
+        min= child;
+      if ( min == i ) break;
+      sched_swap ( i, min );
+      i= min;
+    }
+  
+} // end sched_sift_down
+
+
+static void
+sched_update_next_event (void)
+{
+
+  int tmp;
+
+  
+  tmp= _sched.deadline[_sched.heap[0]];
+  PSX_NextEventCC= tmp < _sched.end ? tmp : _sched.end;
+  
+} // end sched_update_next_event
+
+
+static void
+sched_set (
+           const PSX_EventSource src,
+           const int             deadline
+           )
+{
+
+  int old;
+
+
+  old= _sched.deadline[src];
+  if ( old == deadline ) return;
+  _sched.deadline[src]= deadline;
+  if ( deadline < old ) sched_sift_up ( _sched.pos[src] );
+  else                  sched_sift_down ( _sched.pos[src] );
+  sched_update_next_event ();
+  
+} // end sched_set
+
+
+// Torna a consultar a tots els mòduls. Es fa a l'inici de cada
+// PSX_iter, d'aquesta manera qualsevol canvi fet entre crides (reset,
+// traça, frontend) queda reflectit.
+static void
+sched_resync (void)
+{
+
+  int i;
+  
+  
+  for ( i= 0; i < PSX_EVENT_NUM; ++i )
+    PSX_schedule ( (PSX_EventSource) i, _sources[i].next_event_cc () );
+  sched_update_next_event ();
+  
+} // end sched_resync
+
+
+static void
+sched_init (void)
+{
+
+  int i;
+
+
+  for ( i= 0; i < PSX_EVENT_NUM; ++i )
+    {
+      _sched.deadline[i]= INT_MAX;
+      _sched.heap[i]= i;
+      _sched.pos[i]= i;
+    }
+  _sched.end= 0;
+  _sched.base= 0;
+  
+} // end sched_init
+
+
+// Crida als mòduls amb events pendents. Es processen en l'ordre de
+// les fonts, i un mòdul que passa a tindre un event pendent per culpa
+// d'un altre anterior també es processa.
+static void
+sched_run_events (void)
+{
+
+  int i,tmp;
+
+  
+  for ( i= 0; i < PSX_EVENT_NUM; ++i )
+    if ( _sched.deadline[i] <= PSX_Clock )
+      {
+        _sources[i].clock ();
+        tmp= _sources[i].next_event_cc ();
+        PSX_schedule ( (PSX_EventSource) i, tmp );
+      }
+  
+} // end sched_run_events
+
+
+static int
+iter (
+      const int cc
+      )
+{
+
+  /* NOTA!!! PSX_Clock ja no es reinicia en cada tram entre events,
+   * compta des de l'inici de la crida. Cada mòdul planifica el seu
+   * següent event amb PSX_schedule i sols es crida (PSX_<mòdul>_clock)
+   * als mòduls que tenen l'event pendent. Els *_end_iter es criden
+   * una única vegada al final de la crida.
+   */
+  
+  int ret,tmp;
+
+  
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_OTHER );
+  PSX_Clock= 0;
+  _sched.end= cc;
+  sched_resync ();
+  while ( PSX_Clock < _sched.end )
+    {
+      
+      // Itera tot els que es puga.
+      // NOTA!! PSX_NextEventCC el manté actualitzat el planificador.
+      do {
+        switch ( PSX_BusOwner )
+          {
+          case PSX_BUS_OWNER_CPU:
+            PSX_PROFILE_BEGIN ( PSX_PROFILE_CPU );
+            PSX_cpu_run ( PSX_NextEventCC - PSX_Clock );
+            PSX_PROFILE_END;
+            break;
+          case PSX_BUS_OWNER_DMA:
+            PSX_PROFILE_BEGIN ( PSX_PROFILE_DMA );
+            PSX_Clock+= tmp= PSX_dma_run ();
+            PSX_PROFILE_END;
+            break;
+          case PSX_BUS_OWNER_CPU_DMA:
+            // Per no perfilar instrucció a instrucció tot compta
+            // com a DMA.
+            PSX_PROFILE_BEGIN ( PSX_PROFILE_DMA );
+            PSX_Clock+= tmp= PSX_cpu_next_inst ();
+            PSX_dma_run_cc ( tmp );
+            PSX_PROFILE_END;
+            break;
+          }
+      } while ( PSX_Clock < PSX_NextEventCC );
+
+      // Executa events pendents.
+      sched_run_events ();
+      
+    }
+  
+  // Consumeix cicles pendets.
+  PSX_dma_end_iter ();
+  PSX_gte_end_iter ();
+  PSX_mdec_end_iter ();
+  PSX_gpu_end_iter ();
+  PSX_cd_end_iter ();
+  PSX_spu_end_iter ();
+  PSX_joy_end_iter ();
+  PSX_timers_end_iter ();
+
+  // Prepara següent iteració.
+  _sched.base+= (uint64_t) PSX_Clock;
+  ret= PSX_Clock;
+  PSX_Clock= 0;
+  PSX_PROFILE_END;
+
+  return ret;
+  
+} // end iter
+
+
+// Executa fins al següent inici del VBlank (vore PSX_vblank_in). Per
+// si no es generen VBlanks (pantalla mal configurada) para després de
+// MAX_FRAME_CC cicles.
+static int
+run_frame (void)
+{
+
+  int ret;
+
+
+  _stop_at_vblank= true;
+  ret= iter ( MAX_FRAME_CC );
+  _stop_at_vblank= false;
+
+  return ret;
+  
+} // end run_frame
+
+
+// Reserva memòria per a guardar un estat de grandària SIZE.
+static bool
+ahead_reserve (
+               const size_t size
+               )
+{
+
+  uint8_t *mem;
+  
+
+  if ( size > _ahead.capacity )
+    {
+      mem= realloc ( _ahead.buf, size );
+      if ( mem == NULL )
+        {
+          _warning ( _udata, "run-ahead: no s'ha pogut reservar memòria"
+        	     " per a guardar l'estat" );
+          return false;
+        }
+      _ahead.buf= mem;
+      _ahead.capacity= size;
+    }
+
+  return true;
+  
+} // end ahead_reserve
+
+
+// Guarda l'estat per al run-ahead.
+static bool
+ahead_save (void)
+{
+
+  size_t size;
+  
+
+  size= PSX_state_size ();
+  if ( !ahead_reserve ( size ) ) return false;
+  _ahead.size= PSX_state_save ( _ahead.buf, size );
+
+  return _ahead.size != 0;
+  
+} // end ahead_save
+
+
+static void
+main_state_save (
+        	 PSX_State *st
+        	 )
+{
+
+  PSX_STATE_WRITE ( st, PSX_BusOwner );
+  PSX_STATE_WRITE ( st, _sched.base );
+  PSX_STATE_WRITE ( st, _frames );
+  
+} // end main_state_save
+
+
+static void
+main_state_load (
+        	 PSX_State *st
+        	 )
+{
+
+  PSX_STATE_READ ( st, PSX_BusOwner );
+  PSX_STATE_READ ( st, _sched.base );
+  PSX_STATE_READ ( st, _frames );
+  
+} // end main_state_load
+
+
+// Blocs de l'estat. L'ordre és el de càrrega.
+static const struct
+{
+  uint32_t id;
+  void (*save) (PSX_State *st);
+  void (*load) (PSX_State *st);
+} _chunks[]=
+  {
+    { STATE_ID('M','A','I','N'), main_state_save, main_state_load },
+    { STATE_ID('C','P','U',' '), PSX_cpu_state_save, PSX_cpu_state_load },
+    { STATE_ID('G','T','E',' '), PSX_gte_state_save, PSX_gte_state_load },
+    { STATE_ID('M','E','M',' '), PSX_mem_state_save, PSX_mem_state_load },
+    { STATE_ID('I','N','T',' '), PSX_int_state_save, PSX_int_state_load },
+    { STATE_ID('D','M','A',' '), PSX_dma_state_save, PSX_dma_state_load },
+    { STATE_ID('M','D','E','C'), PSX_mdec_state_save, PSX_mdec_state_load },
+    { STATE_ID('G','P','U',' '), PSX_gpu_state_save, PSX_gpu_state_load },
+    { STATE_ID('C','D',' ',' '), PSX_cd_state_save, PSX_cd_state_load },
+    { STATE_ID('S','P','U',' '), PSX_spu_state_save, PSX_spu_state_load },
+    { STATE_ID('J','O','Y',' '), PSX_joy_state_save, PSX_joy_state_load },
+    { STATE_ID('T','I','M','R'), PSX_timers_state_save,
+      PSX_timers_state_load },
+    { STATE_ID('E','X','E',' '), PSX_exe_state_save, PSX_exe_state_load }
+  };
+
+#define NCHUNKS ((int) (sizeof(_chunks)/sizeof(_chunks[0])))
+
+// Posició i grandària de cada bloc (en l'ordre de _chunks) dins d'un
+// estat guardat.
+typedef struct
+{
+  size_t   offset[NCHUNKS];
+  uint32_t size[NCHUNKS];
+} state_index_t;
+
+
+static void
+state_save (
+            PSX_State *st
+            )
+{
+
+  state_header_t header;
+  state_chunk_t chunk;
+  size_t begin;
+  int n;
+  
+
+  header.magic= STATE_MAGIC;
+  header.version= PSX_STATE_VERSION;
+  header.bom= STATE_BOM;
+  header.nchunks= NCHUNKS;
+  PSX_STATE_WRITE ( st, header );
+  for ( n= 0; n < NCHUNKS && !st->error; ++n )
+    {
+      
+      // La grandària es completa al final.
+      begin= st->pos;
+      chunk.id= _chunks[n].id;
+      chunk.size= 0;
+      PSX_STATE_WRITE ( st, chunk );
+      _chunks[n].save ( st );
+      if ( st->out != NULL && !st->error )
+        {
+          chunk.size= (uint32_t) (st->pos-begin-sizeof(chunk));
+          memcpy ( st->out+begin, &chunk, sizeof(chunk) );
+        }
+      
+    }
+  
+} // end state_save
+
+
+// Comprova la capçalera i localitza els blocs sense tocar l'estat.
+static bool
+state_index (
+             const uint8_t *buf,
+             const size_t   size,
+             state_index_t *ind
+             )
+{
+
+  PSX_State st;
+  state_header_t header;
+  state_chunk_t chunk;
+  uint32_t i;
+  int n;
+  
+  
+  st.out= NULL;
+  st.in= buf;
+  st.size= size;
+  st.pos= 0;
+  st.error= false;
+
+  // Capçalera.
+  PSX_STATE_READ ( &st, header );
+  if ( st.error || header.magic != STATE_MAGIC ||
+       header.version != PSX_STATE_VERSION || header.bom != STATE_BOM )
+    return false;
+
+  // Localitza els blocs. Els desconeguts s'ignoren.
+  for ( n= 0; n < NCHUNKS; ++n ) ind->offset[n]= 0;
+  for ( i= 0; i < header.nchunks; ++i )
+    {
+      PSX_STATE_READ ( &st, chunk );
+      if ( st.error || chunk.size > st.size-st.pos ) return false;
+      for ( n= 0; n < NCHUNKS && _chunks[n].id != chunk.id; ++n );
+      if ( n < NCHUNKS )
+        {
+          if ( ind->offset[n] != 0 ) return false;
+          ind->offset[n]= st.pos;
+          ind->size[n]= chunk.size;
+        }
+      st.pos+= chunk.size;
+    }
+  for ( n= 0; n < NCHUNKS; ++n )
+    if ( ind->offset[n] == 0 ) return false;
+
+  return true;
+  
+} // end state_index
+
+
+// Carrega els blocs en els mòduls. Si torna fals l'estat pot haver
+// quedat a mitges.
+static bool
+state_apply (
+             const uint8_t       *buf,
+             const state_index_t *ind
+             )
+{
+
+  PSX_State sub;
+  int n;
+  
+
+  // Cada mòdul ha de consumir exactament el seu bloc.
+  for ( n= 0; n < NCHUNKS; ++n )
+    {
+      sub.out= NULL;
+      sub.in= buf+ind->offset[n];
+      sub.size= ind->size[n];
+      sub.pos= 0;
+      sub.error= false;
+      _chunks[n].load ( &sub );
+      if ( sub.error || sub.pos != sub.size ) return false;
+    }
+
+  return true;
+  
+} // end state_apply
+
+
+// Guarda l'estat actual en _undo. Torna la grandària o 0 si falla.
+static size_t
+undo_save (void)
+{
+
+  size_t size;
+  uint8_t *mem;
+  
+
+  size= PSX_state_size ();
+  if ( size > _undo.capacity )
+    {
+      mem= realloc ( _undo.buf, size );
+      if ( mem == NULL )
+        {
+          _warning ( _udata, "no s'ha pogut reservar memòria per a"
+        	     " desfer la càrrega de l'estat" );
+          return 0;
+        }
+      _undo.buf= mem;
+      _undo.capacity= size;
+    }
+  
+  return PSX_state_save ( _undo.buf, size );
+  
+} // end undo_save
+
+
+// Torna a l'estat guardat per ahead_save. L'ha generat PSX_state_save
+// just abans, així que no cal la còpia per a desfer de PSX_state_load.
+static bool
+ahead_load (void)
+{
+
+  state_index_t ind;
+
+
+  return state_index ( _ahead.buf, _ahead.size, &ind ) &&
+    state_apply ( _ahead.buf, &ind );
+  
+} // end ahead_load
+
+
 static void
 reset (void)
 {
@@ -65,21 +770,71 @@ reset (void)
   PSX_mdec_reset ();
   PSX_spu_reset ();
   PSX_dma_reset ();
+  PSX_exe_reset ();
   PSX_cpu_reset (); // Important que siga l'últim.
   _reset= false;
   
 } // end reset
 
 
+static void
+check_signals (
+               bool *stop
+               )
+{
+  
+  if ( _check != NULL )
+    {
+      _check ( stop, &_reset, _udata );
+      if ( _reset ) reset ();
+    }
+  
+} // end check_signals
+
+
 
 
 /***********************/
 /* VARIABLES PÚBLIQUES */
 /***********************/
 
+#ifndef PSX_MULTI_INSTANCE
 int PSX_Clock;
 int PSX_NextEventCC;
 PSX_BusOwnerType PSX_BusOwner;
+#ifdef PSX_COUNTERS
+PSX_Counters PSX_Cnt;
+#endif
+#else
+PSX_CTX_DEFINE ( PSX_Core, CORE );
+
+_Thread_local void *PSX_ctx_blocks[PSX_CTX_NUM];
+
+static _Thread_local PSX_Context *_current_ctx;
+
+static const size_t *const _ctx_sizes[PSX_CTX_NUM]=
+  {
+    &PSX_ctx_size_CORE,
+    &PSX_ctx_size_MAIN,
+    &PSX_ctx_size_CPU,
+    &PSX_ctx_size_CPU_CACHE,
+    &PSX_ctx_size_CPU_REC,
+    &PSX_ctx_size_CPU_HLE,
+    &PSX_ctx_size_GTE,
+    &PSX_ctx_size_MEM,
+    &PSX_ctx_size_INT,
+    &PSX_ctx_size_DMA,
+    &PSX_ctx_size_MDEC,
+    &PSX_ctx_size_TIMERS,
+    &PSX_ctx_size_GPU,
+    &PSX_ctx_size_CD,
+    &PSX_ctx_size_SPU,
+    &PSX_ctx_size_JOY,
+    &PSX_ctx_size_MOVIE,
+    &PSX_ctx_size_EXE,
+    &PSX_ctx_size_REWIND
+  };
+#endif
 
 
 
@@ -88,16 +843,105 @@ PSX_BusOwnerType PSX_BusOwner;
 /* FUNCIONS PÚBLIQUES */
 /**********************/
 
+#ifdef PSX_MULTI_INSTANCE
+PSX_Context *
+PSX_context_new (void)
+{
+
+  size_t off[PSX_CTX_NUM],size;
+  uint8_t *mem;
+  PSX_Context *ctx;
+  int i;
+  
+
+  // Una única reserva, amb l'estat a zero com les variables estàtiques.
+  size= CTX_ROUND ( sizeof(PSX_Context) );
+  for ( i= 0; i < PSX_CTX_NUM; ++i )
+    {
+      off[i]= size;
+      size+= CTX_ROUND ( *(_ctx_sizes[i]) );
+    }
+  mem= (uint8_t *) calloc ( 1, size );
+  if ( mem == NULL ) return NULL;
+  ctx= (PSX_Context *) mem;
+  for ( i= 0; i < PSX_CTX_NUM; ++i )
+    ctx->blocks[i]= mem + off[i];
+  
+  return ctx;
+  
+} // end PSX_context_new
+
+
+void
+PSX_context_free (
+        	  PSX_Context *ctx
+        	  )
+{
+
+  PSX_Context *prev;
+  
+
+  if ( ctx == NULL ) return;
+
+  // La memòria dels mòduls s'allibera amb el context actiu.
+  prev= _current_ctx;
+  PSX_context_make_current ( ctx );
+  PSX_cpu_close ();
+  PSX_gpu_close ();
+  PSX_cd_close ();
+  PSX_movie_close ();
+  PSX_exe_close ();
+  PSX_rewind_disable ();
+  free ( _ahead.buf );
+  _ahead.buf= NULL;
+  free ( _undo.buf );
+  _undo.buf= NULL;
+  PSX_context_make_current ( prev == ctx ? NULL : prev );
+  free ( ctx );
+  
+} // end PSX_context_free
+
+
+void
+PSX_context_make_current (
+        		  PSX_Context *ctx
+        		  )
+{
+
+  _current_ctx= ctx;
+  if ( ctx != NULL )
+    memcpy ( PSX_ctx_blocks, ctx->blocks, sizeof(PSX_ctx_blocks) );
+  else
+    memset ( PSX_ctx_blocks, 0, sizeof(PSX_ctx_blocks) );
+  
+} // end PSX_context_make_current
+
+
+PSX_Context *
+PSX_context_get_current (void)
+{
+  return _current_ctx;
+} // end PSX_context_get_current
+#endif
+
+
 void
 PSX_init (
           const uint8_t bios[PSX_BIOS_SIZE],
           const PSX_Frontend *frontend,       // Frontend.
           void               *udata,          // Dades frontend.
-          PSX_Renderer       *renderer
+          PSX_Renderer       *renderer,
+          const PSX_Options  *opts
           )
 {
 
+  PSX_CPUBackend backend;
+
+  
   _reset= false;
+
+  // Opcions.
+  backend= opts!=NULL ? opts->cpu : PSX_CPU_INTERPRETER;
   
   // Callbacks.
   _check= frontend->check;
@@ -112,14 +956,19 @@ PSX_init (
   PSX_Clock= 0;
   PSX_NextEventCC= INT_MAX;
   PSX_BusOwner= PSX_BUS_OWNER_CPU;
+  sched_init (); // Abans dels mòduls, que ja planifiquen events.
+  _frames= 0;
+  _frames_drawn= 0;
   
   // Mòduls.
-  PSX_cpu_init ( frontend->warning, udata );
+  PSX_cpu_init ( backend, frontend->warning, udata );
+  PSX_cpu_set_idle_skip ( opts==NULL || !opts->no_idle_skip );
+  PSX_cpu_set_bios_hle ( opts!=NULL && opts->bios_hle );
   PSX_gte_init ( frontend->warning,
         	 frontend->trace!=NULL?frontend->trace->gte_cmd_trace:NULL,
         	 frontend->trace!=NULL?frontend->trace->gte_mem_access:NULL,
         	 udata );
-  PSX_mem_init ( bios,
+  PSX_mem_init ( bios, opts!=NULL && opts->shared_bios,
         	 frontend->trace!=NULL?frontend->trace->mem_changed:NULL,
         	 frontend->trace!=NULL?frontend->trace->mem_access:NULL,
         	 frontend->trace!=NULL?frontend->trace->mem_access16:NULL,
@@ -137,9 +986,14 @@ PSX_init (
   PSX_cd_init ( frontend->trace!=NULL?frontend->trace->cd_cmd:NULL,
         	frontend->warning, udata );
   PSX_spu_init ( frontend->play_sound, frontend->warning, udata );
+  PSX_movie_init ( frontend->get_ctrl_state, frontend->warning, udata );
   PSX_joy_init ( frontend->warning,
-        	 frontend->get_ctrl_state,
+        	 PSX_movie_get_ctrl_state,
         	 udata );
+  PSX_exe_init ( opts!=NULL && opts->fast_boot, frontend->warning, udata );
+  PSX_rewind_init ();
+  PSX_reset_profile ();
+  PSX_reset_counters ();
 
 } // end PSX_init
 
@@ -151,92 +1005,91 @@ PSX_iter (
           )
 {
 
-  /* NOTA!!! L'esquema de clock(end_iter) està relacionat en executar
-   * un bloc d'instruccions seguit i que es puguen produir events en
-   * eixe bloc. Les interrupcions són molt sensibles a això. Per
-   * aquest motiu 'INT' clockeja tots els components abans
-   * d'actualitzar les mascares i altres valors. No obstant açò amb la
-   * nova aproximació de parar abans de cada event en realitat ja no
-   * és necessaria que 'INT' faça res. Sí que és cert, que si en el
-   * futur la únitat mínima deixara de ser la instrucció i fora un
-   * bloc d'instruccions tornaria a ser necessari. Per aquest motiu he
-   * decidit comentar l'esquema clock(end_iter), per si de cas en el
-   * futur ho recupere.
-   */
+  int ret;
+
+
+  ret= iter ( cc );
+  PSX_rewind_end_iter ( _frames );
+  check_signals ( stop );
+  
+  return ret;
   
-  int cc_remain,cc_total,tmp;
+} // end PSX_iter
 
+
+int
+PSX_run_ahead (
+               const int  frames,
+               bool      *stop
+               )
+{
+
+  int ret,n;
   
-  cc_remain= cc;
-  cc_total= 0;
-  while ( cc_remain > 0 )
+
+  // Abans d'amagar el frame real es comprova que es podrà guardar
+  // l'estat. Si no, s'executa un frame normal. La grandària de
+  // l'estat no canvia en un frame (excepte si es carrega un EXE), i
+  // si després creix i no hi ha memòria es perd la imatge d'aquest
+  // frame però no l'emulació.
+  if ( frames <= 0 || !ahead_reserve ( PSX_state_size () ) )
+    ret= run_frame ();
+  else
     {
 
-      // Inicialitza iteració.
-      PSX_NextEventCC= cc_remain;
-      // NOTA!! GTE no genera events.
-      tmp= PSX_dma_next_event_cc ();
-      if ( tmp != -1 && tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_mdec_next_event_cc ();
-      if ( tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_gpu_next_event_cc ();
-      if ( tmp != -1 && tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_cd_next_event_cc ();
-      if ( tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_spu_next_event_cc ();
-      if ( tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_joy_next_event_cc ();
-      if ( tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      tmp= PSX_timers_next_event_cc ();
-      if ( tmp < PSX_NextEventCC ) PSX_NextEventCC= tmp;
-      PSX_Clock= 0;
+      // Frame real. Es sent però no es veu.
+      PSX_gpu_set_output ( false );
+      ret= run_frame ();
 
-      // Itera tot els que es puga.
-      // NOTA!! Qualsevol actualització de PSX_NextEventCC s'ha de fer
-      // tenint en compte que en aquesta iteració en portem PSX_Clock
-      // cicles executats.
-      do {
-        switch ( PSX_BusOwner )
-          {
-          case PSX_BUS_OWNER_CPU:
-            PSX_Clock+= tmp= PSX_cpu_next_inst ();
-            break;
-          case PSX_BUS_OWNER_DMA:
-            PSX_Clock+= tmp= PSX_dma_run ();
-            break;
-          case PSX_BUS_OWNER_CPU_DMA:
-            PSX_Clock+= tmp= PSX_cpu_next_inst ();
-            PSX_dma_run_cc ( tmp );
-            break;
-          }
-      } while ( PSX_Clock < PSX_NextEventCC );
-      
-      // Consumeix cicles pendets (executa possible event)
-      PSX_dma_end_iter ();
-      PSX_gte_end_iter ();
-      PSX_mdec_end_iter ();
-      PSX_gpu_end_iter ();
-      PSX_cd_end_iter ();
-      PSX_spu_end_iter ();
-      PSX_joy_end_iter ();
-      PSX_timers_end_iter ();
-
-      // Prepara següent iteració.
-      cc_total+= PSX_Clock;
-      cc_remain-= PSX_Clock;
+      // Frames especulatius. Sols es veu l'últim.
+      if ( ahead_save () )
+        {
+          PSX_spu_set_output ( false );
+          for ( n= 1; n < frames; ++n )
+            run_frame ();
+          PSX_gpu_set_output ( true );
+          run_frame ();
+          PSX_spu_set_output ( true );
+          // No hauria de fallar mai (l'estat és nostre), però si falla
+          // la màquina ha quedat a mitges entre el futur i el present.
+          if ( !ahead_load () )
+            {
+              _warning ( _udata, "run-ahead: no s'ha pogut tornar a"
+        		 " l'estat real, es reinicia la màquina" );
+              reset ();
+            }
+        }
+      else PSX_gpu_set_output ( true );
       
     }
+  PSX_rewind_end_iter ( _frames );
+  check_signals ( stop );
+  
+  return ret;
+  
+} // end PSX_run_ahead
 
-  // Senyals externes
-  if ( _check != NULL )
-    {
-      _check ( stop, &_reset, _udata );
-      if ( _reset ) reset ();
-    }
+
+int
+PSX_run_frame (
+               bool *updated,
+               bool *stop
+               )
+{
+
+  uint64_t frames;
+  int ret;
+
+
+  frames= _frames_drawn;
+  ret= run_frame ();
+  if ( updated != NULL ) *updated= _frames_drawn!=frames;
+  PSX_rewind_end_iter ( _frames );
+  check_signals ( stop );
   
-  return cc_total;
+  return ret;
   
-} // end PSX_iter
+} // end PSX_run_frame
 
 
 void
@@ -308,8 +1161,256 @@ PSX_trace (void)
   PSX_gte_set_mode_trace ( false );
   PSX_mem_set_mode_trace ( false );
   ret= PSX_Clock;
+  _sched.base+= (uint64_t) ret;
   PSX_Clock= 0;
   
   return ret;
   
 } // end PSX_trace
+
+
+void
+PSX_schedule (
+              const PSX_EventSource src,
+              const int             cc
+              )
+{
+  
+  int deadline;
+
+  
+  if ( cc < 0 || cc >= INT_MAX-PSX_Clock ) deadline= INT_MAX;
+  else                                     deadline= PSX_Clock + cc;
+  sched_set ( src, deadline );
+  
+} // end PSX_schedule
+
+
+uint64_t
+PSX_get_timestamp (void)
+{
+  return _sched.base + (uint64_t) PSX_Clock;
+} // end PSX_get_timestamp
+
+
+void
+PSX_end_frame (
+               const bool drawn
+               )
+{
+
+  PSX_movie_end_frame ( _frames );
+  ++_frames;
+  if ( drawn ) ++_frames_drawn;
+  
+} // end PSX_end_frame
+
+
+void
+PSX_vblank_in (void)
+{
+
+  if ( !_stop_at_vblank ) return;
+  _stop_at_vblank= false;
+  _sched.end= PSX_Clock;
+  sched_update_next_event ();
+  
+} // end PSX_vblank_in
+
+
+#ifdef PSX_PROFILE
+void
+PSX_profile_begin (
+        	   const PSX_ProfileSection sec
+        	   )
+{
+
+  profile_update ();
+  assert ( _prof.N < PROFILE_DEPTH );
+  if ( _prof.N == 0 || _prof.stack[_prof.N-1] != (int) sec )
+    ++_prof.prof.calls[sec];
+  _prof.stack[_prof.N++]= (int) sec;
+  
+} // end PSX_profile_begin
+
+
+void
+PSX_profile_end (void)
+{
+
+  assert ( _prof.N > 0 );
+  profile_update ();
+  --_prof.N;
+  
+} // end PSX_profile_end
+#endif
+
+
+bool
+PSX_get_profile (
+        	 PSX_Profile *prof
+        	 )
+{
+
+#ifdef PSX_PROFILE
+  profile_update ();
+  *prof= _prof.prof;
+  return true;
+#else
+  memset ( prof, 0, sizeof(*prof) );
+  return false;
+#endif
+  
+} // end PSX_get_profile
+
+
+void
+PSX_reset_profile (void)
+{
+#ifdef PSX_PROFILE
+  memset ( &_prof.prof, 0, sizeof(_prof.prof) );
+  _prof.t= profile_now ();
+#endif
+} // end PSX_reset_profile
+
+
+bool
+PSX_get_counters (
+        	  PSX_Counters *cnt
+        	  )
+{
+
+#ifdef PSX_COUNTERS
+  *cnt= PSX_Cnt;
+#else
+  memset ( cnt, 0, sizeof(*cnt) );
+#endif
+  cnt->cycles= PSX_get_timestamp ();
+#ifdef PSX_COUNTERS
+  return true;
+#else
+  return false;
+#endif
+  
+} // end PSX_get_counters
+
+
+void
+PSX_reset_counters (void)
+{
+#ifdef PSX_COUNTERS
+  memset ( &PSX_Cnt, 0, sizeof(PSX_Cnt) );
+#endif
+} // end PSX_reset_counters
+
+
+uint64_t
+PSX_get_frame_count (void)
+{
+  return _frames;
+} // end PSX_get_frame_count
+
+
+void
+PSX_state_write (
+        	 PSX_State    *st,
+        	 const void   *data,
+        	 const size_t  nbytes
+        	 )
+{
+  
+  if ( st->error ) return;
+  if ( st->out != NULL )
+    {
+      if ( nbytes > st->size-st->pos ) { st->error= true; return; }
+      memcpy ( st->out+st->pos, data, nbytes );
+    }
+  st->pos+= nbytes;
+  
+} // end PSX_state_write
+
+
+void
+PSX_state_read (
+        	PSX_State    *st,
+        	void         *data,
+        	const size_t  nbytes
+        	)
+{
+
+  if ( !st->error && nbytes > st->size-st->pos ) st->error= true;
+  if ( st->error ) { memset ( data, 0, nbytes ); return; }
+  memcpy ( data, st->in+st->pos, nbytes );
+  st->pos+= nbytes;
+  
+} // end PSX_state_read
+
+
+size_t
+PSX_state_size (void)
+{
+
+  PSX_State st;
+
+  
+  st.out= NULL;
+  st.in= NULL;
+  st.size= 0;
+  st.pos= 0;
+  st.error= false;
+  state_save ( &st );
+  
+  return st.pos;
+  
+} // end PSX_state_size
+
+
+size_t
+PSX_state_save (
+        	uint8_t      *buf,
+        	const size_t  size
+        	)
+{
+
+  PSX_State st;
+
+
+  st.out= buf;
+  st.in= NULL;
+  st.size= size;
+  st.pos= 0;
+  st.error= false;
+  state_save ( &st );
+  
+  return st.error ? 0 : st.pos;
+  
+} // end PSX_state_save
+
+
+bool
+PSX_state_load (
+        	const uint8_t *buf,
+        	const size_t   size
+        	)
+{
+
+  state_index_t ind,undo_ind;
+  size_t undo_size;
+  bool ok;
+  
+  
+  if ( !state_index ( buf, size, &ind ) ) return false;
+
+  // Si un bloc està mal, es torna a l'estat d'abans. La còpia l'ha
+  // feta PSX_state_save i per tant sempre es pot carregar.
+  undo_size= undo_save ();
+  if ( undo_size == 0 ) return false;
+  if ( state_apply ( buf, &ind ) ) return true;
+  ok= state_index ( _undo.buf, undo_size, &undo_ind ) &&
+    state_apply ( _undo.buf, &undo_ind );
+  assert ( ok );
+  (void) ok;
+  
+  return false;
+  
+} // end PSX_state_load
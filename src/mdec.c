@@ -156,109 +156,131 @@ static const int ZIGZAG[64]=
 /* ESTAT */
 /*********/
 
-// Callbacks.
-static PSX_Warning *_warning;
-static void *_udata;
+typedef struct
+{
 
-// Taules de quantificació.
-static uint8_t _qt[2][64];
+  // Callbacks.
+  PSX_Warning *_warning;
+  void *_udata;
 
-// Taula d'escalat.
-static struct
-{
-  double   v[64];
-  uint64_t diff;    // Si és 0 aleshores és igual al per defecte.
-} _st;
+  // Taules de quantificació.
+  uint8_t _qt[2][64];
 
-static double _scalezag[64];
-static int _zagzig[64];
+  // Taula d'escalat.
+  struct
+  {
+    double   v[64];
+    uint64_t diff;    // Si és 0 aleshores és igual al per defecte.
+  } _st;
 
-// Fifos
-static fifo_t _fifo_in;
-static fifo_t _fifo_out;
+  double _scalezag[64];
+  int _zagzig[64];
 
-// Timing.
-static struct
-{
-  int  cc;
-  int  cc_used;
-  int  cc_current_macroblock;
-  int  cctoWriteMacroblock;
-  int  cctoEvent;
-} _timing;
-
-// Estat.
-static struct
-{
-  int      data_out_depth; // 0=4bit, 1=8bit, 2=24bit, 3=15bit
-  bool     data_out_signed;
-  bool     data_out_bit15_set;
-  uint16_t remaining_words; // Per al status.
-  uint32_t current_block;
-  bool     waiting_write_macroblock;
-  enum
-    {
-     DECODE,
-     SET_QT,
-     SET_ST,
-     NONE
-  }        cmd;
-  union
+  // Fifos
+  fifo_t _fifo_in;
+  fifo_t _fifo_out;
+
+  // Timing.
+  struct
   {
-    struct
-    {
-      bool end; // Indica que s'ha acabat.
-      int  cr_state; // Estat de la corutina.
-      int  rldb_state; // Estat de la corutina rl_decode_block
-      bool fast_idct;
-    } decode;
-    struct
-    {
-      int pos;    // Següent posició a escriure.
-      int N;      // Número total de bytes a escriure.
-    } set_qt;
-    struct
+    int  cc;
+    int  cc_used;
+    int  cc_current_macroblock;
+    int  cctoWriteMacroblock;
+    int  cctoEvent;
+  } _timing;
+
+  // Estat.
+  struct
+  {
+    int      data_out_depth; // 0=4bit, 1=8bit, 2=24bit, 3=15bit
+    bool     data_out_signed;
+    bool     data_out_bit15_set;
+    uint16_t remaining_words; // Per al status.
+    uint32_t current_block;
+    bool     waiting_write_macroblock;
+    enum
+      {
+       DECODE,
+       SET_QT,
+       SET_ST,
+       NONE
+    }        cmd;
+    union
     {
-      int      pos;     // Següent posició a escriure.
-      uint64_t mask;    // Utilitzat per a calcular diff.
-    } set_st;
-  } var;
-} _state;
-
-// Variables funcions estàtiques.
-static struct
-{
+      struct
+      {
+        bool end; // Indica que s'ha acabat.
+        int  cr_state; // Estat de la corutina.
+        int  rldb_state; // Estat de la corutina rl_decode_block
+        bool fast_idct;
+      } decode;
+      struct
+      {
+        int pos;    // Següent posició a escriure.
+        int N;      // Número total de bytes a escriure.
+      } set_qt;
+      struct
+      {
+        int      pos;     // Següent posició a escriure.
+        uint64_t mask;    // Utilitzat per a calcular diff.
+      } set_st;
+    } var;
+  } _state;
+
+  // Variables funcions estàtiques.
+  struct
+  {
 
-  // rl_decode_block.
-  int32_t rldb_n;
-  int rldb_k,rldb_q_scale;
-  bool rldb_stop;
+    // rl_decode_block.
+    int32_t rldb_n;
+    int rldb_k,rldb_q_scale;
+    bool rldb_stop;
 
-  // run_decode blocks.
-  double  crblk[64];
-  double  cbblk[64];
-  double  yblk[64];
-  uint8_t fb[16*16*3 /*Grandària màxima 24b*/];
-  int     fb_N; // Paraules que s'han escrit.
-  
-} _v;
+    // run_decode blocks.
+    double  crblk[64];
+    double  cbblk[64];
+    double  yblk[64];
+    uint8_t fb[16*16*3 /*Grandària màxima 24b*/];
+    int     fb_N; // Paraules que s'han escrit.
 
-// Buffer d'entrada per al decode.
-static struct
-{
-  uint16_t v[BIN_SIZE]; // No s'ha de plenar mai.
-  int      p;    // Posició del primer valor.
-  int      N;    // Número de valors.
-} _bin;
+  } _v;
 
-// Control del DMA.
-static struct
-{
-  bool in_enabled;
-  bool out_enabled;
-  bool out_waiting; // Hi ha un sync pendent.
-  int  out_waiting_nwords;
-} _dma;
+  // Buffer d'entrada per al decode.
+  struct
+  {
+    uint16_t v[BIN_SIZE]; // No s'ha de plenar mai.
+    int      p;    // Posició del primer valor.
+    int      N;    // Número de valors.
+  } _bin;
+
+  // Control del DMA.
+  struct
+  {
+    bool in_enabled;
+    bool out_enabled;
+    bool out_waiting; // Hi ha un sync pendent.
+    int  out_waiting_nwords;
+  } _dma;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, MDEC );
+
+#define STATE PSX_CTX_STATE ( state_t, MDEC )
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _qt (STATE._qt)
+#define _st (STATE._st)
+#define _scalezag (STATE._scalezag)
+#define _zagzig (STATE._zagzig)
+#define _fifo_in (STATE._fifo_in)
+#define _fifo_out (STATE._fifo_out)
+#define _timing (STATE._timing)
+#define _state (STATE._state)
+#define _v (STATE._v)
+#define _bin (STATE._bin)
+#define _dma (STATE._dma)
 
 
 
@@ -321,22 +343,13 @@ static void
 update_timing_event (void)
 {
 
-  int tmp;
-
-  
   // Actualitza cctoEvent
   _timing.cctoEvent= CCMAX;
   if ( _state.waiting_write_macroblock )
     _timing.cctoEvent= _timing.cctoWriteMacroblock;
 
-  // Update PSX_NextEventCC
-  tmp= PSX_mdec_next_event_cc ();
-  if ( tmp != -1 )
-    {
-      tmp+= PSX_Clock;
-      if ( tmp < PSX_NextEventCC )
-        PSX_NextEventCC= tmp;
-    }
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_MDEC, PSX_mdec_next_event_cc () );
   
 } // end update_timing_event
 
@@ -1067,6 +1080,7 @@ process_fifo_in (void)
   uint32_t word;
 
   
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_MDEC );
   while ( _fifo_in.N && !_state.waiting_write_macroblock )
     {
 
@@ -1093,6 +1107,7 @@ process_fifo_in (void)
         }
       
     }
+  PSX_PROFILE_END;
   
 } // end process_fifo_in
 
@@ -1154,6 +1169,54 @@ clock (void)
 } // end clock
 
 
+// Sols es guarden les paraules ocupades.
+static void
+fifo_state_save (
+        	 PSX_State    *st,
+        	 const fifo_t *fifo
+        	 )
+{
+
+  int n;
+  
+
+  PSX_STATE_WRITE ( st, fifo->p );
+  PSX_STATE_WRITE ( st, fifo->N );
+  n= FIFO_SIZE-fifo->p;
+  if ( n > fifo->N ) n= fifo->N;
+  PSX_state_write ( st, &(fifo->v[fifo->p]), sizeof(uint32_t)*n );
+  PSX_state_write ( st, &(fifo->v[0]), sizeof(uint32_t)*(fifo->N-n) );
+  
+} // end fifo_state_save
+
+
+static void
+fifo_state_load (
+        	 PSX_State *st,
+        	 fifo_t    *fifo
+        	 )
+{
+
+  int n;
+  
+
+  PSX_STATE_READ ( st, fifo->p );
+  PSX_STATE_READ ( st, fifo->N );
+  if ( fifo->p < 0 || fifo->p >= FIFO_SIZE ||
+       fifo->N < 0 || fifo->N > FIFO_SIZE )
+    {
+      fifo->p= fifo->N= 0;
+      st->error= true;
+      return;
+    }
+  n= FIFO_SIZE-fifo->p;
+  if ( n > fifo->N ) n= fifo->N;
+  PSX_state_read ( st, &(fifo->v[fifo->p]), sizeof(uint32_t)*n );
+  PSX_state_read ( st, &(fifo->v[0]), sizeof(uint32_t)*(fifo->N-n) );
+  
+} // end fifo_state_load
+
+
 
 
 /**********************/
@@ -1200,7 +1263,88 @@ PSX_mdec_init (
 
 
 void
-PSX_mdec_end_iter(void)
+PSX_mdec_state_save (
+        	     PSX_State *st
+        	     )
+{
+
+  PSX_STATE_WRITE ( st, _qt );
+  PSX_STATE_WRITE ( st, _st );
+  PSX_STATE_WRITE ( st, _scalezag );
+  PSX_STATE_WRITE ( st, _zagzig );
+  fifo_state_save ( st, &_fifo_in );
+  fifo_state_save ( st, &_fifo_out );
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _state );
+  PSX_STATE_WRITE ( st, _v );
+  PSX_STATE_WRITE ( st, _bin );
+  PSX_STATE_WRITE ( st, _dma );
+  
+} // end PSX_mdec_state_save
+
+
+void
+PSX_mdec_state_load (
+        	     PSX_State *st
+        	     )
+{
+
+  int n;
+  
+
+  PSX_STATE_READ ( st, _qt );
+  PSX_STATE_READ ( st, _st );
+  PSX_STATE_READ ( st, _scalezag );
+  PSX_STATE_READ ( st, _zagzig );
+  for ( n= 0; n < 64; ++n )
+    if ( _zagzig[n] < 0 || _zagzig[n] > 63 ) goto error;
+  fifo_state_load ( st, &_fifo_in );
+  fifo_state_load ( st, &_fifo_out );
+  PSX_STATE_READ ( st, _timing );
+
+  // Estat del comandament.
+  PSX_STATE_READ ( st, _state );
+  if ( (unsigned) _state.cmd > NONE ||
+       _state.data_out_depth < 0 || _state.data_out_depth > 3 )
+    goto error;
+  if ( _state.cmd == SET_QT &&
+       ((_state.var.set_qt.N != 64 && _state.var.set_qt.N != 128) ||
+        _state.var.set_qt.pos < 0 || (_state.var.set_qt.pos&0x3) ||
+        _state.var.set_qt.pos+4*(_state.remaining_words+1) !=
+        _state.var.set_qt.N) )
+    goto error;
+  if ( _state.cmd == SET_ST &&
+       (_state.var.set_st.pos < 0 || (_state.var.set_st.pos&0x1) ||
+        _state.var.set_st.pos+2*(_state.remaining_words+1) != 64) )
+    goto error;
+
+  // Descodificació.
+  PSX_STATE_READ ( st, _v );
+  if ( _v.rldb_k < 0 || (_v.rldb_k > 63 && !_v.rldb_stop) ||
+       _v.fb_N < 0 || _v.fb_N > (16*16*3)/4 )
+    goto error;
+  PSX_STATE_READ ( st, _bin );
+  if ( _bin.p < 0 || _bin.p >= BIN_SIZE ||
+       _bin.N < 0 || _bin.N > BIN_SIZE )
+    goto error;
+  PSX_STATE_READ ( st, _dma );
+
+  return;
+  
+ error:
+  init_zagzig ();
+  _state.cmd= NONE;
+  _state.data_out_depth= 0;
+  _v.rldb_k= 0;
+  _v.fb_N= 0;
+  _bin.p= _bin.N= 0;
+  st->error= true;
+  
+} // end PSX_mdec_state_load
+
+
+void
+PSX_mdec_clock (void)
 {
 
   int cc;
@@ -1214,6 +1358,15 @@ PSX_mdec_end_iter(void)
       if ( _timing.cc >= _timing.cctoEvent )
         clock ();
     }
+  
+} // end PSX_mdec_clock
+
+
+void
+PSX_mdec_end_iter (void)
+{
+
+  PSX_mdec_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_mdec_end_iter
@@ -25,7 +25,9 @@
  */
 
 
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -114,61 +116,214 @@ typedef struct
 /* ESTAT */
 /*********/
 
-/* Callbacks. */
-static PSX_MemChanged *_mem_changed;
-static PSX_MemAccess *_mem_access;
-static PSX_MemAccess16 *_mem_access16;
-static PSX_MemAccess8 *_mem_access8;
-static void *_udata;
-
-/* Funcions. */
-static bool (*_mem_read) (const uint32_t addr,uint32_t *dst);
-static bool (*_mem_write) (const uint32_t addr,const uint32_t data);
-static bool (*_mem_read16) (const uint32_t addr,uint16_t *dst,const bool is_le);
-static bool (*_mem_write16) (const uint32_t addr,const uint16_t data,
-        		     const bool is_le);
-static bool (*_mem_read8) (const uint32_t addr,uint8_t *dst,const bool is_le);
-static bool (*_mem_write8) (const uint32_t addr,const uint8_t data,
-        		    const uint16_t data16,const bool is_le);
-
-/* RAM */
-static struct
+typedef struct
+{
+
+  /* Callbacks. */
+  PSX_MemChanged *_mem_changed;
+  PSX_MemAccess *_mem_access;
+  PSX_MemAccess16 *_mem_access16;
+  PSX_MemAccess8 *_mem_access8;
+  void *_udata;
+
+  /* Funcions. */
+  bool (*_mem_read) (const uint32_t addr,uint32_t *dst);
+  bool (*_mem_write) (const uint32_t addr,const uint32_t data);
+  bool (*_mem_read16) (const uint32_t addr,uint16_t *dst,const bool is_le);
+  bool (*_mem_write16) (const uint32_t addr,const uint16_t data,
+          			     const bool is_le);
+  bool (*_mem_read8) (const uint32_t addr,uint8_t *dst,const bool is_le);
+  bool (*_mem_write8) (const uint32_t addr,const uint8_t data,
+          			    const uint16_t data16,const bool is_le);
+
+  /* RAM */
+  struct
+  {
+
+    uint32_t ram_size; /* Valor del registre. */
+    uint8_t  v[RAM_SIZE];
+    uint32_t end_ram32;
+    uint32_t end_ram16;
+    uint32_t end_ram8;
+    uint32_t end_hz32;
+    uint32_t end_hz16;
+    uint32_t end_hz8;
+    bool     locked_00800000;
+
+  } _ram;
+
+  /* BIOS. */
+  struct
+  {
+
+    // Es llig amb 'const uint32_t *', ha d'estar alineada a 4.
+    _Alignas(4) uint8_t mem[PSX_BIOS_SIZE];
+    delay_size_t        ds;
+    const uint8_t      *v; // Apunta a 'mem' o a la BIOS compartida.
+    bool                shared;
+
+  } _bios;
+
+  /* Altres. */
+  delay_size_t _exp3;
+  exp_t _exp1,_exp2;
+  uint32_t _spu,_cdrom,_com;
+
+  uint8_t _scratchpad[1024];
+
+  /* Pàgines de RAM amb codi vigilat. */
+  bool _code_watch[PSX_MEM_CODE_RAM_PAGES];
+
+  /* Taules d'accés ràpid. Sols es toquen les entrades de la RAM, el
+     scratchpad i la BIOS, la resta sempre valen 0. */
+  struct
+  {
+
+    bool            enabled;
+    PSX_MemFastPage t[PSX_MEM_FAST_NONE+1][PSX_MEM_FAST_PAGES];
+
+  } _fast;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, MEM );
+
+#define STATE PSX_CTX_STATE ( state_t, MEM )
+#define _mem_changed (STATE._mem_changed)
+#define _mem_access (STATE._mem_access)
+#define _mem_access16 (STATE._mem_access16)
+#define _mem_access8 (STATE._mem_access8)
+#define _udata (STATE._udata)
+#define _mem_read (STATE._mem_read)
+#define _mem_write (STATE._mem_write)
+#define _mem_read16 (STATE._mem_read16)
+#define _mem_write16 (STATE._mem_write16)
+#define _mem_read8 (STATE._mem_read8)
+#define _mem_write8 (STATE._mem_write8)
+#define _ram (STATE._ram)
+#define _bios (STATE._bios)
+#define _exp3 (STATE._exp3)
+#define _exp1 (STATE._exp1)
+#define _exp2 (STATE._exp2)
+#define _spu (STATE._spu)
+#define _cdrom (STATE._cdrom)
+#define _com (STATE._com)
+#define _scratchpad (STATE._scratchpad)
+#define _code_watch (STATE._code_watch)
+#define _fast (STATE._fast)
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+fast_set_page (
+               const int      page,
+               uint8_t       *p,
+               const uint32_t rsize,
+               const uint32_t rsize_nosp,
+               const uint32_t wsize,
+               const uint32_t wsize_nosp
+               )
 {
+
+  _fast.t[PSX_MEM_FAST_READ][page].p= p;
+  _fast.t[PSX_MEM_FAST_READ][page].size= rsize;
+  _fast.t[PSX_MEM_FAST_READ_NOSP][page].p= p;
+  _fast.t[PSX_MEM_FAST_READ_NOSP][page].size= rsize_nosp;
+  _fast.t[PSX_MEM_FAST_WRITE][page].p= p;
+  _fast.t[PSX_MEM_FAST_WRITE][page].size= wsize;
+  _fast.t[PSX_MEM_FAST_WRITE_NOSP][page].p= p;
+  _fast.t[PSX_MEM_FAST_WRITE_NOSP][page].size= wsize_nosp;
+  
+} // end fast_set_page
+
+
+/* Actualitza els espills d'una pàgina de RAM (0..PSX_MEM_CODE_RAM_PAGES-1). */
+static void
+fast_update_ram_page (
+        	      const int page
+        	      )
+{
+
+  int n;
+  uint32_t wsize;
   
-  uint32_t ram_size; /* Valor del registre. */
-  uint8_t  v[RAM_SIZE];
-  uint32_t end_ram32;
-  uint32_t end_ram16;
-  uint32_t end_ram8;
-  uint32_t end_hz32;
-  uint32_t end_hz16;
-  uint32_t end_hz8;
-  bool     locked_00800000;
+
+  wsize= _code_watch[page] ? 0 : PSX_MEM_FAST_PAGE_SIZE;
+  for ( n= page;
+        n < (0x00800000/PSX_MEM_FAST_PAGE_SIZE);
+        n+= PSX_MEM_CODE_RAM_PAGES )
+    {
+      if ( _fast.enabled &&
+           (uint32_t) n*PSX_MEM_FAST_PAGE_SIZE < _ram.end_ram8 )
+        fast_set_page ( n, &(_ram.v[page*PSX_MEM_FAST_PAGE_SIZE]),
+        		PSX_MEM_FAST_PAGE_SIZE, PSX_MEM_FAST_PAGE_SIZE,
+        		wsize, wsize );
+      else fast_set_page ( n, NULL, 0, 0, 0, 0 );
+    }
   
-} _ram;
+} // end fast_update_ram_page
+
 
-/* BIOS. */
-static struct
+static void
+fast_update_bios (void)
 {
 
-  delay_size_t ds;
-  uint8_t      v[PSX_BIOS_SIZE];
+  int n;
+  uint32_t begin,size;
   
-} _bios;
 
-/* Altres. */
-static delay_size_t _exp3;
-static exp_t _exp1,_exp2;
-static uint32_t _spu,_cdrom,_com;
+  for ( n= 0x1FC00000/PSX_MEM_FAST_PAGE_SIZE; n < PSX_MEM_FAST_PAGES; ++n )
+    {
+      begin= (uint32_t) n*PSX_MEM_FAST_PAGE_SIZE;
+      if ( _fast.enabled && _bios.ds.end8 > begin )
+        {
+          size= _bios.ds.end8-begin;
+          if ( size > PSX_MEM_FAST_PAGE_SIZE ) size= PSX_MEM_FAST_PAGE_SIZE;
+          fast_set_page ( n, (uint8_t *) &(_bios.v[begin&BIOS_MASK]),
+        		  size, size, 0, 0 );
+        }
+      else fast_set_page ( n, NULL, 0, 0, 0, 0 );
+    }
+  
+} // end fast_update_bios
 
-static uint8_t _scratchpad[1024];
 
+static void
+fast_update (void)
+{
 
+  int n;
+  
 
+  for ( n= 0; n < PSX_MEM_CODE_RAM_PAGES; ++n )
+    fast_update_ram_page ( n );
+  if ( _fast.enabled )
+    fast_set_page ( 0x1F800000/PSX_MEM_FAST_PAGE_SIZE, _scratchpad,
+        	    1024, 0, 1024, 0 );
+  else
+    fast_set_page ( 0x1F800000/PSX_MEM_FAST_PAGE_SIZE, NULL, 0, 0, 0, 0 );
+  fast_update_bios ();
+  
+} // end fast_update
+
+
+static void
+code_modified (
+               const int page
+               )
+{
+
+  _code_watch[page]= false;
+  fast_update_ram_page ( page );
+  PSX_cpu_code_modified ( page );
+  
+} // end code_modified
 
-/*********************/
-/* FUNCIONS PRIVADES */
-/*********************/
 
 static void
 write_ram_size (
@@ -184,6 +339,9 @@ write_ram_size (
    *   Cycle)
    * - 8 Unknown (no effect) (should be set for 8MB, cleared for 2MB)
    */
+
+  int n;
+  
   
   _ram.ram_size= data;
   switch ( (data>>9)&0x7 )
@@ -233,6 +391,8 @@ write_ram_size (
   _ram.end_hz16= _ram.end_hz8>>1;
   _ram.end_ram32= _ram.end_ram8>>2;
   _ram.end_hz32= _ram.end_hz8>>2;
+  for ( n= 0; n < PSX_MEM_CODE_RAM_PAGES; ++n )
+    fast_update_ram_page ( n );
   if ( _mem_changed != NULL ) _mem_changed ( _udata );
   
 } /* end write_ram_size */
@@ -335,7 +495,10 @@ write_bios_delay_size (
         	       const uint32_t data
         	       )
 {
+  
   write_delay_size ( &_bios.ds, data, 0x1FC00000 );
+  fast_update_bios ();
+  
 } /* end write_bios_delay_size */
 
 
@@ -367,16 +530,38 @@ write_exp2_delay_size (
 
 
 static void
-init_bios (
-           const uint8_t bios[PSX_BIOS_SIZE]
-           )
+set_bios (
+          const uint8_t bios[PSX_BIOS_SIZE]
+          )
 {
 
 #ifdef PSX_LE
-  memcpy ( _bios.v, bios, PSX_BIOS_SIZE );
+  if ( _bios.shared )
+    {
+      _bios.v= bios;
+      assert ( (((uintptr_t) _bios.v)&3) == 0 );
+      return;
+    }
+  memcpy ( _bios.mem, bios, PSX_BIOS_SIZE );
 #else
-  swap_u32 ( (uint32_t *) _bios.v, (const uint32_t *) bios, PSX_BIOS_SIZE>>2 );
+  swap_u32 ( (uint32_t *) _bios.mem, (const uint32_t *) bios,
+             PSX_BIOS_SIZE>>2 );
 #endif
+  _bios.v= _bios.mem;
+  assert ( (((uintptr_t) _bios.v)&3) == 0 );
+  
+} /* end set_bios */
+
+
+static void
+init_bios (
+           const uint8_t bios[PSX_BIOS_SIZE],
+           const bool    shared
+           )
+{
+
+  _bios.shared= shared;
+  set_bios ( bios );
   write_bios_delay_size ( 0x0013243F );
   
 } /* end init_bios */
@@ -973,7 +1158,7 @@ mem_read (
   else
     {
       if ( aux < _bios.ds.end32 )
-        *dst= ((uint32_t *) _bios.v)[aux&BIOS_MASK_32];
+        *dst= ((const uint32_t *) _bios.v)[aux&BIOS_MASK_32];
       else return false;
     }
   
@@ -1561,7 +1746,7 @@ mem_read16 (
 #else
           if ( is_le ) aux^= 1;
 #endif
-          *dst= ((uint16_t *) _bios.v)[aux&BIOS_MASK_16];
+          *dst= ((const uint16_t *) _bios.v)[aux&BIOS_MASK_16];
         }
       else return false;
     }
@@ -2771,7 +2956,12 @@ mem_write (
   aux= addr>>2;
   
   /* RAM. */
-  if ( aux < _ram.end_ram32 ) ((uint32_t *) _ram.v)[aux&RAM_MASK_32]= data;
+  if ( aux < _ram.end_ram32 )
+    {
+      aux&= RAM_MASK_32;
+      ((uint32_t *) _ram.v)[aux]= data;
+      if ( _code_watch[aux>>10] ) code_modified ( aux>>10 );
+    }
 
   /* La resta de l'àrea de la RAM. */
   else if ( aux <= (0x00800000>>2) )
@@ -3386,7 +3576,9 @@ mem_write16 (
 #else
       if ( is_le ) aux^= 1;
 #endif
-      ((uint16_t *) _ram.v)[aux&RAM_MASK_16]= data;
+      aux&= RAM_MASK_16;
+      ((uint16_t *) _ram.v)[aux]= data;
+      if ( _code_watch[aux>>11] ) code_modified ( aux>>11 );
     }
 
   /* La resta de l'àrea de la RAM. */
@@ -3847,7 +4039,9 @@ mem_write8 (
 #else
       if ( is_le ) aux^= 1;
 #endif
-      _ram.v[aux&RAM_MASK]= data;
+      aux&= RAM_MASK;
+      _ram.v[aux]= data;
+      if ( _code_watch[aux>>12] ) code_modified ( aux>>12 );
     }
 
   /* La resta de l'àrea de la RAM. */
@@ -5149,6 +5343,7 @@ mem_write8_trace (
 void
 PSX_mem_init (
               const uint8_t    bios[PSX_BIOS_SIZE],
+              const bool       shared_bios,
               PSX_MemChanged  *mem_changed,
               PSX_MemAccess   *mem_access,
               PSX_MemAccess16 *mem_access16,
@@ -5174,7 +5369,7 @@ PSX_mem_init (
   
   /* Estat. */
   init_ram ();
-  init_bios ( bios );
+  init_bios ( bios, shared_bios );
   write_exp3_delay_size ( 0x00003022 );
   init_exp ( &_exp1, 0x1F000000, 0x0013243F );
   init_exp ( &_exp2, 0x1F802000, 0x00070777 );
@@ -5182,6 +5377,13 @@ PSX_mem_init (
   _cdrom= 0x00020843;
   _com= 0x00031125;
   memset ( _scratchpad, 0, 1024 );
+  memset ( _code_watch, 0, sizeof(_code_watch) );
+#ifdef PSX_LE
+  _fast.enabled= true;
+#else
+  _fast.enabled= false;
+#endif
+  fast_update ();
   
 } /* end PSX_mem_init */
 
@@ -5296,6 +5498,12 @@ PSX_mem_set_mode_trace (
           _mem_write8= mem_write8;
         }
     }
+
+  // En mode traça tots els accessos han de passar per les funcions.
+#ifdef PSX_LE
+  _fast.enabled= !val;
+  fast_update ();
+#endif
   
 } /* end PSX_mem_set_mode_trace */
 
@@ -5313,16 +5521,146 @@ PSX_mem_get_map (
 } /* end PSX_mem_get_map */
 
 
+void
+PSX_mem_state_save (
+                    PSX_State *st
+                    )
+{
+
+  PSX_STATE_WRITE ( st, _ram.ram_size );
+  PSX_STATE_WRITE ( st, _ram.v );
+  PSX_STATE_WRITE ( st, _ram.end_ram32 );
+  PSX_STATE_WRITE ( st, _ram.end_ram16 );
+  PSX_STATE_WRITE ( st, _ram.end_ram8 );
+  PSX_STATE_WRITE ( st, _ram.end_hz32 );
+  PSX_STATE_WRITE ( st, _ram.end_hz16 );
+  PSX_STATE_WRITE ( st, _ram.end_hz8 );
+  PSX_STATE_WRITE ( st, _ram.locked_00800000 );
+  PSX_STATE_WRITE ( st, _bios.ds );
+  PSX_STATE_WRITE ( st, _exp1 );
+  PSX_STATE_WRITE ( st, _exp2 );
+  PSX_STATE_WRITE ( st, _exp3 );
+  PSX_STATE_WRITE ( st, _spu );
+  PSX_STATE_WRITE ( st, _cdrom );
+  PSX_STATE_WRITE ( st, _com );
+  PSX_STATE_WRITE ( st, _scratchpad );
+  
+} // end PSX_mem_state_save
+
+
+void
+PSX_mem_state_load (
+                    PSX_State *st
+                    )
+{
+
+  uint8_t page[PSX_MEM_CODE_PAGE_SIZE];
+  int n;
+
+  
+  // RAM. Sols es copien les pàgines que canvien, i sols eixes perden
+  // el codi traduït per la UCP (es tracten com una escriptura).
+  PSX_STATE_READ ( st, _ram.ram_size );
+  for ( n= 0; n < PSX_MEM_CODE_RAM_PAGES; ++n )
+    {
+      PSX_STATE_READ ( st, page );
+      if ( memcmp ( &_ram.v[n*PSX_MEM_CODE_PAGE_SIZE], page, sizeof(page) ) )
+        {
+          memcpy ( &_ram.v[n*PSX_MEM_CODE_PAGE_SIZE], page, sizeof(page) );
+          if ( _code_watch[n] ) code_modified ( n );
+        }
+    }
+  PSX_STATE_READ ( st, _ram.end_ram32 );
+  PSX_STATE_READ ( st, _ram.end_ram16 );
+  PSX_STATE_READ ( st, _ram.end_ram8 );
+  PSX_STATE_READ ( st, _ram.end_hz32 );
+  PSX_STATE_READ ( st, _ram.end_hz16 );
+  PSX_STATE_READ ( st, _ram.end_hz8 );
+  PSX_STATE_READ ( st, _ram.locked_00800000 );
+  PSX_STATE_READ ( st, _bios.ds );
+  PSX_STATE_READ ( st, _exp1 );
+  PSX_STATE_READ ( st, _exp2 );
+  PSX_STATE_READ ( st, _exp3 );
+  PSX_STATE_READ ( st, _spu );
+  PSX_STATE_READ ( st, _cdrom );
+  PSX_STATE_READ ( st, _com );
+  PSX_STATE_READ ( st, _scratchpad );
+
+  fast_update ();
+  
+} // end PSX_mem_state_load
+
+
 void
 PSX_change_bios (
                  const uint8_t bios[PSX_BIOS_SIZE]
                  )
 {
 
-#ifdef PSX_LE
-  memcpy ( _bios.v, bios, PSX_BIOS_SIZE );
-#else
-  swap_u32 ( (uint32_t *) _bios.v, (const uint32_t *) bios, PSX_BIOS_SIZE>>2 );
-#endif
+  int n;
+
+  
+  set_bios ( bios );
+  fast_update_bios ();
+
+  // Descarta el codi traduït.
+  for ( n= PSX_MEM_CODE_RAM_PAGES; n < PSX_MEM_CODE_PAGES; ++n )
+    PSX_cpu_code_modified ( n );
   
 } // end PSX_change_bios
+
+
+const uint32_t *
+PSX_mem_get_code_page (
+        	       const uint32_t  addr,
+        	       int            *page
+        	       )
+{
+
+  uint32_t aux;
+
+  
+  // RAM.
+  if ( addr < _ram.end_ram8 )
+    {
+      aux= addr&RAM_MASK&~(PSX_MEM_CODE_PAGE_SIZE-1);
+      *page= aux/PSX_MEM_CODE_PAGE_SIZE;
+      return (const uint32_t *) &(_ram.v[aux]);
+    }
+
+  // BIOS. Tota la pàgina ha d'estar dins de la BIOS.
+  else if ( addr >= 0x1FC00000 && addr < 0x20000000 &&
+            ((addr|(PSX_MEM_CODE_PAGE_SIZE-1))>>2) < _bios.ds.end32 )
+    {
+      aux= addr&BIOS_MASK&~(PSX_MEM_CODE_PAGE_SIZE-1);
+      *page= PSX_MEM_CODE_RAM_PAGES + aux/PSX_MEM_CODE_PAGE_SIZE;
+      return (const uint32_t *) &(_bios.v[aux]);
+    }
+
+  else return NULL;
+  
+} // end PSX_mem_get_code_page
+
+
+void
+PSX_mem_watch_code_page (
+        		 const int page
+        		 )
+{
+  
+  if ( page < PSX_MEM_CODE_RAM_PAGES && !_code_watch[page] )
+    {
+      _code_watch[page]= true;
+      fast_update_ram_page ( page );
+    }
+  
+} // end PSX_mem_watch_code_page
+
+
+const PSX_MemFastPage *
+PSX_mem_get_fast_pages (
+        		const PSX_MemFastTable table
+        		)
+{
+  return &(_fast.t[table][0]);
+} // end PSX_mem_get_fast_pages
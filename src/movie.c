@@ -0,0 +1,670 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  movie.c - Gravació i reproducció de l'entrada dels controladors.
+ *
+ */
+/*
+ * NOTA: Mentre es grava, l'estat de cada controlador es consulta al
+ * frontend una única vegada per frame, just quan comença el frame, i
+ * sols es guarden els canvis. El joc sempre llig els valors ja
+ * gravats, igual que en la reproducció. A més, al final de cada frame
+ * es guarda un hash de la UCP, la RAM i la VRAM. En reproduir,
+ * l'entrada es trau de la pel·lícula i els hashos es comparen amb els
+ * gravats.
+ *
+ * Si el número de frame va cap arrere (s'ha carregat un estat, per
+ * exemple pel rebobinat o el run-ahead) la gravació es talla després
+ * d'eixe frame. Com que l'entrada es consulta al principi del frame,
+ * qualsevol estat d'un frame ja té la seua entrada gravada.
+ *
+ * Format (tot en little-endian):
+ *
+ *   'PSXM', uint32 versió, uint64 primer frame, uint32 frames,
+ *   uint32 canvis controlador 1, uint32 canvis controlador 2,
+ *   canvis: { uint32 frame (relatiu), uint8 connectat, uint8 0,
+ *             uint16 botons }*
+ *   hashos: uint32 * frames
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define MOVIE_MAGIC 0x4D585350 // 'PSXM'
+
+#define MOVIE_VERSION 1
+
+#define HEADER_SIZE 28
+
+#define EVENT_SIZE 8
+
+#define NPORTS 2
+
+#define NO_FRAME (~((uint64_t) 0))
+
+#define HASH_PRIME 0x9E3779B97F4A7C15ULL
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+  uint32_t frame;   // Relatiu al primer frame.
+  bool     present; // El frontend ha tornat un estat (no NULL).
+  uint16_t buttons;
+} event_t;
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  // Callbacks.
+  PSX_GetControllerState *_get_ctrl_state;
+  PSX_Warning *_warning;
+  void *_udata;
+
+  // Pel·lícula.
+  struct
+  {
+
+    PSX_MovieStatus status;
+    uint64_t        start;    // Primer frame.
+    uint64_t        last;     // Últim frame vist.
+    int64_t         diverged; // Primer frame diferent o -1.
+    uint32_t        hash;     // Hash de l'últim frame.
+
+    // Canvis de cada controlador.
+    struct
+    {
+      event_t             *v;
+      size_t               N;
+      size_t               capacity;
+      uint64_t             latch;  // Frame de l'estat actual.
+      PSX_ControllerState  state;
+      bool                 present;
+    } ports[NPORTS];
+
+    // Hashos per frame.
+    uint32_t *hashes;
+    size_t    N;
+    size_t    capacity;
+
+    // Pel·lícula serialitzada.
+    uint8_t *out;
+
+  } _mv;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, MOVIE );
+
+#define STATE PSX_CTX_STATE ( state_t, MOVIE )
+#define _get_ctrl_state (STATE._get_ctrl_state)
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _mv (STATE._mv)
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+put32 (
+       uint8_t        *p,
+       const uint32_t  val
+       )
+{
+
+  p[0]= (uint8_t) val;
+  p[1]= (uint8_t) (val>>8);
+  p[2]= (uint8_t) (val>>16);
+  p[3]= (uint8_t) (val>>24);
+
+} // end put32
+
+
+static uint32_t
+get32 (
+       const uint8_t *p
+       )
+{
+  return
+    (uint32_t) p[0] | ((uint32_t) p[1]<<8) |
+    ((uint32_t) p[2]<<16) | ((uint32_t) p[3]<<24);
+} // end get32
+
+
+// Fa créixer un vector dinàmic.
+static bool
+grow (
+      void         **v,
+      size_t        *capacity,
+      const size_t   N,
+      const size_t   elem_size
+      )
+{
+
+  size_t new_cap;
+  void *mem;
+
+
+  if ( N < *capacity ) return true;
+  new_cap= *capacity==0 ? 1024 : (*capacity)*2;
+  mem= realloc ( *v, new_cap*elem_size );
+  if ( mem == NULL )
+    {
+      _warning ( _udata, "movie: no s'ha pogut reservar memòria" );
+      return false;
+    }
+  *v= mem;
+  *capacity= new_cap;
+
+  return true;
+
+} // end grow
+
+
+static void
+free_movie (void)
+{
+
+  int i;
+
+
+  for ( i= 0; i < NPORTS; ++i )
+    free ( _mv.ports[i].v );
+  free ( _mv.hashes );
+  free ( _mv.out );
+  memset ( &_mv, 0, sizeof(_mv) );
+  _mv.status= PSX_MOVIE_OFF;
+  _mv.diverged= -1;
+
+} // end free_movie
+
+
+static void
+reset_ports (void)
+{
+
+  int i;
+
+
+  for ( i= 0; i < NPORTS; ++i )
+    _mv.ports[i].latch= NO_FRAME;
+
+} // end reset_ports
+
+
+// Talla la gravació després del frame FRAME. L'entrada de FRAME es
+// conserva però el seu hash no.
+static void
+truncate_movie (
+        	const uint64_t frame
+        	)
+{
+
+  uint32_t rel;
+  int i;
+
+
+  rel= (uint32_t) (frame-_mv.start);
+  for ( i= 0; i < NPORTS; ++i )
+    while ( _mv.ports[i].N > 0 && _mv.ports[i].v[_mv.ports[i].N-1].frame > rel )
+      --_mv.ports[i].N;
+  if ( _mv.N > rel ) _mv.N= rel;
+  reset_ports ();
+
+} // end truncate_movie
+
+
+// Comprova si s'ha tornat arrere. Torna fals si la gravació s'ha
+// hagut de parar.
+static bool
+check_frame (
+             const uint64_t frame
+             )
+{
+
+  if ( frame >= _mv.last ) { _mv.last= frame; return true; }
+  if ( _mv.status != PSX_MOVIE_RECORDING ) { _mv.last= frame; return true; }
+  if ( frame < _mv.start )
+    {
+      _warning ( _udata, "movie: s'ha carregat un estat anterior a"
+        	 " l'inici de la gravació, es para la gravació" );
+      _mv.status= PSX_MOVIE_OFF;
+      return false;
+    }
+  truncate_movie ( frame );
+  _mv.last= frame;
+
+  return true;
+
+} // end check_frame
+
+
+// Consulta al frontend l'entrada del frame FRAME i la guarda si ha
+// canviat.
+static void
+record_ctrl_states (
+        	    const uint64_t frame
+        	    )
+{
+
+  const PSX_ControllerState *state;
+  event_t *last,*e;
+  bool present;
+  uint16_t buttons;
+  int joy;
+
+
+  for ( joy= 0; joy < NPORTS; ++joy )
+    {
+      state= _get_ctrl_state ( joy, _udata );
+      present= state!=NULL;
+      buttons= present ? state->buttons : 0;
+      last= _mv.ports[joy].N>0 ?
+        &(_mv.ports[joy].v[_mv.ports[joy].N-1]) : NULL;
+      if ( last != NULL && last->present == present &&
+           last->buttons == buttons )
+        continue;
+      if ( !grow ( (void **) &(_mv.ports[joy].v), &(_mv.ports[joy].capacity),
+        	   _mv.ports[joy].N, sizeof(event_t) ) )
+        {
+          _mv.status= PSX_MOVIE_OFF;
+          return;
+        }
+      e= &(_mv.ports[joy].v[_mv.ports[joy].N++]);
+      e->frame= (uint32_t) (frame-_mv.start);
+      e->present= present;
+      e->buttons= buttons;
+    }
+  reset_ports ();
+
+} // end record_ctrl_states
+
+
+static const PSX_ControllerState *
+play_ctrl_state (
+        	 const int      joy,
+        	 const uint64_t frame
+        	 )
+{
+
+  const event_t *v;
+  uint32_t rel;
+  size_t a,b,m;
+
+
+  if ( _mv.ports[joy].latch != frame )
+    {
+
+      // Últim canvi amb frame <= REL.
+      v= _mv.ports[joy].v;
+      rel= (uint32_t) (frame-_mv.start);
+      a= 0; b= _mv.ports[joy].N;
+      while ( a < b )
+        {
+          m= (a+b)/2;
+          if ( v[m].frame <= rel ) a= m+1;
+          else                     b= m;
+        }
+      _mv.ports[joy].latch= frame;
+      if ( a == 0 ) _mv.ports[joy].present= false;
+      else
+        {
+          _mv.ports[joy].present= v[a-1].present;
+          _mv.ports[joy].state.buttons= v[a-1].buttons;
+        }
+
+    }
+
+  return _mv.ports[joy].present ? &(_mv.ports[joy].state) : NULL;
+
+} // end play_ctrl_state
+
+
+static uint32_t
+frame_hash (void)
+{
+
+  uint64_t h[4],w;
+  const uint8_t *p;
+  size_t i,n;
+  int page,k;
+
+
+  h[0]= PSX_get_timestamp ();
+  h[1]= h[2]= h[3]= 0;
+  p= (const uint8_t *) &PSX_cpu_regs;
+  for ( i= 0; i+8 <= sizeof(PSX_cpu_regs); i+= 8 )
+    {
+      memcpy ( &w, p+i, 8 );
+      h[0]= (h[0]^w)*HASH_PRIME;
+    }
+
+  // RAM i VRAM, amb 4 cadenes independents.
+  for ( k= 0; k <= PSX_MEM_CODE_RAM_PAGES; ++k )
+    {
+      if ( k < PSX_MEM_CODE_RAM_PAGES )
+        {
+          p= (const uint8_t *)
+            PSX_mem_get_code_page ( (uint32_t) k*PSX_MEM_CODE_PAGE_SIZE, &page );
+          n= PSX_MEM_CODE_PAGE_SIZE;
+        }
+      else
+        {
+          p= (const uint8_t *) PSX_gpu_get_frame_buffer ();
+          n= 1024*512*2;
+        }
+      for ( i= 0; i < n; i+= 32 )
+        {
+          memcpy ( &w, p+i, 8 );    h[0]= (h[0]^w)*HASH_PRIME;
+          memcpy ( &w, p+i+8, 8 );  h[1]= (h[1]^w)*HASH_PRIME;
+          memcpy ( &w, p+i+16, 8 ); h[2]= (h[2]^w)*HASH_PRIME;
+          memcpy ( &w, p+i+24, 8 ); h[3]= (h[3]^w)*HASH_PRIME;
+        }
+    }
+  w= h[0] ^ (h[1]>>7) ^ (h[2]>>13) ^ (h[3]>>29);
+  w*= HASH_PRIME;
+
+  return (uint32_t) (w>>32);
+
+} // end frame_hash
+
+
+static uint8_t *
+serialize (
+           size_t *size
+           )
+{
+
+  uint8_t *mem,*p;
+  size_t i;
+  int j;
+
+
+  *size= HEADER_SIZE + (_mv.ports[0].N+_mv.ports[1].N)*EVENT_SIZE + _mv.N*4;
+  mem= malloc ( *size );
+  if ( mem == NULL ) return NULL;
+  p= mem;
+  put32 ( p, MOVIE_MAGIC ); p+= 4;
+  put32 ( p, MOVIE_VERSION ); p+= 4;
+  put32 ( p, (uint32_t) _mv.start ); p+= 4;
+  put32 ( p, (uint32_t) (_mv.start>>32) ); p+= 4;
+  put32 ( p, (uint32_t) _mv.N ); p+= 4;
+  for ( j= 0; j < NPORTS; ++j )
+    { put32 ( p, (uint32_t) _mv.ports[j].N ); p+= 4; }
+  for ( j= 0; j < NPORTS; ++j )
+    for ( i= 0; i < _mv.ports[j].N; ++i )
+      {
+        put32 ( p, _mv.ports[j].v[i].frame );
+        p[4]= (uint8_t) _mv.ports[j].v[i].present;
+        p[5]= 0;
+        p[6]= (uint8_t) _mv.ports[j].v[i].buttons;
+        p[7]= (uint8_t) (_mv.ports[j].v[i].buttons>>8);
+        p+= EVENT_SIZE;
+      }
+  for ( i= 0; i < _mv.N; ++i, p+= 4 )
+    put32 ( p, _mv.hashes[i] );
+
+  return mem;
+
+} // end serialize
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+void
+PSX_movie_init (
+        	PSX_GetControllerState *get_ctrl_state,
+        	PSX_Warning            *warning,
+        	void                   *udata
+        	)
+{
+
+  _get_ctrl_state= get_ctrl_state;
+  _warning= warning;
+  _udata= udata;
+  free_movie ();
+
+} // end PSX_movie_init
+
+
+void
+PSX_movie_close (void)
+{
+  free_movie ();
+} // end PSX_movie_close
+
+
+const PSX_ControllerState *
+PSX_movie_get_ctrl_state (
+        		  const int  joy,
+        		  void      *udata
+        		  )
+{
+
+  uint64_t frame;
+
+
+  if ( _mv.status != PSX_MOVIE_RECORDING && _mv.status != PSX_MOVIE_PLAYING )
+    return _get_ctrl_state ( joy, udata );
+  frame= PSX_get_frame_count ();
+  if ( !check_frame ( frame ) ) return _get_ctrl_state ( joy, udata );
+  if ( _mv.status == PSX_MOVIE_RECORDING || frame-_mv.start < _mv.N )
+    return play_ctrl_state ( joy, frame );
+  else return _get_ctrl_state ( joy, udata );
+
+} // end PSX_movie_get_ctrl_state
+
+
+void
+PSX_movie_end_frame (
+        	     const uint64_t frame
+        	     )
+{
+
+  uint64_t rel;
+
+
+  if ( _mv.status != PSX_MOVIE_RECORDING && _mv.status != PSX_MOVIE_PLAYING )
+    return;
+  if ( !check_frame ( frame ) ) return;
+  rel= frame-_mv.start;
+  _mv.hash= frame_hash ();
+  if ( _mv.status == PSX_MOVIE_RECORDING )
+    {
+      if ( rel == _mv.N &&
+           grow ( (void **) &_mv.hashes, &_mv.capacity,
+        	  _mv.N, sizeof(uint32_t) ) )
+        _mv.hashes[_mv.N++]= _mv.hash;
+      record_ctrl_states ( frame+1 );
+      _mv.last= frame+1;
+    }
+  else if ( rel < _mv.N )
+    {
+      if ( _mv.hashes[rel] != _mv.hash && _mv.diverged == -1 )
+        {
+          _mv.diverged= (int64_t) frame;
+          _warning ( _udata, "movie: el frame %llu no coincideix amb"
+        	     " la gravació", (unsigned long long) frame );
+        }
+      if ( rel+1 == _mv.N ) _mv.status= PSX_MOVIE_FINISHED;
+    }
+
+} // end PSX_movie_end_frame
+
+
+void
+PSX_movie_record (void)
+{
+
+  free_movie ();
+  _mv.start= _mv.last= PSX_get_frame_count ();
+  _mv.status= PSX_MOVIE_RECORDING;
+  record_ctrl_states ( _mv.start );
+
+} // end PSX_movie_record
+
+
+bool
+PSX_movie_play (
+        	const uint8_t *data,
+        	const size_t   size
+        	)
+{
+
+  const uint8_t *p;
+  uint32_t N,nevents[NPORTS],j;
+  size_t i;
+  event_t *e;
+
+
+  free_movie ();
+
+  // Capçalera.
+  if ( size < HEADER_SIZE ) goto error;
+  p= data;
+  if ( get32 ( p ) != MOVIE_MAGIC || get32 ( p+4 ) != MOVIE_VERSION )
+    goto error;
+  _mv.start= (uint64_t) get32 ( p+8 ) | ((uint64_t) get32 ( p+12 )<<32);
+  N= get32 ( p+16 );
+  nevents[0]= get32 ( p+20 );
+  nevents[1]= get32 ( p+24 );
+  if ( size != HEADER_SIZE +
+       ((size_t) nevents[0]+nevents[1])*EVENT_SIZE + ((size_t) N)*4 )
+    goto error;
+  if ( _mv.start != PSX_get_frame_count () )
+    {
+      _warning ( _udata, "movie: la pel·lícula comença en el frame %llu"
+        	 " però el simulador està en el frame %llu",
+        	 (unsigned long long) _mv.start,
+        	 (unsigned long long) PSX_get_frame_count () );
+      goto error;
+    }
+  p+= HEADER_SIZE;
+
+  // Canvis.
+  for ( j= 0; j < NPORTS; ++j )
+    {
+      _mv.ports[j].v= malloc ( sizeof(event_t)*(nevents[j]+1) );
+      if ( _mv.ports[j].v == NULL ) goto error;
+      _mv.ports[j].capacity= nevents[j]+1;
+      for ( i= 0; i < nevents[j]; ++i, p+= EVENT_SIZE )
+        {
+          e= &(_mv.ports[j].v[i]);
+          e->frame= get32 ( p );
+          e->present= p[4]!=0;
+          e->buttons= (uint16_t) p[6] | ((uint16_t) p[7]<<8);
+          if ( i > 0 && e->frame < _mv.ports[j].v[i-1].frame ) goto error;
+        }
+      _mv.ports[j].N= nevents[j];
+    }
+
+  // Hashos.
+  _mv.hashes= malloc ( sizeof(uint32_t)*(N+1) );
+  if ( _mv.hashes == NULL ) goto error;
+  _mv.capacity= N+1;
+  for ( i= 0; i < N; ++i, p+= 4 )
+    _mv.hashes[i]= get32 ( p );
+  _mv.N= N;
+
+  _mv.last= _mv.start;
+  reset_ports ();
+  _mv.status= N>0 ? PSX_MOVIE_PLAYING : PSX_MOVIE_FINISHED;
+
+  return true;
+
+ error:
+  free_movie ();
+  return false;
+
+} // end PSX_movie_play
+
+
+const uint8_t *
+PSX_movie_stop (
+        	size_t *size
+        	)
+{
+
+  bool recording;
+  uint8_t *out;
+
+
+  recording= _mv.status == PSX_MOVIE_RECORDING;
+  out= recording ? serialize ( size ) : NULL;
+  free_movie ();
+  _mv.out= out;
+  if ( recording && out == NULL )
+    _warning ( _udata, "movie: no s'ha pogut reservar memòria" );
+
+  return out;
+
+} // end PSX_movie_stop
+
+
+PSX_MovieStatus
+PSX_movie_status (void)
+{
+  return _mv.status;
+} // end PSX_movie_status
+
+
+int64_t
+PSX_movie_diverged_frame (void)
+{
+  return _mv.diverged;
+} // end PSX_movie_diverged_frame
+
+
+uint32_t
+PSX_movie_last_hash (void)
+{
+  return _mv.hash;
+} // end PSX_movie_last_hash
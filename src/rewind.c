@@ -0,0 +1,440 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  rewind.c - Rebobinat a partir d'estats guardats periòdicament.
+ *
+ */
+/*
+ * NOTA: Es guarda sencera sols l'última captura (KEY). Les anteriors
+ * es guarden en un anell de bytes com a deltes cap arrere: cada delta
+ * és l'XOR entre una captura i la següent, comprimit codificant les
+ * paraules de 64 bits a zero com a una longitud. Entre dos frames
+ * quasi tota la RAM, VRAM i RAM de l'SPU no canvia, per tant quasi
+ * tot són zeros. Quan no hi ha espai s'esborren els deltes més
+ * antics. Tota la memòria (KEY, buffer temporal i anell) es reserva
+ * d'una vegada i no es supera mai el límit indicat.
+ *
+ * Format d'un delta en l'anell:
+ *
+ *   uint32 nbytes (tot el delta), uint32 grandària de l'estat
+ *   { uint32 zeros, uint32 literals, literals*8 bytes }*
+ *   uint32 nbytes
+ *
+ * La grandària final permet recórrer l'anell cap arrere des del cap.
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+// Paraules a zero necessàries per a tallar una seqüència de literals.
+#define MIN_ZEROS 2
+
+// Paraules que es comproven de colp buscant zeros.
+#define BLOCK 8
+
+// Espai mínim per a l'anell.
+#define MIN_RING_SIZE (64*1024)
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+typedef struct
+{
+
+  bool      enabled;
+  int       interval;  // Frames entre captures.
+  uint64_t  last;      // Frame de l'última captura.
+  uint8_t  *mem;       // Tota la memòria reservada.
+  size_t    size;      // Grandària dels buffers (múltiple de 8).
+
+  // Última captura.
+  uint64_t *key;
+  uint64_t *tmp;
+  size_t    key_size;  // 0 si no hi ha captura.
+
+  // Anell de deltes.
+  uint8_t  *ring;
+  size_t    cap;
+  size_t    head;      // On s'escriu el següent delta.
+  size_t    tail;      // Delta més antic.
+  size_t    used;      // Bytes dels deltes complets.
+  size_t    cur;       // Bytes del delta que s'està escrivint.
+  int       N;         // Número de deltes.
+  bool      overflow;  // El delta actual no cap en l'anell.
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, REWIND );
+
+#define _rw PSX_CTX_STATE ( state_t, REWIND )
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+ring_read (
+           void         *dst,
+           const size_t  pos,
+           const size_t  nbytes
+           )
+{
+
+  size_t n;
+
+
+  n= _rw.cap-pos;
+  if ( n >= nbytes ) memcpy ( dst, _rw.ring+pos, nbytes );
+  else
+    {
+      memcpy ( dst, _rw.ring+pos, n );
+      memcpy ( ((uint8_t *) dst)+n, _rw.ring, nbytes-n );
+    }
+
+} // end ring_read
+
+
+static uint32_t
+ring_read32 (
+             const size_t pos
+             )
+{
+
+  uint32_t ret;
+
+
+  ring_read ( &ret, pos, sizeof(ret) );
+
+  return ret;
+
+} // end ring_read32
+
+
+static void
+drop_oldest (void)
+{
+
+  uint32_t nbytes;
+
+
+  nbytes= ring_read32 ( _rw.tail );
+  _rw.tail= (_rw.tail+nbytes)%_rw.cap;
+  _rw.used-= nbytes;
+  --_rw.N;
+
+} // end drop_oldest
+
+
+static void
+ring_copy (
+           const size_t  pos,
+           const void   *src,
+           const size_t  nbytes
+           )
+{
+
+  size_t n;
+
+
+  n= _rw.cap-pos;
+  if ( n >= nbytes ) memcpy ( _rw.ring+pos, src, nbytes );
+  else
+    {
+      memcpy ( _rw.ring+pos, src, n );
+      memcpy ( _rw.ring, ((const uint8_t *) src)+n, nbytes-n );
+    }
+
+} // end ring_copy
+
+
+// Afegeix bytes al delta que s'està escrivint. Si no hi ha espai
+// esborra els deltes més antics, i si tot i així no cap ho indica en
+// OVERFLOW.
+static void
+ring_write (
+            const void   *src,
+            const size_t  nbytes
+            )
+{
+
+  if ( _rw.overflow ) return;
+  while ( _rw.cap-_rw.used-_rw.cur < nbytes )
+    {
+      if ( _rw.N == 0 ) { _rw.overflow= true; return; }
+      drop_oldest ();
+    }
+  ring_copy ( (_rw.head+_rw.cur)%_rw.cap, src, nbytes );
+  _rw.cur+= nbytes;
+
+} // end ring_write
+
+
+static void
+write_token (
+             const uint64_t *lits,
+             const uint32_t  nzeros,
+             const uint32_t  nlits
+             )
+{
+
+  uint32_t hdr[2];
+
+
+  hdr[0]= nzeros; hdr[1]= nlits;
+  ring_write ( hdr, sizeof(hdr) );
+  if ( nlits > 0 ) ring_write ( lits, ((size_t) nlits)*8 );
+
+} // end write_token
+
+
+// Comprimeix KEY^TMP en l'anell. KEY queda destruït (conté el delta
+// en les posicions dels literals).
+static void
+write_delta (void)
+{
+
+  uint64_t *a,*b,x;
+  size_t i,j,W,zbeg,lbeg,nz;
+  uint32_t hdr[2];
+
+
+  a= _rw.key; b= _rw.tmp;
+  W= _rw.size/8;
+  _rw.cur= 0;
+  _rw.overflow= false;
+  hdr[0]= 0; // Es completa al final.
+  hdr[1]= (uint32_t) _rw.key_size;
+  ring_write ( hdr, sizeof(hdr) );
+  i= 0;
+  while ( i < W && !_rw.overflow )
+    {
+
+      // Zeros.
+      zbeg= i;
+      for ( ; i+BLOCK <= W; i+= BLOCK )
+        {
+          x= 0;
+          for ( j= 0; j < BLOCK; ++j )
+            x|= a[i+j]^b[i+j];
+          if ( x != 0 ) break;
+        }
+      while ( i < W && (a[i]^b[i]) == 0 ) ++i;
+
+      // Literals. Es tallen quan apareixen MIN_ZEROS zeros seguits.
+      lbeg= i; nz= 0;
+      for ( ; i < W && nz < MIN_ZEROS; ++i )
+        {
+          if ( a[i] == b[i] ) ++nz;
+          else                nz= 0;
+        }
+      i-= nz;
+      for ( j= lbeg; j < i; ++j )
+        a[j]^= b[j];
+      write_token ( &a[lbeg], (uint32_t) (lbeg-zbeg), (uint32_t) (i-lbeg) );
+
+    }
+  hdr[0]= (uint32_t) (_rw.cur+sizeof(uint32_t));
+  ring_write ( &hdr[0], sizeof(uint32_t) );
+
+  // Tanca el delta o el descarta.
+  if ( _rw.overflow )
+    {
+      while ( _rw.N > 0 ) drop_oldest ();
+      _rw.head= _rw.tail= 0;
+    }
+  else
+    {
+      ring_copy ( _rw.head, &hdr[0], sizeof(uint32_t) );
+      _rw.head= (_rw.head+_rw.cur)%_rw.cap;
+      _rw.used+= _rw.cur;
+      ++_rw.N;
+    }
+  _rw.cur= 0;
+
+} // end write_delta
+
+
+// Aplica el delta més nou sobre KEY i el lleva de l'anell.
+static void
+pop_delta (void)
+{
+
+  size_t beg,pos,i,j,W,n,k;
+  uint32_t nbytes,hdr[2];
+  uint64_t buf[64];
+
+
+  nbytes= ring_read32 ( (_rw.head+_rw.cap-sizeof(uint32_t))%_rw.cap );
+  beg= (_rw.head+_rw.cap-nbytes)%_rw.cap;
+  ring_read ( hdr, beg, sizeof(hdr) );
+  _rw.key_size= hdr[1];
+  pos= (beg+sizeof(hdr))%_rw.cap;
+  W= _rw.size/8;
+  i= 0;
+  while ( i < W )
+    {
+      ring_read ( hdr, pos, sizeof(hdr) );
+      pos= (pos+sizeof(hdr))%_rw.cap;
+      i+= hdr[0];
+      for ( n= hdr[1]; n > 0; n-= k )
+        {
+          k= n > 64 ? 64 : n;
+          ring_read ( buf, pos, k*8 );
+          pos= (pos+k*8)%_rw.cap;
+          for ( j= 0; j < k; ++j )
+            _rw.key[i++]^= buf[j];
+        }
+    }
+  _rw.head= beg;
+  _rw.used-= nbytes;
+  --_rw.N;
+
+} // end pop_delta
+
+
+static void
+capture (void)
+{
+
+  size_t n;
+  uint64_t *tmp;
+
+
+  n= PSX_state_size ();
+  if ( n > _rw.size ) return; // Sols en l'arrancada ràpida.
+  PSX_state_save ( (uint8_t *) _rw.tmp, n );
+  memset ( ((uint8_t *) _rw.tmp)+n, 0, _rw.size-n );
+  if ( _rw.key_size != 0 ) write_delta ();
+  tmp= _rw.key; _rw.key= _rw.tmp; _rw.tmp= tmp;
+  _rw.key_size= n;
+
+} // end capture
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+void
+PSX_rewind_init (void)
+{
+  PSX_rewind_disable ();
+} // end PSX_rewind_init
+
+
+void
+PSX_rewind_end_iter (
+                     const uint64_t frames
+                     )
+{
+
+  if ( !_rw.enabled ) return;
+  if ( _rw.key_size != 0 && frames-_rw.last < (uint64_t) _rw.interval )
+    return;
+  capture ();
+  _rw.last= frames;
+
+} // end PSX_rewind_end_iter
+
+
+bool
+PSX_rewind_enable (
+        	   const size_t max_bytes,
+        	   const int    interval
+        	   )
+{
+
+  size_t size;
+
+
+  PSX_rewind_disable ();
+  if ( interval <= 0 ) return false;
+  size= (PSX_state_size ()+7)&~((size_t) 7);
+  if ( max_bytes < 2*size + MIN_RING_SIZE ) return false;
+  _rw.mem= malloc ( max_bytes );
+  if ( _rw.mem == NULL ) return false;
+  _rw.size= size;
+  _rw.key= (uint64_t *) _rw.mem;
+  _rw.tmp= (uint64_t *) (_rw.mem+size);
+  _rw.key_size= 0;
+  _rw.ring= _rw.mem+2*size;
+  _rw.cap= max_bytes-2*size;
+  _rw.head= _rw.tail= _rw.used= _rw.cur= 0;
+  _rw.N= 0;
+  _rw.interval= interval;
+  _rw.last= 0;
+  _rw.enabled= true;
+
+  return true;
+
+} // end PSX_rewind_enable
+
+
+void
+PSX_rewind_disable (void)
+{
+
+  free ( _rw.mem );
+  memset ( &_rw, 0, sizeof(_rw) );
+
+} // end PSX_rewind_disable
+
+
+bool
+PSX_rewind_step (void)
+{
+
+  if ( !_rw.enabled || _rw.key_size == 0 ) return false;
+  if ( !PSX_state_load ( (const uint8_t *) _rw.key, _rw.key_size ) )
+    return false;
+  _rw.last= PSX_get_frame_count ();
+  if ( _rw.N > 0 ) pop_delta ();
+  else             _rw.key_size= 0;
+
+  return true;
+
+} // end PSX_rewind_step
+
+
+int
+PSX_rewind_count (void)
+{
+  return _rw.key_size != 0 ? _rw.N+1 : 0;
+} // end PSX_rewind_count
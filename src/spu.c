@@ -104,7 +104,7 @@ int FLAG=0;
 /* CONSTANTS */
 /*************/
 
-static int32_t GAUSS[]=
+static const int32_t GAUSS[]=
   {
     -0x001,-0x001,-0x001,-0x001,-0x001,-0x001,-0x001,-0x001,
     -0x001,-0x001,-0x001,-0x001,-0x001,-0x001,-0x001,-0x001,
@@ -271,146 +271,173 @@ struct voice
 /* ESTAT */
 /*********/
 
-// Callbacks.
-static PSX_PlaySound *_play_sound;
-static PSX_Warning *_warning;
-static void *_udata;
-
-// Exida.
-static struct
-{
-  int16_t v[PSX_AUDIO_BUFFER_SIZE*2];
-  int     N;
-} _out;
-
-// Veus.
-static voice_t _voices[24];
-
-// Memòria.
-static uint8_t _ram[RAM_SIZE];
-
-// Registres globals.
-static struct
-{
-  uint32_t pmon;
-  uint32_t endx;
-  uint32_t non; // noise ON/OFF.
-  uint32_t eon; // echo ON/OFF (Reverb)
-  uint32_t kon; // Key On
-  uint32_t koff; // Key Off
-  uint16_t unk_da0;
-  uint16_t unk_dbc[2];
-  uint16_t unk_e60[16];
-} _regs;
-
-// Soroll.
-static struct
-{
-  int32_t timer;
-  int     step;
-  int     shift;
-  int16_t out;
-} _noise;
-
-// CDrom.
-static struct
-{
-  int16_t         vol_l;
-  int16_t         vol_r;
-  uint32_t        rec_base_addr_l; // Buffer en RAM per a recording
-  uint32_t        rec_base_addr_r; // Buffer en RAM per a recording
-  unsigned short  rec_p; // Següent posició.
-  int16_t         out[2]; // 0 - left; 1 - right
-} _cd;
-
-// Main Volum i altres.
-static struct
-{
-
-  volume_t l; // left
-  volume_t r; // right
-  int16_t  ext_l; // External ??
-  int16_t  ext_r; // External ??
-  
-} _vol;
-
-// Transferència.
-static struct
-{
-  enum {
-    STOP_IO= 0,
-    MANUAL_WRITE= 1,
-    DMA_WRITE= 2,
-    DMA_READ= 3
-  }        mode;
-  int      transfer_type;
-  uint16_t transfer_reg;
-  uint16_t fifo[FIFO_SIZE];
-  int      N; // Elements en la FIFO.
-  uint16_t addr;
-  uint32_t current_addr;
-  bool     busy; // Ara mateix indica que en el següent cicle copiem
-        	 // el FIFO a MEM. És una manera com un altar de fer
-        	 // que no siga immediat la copia, però no sé si
-        	 // m'estic passant de cicles o no aplegue.
-} _io;
-
-// Control/Estat.
-static struct
-{
-  bool enabled; // SPU enabled (no afecta al CD)
-  bool mute; // No afecta al CD
-  bool reverb_master_enabled;
-  bool irq_enabled;
-  bool reverb_ext_enabled;
-  bool reverb_cd_enabled;
-  bool ext_enabled;
-  bool cd_enabled;
-  // Els bits 0-5 s'actualitzen més tart (en el STAT!!!)
-  uint16_t reg;
-  uint16_t reg_read; // Part baixa que es mostra en el STAT
-} _stat;
-
-// Interrupcions.
-static struct
+typedef struct
 {
-  bool     request;
-  uint32_t addr;
-  uint16_t addr16;
-  uint16_t addr_reg;
-} _int;
 
-// Controla els cicles.
-static struct
-{
-  int cc;
-  int cc_used;
-} _timing;
+  // Callbacks.
+  PSX_PlaySound *_play_sound;
+  bool _output; // Crida a _play_sound.
+  PSX_Warning *_warning;
+  void *_udata;
 
-// Reverb.
-static struct
-{
-  // Regs.
-  int16_t  vlout;
-  int16_t  vrout;
-  uint16_t mbase;
-  uint16_t regs[32];
-  // Aux.
-  uint32_t current_addr;
-  uint32_t base_addr;
-  int16_t  out[2]; // 0 - left; 1 - right
-  int16_t  tmp_l,tmp_r; // Input and output tmps.
-  int      step; // Switch 0(left)/1(right)
-} _reverb;
+  // Exida.
+  struct
+  {
+    int16_t v[PSX_AUDIO_BUFFER_SIZE*2];
+    int     N;
+  } _out;
 
-static struct
-{
+  // Veus.
+  voice_t _voices[24];
 
-  bool ready;
-  int  p;
-  int  N;
-  
-} _dma;
+  // Memòria.
+  uint8_t _ram[RAM_SIZE];
+
+  // Registres globals.
+  struct
+  {
+    uint32_t pmon;
+    uint32_t endx;
+    uint32_t non; // noise ON/OFF.
+    uint32_t eon; // echo ON/OFF (Reverb)
+    uint32_t kon; // Key On
+    uint32_t koff; // Key Off
+    uint16_t unk_da0;
+    uint16_t unk_dbc[2];
+    uint16_t unk_e60[16];
+  } _regs;
+
+  // Soroll.
+  struct
+  {
+    int32_t timer;
+    int     step;
+    int     shift;
+    int16_t out;
+  } _noise;
+
+  // CDrom.
+  struct
+  {
+    int16_t         vol_l;
+    int16_t         vol_r;
+    uint32_t        rec_base_addr_l; // Buffer en RAM per a recording
+    uint32_t        rec_base_addr_r; // Buffer en RAM per a recording
+    unsigned short  rec_p; // Següent posició.
+    int16_t         out[2]; // 0 - left; 1 - right
+  } _cd;
+
+  // Main Volum i altres.
+  struct
+  {
+
+    volume_t l; // left
+    volume_t r; // right
+    int16_t  ext_l; // External ??
+    int16_t  ext_r; // External ??
+
+  } _vol;
+
+  // Transferència.
+  struct
+  {
+    enum {
+      STOP_IO= 0,
+      MANUAL_WRITE= 1,
+      DMA_WRITE= 2,
+      DMA_READ= 3
+    }        mode;
+    int      transfer_type;
+    uint16_t transfer_reg;
+    uint16_t fifo[FIFO_SIZE];
+    int      N; // Elements en la FIFO.
+    uint16_t addr;
+    uint32_t current_addr;
+    bool     busy; // Ara mateix indica que en el següent cicle copiem
+          	 // el FIFO a MEM. És una manera com un altar de fer
+          	 // que no siga immediat la copia, però no sé si
+          	 // m'estic passant de cicles o no aplegue.
+  } _io;
+
+  // Control/Estat.
+  struct
+  {
+    bool enabled; // SPU enabled (no afecta al CD)
+    bool mute; // No afecta al CD
+    bool reverb_master_enabled;
+    bool irq_enabled;
+    bool reverb_ext_enabled;
+    bool reverb_cd_enabled;
+    bool ext_enabled;
+    bool cd_enabled;
+    // Els bits 0-5 s'actualitzen més tart (en el STAT!!!)
+    uint16_t reg;
+    uint16_t reg_read; // Part baixa que es mostra en el STAT
+  } _stat;
+
+  // Interrupcions.
+  struct
+  {
+    bool     request;
+    uint32_t addr;
+    uint16_t addr16;
+    uint16_t addr_reg;
+  } _int;
+
+  // Controla els cicles.
+  struct
+  {
+    int cc;
+    int cc_used;
+  } _timing;
+
+  // Reverb.
+  struct
+  {
+    // Regs.
+    int16_t  vlout;
+    int16_t  vrout;
+    uint16_t mbase;
+    uint16_t regs[32];
+    // Aux.
+    uint32_t current_addr;
+    uint32_t base_addr;
+    int16_t  out[2]; // 0 - left; 1 - right
+    int16_t  tmp_l,tmp_r; // Input and output tmps.
+    int      step; // Switch 0(left)/1(right)
+  } _reverb;
+
+  struct
+  {
+
+    bool ready;
+    int  p;
+    int  N;
+
+  } _dma;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, SPU );
+
+#define STATE PSX_CTX_STATE ( state_t, SPU )
+#define _play_sound (STATE._play_sound)
+#define _output (STATE._output)
+#define _warning (STATE._warning)
+#define _udata (STATE._udata)
+#define _out (STATE._out)
+#define _voices (STATE._voices)
+#define _ram (STATE._ram)
+#define _regs (STATE._regs)
+#define _noise (STATE._noise)
+#define _cd (STATE._cd)
+#define _vol (STATE._vol)
+#define _io (STATE._io)
+#define _stat (STATE._stat)
+#define _int (STATE._int)
+#define _timing (STATE._timing)
+#define _reverb (STATE._reverb)
+#define _dma (STATE._dma)
 
 
 
@@ -1477,7 +1504,7 @@ run_sample (void)
   
   if ( ++_out.N == PSX_AUDIO_BUFFER_SIZE )
     {
-      _play_sound ( _out.v, _udata );
+      if ( _output ) _play_sound ( _out.v, _udata );
       _out.N= 0;
     }
   
@@ -1488,7 +1515,7 @@ static void
 clock (void)
 {
 
-  int nsamples,n,cc,tmp;
+  int nsamples,n,cc;
 
 
   cc= PSX_Clock-_timing.cc_used;
@@ -1496,12 +1523,14 @@ clock (void)
   
   nsamples= _timing.cc/CCPERSAMPLE;
   _timing.cc%= CCPERSAMPLE;
+  PSX_COUNT_N ( spu_samples, nsamples );
+  PSX_PROFILE_BEGIN ( PSX_PROFILE_SPU );
   for ( n= 0; n < nsamples; ++n )
     run_sample ();
+  PSX_PROFILE_END;
 
-  tmp= PSX_Clock + PSX_spu_next_event_cc ();
-  if ( tmp < PSX_NextEventCC )
-    PSX_NextEventCC= tmp;
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_SPU, PSX_spu_next_event_cc () );
   
 } // end clock
 
@@ -1513,7 +1542,7 @@ clock (void)
 /**********************/
 
 void
-PSX_spu_end_iter (void)
+PSX_spu_clock (void)
 {
 
   int cc;
@@ -1527,6 +1556,15 @@ PSX_spu_end_iter (void)
       if ( _timing.cc >= CCPERSAMPLE )
         clock ();
     }
+  
+} // end PSX_spu_clock
+
+
+void
+PSX_spu_end_iter (void)
+{
+
+  PSX_spu_clock ();
   _timing.cc_used= 0;
   
 } // end PSX_spu_end_iter
@@ -1562,6 +1600,7 @@ PSX_spu_init (
   _play_sound= play_sound;
   _warning= warning;
   _udata= udata;
+  _output= true;
 
   // Inicialitza memòria.
   memset ( _ram, 0, sizeof(_ram) );
@@ -1604,6 +1643,113 @@ PSX_spu_init (
 } // end PSX_spu_init
 
 
+void
+PSX_spu_state_save (
+                    PSX_State *st
+                    )
+{
+
+  voice_t v;
+  int i,mod;
+  
+
+  // Veus. Els punters es guarden com a índexs.
+  for ( i= 0; i < 24; ++i )
+    {
+      v= _voices[i];
+      mod= v.pit.mod!=NULL ? (int) (v.pit.mod-_voices) : -1;
+      v.dec.v= NULL;
+      v.pit.mod= NULL;
+      PSX_STATE_WRITE ( st, v );
+      PSX_STATE_WRITE ( st, mod );
+    }
+  
+  PSX_STATE_WRITE ( st, _out );
+  PSX_STATE_WRITE ( st, _ram );
+  PSX_STATE_WRITE ( st, _regs );
+  PSX_STATE_WRITE ( st, _noise );
+  PSX_STATE_WRITE ( st, _cd );
+  PSX_STATE_WRITE ( st, _vol );
+  PSX_STATE_WRITE ( st, _io );
+  PSX_STATE_WRITE ( st, _stat );
+  PSX_STATE_WRITE ( st, _int );
+  PSX_STATE_WRITE ( st, _timing );
+  PSX_STATE_WRITE ( st, _reverb );
+  PSX_STATE_WRITE ( st, _dma );
+  
+} // end PSX_spu_state_save
+
+
+void
+PSX_spu_state_load (
+                    PSX_State *st
+                    )
+{
+
+  int i,mod;
+  
+
+  // Veus.
+  for ( i= 0; i < 24; ++i )
+    {
+      PSX_STATE_READ ( st, _voices[i] );
+      PSX_STATE_READ ( st, mod );
+      _voices[i].dec.v= &(_voices[i].dec.v_mem[3]);
+      if ( mod < 0 || mod >= 24 ) _voices[i].pit.mod= NULL;
+      else                        _voices[i].pit.mod= &(_voices[mod]);
+      if ( (unsigned) _voices[i].adsr.mode > RELEASE ||
+           (_voices[i].adsr.rec_base_addr != 0xFFFF &&
+            _voices[i].adsr.rec_base_addr > RAM_SIZE/2-0x200) )
+        goto error;
+    }
+  
+  PSX_STATE_READ ( st, _out );
+  if ( _out.N < 0 || _out.N >= PSX_AUDIO_BUFFER_SIZE ) goto error;
+  PSX_STATE_READ ( st, _ram );
+  PSX_STATE_READ ( st, _regs );
+  PSX_STATE_READ ( st, _noise );
+  PSX_STATE_READ ( st, _cd );
+  if ( _cd.rec_base_addr_l > RAM_SIZE/2-0x200 ||
+       _cd.rec_base_addr_r > RAM_SIZE/2-0x200 )
+    goto error;
+  PSX_STATE_READ ( st, _vol );
+  PSX_STATE_READ ( st, _io );
+  if ( (unsigned) _io.mode > DMA_READ ||
+       _io.N < 0 || _io.N > FIFO_SIZE ||
+       _io.current_addr >= RAM_SIZE )
+    goto error;
+  PSX_STATE_READ ( st, _stat );
+  PSX_STATE_READ ( st, _int );
+  PSX_STATE_READ ( st, _timing );
+  PSX_STATE_READ ( st, _reverb );
+  if ( _reverb.current_addr >= RAM_SIZE || _reverb.base_addr >= RAM_SIZE ||
+       _reverb.step < 0 || _reverb.step > 1 )
+    goto error;
+  PSX_STATE_READ ( st, _dma );
+  if ( _dma.p < 0 || _dma.p > FIFO_SIZE/2 || _dma.N < 0 ) goto error;
+
+  return;
+  
+ error:
+  for ( i= 0; i < 24; ++i )
+    {
+      _voices[i].adsr.mode= STOP;
+      _voices[i].adsr.rec_base_addr= 0xFFFF;
+    }
+  _out.N= 0;
+  _cd.rec_base_addr_l= _cd.rec_base_addr_r= 0;
+  _io.mode= STOP_IO;
+  _io.N= 0;
+  _io.current_addr= 0;
+  _reverb.current_addr= _reverb.base_addr= 0;
+  _reverb.step= 0;
+  _dma.p= _dma.N= 0;
+  _dma.ready= false;
+  st->error= true;
+  
+} // end PSX_spu_state_load
+
+
 uint16_t
 PSX_spu_voice_get_start_addr (
         		      const int voice
@@ -2698,3 +2844,12 @@ PSX_spu_reset (void)
   _dma.N= 0;
   
 } // end PSX_spu_reset
+
+
+void
+PSX_spu_set_output (
+        	    const bool enable
+        	    )
+{
+  _output= enable;
+} // end PSX_spu_set_output
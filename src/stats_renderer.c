@@ -289,6 +289,7 @@ fill_line (
 
   if ( dummy ) return;
   if ( row < a->clip_y1 || row > a->clip_y2 ) return;
+  ++stats->nlines;
   beg= a->clip_x1 > lineA->c ? a->clip_x1 : lineA->c;
   end= a->clip_x2 < lineB->c ? a->clip_x2 : lineB->c;
   npixels= end-beg;
@@ -431,6 +432,7 @@ pol3 (
 
 
   stats->npixels= 0;
+  stats->nlines= 0;
   v0= &(a->v[0]); v1= &(a->v[1]); v2= &(a->v[2]);
   if ( !sort_coords_pol3 ( &v0, &v1, &v2 ) )
     return;
@@ -451,6 +453,7 @@ pol4 (
 
 
   stats->npixels= 0;
+  stats->nlines= 0;
   va0= &(a->v[0]); va1= &(a->v[1]); va2= &(a->v[2]);
   vb0= &(a->v[1]); vb1= &(a->v[2]); vb2= &(a->v[3]);
   if ( !sort_coords_pol3 ( &va0, &va1, &va2 ) ) 
@@ -489,6 +492,7 @@ rect (
   
 
   stats->npixels= 0;
+  stats->nlines= 0;
   cy1= a->clip_y1 - a->v[0].y; cy2= a->clip_y2 - a->v[0].y;
   cx1= a->clip_x1 - a->v[0].x; cx2= a->clip_x2 - a->v[0].x;
   beg= cy1>0 ? cy1 : 0;
@@ -517,6 +521,7 @@ line (
   
 
   stats->npixels= 0;
+  stats->nlines= 0;
   
   // Prepara.
   dx= a->v[1].x - a->v[0].x;
@@ -607,6 +612,7 @@ PSX_create_stats_renderer (void)
   new->line= line;
   new->draw= draw;
   new->enable_display= enable_display;
+  new->vram_written= NULL; // No manté VRAM.
   
   return PSX_RENDERER(new);
   
@@ -0,0 +1,861 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/PSX.
+ *
+ * adriagipas/PSX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/PSX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/PSX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  threaded_renderer.c - Implementació de PSX_Renderer que executa
+ *                        un altre renderer en un o més fils a banda.
+ *
+ */
+/*
+ * NOTA: La cua té un únic productor (el fil de la simulació) i un
+ * únic consumidor (el fil del renderer). 'head' sols l'escriu el
+ * productor i 'tail' sols el consumidor, per tant no cal cap mutex
+ * per a afegir o traure comandaments. El mutex i les condicions sols
+ * s'empren quan un dels dos s'ha de dormir: el consumidor quan la cua
+ * està buida i el productor quan està plena o quan espera que es
+ * buide (lock, unlock, draw...). Abans de dormir-se cadascú ho indica
+ * en 'sleeping'/'waiting', i l'altre sols agafa el mutex si ho veu.
+ *
+ * Amb més d'un fil la VRAM es divideix en bandes horitzontals, cada
+ * fil té la seua cua i sols dibuixa en la seua banda (es retalla
+ * clip_y1/clip_y2). Dins d'una banda l'ordre es manté, però entre
+ * bandes no, i un polígon amb textura pot llegir files d'altra
+ * banda. Per això es guarden les regions escrites i llegides des de
+ * l'última sincronització, i si una primitiva llig el que altra ha
+ * escrit (o escriu el que altra llig) primer s'espera a tots els
+ * fils.
+ */
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "PSX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define DR(ptr) ((threaded_renderer_t *) (ptr))
+
+#define RING_SIZE 1024 // Potència de 2.
+#define RING_MASK (RING_SIZE-1)
+
+// Voltes que es fan comprovant la cua abans de dormir-se.
+#define SPIN 1000
+
+#define NLINES 512
+#define NCOLS 1024
+
+#define MAX_THREADS 16
+
+// Regions que es guarden entre sincronitzacions. Si no caben es
+// fusionen.
+#define MAX_RECTS 8
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef enum
+  {
+    CMD_POL3,
+    CMD_POL4,
+    CMD_RECT,
+    CMD_LINE
+  } cmd_t;
+
+typedef struct
+{
+
+  cmd_t            cmd;
+  int              width,height; // Sols per a CMD_RECT.
+  PSX_RendererArgs args;
+
+} entry_t;
+
+// Rectangle de la VRAM (límits inclosos).
+typedef struct
+{
+  int x0,x1,y0,y1;
+} rect_t;
+
+typedef struct
+{
+  int    n;
+  rect_t v[MAX_RECTS];
+} rect_set_t;
+
+typedef struct threaded_renderer threaded_renderer_t;
+
+typedef struct
+{
+
+  threaded_renderer_t *self;
+  int                  y0,y1;     // Files de la banda.
+  pthread_t            thread;
+  pthread_mutex_t      mutex;
+  pthread_cond_t       cond_cmd;  // Hi ha comandaments o cal parar.
+  pthread_cond_t       cond_done; // S'ha consumit algun comandament.
+  atomic_bool          sleeping;  // El consumidor espera en cond_cmd.
+  atomic_bool          waiting;   // El productor espera en cond_done.
+  atomic_bool          stop;
+  atomic_uint          head;      // Següent posició a escriure.
+  atomic_uint          tail;      // Següent posició a llegir.
+  entry_t              ring[RING_SIZE];
+
+} worker_t;
+
+struct threaded_renderer
+{
+
+  PSX_RENDERER_CLASS;
+
+  PSX_Renderer *inner;    // Renderer que dibuixa.
+  PSX_Renderer *stats;    // Estadístics per a la GPU.
+  int           nworkers;
+  worker_t     *workers;  // Un per banda.
+  rect_set_t    written;  // Regions dibuixades des de l'última sync.
+  rect_set_t    read;     // Regions llegides com a textura.
+
+};
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+/* Consumidor *****************************************************************/
+// Espera que hi haja un comandament en la posició T. Torna false si
+// s'ha de parar i la cua està buida.
+static bool
+wait_cmd (
+          worker_t           *w,
+          const unsigned int  t
+          )
+{
+
+  int n;
+
+
+  for ( n= 0; n < SPIN; ++n )
+    if ( atomic_load ( &w->head ) != t ) return true;
+  pthread_mutex_lock ( &w->mutex );
+  atomic_store ( &w->sleeping, true );
+  while ( atomic_load ( &w->head ) == t && !atomic_load ( &w->stop ) )
+    pthread_cond_wait ( &w->cond_cmd, &w->mutex );
+  atomic_store ( &w->sleeping, false );
+  pthread_mutex_unlock ( &w->mutex );
+
+  return atomic_load ( &w->head ) != t;
+
+} // end wait_cmd
+
+
+static void
+run_cmd (
+         threaded_renderer_t *self,
+         entry_t             *e
+         )
+{
+
+  PSX_RendererStats stats;
+
+
+  switch ( e->cmd )
+    {
+    case CMD_POL3:
+      self->inner->pol3 ( self->inner, &(e->args), &stats );
+      break;
+    case CMD_POL4:
+      self->inner->pol4 ( self->inner, &(e->args), &stats );
+      break;
+    case CMD_RECT:
+      self->inner->rect ( self->inner, &(e->args),
+        		  e->width, e->height, &stats );
+      break;
+    case CMD_LINE:
+      self->inner->line ( self->inner, &(e->args), &stats );
+      break;
+    }
+
+} // end run_cmd
+
+
+static void *
+loop (
+      void *data
+      )
+{
+
+  worker_t *w;
+  unsigned int t;
+
+
+  w= (worker_t *) data;
+  t= atomic_load ( &w->tail );
+  while ( wait_cmd ( w, t ) )
+    {
+      run_cmd ( w->self, &(w->ring[t&RING_MASK]) );
+      atomic_store ( &w->tail, ++t );
+      if ( atomic_load ( &w->waiting ) )
+        {
+          pthread_mutex_lock ( &w->mutex );
+          pthread_cond_signal ( &w->cond_done );
+          pthread_mutex_unlock ( &w->mutex );
+        }
+    }
+
+  return NULL;
+
+} // end loop
+
+
+/* Regions ********************************************************************/
+static bool
+rect_overlap (
+              const rect_t *a,
+              const rect_t *b
+              )
+{
+  return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+} // end rect_overlap
+
+
+static void
+rect_union (
+            rect_t       *a,
+            const rect_t *b
+            )
+{
+
+  if ( b->x0 < a->x0 ) a->x0= b->x0;
+  if ( b->x1 > a->x1 ) a->x1= b->x1;
+  if ( b->y0 < a->y0 ) a->y0= b->y0;
+  if ( b->y1 > a->y1 ) a->y1= b->y1;
+
+} // end rect_union
+
+
+static bool
+rects_overlap (
+               const rect_set_t *set,
+               const rect_t     *r
+               )
+{
+
+  int i;
+
+
+  for ( i= 0; i < set->n; ++i )
+    if ( rect_overlap ( &(set->v[i]), r ) )
+      return true;
+
+  return false;
+
+} // end rects_overlap
+
+
+// Afegeix R. Si ja no cap es fusiona amb el rectangle que menys
+// creix.
+static void
+rects_add (
+           rect_set_t   *set,
+           const rect_t *r
+           )
+{
+
+  int i,best;
+  long area,best_area;
+  rect_t tmp;
+
+
+  for ( i= 0; i < set->n; ++i )
+    if ( r->x0 >= set->v[i].x0 && r->x1 <= set->v[i].x1 &&
+         r->y0 >= set->v[i].y0 && r->y1 <= set->v[i].y1 )
+      return;
+  if ( set->n < MAX_RECTS ) { set->v[set->n++]= *r; return; }
+  best= 0; best_area= -1;
+  for ( i= 0; i < set->n; ++i )
+    {
+      tmp= set->v[i];
+      rect_union ( &tmp, r );
+      area= ((long) (tmp.x1-tmp.x0+1))*(tmp.y1-tmp.y0+1);
+      if ( best_area < 0 || area < best_area ) { best= i; best_area= area; }
+    }
+  rect_union ( &(set->v[best]), r );
+
+} // end rects_add
+
+
+// Regió que pot dibuixar la primitiva. Torna false si és buida.
+static bool
+prim_region (
+             const cmd_t             cmd,
+             const PSX_RendererArgs *args,
+             const int               width,
+             const int               height,
+             rect_t                 *r
+             )
+{
+
+  int i,n;
+
+
+  if ( cmd == CMD_RECT )
+    {
+      r->x0= args->v[0].x; r->x1= args->v[0].x + width - 1;
+      r->y0= args->v[0].y; r->y1= args->v[0].y + height - 1;
+    }
+  else
+    {
+      n= cmd == CMD_POL4 ? 4 : (cmd == CMD_POL3 ? 3 : 2);
+      r->x0= r->x1= args->v[0].x;
+      r->y0= r->y1= args->v[0].y;
+      for ( i= 1; i < n; ++i )
+        {
+          if ( args->v[i].x < r->x0 ) r->x0= args->v[i].x;
+          if ( args->v[i].x > r->x1 ) r->x1= args->v[i].x;
+          if ( args->v[i].y < r->y0 ) r->y0= args->v[i].y;
+          if ( args->v[i].y > r->y1 ) r->y1= args->v[i].y;
+        }
+    }
+  if ( r->x0 < args->clip_x1 ) r->x0= args->clip_x1;
+  if ( r->x1 > args->clip_x2 ) r->x1= args->clip_x2;
+  if ( r->y0 < args->clip_y1 ) r->y0= args->clip_y1;
+  if ( r->y1 > args->clip_y2 ) r->y1= args->clip_y2;
+
+  return r->x0 <= r->x1 && r->y0 <= r->y1;
+
+} // end prim_region
+
+
+// Regió de X halfwords a partir de (X,Y). Si passa de la columna
+// 1023 el renderer continua en la fila següent.
+static void
+vram_region (
+             const int  x,
+             const int  y,
+             const int  width,
+             const int  height,
+             rect_t    *r
+             )
+{
+
+  r->y0= y;
+  if ( x+width > NCOLS )
+    {
+      r->x0= 0; r->x1= NCOLS-1;
+      r->y1= y+height;
+    }
+  else
+    {
+      r->x0= x; r->x1= x+width-1;
+      r->y1= y+height-1;
+    }
+  if ( r->y1 >= NLINES ) r->y1= NLINES-1;
+
+} // end vram_region
+
+
+// Regions que llig la primitiva com a textura (pàgina i CLUT). Torna
+// el número de regions.
+static int
+tex_regions (
+             const cmd_t             cmd,
+             const PSX_RendererArgs *args,
+             rect_t                  r[2]
+             )
+{
+
+  if ( cmd == CMD_LINE ) return 0;
+  switch ( args->texture_mode )
+    {
+    case PSX_TEX_4b:
+      vram_region ( args->texpage_x*64, args->texpage_y*256, 64, 256, &r[0] );
+      vram_region ( args->texclut_x*16, args->texclut_y, 16, 1, &r[1] );
+      return 2;
+    case PSX_TEX_8b:
+      vram_region ( args->texpage_x*64, args->texpage_y*256, 128, 256, &r[0] );
+      vram_region ( args->texclut_x*16, args->texclut_y, 256, 1, &r[1] );
+      return 2;
+    case PSX_TEX_15b:
+      vram_region ( args->texpage_x*64, args->texpage_y*256, 256, 256, &r[0] );
+      return 1;
+    default: return 0;
+    }
+
+} // end tex_regions
+
+
+/* Productor ******************************************************************/
+// Espera fins que en la cua queden com a màxim MAX comandaments.
+static void
+wait_done (
+           worker_t           *w,
+           const unsigned int  max
+           )
+{
+
+  unsigned int h;
+  int n;
+
+
+  h= atomic_load ( &w->head );
+  for ( n= 0; n < SPIN; ++n )
+    if ( h - atomic_load ( &w->tail ) <= max ) return;
+  pthread_mutex_lock ( &w->mutex );
+  atomic_store ( &w->waiting, true );
+  while ( h - atomic_load ( &w->tail ) > max )
+    pthread_cond_wait ( &w->cond_done, &w->mutex );
+  atomic_store ( &w->waiting, false );
+  pthread_mutex_unlock ( &w->mutex );
+
+} // end wait_done
+
+
+// Espera que tots els fils hagen dibuixat tots els comandaments.
+static void
+sync_ (
+       threaded_renderer_t *self
+       )
+{
+
+  int i;
+
+
+  for ( i= 0; i < self->nworkers; ++i )
+    wait_done ( &(self->workers[i]), 0 );
+  self->written.n= 0;
+  self->read.n= 0;
+
+} // end sync_
+
+
+static void
+push_worker (
+             worker_t               *w,
+             const cmd_t             cmd,
+             const PSX_RendererArgs *args,
+             const int               width,
+             const int               height
+             )
+{
+
+  unsigned int h;
+  entry_t *e;
+
+
+  wait_done ( w, RING_SIZE-1 );
+  h= atomic_load ( &w->head );
+  e= &(w->ring[h&RING_MASK]);
+  e->cmd= cmd;
+  e->width= width;
+  e->height= height;
+  e->args= *args;
+  atomic_store ( &w->head, h+1 );
+  if ( atomic_load ( &w->sleeping ) )
+    {
+      pthread_mutex_lock ( &w->mutex );
+      pthread_cond_signal ( &w->cond_cmd );
+      pthread_mutex_unlock ( &w->mutex );
+    }
+
+} // end push_worker
+
+
+static void
+push (
+      threaded_renderer_t    *self,
+      const cmd_t             cmd,
+      const PSX_RendererArgs *args,
+      const int               width,
+      const int               height
+      )
+{
+
+  PSX_RendererArgs band_args;
+  rect_t region,tex[2];
+  int i,ntex;
+  bool self_read;
+  worker_t *w;
+
+
+  // Un sol fil, no cal res més.
+  if ( self->nworkers == 1 )
+    {
+      push_worker ( &(self->workers[0]), cmd, args, width, height );
+      return;
+    }
+
+  // Dependències amb primitives d'altres bandes.
+  if ( !prim_region ( cmd, args, width, height, &region ) ) return;
+  ntex= tex_regions ( cmd, args, tex );
+  self_read= false;
+  for ( i= 0; i < ntex; ++i )
+    {
+      if ( rects_overlap ( &self->written, &tex[i] ) ) sync_ ( self );
+      if ( rect_overlap ( &region, &tex[i] ) ) self_read= true;
+    }
+  if ( rects_overlap ( &self->read, &region ) ) sync_ ( self );
+
+  // Si llig el que ella mateixa dibuixa l'ordre dels píxels importa,
+  // es dibuixa sencera en un fil i sense res més en paral·lel.
+  if ( self_read )
+    {
+      sync_ ( self );
+      push_worker ( &(self->workers[0]), cmd, args, width, height );
+      sync_ ( self );
+      return;
+    }
+  
+  // Envia a cada banda.
+  for ( i= 0; i < self->nworkers; ++i )
+    {
+      w= &(self->workers[i]);
+      if ( w->y1 < region.y0 || w->y0 > region.y1 ) continue;
+      band_args= *args;
+      if ( band_args.clip_y1 < w->y0 ) band_args.clip_y1= w->y0;
+      if ( band_args.clip_y2 > w->y1 ) band_args.clip_y2= w->y1;
+      push_worker ( w, cmd, &band_args, width, height );
+    }
+  rects_add ( &self->written, &region );
+  for ( i= 0; i < ntex; ++i )
+    rects_add ( &self->read, &tex[i] );
+
+} // end push
+
+
+// Para els primers N fils.
+static void
+stop_workers (
+              threaded_renderer_t *self,
+              const int            n
+              )
+{
+
+  int i;
+  worker_t *w;
+
+
+  for ( i= 0; i < n; ++i )
+    {
+      w= &(self->workers[i]);
+      pthread_mutex_lock ( &w->mutex );
+      atomic_store ( &w->stop, true );
+      pthread_cond_signal ( &w->cond_cmd );
+      pthread_mutex_unlock ( &w->mutex );
+      pthread_join ( w->thread, NULL );
+    }
+  for ( i= 0; i < self->nworkers; ++i )
+    {
+      w= &(self->workers[i]);
+      pthread_cond_destroy ( &w->cond_done );
+      pthread_cond_destroy ( &w->cond_cmd );
+      pthread_mutex_destroy ( &w->mutex );
+    }
+
+} // end stop_workers
+
+
+
+
+/***********/
+/* MÈTODES */
+/***********/
+
+static void
+free_ (
+       PSX_Renderer *rend
+       )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(rend);
+  stop_workers ( self, self->nworkers );
+  PSX_renderer_free ( self->stats );
+  free ( self->workers );
+  free ( self );
+
+} // end free_
+
+
+static void
+lock (
+      PSX_Renderer *renderer,
+      uint16_t     *fb
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  sync_ ( self );
+  self->inner->lock ( self->inner, fb );
+
+} // end lock
+
+
+static void
+unlock (
+        PSX_Renderer *renderer,
+        uint16_t     *fb
+        )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  sync_ ( self );
+  self->inner->unlock ( self->inner, fb );
+
+} // end unlock
+
+
+static void
+pol3 (
+      PSX_Renderer      *renderer,
+      PSX_RendererArgs  *a,
+      PSX_RendererStats *stats
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  push ( self, CMD_POL3, a, 0, 0 );
+  self->stats->pol3 ( self->stats, a, stats );
+
+} // end pol3
+
+
+static void
+pol4 (
+      PSX_Renderer      *renderer,
+      PSX_RendererArgs  *a,
+      PSX_RendererStats *stats
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  push ( self, CMD_POL4, a, 0, 0 );
+  self->stats->pol4 ( self->stats, a, stats );
+
+} // end pol4
+
+
+static void
+rect (
+      PSX_Renderer      *renderer,
+      PSX_RendererArgs  *a,
+      const int          width,
+      const int          height,
+      PSX_RendererStats *stats
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  push ( self, CMD_RECT, a, width, height );
+  self->stats->rect ( self->stats, a, width, height, stats );
+
+} // end rect
+
+
+static void
+line (
+      PSX_Renderer      *renderer,
+      PSX_RendererArgs  *a,
+      PSX_RendererStats *stats
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  push ( self, CMD_LINE, a, 0, 0 );
+  self->stats->line ( self->stats, a, stats );
+
+} // end line
+
+
+static void
+draw (
+      PSX_Renderer            *renderer,
+      const PSX_FrameGeometry *g
+      )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  sync_ ( self );
+  self->inner->draw ( self->inner, g );
+
+} // end draw
+
+
+static void
+enable_display (
+        	PSX_Renderer *renderer,
+        	const bool    enable
+        	)
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  sync_ ( self );
+  self->inner->enable_display ( self->inner, enable );
+
+} // end enable_display
+
+
+static void
+vram_written (
+              PSX_Renderer *renderer,
+              const int     x,
+              const int     y,
+              const int     width,
+              const int     height
+              )
+{
+
+  threaded_renderer_t *self;
+
+
+  self= DR(renderer);
+  sync_ ( self );
+  if ( self->inner->vram_written != NULL )
+    self->inner->vram_written ( self->inner, x, y, width, height );
+
+} // end vram_written
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+PSX_Renderer *
+PSX_create_band_renderer (
+        		  PSX_Renderer *inner,
+        		  const int     nthreads
+        		  )
+{
+
+  threaded_renderer_t *new;
+  worker_t *w;
+  int i,n;
+
+
+  if ( nthreads < 1 || nthreads > MAX_THREADS ) return NULL;
+  new= (threaded_renderer_t *) malloc ( sizeof(threaded_renderer_t) );
+  if ( new == NULL ) return NULL;
+  new->workers= (worker_t *) malloc ( sizeof(worker_t)*nthreads );
+  if ( new->workers == NULL ) { free ( new ); return NULL; }
+  new->inner= inner;
+  new->stats= PSX_create_stats_renderer ();
+  if ( new->stats == NULL )
+    {
+      free ( new->workers );
+      free ( new );
+      return NULL;
+    }
+  new->nworkers= nthreads;
+  new->written.n= 0;
+  new->read.n= 0;
+
+  /* Mètodes. */
+  new->free= free_;
+  new->lock= lock;
+  new->unlock= unlock;
+  new->pol3= pol3;
+  new->pol4= pol4;
+  new->rect= rect;
+  new->line= line;
+  new->draw= draw;
+  new->enable_display= enable_display;
+  new->vram_written= vram_written;
+
+  /* Fils. */
+  for ( i= 0; i < nthreads; ++i )
+    {
+      w= &(new->workers[i]);
+      w->self= new;
+      w->y0= (i*NLINES)/nthreads;
+      w->y1= ((i+1)*NLINES)/nthreads - 1;
+      atomic_init ( &w->sleeping, false );
+      atomic_init ( &w->waiting, false );
+      atomic_init ( &w->stop, false );
+      atomic_init ( &w->head, 0 );
+      atomic_init ( &w->tail, 0 );
+      pthread_mutex_init ( &w->mutex, NULL );
+      pthread_cond_init ( &w->cond_cmd, NULL );
+      pthread_cond_init ( &w->cond_done, NULL );
+    }
+  for ( n= 0; n < nthreads; ++n )
+    if ( pthread_create ( &(new->workers[n].thread), NULL,
+        		  loop, &(new->workers[n]) ) != 0 )
+      goto error;
+
+  return PSX_RENDERER(new);
+
+ error:
+  stop_workers ( new, n );
+  PSX_renderer_free ( new->stats );
+  free ( new->workers );
+  free ( new );
+  return NULL;
+
+} // end PSX_create_band_renderer
+
+
+PSX_Renderer *
+PSX_create_threaded_renderer (
+        		      PSX_Renderer *inner
+        		      )
+{
+  return PSX_create_band_renderer ( inner, 1 );
+} // end PSX_create_threaded_renderer
@@ -79,38 +79,55 @@ typedef struct
 /* ESTAT */
 /*********/
 
-static struct
+typedef struct
 {
 
-  int cc; /* Cicles de CPUx11, és a dir, fraccions 1/11 de CPU. 7
-             fraccions son un cicle de GPU. */
-  int dot; /* Número de cicles gpu per a cada punt. */
-  
-} _dotclock;
+  struct
+  {
 
-static psx_timer_t _timer0;
-static bool _timer0_use_dotclock;
+    int cc; /* Cicles de CPUx11, és a dir, fraccions 1/11 de CPU. 7
+               fraccions son un cicle de GPU. */
+    int dot; /* Número de cicles gpu per a cada punt. */
 
-static psx_timer_t _timer1;
-static bool _timer1_use_hblank;
+  } _dotclock;
 
-static psx_timer_t _timer2;
-static struct
-{
-  int  cc;
-  bool enabled;
-} _timer2_cc8;
+  psx_timer_t _timer0;
+  bool _timer0_use_dotclock;
 
-// Controla quan cridar a clock.
-static struct
-{
-  
-  int cc_used;
-  int cc;
-  int cctoIRQ;
-  int cctoEvent;
-  
-} _timing;
+  psx_timer_t _timer1;
+  bool _timer1_use_hblank;
+
+  psx_timer_t _timer2;
+  struct
+  {
+    int  cc;
+    bool enabled;
+  } _timer2_cc8;
+
+  // Controla quan cridar a clock.
+  struct
+  {
+
+    int cc_used;
+    int cc;
+    int cctoIRQ;
+    int cctoEvent;
+
+  } _timing;
+
+} state_t;
+
+PSX_CTX_DEFINE ( state_t, TIMERS );
+
+#define STATE PSX_CTX_STATE ( state_t, TIMERS )
+#define _dotclock (STATE._dotclock)
+#define _timer0 (STATE._timer0)
+#define _timer0_use_dotclock (STATE._timer0_use_dotclock)
+#define _timer1 (STATE._timer1)
+#define _timer1_use_hblank (STATE._timer1_use_hblank)
+#define _timer2 (STATE._timer2)
+#define _timer2_cc8 (STATE._timer2_cc8)
+#define _timing (STATE._timing)
 
 
 
@@ -123,18 +140,13 @@ static void
 update_timing_event (void)
 {
 
-  int tmp;
-
-  
   // Actualitza cctoEvent
   _timing.cctoEvent= 100000; // ¿¿?????
   if ( _timing.cctoIRQ && _timing.cctoIRQ < _timing.cctoEvent )
     _timing.cctoEvent= _timing.cctoIRQ;
   
-  // Update PSX_NextEventCC
-  tmp= PSX_Clock + PSX_timers_next_event_cc ();
-  if ( tmp < PSX_NextEventCC )
-    PSX_NextEventCC= tmp;
+  // Planifica el següent event.
+  PSX_schedule ( PSX_EVENT_TIMERS, PSX_timers_next_event_cc () );
   
 } // end update_timing_event
 
@@ -533,48 +545,33 @@ clock (void)
 /**********************/
 /* FUNCIONS PÚBLIQUES */
 /**********************/
-#if 0
 void
-PSX_timers_clock (
-        	  const bool end_iter
-        	  )
+PSX_timers_clock (void)
 {
 
   int cc;
-
+  
   
   cc= PSX_Clock-_timing.cc_used;
   if ( cc > 0 )
     {
       _timing.cc+= cc;
       _timing.cc_used+= cc;
-      if ( (_timing.cctoIRQ && _timing.cc >= _timing.cctoIRQ) ||
-           _timing.cc >= 100000 )
+      if ( _timing.cc >= _timing.cctoEvent )
         clock ();
     }
-  if ( end_iter ) _timing.cc_used= 0;
   
 } // end PSX_timers_clock
-#endif
+
 
 void
 PSX_timers_end_iter (void)
 {
 
-  int cc;
-  
-  
-  cc= PSX_Clock-_timing.cc_used;
-  if ( cc > 0 )
-    {
-      _timing.cc+= cc;
-      _timing.cc_used+= cc;
-      if ( _timing.cc >= _timing.cctoEvent )
-        clock ();
-    }
+  PSX_timers_clock ();
   _timing.cc_used= 0;
   
-} // end PSX_timers_clock
+} // end PSX_timers_end_iter
 
 
 int
@@ -607,6 +604,42 @@ PSX_timers_init (void)
 } // end PSX_timers_init
 
 
+void
+PSX_timers_state_save (
+        	       PSX_State *st
+        	       )
+{
+
+  PSX_STATE_WRITE ( st, _dotclock );
+  PSX_STATE_WRITE ( st, _timer0 );
+  PSX_STATE_WRITE ( st, _timer0_use_dotclock );
+  PSX_STATE_WRITE ( st, _timer1 );
+  PSX_STATE_WRITE ( st, _timer1_use_hblank );
+  PSX_STATE_WRITE ( st, _timer2 );
+  PSX_STATE_WRITE ( st, _timer2_cc8 );
+  PSX_STATE_WRITE ( st, _timing );
+  
+} // end PSX_timers_state_save
+
+
+void
+PSX_timers_state_load (
+        	       PSX_State *st
+        	       )
+{
+
+  PSX_STATE_READ ( st, _dotclock );
+  PSX_STATE_READ ( st, _timer0 );
+  PSX_STATE_READ ( st, _timer0_use_dotclock );
+  PSX_STATE_READ ( st, _timer1 );
+  PSX_STATE_READ ( st, _timer1_use_hblank );
+  PSX_STATE_READ ( st, _timer2 );
+  PSX_STATE_READ ( st, _timer2_cc8 );
+  PSX_STATE_READ ( st, _timing );
+  
+} // end PSX_timers_state_load
+
+
 void
 PSX_timers_hblank_in (void)
 {